@@ -0,0 +1,40 @@
+/**
+ * @file catalog_bench.cpp
+ * @brief Benchmarks of translations taken from template catalogs
+ */
+
+#include <catalog.h>
+
+#include <filesystem>
+
+#include "harness.h"
+
+// cSpell: disable
+namespace {
+	
+	const std::string MSGID{"%{num}% file%{num!P:,s}% modified"};
+	const std::string TRANSLATION{"%{num}% plik%{num!P:,i,ów}% został%{num!P:,y,o}% zmodyfikowan%{num!P:y,e,ych}%"};
+	
+	void addCatalogBenchmarks() {
+		auto& plLocale = mls::locale::getLocale("pl_PL");
+		auto path = (std::filesystem::temp_directory_path() / "mls_bench.mlsc").string();
+		mls::backend::writeTemplateCatalog(path, plLocale, {{MSGID, TRANSLATION}});
+		static const mls::backend::TemplateCatalog catalog{path};
+		
+		bench::add("TemplateCatalog/open", [path]() {
+			mls::backend::TemplateCatalog opened{path};
+			bench::keep(opened);
+		});
+		bench::add("TemplateCatalog/translate", []() {
+			bench::keep( catalog.translate(MSGID).apply("num", 5).get() );
+		});
+		//what a .mo catalog does for every translation
+		bench::add("TemplateCatalog/parse_translation", [&plLocale]() {
+			mls::Template parsed{TRANSLATION, plLocale};
+			bench::keep( parsed.apply("num", 5).get() );
+		});
+	}
+	
+	bench::Suite catalogSuite{addCatalogBenchmarks};
+
+};
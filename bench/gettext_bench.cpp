@@ -0,0 +1,37 @@
+/**
+ * @file gettext_bench.cpp
+ * @brief Benchmarks of `mls::translate(...)` with the .mo file of the tests
+ */
+
+#include <gettext_backend.h>
+#include <template.h>
+
+#include "harness.h"
+
+namespace {
+	
+	void addGettextBenchmarks() {
+		mls::backend::init("gettext_test", "pl_PL.UTF-8", LOCALES_DIR);
+		
+		bench::add("translate/cached", []() {
+			bench::keep( _("To translate") );
+		});
+		bench::add("translate/cached_get", []() {
+			bench::keep( _("To translate").get() );
+		});
+		bench::add("translate/runtime_msgid", []() {
+			bench::keep( mls::translate("To translate") );
+		});
+		//the last one, as it turns the cache off
+		bench::add("translate/uncached", [cacheOff = false]() mutable {
+			if( !cacheOff ) {
+				mls::backend::setCacheCapacity(0u);
+				cacheOff = true;
+			}
+			bench::keep( _("To translate") );
+		});
+	}
+	
+	bench::Suite gettextSuite{addGettextBenchmarks};
+
+};
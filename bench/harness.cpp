@@ -0,0 +1,151 @@
+/**
+ * @file harness.cpp
+ * @brief Runs the registered benchmarks and prints their results as JSON or CSV
+ * 
+ * Options:
+ * `--format=json` (default) or `--format=csv`,
+ * `--filter=<text>` runs only benchmarks whose names contain the text,
+ * `--min-time=<ms>` the shortest time of one measured run (default 20).
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <new>
+#include <string_view>
+
+#include "harness.h"
+
+//------------- Counting allocations
+
+namespace {
+	std::atomic<std::size_t> allocationsCount{0u};
+};
+
+void* operator new(std::size_t size) {
+	allocationsCount.fetch_add(1u, std::memory_order_relaxed);
+	if( void* memory = std::malloc(size == 0u ? 1u : size) ) {
+		return memory;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+	std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+	std::free(memory);
+}
+
+//------------- The harness
+
+namespace bench {
+	
+	std::vector<Benchmark>& registry() {
+		static std::vector<Benchmark> benchmarks;
+		return benchmarks;
+	}
+	
+	std::vector<void (*)()>& suites() {
+		static std::vector<void (*)()> addAllFunctions;
+		return addAllFunctions;
+	}
+	
+	struct Result {
+		double nsPerOp;
+		double allocsPerOp;
+		std::size_t iterations;
+	};
+	
+	///the number of measured runs, the best one is reported
+	constexpr int RUNS = 5;
+	
+	double secondsOf(const Benchmark& benchmark, std::size_t iterations) {
+		auto start = std::chrono::steady_clock::now();
+		benchmark.run(iterations);
+		auto stop = std::chrono::steady_clock::now();
+		return std::chrono::duration<double>(stop - start).count();
+	}
+	
+	Result measure(const Benchmark& benchmark, double minSeconds) {
+		//find how many iterations take at least `minSeconds`
+		std::size_t iterations = 1u;
+		double seconds = secondsOf(benchmark, iterations);
+		while( seconds < minSeconds && iterations < (std::size_t{1} << 40) ) {
+			double scale = seconds > 0.0 ? 1.4 * minSeconds / seconds : 100.0;
+			iterations = static_cast<std::size_t>( static_cast<double>(iterations) * std::clamp(scale, 2.0, 100.0) );
+			seconds = secondsOf(benchmark, iterations);
+		}
+		
+		Result result{std::numeric_limits<double>::max(), 0.0, iterations};
+		for(int run=0; run<RUNS; ++run) {
+			std::size_t allocationsBefore = allocationsCount.load(std::memory_order_relaxed);
+			seconds = secondsOf(benchmark, iterations);
+			std::size_t allocations = allocationsCount.load(std::memory_order_relaxed) - allocationsBefore;
+			
+			result.nsPerOp = std::min(result.nsPerOp, seconds * 1e9 / static_cast<double>(iterations));
+			result.allocsPerOp = static_cast<double>(allocations) / static_cast<double>(iterations);
+		}
+		return result;
+	}
+
+};
+
+int main(int argc, char** argv) {
+	using namespace std::literals;
+	bool asCsv = false;
+	std::string_view filter{};
+	double minSeconds = 0.02;
+	
+	for(int i=1; i<argc; ++i) {
+		std::string_view option{argv[i]};
+		if( option == "--format=csv"sv ) {
+			asCsv = true;
+		} else if( option == "--format=json"sv ) {
+			asCsv = false;
+		} else if( option.starts_with("--filter="sv) ) {
+			filter = option.substr(9);
+		} else if( option.starts_with("--min-time="sv) ) {
+			minSeconds = std::atof(argv[i] + 11) / 1000.0;
+		} else {
+			std::fprintf(stderr, "Usage: %s [--format=json|csv] [--filter=<text>] [--min-time=<ms>]\n", argv[0]);
+			return 1;
+		}
+	}
+	
+	//the library's globals are ready now
+	for(auto addAll : bench::suites()) {
+		addAll();
+	}
+	
+	if( asCsv ) {
+		std::printf("name,ns_per_op,allocs_per_op,iterations\n");
+	} else {
+		std::printf("{\n\t\"benchmarks\": [");
+	}
+	bool first = true;
+	for(auto& benchmark : bench::registry()) {
+		if( benchmark.name.find(filter) == std::string::npos ) {
+			continue;
+		}
+		auto result = bench::measure(benchmark, minSeconds);
+		if( asCsv ) {
+			std::printf("%s,%.2f,%.2f,%zu\n", benchmark.name.c_str(), result.nsPerOp, result.allocsPerOp, result.iterations);
+		} else {
+			std::printf(
+				"%s\n\t\t{\"name\": \"%s\", \"ns_per_op\": %.2f, \"allocs_per_op\": %.2f, \"iterations\": %zu}",
+				first ? "" : ",", benchmark.name.c_str(), result.nsPerOp, result.allocsPerOp, result.iterations
+			);
+		}
+		std::fflush(stdout);
+		first = false;
+	}
+	if( !asCsv ) {
+		std::printf("\n\t]\n}\n");
+	}
+	return 0;
+}
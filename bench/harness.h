@@ -0,0 +1,62 @@
+#pragma once
+#ifndef MULAN_STRING_BENCH_HARNESS
+#define MULAN_STRING_BENCH_HARNESS
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * @file harness.h
+ * @brief A tiny harness for the MuLan String microbenchmarks
+ * 
+ * Every benchmark runs one operation in a loop. The harness reports the best time per operation
+ * of a few runs and the number of heap allocations per operation, counted by a replaced `operator new`.
+ */
+
+namespace bench {
+	
+	///keeps the compiler from removing a computation whose result isn't used
+	template<typename T>
+	inline void keep(const T& value) {
+		#if defined(_MSC_VER)
+		static const volatile void* sink;
+		sink = &value;
+		#else
+		asm volatile("" : : "r,m"(value) : "memory");
+		#endif
+	}
+	
+	struct Benchmark {
+		std::string name;
+		///runs the operation `iterations` times
+		std::function<void(std::size_t iterations)> run;
+	};
+	
+	///all registered benchmarks, in the order they were added
+	std::vector<Benchmark>& registry();
+	
+	///register an operation, the harness calls `operation()` in a loop
+	template<typename Operation>
+	void add(std::string name, Operation operation) {
+		registry().push_back( Benchmark{std::move(name), [operation](std::size_t iterations) mutable {
+			for(std::size_t i=0u; i<iterations; ++i) {
+				operation();
+			}
+		}} );
+	}
+	
+	///functions adding the benchmarks of each file, called by `main()`
+	std::vector<void (*)()>& suites();
+	
+	///registers a file's function adding its benchmarks, so the file only has to be linked in
+	struct Suite {
+		explicit Suite(void (*addAll)()) {
+			suites().push_back(addAll);
+		}
+	};
+
+};
+
+#endif //!MULAN_STRING_BENCH_HARNESS
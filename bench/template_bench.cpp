@@ -0,0 +1,238 @@
+/**
+ * @file template_bench.cpp
+ * @brief Benchmarks of the preparser, templates, number formats and plural rules
+ */
+
+#include <preparser.h>
+#include <template.h>
+#include <mls_locale.h>
+
+#include "harness.h"
+
+// cSpell: disable
+namespace {
+	
+	const std::string SHORT_TEMPLATE{"%{num}% file%{num!P:,s}%"};
+	
+	///a long paragraph with a few tags, like a translated e-mail body
+	std::string longTemplate() {
+		std::string result{"Dear %{name}%,\n"};
+		for(int i=0; i<40; ++i) {
+			result += "this paragraph of the message has no tags at all and only makes the text long enough. ";
+		}
+		result += "You have %{num}% new message%{num!P:,s}%.\n%{#signature#}%Regards";
+		return result;
+	}
+	
+	///a text made mostly of tags
+	std::string tagHeavyTemplate() {
+		std::string result;
+		for(int i=0; i<20; ++i) {
+			result += "%{n!I=grouped}% file%{n!P one={} other={s}}% %{#c#}%";
+		}
+		return result;
+	}
+	
+	void preparseBenchmarks(const char* name, std::string templateString) {
+		bench::add(std::string{"preparse_syntax/"} + name, [templateString]() {
+			auto parsed = mls::preparse::preparse_syntax(templateString);
+			bench::keep(parsed.tags.size());
+		});
+	}
+	
+	void addTemplateBenchmarks() {
+		auto& enLocale = mls::locale::getLocale("en_US");
+		auto& plLocale = mls::locale::getLocale("pl_PL");
+		
+		//---------- preparser
+		preparseBenchmarks("short", SHORT_TEMPLATE);
+		preparseBenchmarks("long", longTemplate());
+		preparseBenchmarks("tag_heavy", tagHeavyTemplate());
+		
+		static const std::string tagFree(64u * 1024u, 'x');
+		bench::add("find_text/tag_free_64k", []() {
+			bench::keep( mls::preparse::find_text(tagFree, mls::preparse::TEMPLATE_START) );
+		});
+		bench::add("string_view_find/tag_free_64k", []() {
+			bench::keep( std::string_view{tagFree}.find(mls::preparse::TEMPLATE_START) );
+		});
+		//many first characters of the marker, but no marker
+		static std::string percents;
+		while( percents.size() < 64u * 1024u ) {
+			percents += "100% sure ";
+		}
+		bench::add("find_text/percents_64k", []() {
+			bench::keep( mls::preparse::find_text(percents, mls::preparse::TEMPLATE_START) );
+		});
+		bench::add("string_view_find/percents_64k", []() {
+			bench::keep( std::string_view{percents}.find(mls::preparse::TEMPLATE_START) );
+		});
+		
+		//---------- construction
+		bench::add("template/construct", [&enLocale]() {
+			mls::Template t{SHORT_TEMPLATE, enLocale};
+			bench::keep(t);
+		});
+		bench::add("template/construct_literal", [&enLocale]() {
+			mls::Template t{mls::literal<"%{num}% file%{num!P:,s}%">, enLocale};
+			bench::keep(t);
+		});
+		
+		//---------- rendering
+		// the templates live as long as the program, like the ones kept by the backend's cache
+		static mls::Template plain{"A text without any tags", enLocale};
+		bench::add("get/plain", []() {
+			bench::keep( plain.get() );
+		});
+		
+		static mls::Template variable{"Hello %{name}%!", enLocale};
+		bench::add("get/variable", []() {
+			bench::keep( variable.apply("name", "World").get() );
+		});
+		
+		static mls::Template plural{"%{num}% file%{num!P:,s}%", enLocale};
+		bench::add("get/P", []() {
+			bench::keep( plural.apply("num", 5).get() );
+		});
+		
+		static mls::Template wife{"%{+SG=f}%żona", plLocale};
+		static mls::Template gender{"dobr%{person!G:y,a,e}% %{person}%", plLocale};
+		bench::add("get/G", []() {
+			bench::keep( gender.apply("person", wife).get() );
+		});
+		
+		static mls::Template home{"dom%{+C:,u,owi,,em,u,ie}%", plLocale};
+		static mls::Template grammarCase{"Wejście do %{obj!C=gen}%", plLocale};
+		bench::add("get/C", []() {
+			bench::keep( grammarCase.apply("obj", home).get() );
+		});
+		
+		static mls::Template integer{"%{num!I=grouped}%", enLocale};
+		bench::add("get/I", []() {
+			bench::keep( integer.apply("num", 1'234'567).get() );
+		});
+		
+		static mls::Template real{"%{num!R:grouped,3}%", enLocale};
+		bench::add("get/R", []() {
+			bench::keep( real.applyReal("num", 1234.5678).get() );
+		});
+		
+		static mls::Template inner{"%{num}% file%{num!P:,s}%", enLocale};
+		static mls::Template outer{"Found %{files}% in %{dir}%", enLocale};
+		bench::add("get/nested", []() {
+			inner.apply("num", 3);
+			bench::keep( outer.apply("files", inner).apply("dir", "/tmp").get() );
+		});
+		
+		//a list of people, each a template with an inflected noun
+		static mls::Template neighbour{"sąsiad%{+C:,a,owi,a,em,zie,zie}%", plLocale};
+		static mls::Template person{"%{who!C=ins}% z sąsiedniej wioski", plLocale};
+		static mls::Template people{"Rozmawiałem z %{first}%, %{second}% i %{third}%.", plLocale};
+		bench::add("get/nested_list", []() {
+			person.apply("who", neighbour);
+			bench::keep( people.apply("first", person).apply("second", person).apply("third", person).get() );
+		});
+		
+		static std::string buffer;
+		bench::add("get/P_into_buffer", []() {
+			buffer.clear();
+			plural.apply("num", 5).get(buffer);
+			bench::keep(buffer);
+		});
+		
+		static mls::Template letter{longTemplate(), enLocale};
+		bench::add("get/long", []() {
+			bench::keep( letter.apply("name", "Ann").apply("num", 3).get() );
+		});
+		static mls::IovecSink segments;
+		bench::add("get/long_into_iovec", []() {
+			segments.clear();
+			letter.apply("name", "Ann").apply("num", 3).get(segments);
+			bench::keep( segments.segments().size() );
+		});
+		
+		//---------- batches
+		static std::vector<long> numbers;
+		static std::vector<std::string_view> dirs;
+		for(long row=0; row<1000; ++row) {
+			numbers.push_back(row);
+			dirs.push_back(row % 2 == 0 ? "/tmp" : "/home/user");
+		}
+		static mls::Template report{"%{n}% file%{n!P:,s}% in %{dir}%", enLocale};
+		static mls::BatchOutput rows;
+		bench::add("rows_1000/apply_get", []() {
+			rows.text.clear();
+			for(std::size_t row=0u; row<numbers.size(); ++row) {
+				report.apply("n", numbers[row]).apply("dir", dirs[row]).get(rows.text);
+			}
+			bench::keep(rows.text);
+		});
+		bench::add("rows_1000/renderBatch", []() {
+			const mls::BatchColumn columns[] = {{"n", numbers}, {"dir", dirs}};
+			mls::renderBatch(*report.getCompiled(), columns, rows);
+			bench::keep(rows.text);
+		});
+		
+		//---------- locales
+		bench::add("getLocale/name", []() {
+			bench::keep( &mls::locale::getLocale("pl_PL") );
+		});
+		bench::add("getLocale/alias", []() {
+			bench::keep( &mls::locale::getLocale("Polish_Poland") );
+		});
+		bench::add("getNumberFormat/name", [&enLocale]() {
+			bench::keep( enLocale.getNumberFormat("grouped") );
+		});
+		
+		//---------- number formats
+		static auto* general = enLocale.getNumberFormat("general");
+		static auto* grouped = enLocale.getNumberFormat("grouped");
+		bench::add("formatInteger/general", []() {
+			bench::keep( general->formatInteger(1'234'567) );
+		});
+		bench::add("formatInteger/grouped", []() {
+			bench::keep( grouped->formatInteger(1'234'567'890) );
+		});
+		bench::add("formatReal/general", []() {
+			bench::keep( general->formatReal(1234.5678) );
+		});
+		bench::add("formatReal/grouped_precision", []() {
+			bench::keep( grouped->formatReal(1234567.5678, 2) );
+		});
+		
+		bench::add("getPluralIndex", [&plLocale, number = 0l]() mutable {
+			number = (number + 7) % 100'000;
+			bench::keep( plLocale.getPluralIndex(number) );
+		});
+		
+		//---------- plural rules
+		static const mls::locale::PluralRules polishRules{mls::locale::cldrPluralRules("pl")};
+		bench::add("PluralRules/select_pl", [number = std::uint64_t{0}]() mutable {
+			number = (number + 7u) % 1000u;
+			bench::keep( polishRules.select(number) );
+		});
+		static const mls::locale::PluralOperands realOperands = mls::locale::pluralOperands(2.5);
+		bench::add("PluralRules/select_pl_real", []() {
+			bench::keep( polishRules.select(realOperands) );
+		});
+		bench::add("PluralRules/parse_pl", []() {
+			mls::locale::PluralRules rules{mls::locale::cldrPluralRules("pl")};
+			bench::keep(rules);
+		});
+		const mls::locale::pluralizer rules[] = {
+			mls::locale::PluralRule0, mls::locale::PluralRule1, mls::locale::PluralRule2,
+			mls::locale::PluralRule3, mls::locale::PluralRule4, mls::locale::PluralRule5,
+			mls::locale::PluralRule6, mls::locale::PluralRule7, mls::locale::PluralRule8,
+			mls::locale::PluralRule9
+		};
+		for(int i=0; i<10; ++i) {
+			bench::add("PluralRule" + std::to_string(i), [rule = rules[i], number = 0ul]() mutable {
+				number = (number + 7u) % 1000u;
+				bench::keep( rule(number) );
+			});
+		}
+	}
+	
+	bench::Suite templateSuite{addTemplateBenchmarks};
+
+};
@@ -44,15 +44,35 @@ header += "\n**/\n\n"
 #list of all required headers from the C++ standard library
 header += """
 #include <string>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
 #include <charconv>
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <filesystem>
 #include <string>
 #include <string_view>
 #include <initializer_list>
+#include <iosfwd>
 #include <utility>
 #include <vector>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <ostream>
 #include <sstream>
+#include <span>
+#include <thread>
+#include <type_traits>
 #include <cctype>
 #include <variant>
 
@@ -63,22 +83,33 @@ header += """
 gettext_headers = """
 #include <libintl.h>
 #include <locale.h>
+#include <list>
+#include <mutex>
+#include <unordered_map>
 
 
 """
 
 mainHeadersList = [
 	"errors.h",
+	"plural_rules.h",
+	"mapped_file.h",
 	"mls_locale.h",
+	"locale_data.h",
 	"preparser.h",
-	"template.h"
+	"template.h",
+	"catalog.h"
 ]
 
 mainCodeList = [
 	"errors.cpp",
+	"plural_rules.cpp",
+	"mapped_file.cpp",
 	"mls_locale.cpp",
+	"locale_data.cpp",
 	"preparser.cpp",
-	"template.cpp"
+	"template.cpp",
+	"catalog.cpp"
 ]
 
 if __name__ == "__main__":
@@ -27,15 +27,35 @@ SOFTWARE.
 
 
 #include <string>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
 #include <charconv>
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <filesystem>
 #include <string>
 #include <string_view>
 #include <initializer_list>
+#include <iosfwd>
 #include <utility>
 #include <vector>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <ostream>
 #include <sstream>
+#include <span>
+#include <thread>
+#include <type_traits>
 #include <cctype>
 #include <variant>
 
@@ -43,6 +63,9 @@ SOFTWARE.
 
 #include <libintl.h>
 #include <locale.h>
+#include <list>
+#include <mutex>
+#include <unordered_map>
 
 
 
@@ -56,749 +79,525 @@ namespace mls {
 			const char* what() const noexcept override;
 	};
 	
+	class InvalidPluralRules : public std::exception {
+			const std::string err;
+		public:
+			InvalidPluralRules(std::string errString);
+			const char* what() const noexcept override;
+	};
+	
+	class InvalidLocaleData : public std::exception {
+			const std::string err;
+		public:
+			InvalidLocaleData(std::string errString);
+			const char* what() const noexcept override;
+	};
+	
+	class InvalidCatalog : public std::exception {
+			const std::string err;
+		public:
+			InvalidCatalog(std::string errString);
+			const char* what() const noexcept override;
+	};
+
 };
 
 
 
 namespace mls::locale {
 	
-	class NumberFormat {
-		public:
-			NumberFormat(
-				std::string groupChar, 
-				std::string fractionChar,
-				std::initializer_list<unsigned char> schema
-				);
-			
-			std::string formatInteger(long integer) const;
-			std::string formatReal(double real, short precision = -1) const;
-		private:
-			std::string integerGroupingChar;
-			std::string fractionSeparator;
-			std::vector<unsigned char> groupingSchema;
+	/**
+	 * @brief Operands of a number used by CLDR plural rules
+	 * 
+	 * See https://unicode.org/reports/tr35/tr35-numbers.html#Operands
+	 */
+	struct PluralOperands {
+		///the integer digits of the absolute value
+		std::uint64_t i = 0u;
+		///count of visible fraction digits, with trailing zeros
+		std::uint32_t v = 0u;
+		///count of visible fraction digits, without trailing zeros
+		std::uint32_t w = 0u;
+		///visible fraction digits, with trailing zeros
+		std::uint64_t f = 0u;
+		///visible fraction digits, without trailing zeros
+		std::uint64_t t = 0u;
 	};
 	
-	typedef std::string (*pluralizer)(long, std::string&);
+	PluralOperands pluralOperands(long integer);
+	///operands of a real number written with the given precision, `-1` is the shortest text which reads back the same
+	PluralOperands pluralOperands(double real, short precision = -1);
+	///operands of a number written in decimal, like `"1.50"`
+	PluralOperands pluralOperands(std::string_view decimal);
 	
-	class Locale {
-		std::string_view myName;
-		pluralizer pluralFunction;
-		std::vector<const char*> pluralsList;
-		std::vector<const char*> casesList;
-		std::vector<const char*> gendersList;
-		std::map<std::string, NumberFormat> numFormats;
+	/**
+	 * @brief CLDR plural rules compiled into a table of relations
+	 * 
+	 * Categories of integers are also kept in a table, so selecting them takes a lookup.
+	 * The rules are written like in CLDR: `"one: i = 1 and v = 0; few: v = 0 and i % 10 = 2..4"`.
+	 * Samples after `@` are ignored, `other` needs no condition and is always the last category.
+	 * The operands `e` and `c` (compact exponent) are always 0.
+	 * Invalid rules throw `InvalidPluralRules`.
+	 */
+	class PluralRules {
 		public:
-			Locale(
-				std::string_view name,
-				std::initializer_list<const char*> pluralForms,
-				pluralizer pluralFn,
-				std::initializer_list<const char*> cases,
-				std::initializer_list<const char*> genders,
-				std::initializer_list<std::pair<std::string, NumberFormat>> numberFormats
-			);
+			///only the `other` category
+			PluralRules();
+			explicit PluralRules(std::string_view rules);
+			/**
+			 * @brief Rules compiled before, read in place from the output of `program()`
+			 * 
+			 * The program must be aligned to 8 bytes and made on a machine with the same byte order.
+			 * `owner` keeps the program's memory alive. A broken program throws `InvalidPluralRules`.
+			 */
+			PluralRules(std::span<const std::byte> program, std::shared_ptr<const void> owner);
 			
-			bool isTheLocale(std::string_view localeName) const;
+			///names of categories, in the order of indexes returned by `select(...)`
+			const std::vector<const char*>& getCategories() const;
+			///the category of a non-negative integer
+			std::size_t select(std::uint64_t number) const;
+			std::size_t select(const PluralOperands& number) const;
+			///the compiled rules, which can be saved and read back by the constructor
+			std::span<const std::byte> program() const;
+		private:
+			///the start of a program, followed by its ranges, relations, ends and codes of categories and the table of integers
+			struct ProgramHeader {
+				///categories but `other`
+				std::uint32_t categoriesCount;
+				std::uint32_t relationsCount;
+				std::uint32_t rangesCount;
+				std::uint32_t integersTableSize;
+				std::uint64_t integersPeriod;
+			};
+			struct Relation {
+				enum class Operand : unsigned char {N, I, V, W, F, T, ZERO};
+				///`0` if there is no modulus
+				std::uint64_t modulus;
+				std::uint32_t firstRange;
+				std::uint32_t rangesCount;
+				Operand operand;
+				///`!=` or `not in`
+				bool negated;
+				///`within` also matches numbers with fractions between the ends of a range
+				bool within;
+				///the last relation of an `and` chain
+				bool endsAndChain;
+			};
+			struct Range {
+				std::uint64_t from;
+				std::uint64_t to;
+			};
 			
-			const std::vector<const char*>& getCasesList() const;
-			const std::vector<const char*>& getGendersList() const;
-			const std::vector<const char*>& getPluralsList() const;
+			///keeps the program alive, shared by copies
+			std::shared_ptr<const void> storage;
+			std::span<const std::byte> programBytes;
+			std::vector<const char*> categories;
+			///the end of relations of each category but `other`
+			std::span<const std::uint32_t> categoryEnds;
+			std::span<const Relation> relations;
+			std::span<const Range> ranges;
+			///categories of integers, larger ones repeat the last `integersPeriod` entries; empty if too big
+			std::span<const unsigned char> integersTable;
+			std::uint64_t integersPeriod = 1u;
+			static constexpr std::uint64_t MAX_INTEGERS_TABLE = 2048u;
 			
-			std::string getPluralID(long number) const;
-			NumberFormat * getNumberFormat(std::string_view name);
+			bool matches(const Relation& relation, const PluralOperands& number) const;
+			///runs the relations, the slow way
+			std::size_t evaluate(const PluralOperands& number) const;
+			///lays out the program and fills its table of integers
+			void compile(
+				const std::vector<Range>& newRanges,
+				const std::vector<Relation>& newRelations,
+				const std::vector<std::uint32_t>& newCategoryEnds,
+				const std::vector<unsigned char>& categoryCodes
+			);
+			///points the spans into the program, checking it
+			void readProgram(std::span<const std::byte> program);
+			///the size of the table of integers and its period; a size of 0 if the table would be too big
+			std::pair<std::uint64_t, std::uint64_t> integersTableShape() const;
 	};
 	
-	extern std::vector<Locale> localesList;
-	Locale& getLocale(std::string_view localeName);
+	///CLDR plural rules of a language given by its code, like `"pl"`; `nullptr` if unknown
+	const char* cldrPluralRules(std::string_view language);
+
 };
 
 
 
-namespace mls::preparse {
+namespace mls {
 	
-	class ParsedTemplateFunction {
-		public:
-			char name[2];
-			std::string varName;
-			
-			enum class Type {
-				VAR_ONLY,
-				ONE_ARG,
-				TABLE_ARG,
-				HASH_ARG
-			};
-			virtual Type getType() const =0;
+	/**
+	 * @brief A read-only mapping of a whole file, unmapped when destroyed
+	 * 
+	 * Processes mapping the same file share its pages.
+	 */
+	class MappedFile {
+			const std::byte* data;
+			std::size_t size;
 			
-			virtual ~ParsedTemplateFunction() {};
-	};
-	
-	class VarOnlyFunction : public ParsedTemplateFunction {
-		public:
-			virtual Type getType() const override;
-	};
-	
-	class OneArgFunction : public ParsedTemplateFunction {
+			MappedFile(const std::byte* mappedData, std::size_t mappedSize);
 		public:
-			virtual Type getType() const override;
+			///`nullptr` if the file can't be opened or mapped, or is empty
+			static std::shared_ptr<const MappedFile> open(const std::string& path);
 			
-			std::string argument;
+			MappedFile(const MappedFile&) = delete;
+			MappedFile& operator=(const MappedFile&) = delete;
+			~MappedFile();
 			
-			OneArgFunction(std::string_view templateContent);
+			std::span<const std::byte> bytes() const;
 	};
+
+};
+
+
+
+namespace mls::locale {
 	
-	class TableArgFunction : public ParsedTemplateFunction {
+	/**
+	 * @brief Separators and sizes of digit groups of numbers
+	 * 
+	 * The separators are not copied, they must live as long as the format, like string literals do.
+	 * Formats can be made while compiling, so built-in locales keep them in read-only memory.
+	 */
+	class NumberFormat {
 		public:
-			virtual Type getType() const override;
+			///the most sizes of digit groups, a longer schema keeps its first ones
+			static constexpr std::size_t MAX_GROUPS = 8u;
 			
-			std::vector<std::string> arguments;
+			constexpr NumberFormat(
+				std::string_view groupChar, 
+				std::string_view fractionChar,
+				std::initializer_list<unsigned char> schema
+				): NumberFormat(groupChar, fractionChar, std::span<const unsigned char>(schema.begin(), schema.size())) {}
+			constexpr NumberFormat(
+				std::string_view groupChar, 
+				std::string_view fractionChar,
+				std::span<const unsigned char> schema
+				): integerGroupingChar{groupChar}, fractionSeparator{fractionChar} {
+				for(unsigned char size : schema.first(schema.size() < MAX_GROUPS ? schema.size() : MAX_GROUPS)) {
+					groupingSchema[groupsCount++] = size;
+				}
+			}
 			
-			TableArgFunction(std::string_view templateContent);
-	};
-	
-	class HashArgFunction : public ParsedTemplateFunction {
-		public:
-			virtual Type getType() const override;
+			std::string formatInteger(long integer) const;
+			///appends the formatted integer to `output`, which doesn't allocate memory if `output` has room for it
+			void formatInteger(long integer, std::string& output) const;
+			///`precision` is the count of fractional digits, `-1` writes the shortest text which reads back as the same number
+			std::string formatReal(double real, short precision = -1) const;
+			///appends the formatted real number to `output`, which doesn't allocate memory if `output` has room for it
+			void formatReal(double real, std::string& output, short precision = -1) const;
+			///the longest output for a number with the given count of digits
+			std::size_t maxLength(std::size_t integerDigits, std::size_t fractionDigits = 0u) const;
 			
-			std::map<std::string, std::string> arguments;
+			std::string_view getGroupingChar() const;
+			std::string_view getFractionSeparator() const;
+			///sizes of digit groups from the right, the last one repeats
+			std::span<const unsigned char> getGroupingSchema() const;
+		private:
+			std::string_view integerGroupingChar;
+			std::string_view fractionSeparator;
+			///sizes of digit groups from the right, the last one repeats
+			unsigned char groupingSchema[MAX_GROUPS] = {};
+			unsigned char groupsCount = 0u;
 			
-			HashArgFunction(std::string_view templateContent);
+			std::size_t groupSize(std::size_t groupNo) const;
+			std::size_t countSeparators(std::size_t digitsCount) const;
+			///writes grouped digits backwards ending at `outEnd`, returns the beginning of the written text
+			char* writeGrouped(char* outEnd, const char* digits, std::size_t digitsCount) const;
 	};
 	
-	std::pair<std::vector<char*>, std::vector<ParsedTemplateFunction*>>
-		preparse_template(std::string_view templateString);
+	///returns the index of the plural form of the number in the locale's list of plural forms
+	typedef std::size_t (*pluralizer)(unsigned long);
 	
-};
-
-
-
-namespace mls {
+	///Plural rules of language families, each rule's list of forms is written by its definition
+	std::size_t PluralRule0(unsigned long number);
+	std::size_t PluralRule1(unsigned long number);
+	std::size_t PluralRule2(unsigned long number);
+	std::size_t PluralRule3(unsigned long number);
+	std::size_t PluralRule4(unsigned long number);
+	std::size_t PluralRule5(unsigned long number);
+	std::size_t PluralRule6(unsigned long number);
+	std::size_t PluralRule7(unsigned long number);
+	std::size_t PluralRule8(unsigned long number);
+	std::size_t PluralRule9(unsigned long number);
 	
-	class Template;
-	typedef std::variant<std::string_view, long, double, Template*> variableValue;
+	///identifies a number format by its name, the same in all locales
+	typedef std::uint32_t NumberFormatID;
+	constexpr NumberFormatID NO_NUMBER_FORMAT = 0xFFFF'FFFFu;
+	///the ID of a number format name, `NO_NUMBER_FORMAT` if no locale has such a format
+	NumberFormatID findNumberFormatID(std::string_view name);
+	///the name of a number format, empty if there is no such ID
+	std::string_view numberFormatName(NumberFormatID id);
 	
-	///interface for template functions
-	class TemplateFunction {
-		public:
-			virtual std::string produceString(std::map<std::string_view, variableValue> &variables) = 0;
-	};//!class TemplateFunction
+	struct NamedNumberFormat {
+		std::string_view name;
+		NumberFormat format;
+	};
 	
-	///Template class used to make string out of a template string and a locale
-	class Template {
+	/**
+	 * @brief A built-in locale, kept in read-only memory
+	 * 
+	 * Definitions are constant tables: making them takes no work when the program starts. 
+	 * The `Locale` of a definition is made on the first lookup of a locale.
+	 */
+	struct LocaleDefinition {
+		std::string_view name;
+		///other names of the locale, like `pl-PL` for `pl_PL`
+		std::span<const std::string_view> aliases;
+		///CLDR plural rules, see `PluralRules`
+		std::string_view pluralRules;
+		std::span<const char* const> cases;
+		std::span<const char* const> genders;
+		std::span<const NamedNumberFormat> numberFormats;
+	};
+	
+	///definitions of locales built into the library
+	std::span<const LocaleDefinition> builtInLocales();
+	
+	class Locale {
+		std::string_view myName;
+		///`nullptr` if the locale uses `pluralRules`
+		pluralizer pluralFunction = nullptr;
+		PluralRules pluralRules;
+		///plural forms of `pluralFunction`
+		std::span<const char* const> functionPlurals;
+		std::span<const char* const> casesList;
+		std::span<const char* const> gendersList;
+		std::span<const NamedNumberFormat> numFormats;
+		///lists made at run time, which the spans above may point to; shared by copies, empty for built-in locales
+		std::shared_ptr<const void> ownedLists;
+		///formats with the first IDs, looked up by ID without comparing names
+		static constexpr std::size_t INDEXED_FORMATS_COUNT = 16u;
+		///points into `numFormats`, `nullptr` for formats the locale doesn't have
+		const NumberFormat* formatsByID[INDEXED_FORMATS_COUNT] = {};
+		#ifdef MULANSTR_PLURAL_TABLE
+		///plural forms of numbers below `SMALL_NUMBERS_COUNT`, computed once
+		static constexpr unsigned long SMALL_NUMBERS_COUNT = 1000u;
+		unsigned char smallNumbersPlurals[SMALL_NUMBERS_COUNT];
+		#endif
+		
+		///copies the lists to `ownedLists`
+		void ownLists(
+			std::initializer_list<const char*> pluralForms,
+			std::initializer_list<const char*> cases,
+			std::initializer_list<const char*> genders,
+			std::initializer_list<std::pair<std::string, NumberFormat>> numberFormats
+		);
+		///interns names of `numFormats` and fills `formatsByID`
+		void indexNumberFormats();
+		///fills the table of small numbers
+		void fillPluralsTable();
 		public:
-			///default ctor
-			Template();
-			///no copy ctor
-			Template(const Template& other) = delete;
-			///move ctor
-			Template(Template&& other);
-			///standard ctor
-			Template(const std::string templateString, locale::Locale& locale);
-			~Template();
-			
-			//apply function group
-			
-			///set a raw string for a variable
-			Template& apply(std::string_view varName, std::string_view rawString);
-			///set an integer number for a variable
-			Template& apply(std::string_view varName, long number);
-			///set a real number for a variable
-			Template& applyReal(std::string_view varName, double number);
-			///set another template for a variable
-			Template& apply(std::string_view varName, Template& t);
-			
-			//end apply
+			Locale(
+				std::string_view name,
+				std::initializer_list<const char*> pluralForms,
+				pluralizer pluralFn,
+				std::initializer_list<const char*> cases,
+				std::initializer_list<const char*> genders,
+				std::initializer_list<std::pair<std::string, NumberFormat>> numberFormats
+			);
+			///plural forms given by CLDR plural rules, see `PluralRules`
+			Locale(
+				std::string_view name,
+				std::string_view cldrPluralRules,
+				std::initializer_list<const char*> cases,
+				std::initializer_list<const char*> genders,
+				std::initializer_list<std::pair<std::string, NumberFormat>> numberFormats
+			);
+			///plural forms given by compiled rules, like the ones read by `loadLocaleData(...)`; names aren't copied
+			Locale(
+				std::string_view name,
+				PluralRules rules,
+				std::vector<const char*> cases,
+				std::vector<const char*> genders,
+				std::vector<NamedNumberFormat> numberFormats
+			);
+			///a locale using the tables of the definition, only its plural rules are compiled
+			explicit Locale(const LocaleDefinition& definition);
 			
-			///runs the template and produces a result string
-			std::string get();
+			bool isTheLocale(std::string_view localeName) const;
+			std::string_view getName() const;
 			
-			std::string getGender();
-		private:
-			locale::Locale *myLocale;
-			std::string genderID;
-			std::vector<char*> stringsList;
-			std::map<std::string_view, variableValue> variables;
-			std::vector<TemplateFunction*> functionsList;
+			std::span<const char* const> getCasesList() const;
+			std::span<const char* const> getGendersList() const;
+			std::span<const char* const> getPluralsList() const;
 			
-	};//!class Template
+			///the index of the number's plural form in `getPluralsList()`
+			std::size_t getPluralIndex(long number) const;
+			///the index of the plural form of a number with a fraction, like `pluralOperands(1.5)`
+			std::size_t getPluralIndex(const PluralOperands& number) const;
+			std::string getPluralID(long number) const;
+			///`nullptr` if the locale's plural forms are given by a `pluralizer` function
+			const PluralRules* getPluralRules() const;
+			///`nullptr` if the locale has no such format
+			const NumberFormat * getNumberFormat(std::string_view name) const;
+			///an index into a table of the locale, no names are compared for the first IDs
+			const NumberFormat * getNumberFormat(NumberFormatID id) const;
+			std::span<const NamedNumberFormat> getNumberFormats() const;
+	};
 	
+	///another name of a locale, like `pl-PL` for `pl_PL`
+	struct LocaleAlias {
+		std::string_view alias;
+		std::string_view localeName;
+	};
+	
+	/**
+	 * @brief Locales added by the program, known to `findLocale(...)` and `getLocale(...)` with built-in ones
+	 * 
+	 * Their names and aliases are put in a hash table on the first lookup; after changing the lists call `registerLocales()`. 
+	 * Adding to `localesList` may move its locales, so changing the lists and registering them must be done 
+	 * before other threads use `findLocale(...)` or `getLocale(...)`, or while they don't.
+	 * A name of `loadedLocales` hides the same name in `localesList`, which hides a built-in locale.
+	 * The lists are empty when the program starts.
+	 */
+	extern std::vector<Locale> localesList;
+	extern std::vector<LocaleAlias> localeAliases;
+	///locales read by `loadLocaleData(...)`, kept apart so they never move
+	extern std::vector<std::unique_ptr<Locale>> loadedLocales;
+	///builds the hash table of `findLocale(...)` again from the lists above, no other thread may look locales up meanwhile
+	void registerLocales();
+	///finds a locale by its name or alias, `nullptr` if there is no such locale
+	Locale* findLocale(std::string_view nameOrAlias);
+	///finds a locale by its name or alias, unknown names give `en_US`
+	Locale& getLocale(std::string_view localeName);
 };
 
 
 
-namespace mls::backend {
+namespace mls::locale {
 	
-	class IntlNotInitialized : public std::exception {};
+	///the version of binary locale data files written and read by this library
+	constexpr std::uint16_t LOCALE_DATA_VERSION = 1u;
 	
 	/**
-	 * @brief initialize the GetText utility
+	 * @brief Reads locales from a binary locale data file into `loadedLocales` and their aliases into `localeAliases`, then registers them
 	 * 
-	 * @param packageName Name of the GetText unit to pass to `bindtextdomain(...)`
-	 * @param wantedLocale Force select a specific locale. Pass `nullptr` to use system locale
-	 * @param folderLookup Setup a specific folder to look for `*.mo` files. Pass `nullptr` to use the default `/usr/local/share/locale`
+	 * The file is mapped into memory and nothing is parsed: names, cases, genders and compiled plural rules 
+	 * are read in place, so processes loading the same file share its pages. The file stays mapped as long 
+	 * as its locales live. Files are made by `writeLocaleData(...)` on a machine with the same byte order.
+	 * Don't call it while other threads look up locales. A broken file throws `InvalidLocaleData` and adds nothing.
+	 * @return the count of loaded locales
 	 */
-	void init(
-		const char* packageName, 
-		const char* wantedLocale = nullptr, 
-		const char* folderLookup = nullptr
-		);
-};
-
-namespace mls {
-	
-	///Get template for `msgid` string
-	Template translate(const char* msgid);
-	
-	///Get template for `msgid` string in a .mo `catalog`
-	Template translate(const char* catalog, const char* msgid);
+	std::size_t loadLocaleData(const std::string& path);
 	
-};
-
-#ifndef MULANSTR_DONT_USE_UNDERSCORE
-
-#	define _(msgid) mls::translate(msgid)
-#	define _c(catalog, msgid) mls::translate(catalog, msgid)
-
-#endif
-
-
-
-
-
-#ifdef MULAN_STRING_IMPLEMENTATION
-
-
-
+	/**
+	 * @brief Writes locales and aliases of their names to a binary locale data file
+	 * 
+	 * Only locales with CLDR plural rules can be written, a locale with a `pluralizer` function throws `InvalidLocaleData`.
+	 */
+	void writeLocaleData(const std::string& path, const std::vector<const Locale*>& locales, const std::vector<LocaleAlias>& aliases);
 
-namespace mls {
-	
-	InvalidTemplateState::InvalidTemplateState(std::string errString): err{errString} {};
-	const char* InvalidTemplateState::what() const noexcept {
-		return err.c_str();
-	}
-	
 };
 
 
 
-namespace mls::locale {
-	
-	Locale::Locale(
-		std::string_view name,
-		std::initializer_list<const char*> pluralForms,
-		pluralizer pluralFn,
-		std::initializer_list<const char*> cases,
-		std::initializer_list<const char*> genders,
-		std::initializer_list<std::pair<std::string, NumberFormat>> numberFormats
-	) {
-		myName = name;
-		pluralFunction = pluralFn;
-		for(const char* pl : pluralForms) {
-			pluralsList.push_back(pl);
-		}
-		pluralsList.shrink_to_fit();
-		for(const char* caseName : cases) {
-			casesList.push_back(caseName);
-		}
-		casesList.shrink_to_fit();
-		for(const char* gender : genders) {
-			gendersList.push_back(gender);
-		}
-		gendersList.shrink_to_fit();
-		for(auto format : numberFormats) {
-			numFormats.emplace( format.first, format.second );
-		}
-	}
+namespace mls::preparse {
 	
-	bool Locale::isTheLocale(std::string_view localeName) const {
-		return myName == localeName;
-	}
+	//------------ Configuration
+	// The tag markers are used at compile time too, so they must be the same in every file
 	
-	const std::vector<const char*>& Locale::getCasesList() const {
-		return casesList;
-	}
+	#ifdef MULANSTR_TAG_START
+	constexpr std::string_view TEMPLATE_START{MULANSTR_TAG_START};
+	#else
+	constexpr std::string_view TEMPLATE_START{"%{"};
+	#endif
 	
-	const std::vector<const char*>& Locale::getGendersList() const {
-		return gendersList;
-	}
+	#ifdef MULANSTR_TAG_END
+	constexpr std::string_view TEMPLATE_END{MULANSTR_TAG_END};
+	#else
+	constexpr std::string_view TEMPLATE_END{"}%"};
+	#endif
 	
-	const std::vector<const char*>& Locale::getPluralsList() const {
-		return pluralsList;
-	}
+	#ifdef MULANSTR_INNER_TAG_START
+	constexpr std::string_view INNER_TAG_START{MULANSTR_INNER_TAG_START};
+	#else
+	constexpr std::string_view INNER_TAG_START{"{"};
+	#endif
 	
-	NumberFormat * Locale::getNumberFormat(std::string_view name) {
-		for(auto& format : numFormats) {
-			if( format.first == name ) {
-				return &(format.second);
-			}
-		}
-		//no match
-		return nullptr;
-	}
+	#ifdef MULANSTR_INNER_TAG_END
+	constexpr std::string_view INNER_TAG_END{MULANSTR_INNER_TAG_END};
+	#else
+	constexpr std::string_view INNER_TAG_END{"}"};
+	#endif
 	
-	std::string Locale::getPluralID(long number) const {
-		std::string asString = std::to_string(number);
-		return pluralFunction(number, asString);
-	}
+	constexpr std::string_view VAR_FN_DIVIDER{"!"};
+	constexpr std::string_view NO_VAR_FN{"+"};
+	constexpr char COMMENT_MARKER = '#';
 	
-	NumberFormat::NumberFormat(
-		std::string groupChar, 
-		std::string fractionChar,
-		std::initializer_list<unsigned char> schema
-		) {
-		integerGroupingChar = groupChar;
-		fractionSeparator = fractionChar;
-		for(unsigned char s : schema) {
-			groupingSchema.push_back(s);
-		}
-		groupingSchema.shrink_to_fit();
-	}
-	
-	std::string NumberFormat::formatInteger(long integer) const {
-		char intStr[50];
-		bool negative = integer < 0;
-		auto[lastPtr, err] = std::to_chars(&intStr[0], &intStr[49], std::abs(integer), 10);
-		
-		std::string result;
-		
-		if( groupingSchema.size() == 0u ) {
-			//no grouping
-			result = std::string(&intStr[0], lastPtr - &intStr[0]);
-		} else {
-			unsigned char currentGroup = groupingSchema[0];
-			unsigned char groupNo = 0u;
-			char* charGroup;
-			
-			while( lastPtr != &intStr[0] ) {
-				if( groupNo < groupingSchema.size() - 1 ) {
-					++groupNo;
-					currentGroup = groupingSchema[groupNo];
-				}
-				
-				if( lastPtr - &intStr[0] <= currentGroup ) {
-					result = std::string(&intStr[0], lastPtr - &intStr[0]) + result;
-					lastPtr = &intStr[0];
-					break;
-				} else {
-					charGroup = lastPtr - currentGroup;
-					result = std::string(charGroup, currentGroup) + result;
-					lastPtr = charGroup;
-				}
-				
-				if( lastPtr != &intStr[0]) {
-					result = integerGroupingChar + result;
-				}
-			}
-		}
-		
-		if(negative)
-			return std::string("-") + result;
-		else
-			return result;
-	}
-	
-	std::string NumberFormat::formatReal(double real, short precision) const {
-		long integerPart = static_cast<long>(real);
-		real -= integerPart; //only fractions
-		
-		if( precision == 0 ) {
-			return formatInteger(integerPart);
-		}
-		
-		if( precision > 0 ) {
-			const double modifer = std::pow(10.0, precision);
-			real = std::round( real * modifer ) / modifer;
-		}
-		
-		std::string result = formatInteger(integerPart);
-		
-		if( real == 0.0 )
-			return result;
-		
-		char realStr[50];
-		auto[lastPtr, err] = std::to_chars(&realStr[0], &realStr[49], real, std::chars_format::fixed);
-		
-		char* dotPos = &realStr[0];
-		while( dotPos != lastPtr ) {
-			if( *dotPos == '.' ) {
-				++dotPos;
-				break;
-			}
-			++dotPos;
-		}
-		
-		result = result + fractionSeparator + std::string(dotPos, lastPtr - dotPos);
-		return result;
-	}
-	
-	// helper functions used by pluralizer functions
-	bool hasEnding (std::string const &fullString, std::string_view ending) {
-		if (fullString.length() >= ending.length()) {
-			return (fullString.compare (fullString.length() - ending.length(), ending.length(), ending) == 0);
-		} else {
-			return false;
-		}
-	}
-
-	int twoDigitsEnding(std::string &number) {
-		if(number.length() >= 2)
-			return std::stoi(number.substr(number.length() - 2));
-		else
-			return  std::stoi(number);
-	}
-	/*
-	
-	===================== Plurals ======================
-	based on: https://developer.mozilla.org/en-US/docs/Mozilla/Localization/Localization_and_Plurals
-	
-	*/
-
-	// cSpell: disable
-
-	//Families: Asian (Chinese, Japanese, Korean), Persian, Turkic/Altaic (Turkish), Thai, Lao
-	std::string PluralRule0(long numberAsInt, std::string &numberAsString) {
-		return "other";
-	}
-
-	//Families: Germanic, Finno-Ugric, Language isolate, Latin/Greek, Semitic, Romanic, Vietnamese
-	std::string PluralRule1(long numberAsInt, std::string &numberAsString) {
-		if(numberAsInt == 1) return "one";
-		return "other";
-	}
-
-	//Families: Romanic (French, Brazilian Portuguese), Lingala
-	std::string PluralRule2(long numberAsInt, std::string &numberAsString) {
-		if( numberAsInt == 1 || numberAsInt == 0) return "zero_one";
-		return "other";
-	}
-
-	//Families: Baltic (Latvian, Latgalian)
-	std::string PluralRule3(long numberAsInt, std::string &numberAsString) {
-		if( hasEnding(numberAsString,"0")) return "zero";
-		if( hasEnding(numberAsString,"1") && !hasEnding(numberAsString,"11")) return "one";
-		return "other";
-	}
-
-	//Families: Celtic (Scottish Gaelic)
-	std::string PluralRule4(long numberAsInt, std::string &numberAsString) {
-		if( numberAsInt == 1 || numberAsInt == 11 ) return "one";
-		if( numberAsInt == 2 || numberAsInt == 12 ) return "two";
-		if( 
-			(numberAsInt >= 3 && numberAsInt <= 10)
-			||
-			(numberAsInt >= 13 && numberAsInt <= 19)
-			) return "three";
-		return "other";
-	}
-
-	//Families: Romanic (Romanian)
-	std::string PluralRule5(long numberAsInt, std::string &numberAsString) {
-		if( numberAsInt == 1 ) return "one";
-		int ending = twoDigitsEnding(numberAsString);
-		if( numberAsInt == 0 || (ending >= 1 && ending <= 19) ) return "few";
-		return "other";
-	}
-
-	//Families: Baltic (Lithuanian)
-	std::string PluralRule6(long numberAsInt, std::string &numberAsString) {
-		if( numberAsInt != 11 && hasEnding(numberAsString,"1") ) return "one";
-		int ending = twoDigitsEnding(numberAsString);
-		if( hasEnding(numberAsString,"0") ||
-			(ending >= 11 && ending <= 19)
-		) return "few";
-		return "other";
-	}
-
-	//Families: Belarusian, Russian, Ukrainian
-	std::string PluralRule7(long numberAsInt, std::string &numberAsString) {
-		if( hasEnding(numberAsString,"1") && numberAsInt != 11 ) return "one";
-		int twoDigits = twoDigitsEnding(numberAsString);
-		if(
-			!( twoDigits >= 12 && twoDigits <= 14 )
-			&&
-			( hasEnding(numberAsString,"2") || hasEnding(numberAsString,"3") || hasEnding(numberAsString,"4") )
-		) return "few";
-		return "other";
-	}
-
-	//Families: Slavic (Slovak, Czech)
-	std::string PluralRule8(long numberAsInt, std::string &numberAsString) {
-		if( numberAsInt == 1 ) return "one";
-		if( numberAsInt >=2 && numberAsInt <= 4) return "few";
-		return "other";
-	}
-
-	//Families: Slavic (Polish)
-	std::string PluralRule9(long numberAsInt, std::string &numberAsString) {
-		if( numberAsInt == 1 ) return "one";
-		if(
-			!( hasEnding(numberAsString,"12") || hasEnding(numberAsString,"13") || hasEnding(numberAsString,"14") )
-			&&
-			( hasEnding(numberAsString,"2") || hasEnding(numberAsString,"3") || hasEnding(numberAsString,"4") )
-		) return "few";
-		return "other";
-	}
-
-	//TODO: make rules for the 10-19 positions
-	
-	/*
-	
-	=========================== Supported locales =====================
-	
-	*/
+	constexpr std::string_view FN_ARGS_DIV_ALL{"=: "};
+	constexpr char FN_ARGS_DIV_ONE = '=';
+	constexpr char FN_ARGS_DIV_TABLE = ':';
+	constexpr char FN_ARGS_DIV_HASH = ' ';
 	
-	std::vector<Locale> localesList{
-		//British English
-		{"en_GB", {"one","other"}, PluralRule1, {}, {}, {
-			{"general", {",", ".", {}}},
-			{"grouped", {",", ".", {3}}}
-		}},
-		//American English
-		{"en_US", {"one","other"}, PluralRule1, {}, {}, {
-			{"general", {",", ".", {}}},
-			{"grouped", {",", ".", {3}}}
-		}},
-		//Polish
-		/*
-		(nom)inative = mianownik(kto? co?)
-		(gen)etive = dopełniacz(kogo? czego?)
-		(dat)ive = celownik (komu? czemu?)
-		(acc)usative = biernik (kogo? co?)
-		(ins)trumental = narzędnik (z kim? z czym?)
-		(loc)ative = miejscownik (o kim? o czym?)
-		(voc)ative = wołacz (O!)
-		*/
-		{"pl_PL", {"one","few","other"}, PluralRule9, 
-		{"nom","gen","dat","acc","ins","loc","voc"}, {"m","f","n"}, {
-			{"general", {" ", ",", {}}},
-			{"grouped", {" ", ",", {3}}}
-		}}
+	///How the arguments of a tag's function are written
+	enum class TagType {
+		///`%{var}%`, no function
+		VAR_ONLY,
+		///`F=argument`
+		ONE_ARG,
+		///`F:a,b,c`
+		TABLE_ARG,
+		///`F a={A} b={B}`
+		HASH_ARG
 	};
-		
-	Locale& getLocale(std::string_view localeName) {
-		Locale* found = nullptr;
-		for( auto& locale : localesList ) {
-			if( locale.isTheLocale(localeName) ) {
-				found = &locale;
-			}
-		}
-		
-		if( found != nullptr )
-			return *found;
-		else
-			return getLocale("en_US");
-	}
-	
-};
-
-
-
-namespace mls::preparse {
 	
-	//------------ Configuration
-	
-	#ifdef MULANSTR_TAG_START
-	constexpr std::string_view TEMPLATE_START{MULANSTR_TAG_START};
-	#else
-	constexpr std::string_view TEMPLATE_START{"%{"};
-	#endif
-	
-	#ifdef MULANSTR_TAG_END
-	constexpr std::string_view TEMPLATE_END{MULANSTR_TAG_END};
-	#else
-	constexpr std::string_view TEMPLATE_END{"}%"};
-	#endif
-	
-	#ifdef MULANSTR_INNER_TAG_START
-	constexpr std::string_view INNER_TAG_START{MULANSTR_INNER_TAG_START};
-	#else
-	constexpr std::string_view INNER_TAG_START{"{"};
-	#endif
-	
-	#ifdef MULANSTR_INNER_TAG_END
-	constexpr std::string_view INNER_TAG_END{MULANSTR_INNER_TAG_END};
-	#else
-	constexpr std::string_view INNER_TAG_END{"}"};
-	#endif
-	
-	//-------------- Utility functions (ref)
-	
-	std::pair<std::string_view, std::string_view> 
-		breakInHalfOn( std::string_view source, std::string_view delimiter );
-	
-	bool contains( std::string_view container, std::string_view searched );
+	//-------------- The grammar
+	// It is shared by the run time parsers and the compile time parser of literals.
+	// Errors are returned as messages, `nullptr` means no error.
 	
-	char *copyStringView( const std::string_view theView );
-	std::string copyStringViewAsString( const std::string_view theView );
+	// The searches below work on indexes while compiling, because some compilers can't compare pointers 
+	// into template arguments with `nullptr`, which the standard library's searches do.
 	
-	std::string_view trim(std::string_view theView);
-	
-	//-------------- The main function
-	
-	ParsedTemplateFunction* parse_template_contents(std::string_view content);
+	/**
+	 * @brief `source.find(searched)` using vector instructions of the CPU
+	 * 
+	 * The best of AVX2, SSE2 and plain code is picked at run time. 
+	 * Define `MULANSTR_NO_SIMD` to always use the plain code.
+	 */
+	std::size_t find_text(std::string_view source, std::string_view searched);
 	
-	std::pair<std::vector<char*>, std::vector<ParsedTemplateFunction*>>
-		preparse_template(std::string_view templateString) 
-	{
-		std::vector<char*> resultStrings;
-		std::vector<ParsedTemplateFunction*> resultFunctions;
-		
-		//check if we have got a template string
-		if( !contains(templateString, TEMPLATE_START) ) {
-			//not a template - just copy
-			resultStrings.push_back( copyStringView(templateString) );
-		} else {
-			//a rightful template
-			while( ! templateString.empty() ) {
-				auto[prefix, firstHalf] = breakInHalfOn(templateString, TEMPLATE_START);
-				resultStrings.push_back( copyStringView(prefix) );
-				
-				if( !contains(firstHalf, TEMPLATE_END) ) {//Wrong template
-					#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
-					//clean the result vars
-					for(char* el : resultStrings) {
-						delete[] el;
-					}
-					for(auto el : resultFunctions) {
-						delete el;
-					}
-					throw InvalidTemplateState{"No ending marker"};
-					#else
-					return {resultStrings, resultFunctions};
-					#endif
-				}
-				
-				auto[templateContent, suffix] = breakInHalfOn(firstHalf, TEMPLATE_END);
-				
-				try{
-					resultFunctions.push_back( parse_template_contents(templateContent) );
-				}
-				catch(InvalidTemplateState e) {
-					//clean the result vars
-					for(char* el : resultStrings) {
-						delete[] el;
-					}
-					for(auto el : resultFunctions) {
-						delete el;
-					}
-					throw e;
-				}
-				
-				if( contains(suffix, TEMPLATE_START) ) {//next template?
-					templateString = suffix;
-				} else {
-					//add the last string
-					resultStrings.push_back( copyStringView(suffix) );
-					templateString = std::string_view();
-				}
+	///`source.find(searched)`
+	constexpr std::size_t findText(std::string_view source, std::string_view searched) {
+		if( !std::is_constant_evaluated() ) {
+			return find_text(source, searched);
+		}
+		if( searched.size() > source.size() ) {
+			return std::string_view::npos;
+		}
+		for(std::size_t i=0u; i + searched.size() <= source.size(); ++i) {
+			std::size_t j = 0u;
+			while( j < searched.size() && source[i+j] == searched[j] ) {
+				++j;
+			}
+			if( j == searched.size() ) {
+				return i;
 			}
 		}
-		
-		return {resultStrings, resultFunctions};
+		return std::string_view::npos;
 	}
 	
-	constexpr std::string_view VAR_FN_DIVIDER{"!"};
-	constexpr std::string_view NO_VAR_FN{"+"};
-	constexpr char COMMENT_MARKER = '#';
-	
-	constexpr std::string_view FN_ARGS_DIV_ALL{"=: "};
-	constexpr char FN_ARGS_DIV_ONE = '=';
-	constexpr char FN_ARGS_DIV_TABLE = ':';
-	constexpr char FN_ARGS_DIV_HASH = ' ';
-	
-	ParsedTemplateFunction* parse_template_contents(std::string_view content) {
-		std::string varName{""};
-		bool hasFn = false;
-		//check for comments
-		if( content.starts_with(COMMENT_MARKER) && content.ends_with(COMMENT_MARKER) ) {
-			return nullptr; 
-		}
-		//extract var name
-		if( content.starts_with(NO_VAR_FN) ) {
-			//this is a no-var function
-			content.remove_prefix(NO_VAR_FN.size());
-			hasFn = true;
-		} else {
-			//look for name
-			if( contains(content, VAR_FN_DIVIDER) ) {
-				auto[varNameVS, theRest] = breakInHalfOn(content, VAR_FN_DIVIDER);
-				varName = copyStringViewAsString(varNameVS);
-				content = theRest;
-				hasFn = true;
-			} else {
-				//only var name
-				varName = copyStringViewAsString(content);
-			}
+	///`source.find_first_of(chars)` or, if `isIn` is `false`, `source.find_first_not_of(chars)`
+	constexpr std::size_t findFirstOf(std::string_view source, std::string_view chars, bool isIn = true) {
+		if( !std::is_constant_evaluated() ) {
+			return isIn ? source.find_first_of(chars) : source.find_first_not_of(chars);
 		}
-		//return the right function class
-		if( !hasFn ) {
-			VarOnlyFunction* result = new VarOnlyFunction();
-			result->varName = std::move(varName);
-			result->name[0] = result->name[1] = '\0';
-			
-			return result;
-		} else {
-			auto nameArgsDivider = content.find_first_of(FN_ARGS_DIV_ALL);
-			
-			if( nameArgsDivider == std::string_view::npos ) {
-				//no required element - error
-				#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
-				throw InvalidTemplateState("No function-parameters divider");
-				#else
-				return nullptr;
-				#endif
+		for(std::size_t i=0u; i<source.size(); ++i) {
+			bool found = false;
+			for(auto c : chars) {
+				found = found || source[i] == c;
 			}
-			
-			if( nameArgsDivider != 1 && nameArgsDivider != 2 ) {
-				//wrong function name length
-				#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
-				throw InvalidTemplateState("Wrong function name length");
-				#else
-				return nullptr;
-				#endif
-			}
-			
-			ParsedTemplateFunction* result;
-			try{
-				switch( content[nameArgsDivider] ) {
-					case FN_ARGS_DIV_ONE:
-						result = new OneArgFunction(content.substr(nameArgsDivider+1));
-						break;
-					case FN_ARGS_DIV_TABLE:
-						result = new TableArgFunction(content.substr(nameArgsDivider+1));
-						break;
-					case FN_ARGS_DIV_HASH:
-						result = new HashArgFunction(content.substr(nameArgsDivider+1));
-						break;
-					default: //shouldn't reach
-						#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
-						throw InvalidTemplateState("Unknown function-parameters divider");
-						#else
-						return nullptr;
-						#endif
-				}
-			} catch(InvalidTemplateState e) {
-				#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
-				throw e;
-				#else
-				return nullptr;
-				#endif
+			if( found == isIn ) {
+				return i;
 			}
-			result->varName = std::move(varName);
-			result->name[0] = content[0];
-			if( nameArgsDivider == 2 )
-				result->name[1] = content[1];
-			else
-				result->name[1] = '\0';
-			
-			return result;
 		}
+		return std::string_view::npos;
 	}
 	
-	//-------------- Utility functions
-	
-	std::pair<std::string_view, std::string_view> 
+	constexpr std::pair<std::string_view, std::string_view> 
 		breakInHalfOn( std::string_view source, std::string_view delimiter )
 	{
-		auto delimPos = source.find( delimiter );
+		auto delimPos = findText( source, delimiter );
 		if( delimPos != source.npos ) {
 			return {
 				source.substr(0, delimPos),
@@ -812,340 +611,3262 @@ namespace mls::preparse {
 		}
 	}
 	
-	bool contains( std::string_view container, std::string_view searched )
-	{
-		auto pos = container.find( searched );
-		if( pos == container.npos )
-			return false;
-		else
-			return true;
-	}
-	
-	char *copyStringView( const std::string_view theView )
+	constexpr bool contains( std::string_view container, std::string_view searched )
 	{
-		char *result = new char[theView.size() + 1];
-		theView.copy( result, theView.size() );
-		result[theView.size()] = 0;
-		return result;
+		return findText( container, searched ) != container.npos;
 	}
 	
-	std::string copyStringViewAsString( const std::string_view theView ) {
-		char* copy = copyStringView( theView );
-		std::string strCopy{copy};
-		delete[] copy;
-		return strCopy;
-	}
-	
-	std::string_view trim(std::string_view theView) {
-		auto pos = theView.find_first_not_of(" ");
+	constexpr std::string_view trim(std::string_view theView) {
+		auto pos = findFirstOf(theView, " ", false);
 		if( pos != std::string_view::npos ) {
 			theView.remove_prefix(pos);
 		}
-		pos = theView.find_first_of(" ");
+		pos = findFirstOf(theView, " ");
 		if( pos != std::string_view::npos ) {
 			theView.remove_suffix(theView.size() - pos);
 		}
 		return theView;
 	}
 	
-	//-------------- class methods
-	
-	ParsedTemplateFunction::Type VarOnlyFunction::getType() const {
-		return ParsedTemplateFunction::Type::VAR_ONLY;
-	}
-	
-	ParsedTemplateFunction::Type OneArgFunction::getType() const {
-		return ParsedTemplateFunction::Type::ONE_ARG;
-	}
-	
-	ParsedTemplateFunction::Type TableArgFunction::getType() const {
-		return ParsedTemplateFunction::Type::TABLE_ARG;
-	}
+	///One tag of a template. All strings are views into the template string
+	struct TagSyntax {
+		///comments have no function
+		bool isComment = false;
+		char name[2] = {'\0', '\0'};
+		TagType type = TagType::VAR_ONLY;
+		std::string_view varName{};
+		///the text after the function name and its divider
+		std::string_view argumentsText{};
+		///position of the tag's arguments in `TemplateSyntax::arguments`
+		std::uint32_t firstArgument = 0u;
+		std::uint32_t argumentsCount = 0u;
+	};
 	
-	ParsedTemplateFunction::Type HashArgFunction::getType() const {
-		return ParsedTemplateFunction::Type::HASH_ARG;
-	}
+	///An argument of a tag; `key` is only set for a hash of arguments
+	struct ArgumentSyntax {
+		std::string_view key{};
+		std::string_view value{};
+	};
 	
-	OneArgFunction::OneArgFunction(std::string_view templateContent) {
-		if( templateContent.empty() ) {
-			throw InvalidTemplateState("Empty argument");
-		}
-		argument = copyStringViewAsString(templateContent);
-	}
+	///A parsed template, where `strings[i]` comes before `tags[i]`
+	struct TemplateSyntax {
+		std::span<const std::string_view> strings;
+		std::span<const TagSyntax> tags;
+		std::span<const ArgumentSyntax> arguments;
+	};
 	
-	TableArgFunction::TableArgFunction(std::string_view templateContent) {
+	///Calls `onArgument(value)` for every argument of a `a,b,c` list
+	template<typename ArgumentFn>
+	constexpr const char* for_each_table_argument(std::string_view templateContent, ArgumentFn onArgument) {
 		if( templateContent.empty() ) {
-			throw InvalidTemplateState("Empty argument list");
+			return "Empty argument list";
 		}
 		
 		std::string_view::size_type pos{0};
 		while( pos != std::string_view::npos ) {
-			pos = templateContent.find(",");
+			pos = findText(templateContent, ",");
 			if( pos != std::string_view::npos ) {
-				arguments.push_back(
-					copyStringViewAsString(
-						templateContent.substr(0, pos)
-					)
-				);
+				onArgument( templateContent.substr(0, pos) );
 				templateContent.remove_prefix(pos+1);
 			} else {
-				arguments.push_back(
-					copyStringViewAsString( templateContent )
-				);
+				onArgument( templateContent );
 			}
 		}
+		return nullptr;
 	}
 	
-	HashArgFunction::HashArgFunction(std::string_view templateContent) {
+	///Calls `onArgument(key, value)` for every argument of a `a={A} b={B}` hash
+	template<typename ArgumentFn>
+	constexpr const char* for_each_hash_argument(std::string_view templateContent, ArgumentFn onArgument) {
 		if( templateContent.empty() ) {
-			throw InvalidTemplateState("Empty argument hash");
+			return "Empty argument hash";
 		}
 		
 		std::string_view::size_type pos;
 		while( !templateContent.empty() ) {
-			pos = templateContent.find_first_not_of(" ");
+			pos = findFirstOf(templateContent, " ", false);
 			if( pos == std::string_view::npos ) {//no more arguments
 				break;
 			} else {
-				templateContent.remove_prefix(pos-1);
+				templateContent.remove_prefix(pos);
 			}
 			
-			std::string argName{""};
-			pos = templateContent.find("=");
+			std::string_view argName{};
+			pos = findText(templateContent, "=");
 			if( pos == std::string_view::npos ) {
 				//no required element
-				throw InvalidTemplateState("No required \"=\" sign");
+				return "No required \"=\" sign";
 			}
-			argName = copyStringViewAsString(
-				trim( templateContent.substr(0, pos) )
-			);
+			argName = trim( templateContent.substr(0, pos) );
 			templateContent.remove_prefix(pos);
 			
-			std::string argContent{""};
-			pos = templateContent.find(INNER_TAG_START);
+			std::string_view argContent{};
+			pos = findText(templateContent, INNER_TAG_START);
 			if( pos == std::string_view::npos ) {
 				//no required element
-				throw InvalidTemplateState("No inner tag start");
+				return "No inner tag start";
 			}
 			templateContent.remove_prefix(pos + INNER_TAG_START.size());
-			pos = templateContent.find(INNER_TAG_END);
+			pos = findText(templateContent, INNER_TAG_END);
 			if( pos == std::string_view::npos ) {
 				//no required element
-				throw InvalidTemplateState("No inner tag end");
+				return "No inner tag end";
 			}
-			argContent = copyStringViewAsString(
-				templateContent.substr(0, pos)
-			);
+			argContent = templateContent.substr(0, pos);
 			templateContent.remove_prefix(pos + INNER_TAG_END.size());
 			
-			arguments.emplace(argName, argContent);
+			onArgument(argName, argContent);
 		}
+		return nullptr;
 	}
 	
-};
-
-
-
-namespace mls {
-	
-	//------------- Functions classes (ref)
-	
 	/**
-	 * @brief Just puts the variable content
+	 * @brief Parses the contents of a tag
 	 * 
+	 * Fills `tag` and calls `onArgument(key, value)` for every argument of its function
 	 */
-	class VariablePutter : public TemplateFunction {
-		private:
-			const std::string variable;
-		public:
-			VariablePutter(std::string &&varName): variable{varName} {};
-			
-			virtual std::string produceString(std::map<std::string_view, variableValue> &variables) override;
-	};
+	template<typename ArgumentFn>
+	constexpr const char* parse_tag(std::string_view content, TagSyntax& tag, ArgumentFn onArgument) {
+		tag = TagSyntax{};
+		//check for comments
+		if( content.starts_with(COMMENT_MARKER) && content.ends_with(COMMENT_MARKER) ) {
+			tag.isComment = true;
+			return nullptr;
+		}
+		//extract var name
+		if( content.starts_with(NO_VAR_FN) ) {
+			//this is a no-var function
+			content.remove_prefix(NO_VAR_FN.size());
+		} else if( auto divider = findText(content, VAR_FN_DIVIDER); divider != std::string_view::npos ) {
+			tag.varName = content.substr(0, divider);
+			content.remove_prefix(divider + VAR_FN_DIVIDER.size());
+		} else {
+			//only var name
+			tag.varName = content;
+			return nullptr;
+		}
+		
+		auto nameArgsDivider = findFirstOf(content, FN_ARGS_DIV_ALL);
+		if( nameArgsDivider == std::string_view::npos ) {
+			return "No function-parameters divider";
+		}
+		if( nameArgsDivider != 1 && nameArgsDivider != 2 ) {
+			return "Wrong function name length";
+		}
+		tag.name[0] = content[0];
+		tag.name[1] = nameArgsDivider == 2 ? content[1] : '\0';
+		tag.argumentsText = content.substr(nameArgsDivider+1);
+		
+		auto countedArgument = [&tag, &onArgument](std::string_view key, std::string_view value) {
+			++tag.argumentsCount;
+			onArgument(key, value);
+		};
+		switch( content[nameArgsDivider] ) {
+			case FN_ARGS_DIV_ONE:
+				tag.type = TagType::ONE_ARG;
+				if( tag.argumentsText.empty() ) {
+					return "Empty argument";
+				}
+				countedArgument(std::string_view{}, tag.argumentsText);
+				return nullptr;
+			case FN_ARGS_DIV_TABLE:
+				tag.type = TagType::TABLE_ARG;
+				return for_each_table_argument(tag.argumentsText, [&countedArgument](std::string_view value) {
+					countedArgument(std::string_view{}, value);
+				});
+			case FN_ARGS_DIV_HASH:
+				tag.type = TagType::HASH_ARG;
+				return for_each_hash_argument(tag.argumentsText, countedArgument);
+			default: //shouldn't reach
+				return "Unknown function-parameters divider";
+		}
+	}
 	
 	/**
-	 * @brief Outputs a result based on the gender of the variable
+	 * @brief Calls `onString(text)` for every text between tags and `onTag(content)` for every tag, which returns an error or `nullptr`
 	 * 
-	 * Template: `%{varname!G:output1,output2,...}%`
-	 * 	OR
-	 * Template: `%{varname!G gender1={output1} gender2={output2} ...}%`
+	 * Every byte of the template string is searched only once.
 	 */
-	class GenderFunction : public TemplateFunction {
-		private:
-			const std::string variable;
-			std::map<std::string, std::string> outputTexts;
+	template<typename StringFn, typename TagFn>
+	constexpr const char* scan_template(std::string_view templateString, StringFn onString, TagFn onTag) {
+		auto tagStart = findText(templateString, TEMPLATE_START);
+		while( tagStart != std::string_view::npos ) {
+			onString( templateString.substr(0, tagStart) );
+			templateString.remove_prefix(tagStart + TEMPLATE_START.size());
+			
+			auto tagEnd = findText(templateString, TEMPLATE_END);
+			if( tagEnd == std::string_view::npos ) {//Wrong template
+				return "No ending marker";
+			}
+			if( auto error = onTag(templateString.substr(0, tagEnd)) ) {
+				return error;
+			}
+			templateString.remove_prefix(tagEnd + TEMPLATE_END.size());
+			//next template?
+			tagStart = findText(templateString, TEMPLATE_START);
+		}
+		//the last string, or the only one if it isn't a template
+		onString( templateString );
+		return nullptr;
+	}
+	
+	/**
+	 * @brief Result of `preparse_syntax(...)`
+	 * 
+	 * The template string is copied once into `source` and all views of `view()` point into it.
+	 */
+	class PreparsedSyntax {
 		public:
-			GenderFunction(
-				std::string &&varName,
-				std::vector<std::string> &listOfOutputs,
-				const locale::Locale &locale
-			);
-			GenderFunction(
-				std::string &&varName,
-				std::map<std::string, std::string> &mapOfOutputs
-			);
+			std::unique_ptr<char[]> source;
+			std::vector<std::string_view> strings;
+			std::vector<TagSyntax> tags;
+			std::vector<ArgumentSyntax> arguments;
 			
-			virtual std::string produceString(std::map<std::string_view, variableValue> &variables) override;
+			TemplateSyntax view() const {
+				return TemplateSyntax{strings, tags, arguments};
+			}
+	};
+	
+	///Parses a template string at run time into a flat syntax
+	PreparsedSyntax preparse_syntax(std::string_view templateString);
+	
+	//-------------- Literals parsed at compile time
+	
+	///A string literal which can be passed as a template argument
+	template<std::size_t N>
+	struct FixedString {
+		char data[N];
+		
+		consteval FixedString(const char (&text)[N]) {
+			for(std::size_t i=0u; i<N; ++i) {
+				data[i] = text[i];
+			}
+		}
+		
+		constexpr std::string_view view() const {
+			return std::string_view{data, N - 1u};
+		}
+	};
+	
+	///Lengths of the lists of `TemplateSyntax`, or the syntax error
+	struct SyntaxSize {
+		std::size_t strings = 0u;
+		std::size_t tags = 0u;
+		std::size_t arguments = 0u;
+		const char* error = nullptr;
+	};
+	
+	consteval SyntaxSize measure_syntax(std::string_view templateString) {
+		SyntaxSize size;
+		size.error = scan_template(templateString,
+			[&size](std::string_view) { ++size.strings; },
+			[&size](std::string_view content) -> const char* {
+				TagSyntax tag;
+				++size.tags;
+				return parse_tag(content, tag, [&size](std::string_view, std::string_view) { ++size.arguments; });
+			}
+		);
+		return size;
+	}
+	
+	///Syntax of a literal kept in arrays of exact sizes
+	template<std::size_t STRINGS, std::size_t TAGS, std::size_t ARGUMENTS>
+	struct StaticSyntax {
+		std::array<std::string_view, STRINGS> strings{};
+		std::array<TagSyntax, TAGS> tags{};
+		std::array<ArgumentSyntax, ARGUMENTS> arguments{};
+		
+		constexpr TemplateSyntax view() const {
+			return TemplateSyntax{strings, tags, arguments};
+		}
+	};
+	
+	///Parses a template string literal while compiling, so a malformed tag is a compile error
+	template<FixedString templateString>
+	consteval auto preparse_literal() {
+		constexpr SyntaxSize size = measure_syntax(templateString.view());
+		constexpr std::string_view error{size.error != nullptr ? size.error : ""};
+		static_assert( error != "No ending marker", "Template literal: no ending marker of a tag" );
+		static_assert( error != "No function-parameters divider", "Template literal: no function-parameters divider" );
+		static_assert( error != "Wrong function name length", "Template literal: wrong function name length" );
+		static_assert( error != "Empty argument", "Template literal: empty argument" );
+		static_assert( error != "Empty argument list", "Template literal: empty argument list" );
+		static_assert( error != "Empty argument hash", "Template literal: empty argument hash" );
+		static_assert( error != "No required \"=\" sign", "Template literal: no required \"=\" sign in a hash argument" );
+		static_assert( error != "No inner tag start", "Template literal: no inner tag start in a hash argument" );
+		static_assert( error != "No inner tag end", "Template literal: no inner tag end in a hash argument" );
+		static_assert( error.empty(), "Template literal: invalid syntax" );
+		
+		StaticSyntax<size.strings, size.tags, size.arguments> result;
+		if constexpr( !error.empty() ) {
+			return result;
+		}
+		std::size_t stringsCount = 0u, tagsCount = 0u, argumentsCount = 0u;
+		scan_template(templateString.view(),
+			[&](std::string_view text) { result.strings[stringsCount++] = text; },
+			[&](std::string_view content) -> const char* {
+				TagSyntax& tag = result.tags[tagsCount++];
+				auto error = parse_tag(content, tag, [&](std::string_view key, std::string_view value) {
+					result.arguments[argumentsCount++] = ArgumentSyntax{key, value};
+				});
+				tag.firstArgument = static_cast<std::uint32_t>(argumentsCount - tag.argumentsCount);
+				return error;
+			}
+		);
+		return result;
+	}
+	
+	///The syntax of a template string literal, see `mls::literal`
+	template<FixedString templateString>
+	inline constexpr auto literal_syntax = preparse_literal<templateString>();
+	
+};
+
+
+
+#if !defined(_WIN32)
+#	include <sys/uio.h>
+#endif
+
+namespace mls {
+	
+	class Template;
+	class CompiledTemplate;
+	///`std::monostate` marks a variable which wasn't set
+	typedef std::variant<std::monostate, std::string_view, long, double, Template*> variableValue;
+	
+	///Handle of a template's variable, see `CompiledTemplate::slot(...)`
+	struct VariableSlot {
+		///value of `index` for variables the template doesn't use
+		static constexpr std::uint32_t NONE = UINT32_MAX;
+		
+		std::uint32_t index = NONE;
 	};
 	
 	/**
-	 * @brief Writes an output based on the `__CASE__` variable
+	 * @brief Values of variables used in one run of a compiled template
 	 * 
+	 * Values are kept in an array indexed by the template's variable slots.
+	 * Variables the template doesn't use are ignored.
 	 */
-	class CaseWriterFunction : public TemplateFunction {
+	class TemplateArgs {
+		public:
+			///number of variables kept without allocating memory
+			static constexpr std::size_t INLINE_SLOTS = 8u;
+			
+			///arguments for no template, all variables are ignored
+			TemplateArgs();
+			///arguments for the compiled template, which must live longer than them
+			explicit TemplateArgs(const CompiledTemplate& compiled);
+			
+			//apply function group
+			
+			///set a raw string for a variable
+			TemplateArgs& apply(std::string_view varName, std::string_view rawString);
+			///set an integer number for a variable
+			TemplateArgs& apply(std::string_view varName, long number);
+			///set a real number for a variable
+			TemplateArgs& applyReal(std::string_view varName, double number);
+			///set another template for a variable
+			TemplateArgs& apply(std::string_view varName, Template& t);
+			
+			///set a raw string for a variable slot
+			TemplateArgs& apply(VariableSlot slot, std::string_view rawString);
+			///set an integer number for a variable slot
+			TemplateArgs& apply(VariableSlot slot, long number);
+			///set a real number for a variable slot
+			TemplateArgs& applyReal(VariableSlot slot, double number);
+			///set another template for a variable slot
+			TemplateArgs& apply(VariableSlot slot, Template& t);
+			
+			//end apply
+			
+			///returns `nullptr` if the variable wasn't set
+			const variableValue* find(std::string_view varName) const;
+			///the value in a slot, `std::monostate` if it wasn't set
+			const variableValue& get(std::uint32_t slotIndex) const;
+			///the compiled template these arguments are for
+			const CompiledTemplate* getCompiled() const;
+			///forget all variables
+			void clear();
 		private:
-			std::map<std::string, std::string> outputTexts;
+			const CompiledTemplate *compiled;
+			std::array<variableValue, INLINE_SLOTS> inlineValues;
+			///used instead of `inlineValues` by templates with many variables
+			std::vector<variableValue> moreValues;
+			
+			void set(VariableSlot slot, variableValue value);
+			variableValue* values();
+			const variableValue* values() const;
+	};//!class TemplateArgs
+	
+	/**
+	 * @brief One step of a compiled template
+	 * 
+	 * A template is compiled into a flat list of instructions which `render(...)` runs one by one
+	 */
+	struct Instruction {
+		///value of indices which point to nothing
+		static constexpr std::uint32_t NO_INDEX = UINT32_MAX;
+		
+		enum class Code : unsigned char {
+			///puts the `text`
+			EMIT_LITERAL,
+			///puts the content of the variable
+			PUT_VAR,
+			///puts a choice selected by the plural form of the number in the variable
+			PLURAL_SELECT,
+			///puts a choice selected by the gender of the template in the variable, choices are in the order of the locale's genders
+			GENDER_SELECT,
+			///puts a choice selected by the case asked by the parent template or, without one, by the `__CASE__` variable; 
+			///choices are in the order of the locale's cases
+			CASE_WRITE,
+			///puts the template in the variable in the case given by the `argument`
+			CASE_SELECT,
+			///puts the number in the variable formatted as an integer
+			INT_FORMAT,
+			///puts the number in the variable formatted as a real number
+			REAL_FORMAT
+		};
+		
+		Code code;
+		///precision of a real number, `-1` if not given
+		short precision;
+		///the first entry in the choices table
+		std::uint32_t firstChoice;
+		///the number of entries in the choices table
+		std::uint32_t choicesCount;
+		///the variable slot
+		std::uint32_t slot;
+		///the literal text for `EMIT_LITERAL`, otherwise the variable name
+		std::string_view text;
+		///the case for `CASE_SELECT`
+		std::string_view argument;
+		///the number format for `INT_FORMAT` and `REAL_FORMAT`
+		const locale::NumberFormat *format;
+		///the index of the `argument` in the locale's cases for `CASE_SELECT`, `NO_INDEX` if there is no such case
+		std::uint32_t caseIndex = NO_INDEX;
+	};
+	
+	///An output text together with the plural form, gender or case selecting it
+	struct Choice {
+		std::string_view key;
+		std::string_view text;
+	};
+	
+	/**
+	 * @brief Template string parsed and bound to a locale
+	 * 
+	 * It is never changed after construction, so one object can be shared between many `Template`s 
+	 * and rendered by many threads at once.
+	 */
+	class CompiledTemplate {
 		public:
-			CaseWriterFunction(
-				std::vector<std::string> &listOfOutputs,
-				const locale::Locale &locale
-			);
-			CaseWriterFunction(
-				std::map<std::string, std::string> &mapOfOutputs
+			///no copy ctor
+			CompiledTemplate(const CompiledTemplate& other) = delete;
+			///parses the template string
+			CompiledTemplate(std::string_view templateString, locale::Locale& locale);
+			///uses a parsed template, like `mls::literal<"...">`, whose texts must live longer than this object
+			CompiledTemplate(const preparse::TemplateSyntax& syntax, locale::Locale& locale);
+			/**
+			 * @brief Uses an already compiled program, like one read from a template catalog
+			 * 
+			 * Nothing is checked but the indices of the gender and cases, which are found again. 
+			 * All texts must live longer than this object.
+			 */
+			CompiledTemplate(
+				locale::Locale& locale, 
+				std::string_view gender, 
+				std::vector<Instruction> compiledProgram, 
+				std::vector<Choice> compiledChoices, 
+				std::vector<std::string_view> names
 			);
+			~CompiledTemplate();
 			
-			virtual std::string produceString(std::map<std::string_view, variableValue> &variables) override;
-	};
+			locale::Locale& getLocale() const;
+			std::string_view getGender() const;
+			///the index of the gender in the locale's genders, `Instruction::NO_INDEX` if it isn't there
+			std::uint32_t getGenderIndex() const;
+			///why the template couldn't be compiled, empty if it could; an invalid template has no program
+			std::string_view getError() const;
+			
+			///the instructions run by `render(...)`
+			std::span<const Instruction> getProgram() const;
+			///the choices of all instructions
+			std::span<const Choice> getChoices() const;
+			///names of the variables, indexed by slots
+			std::span<const std::string_view> getVariableNames() const;
+			
+			///the slot of a variable, `VariableSlot::NONE` if the template doesn't use it
+			VariableSlot slot(std::string_view varName) const;
+			///number of variables used by the template
+			std::size_t slotsCount() const;
+			
+			friend std::size_t estimateSize(const CompiledTemplate& compiled, const TemplateArgs& args);
+		private:
+			locale::Locale *myLocale;
+			///copy of the template string which owns all texts of the template
+			std::unique_ptr<char[]> source;
+			std::string_view genderID;
+			std::uint32_t genderIndex = Instruction::NO_INDEX;
+			std::vector<Instruction> program;
+			std::vector<Choice> choices;
+			///names of the variables, indexed by slots
+			std::vector<std::string_view> variableNames;
+			///the error of `compile(...)`, kept when it doesn't throw
+			std::string compileError;
+			
+			std::uint32_t addVariable(std::string_view varName);
+			void compile(const preparse::TemplateSyntax& syntax);
+			///finds the indices of the gender and the cases of `CASE_SELECT` in the locale
+			void resolveIndices();
+	};//!class CompiledTemplate
+	
+	/**
+	 * @brief A template string literal checked and parsed while compiling
+	 * 
+	 * `mls::Template{mls::literal<"%{n!I=grouped}% files">, locale}` needs no parsing at run time, 
+	 * and a malformed tag in the literal is a compile error.
+	 */
+	template<preparse::FixedString templateString>
+	inline constexpr preparse::TemplateSyntax literal = preparse::literal_syntax<templateString>.view();
 	
+	///runs the compiled template with the given variables and produces a result string
+	std::string render(const CompiledTemplate& compiled, const TemplateArgs& args);
+	///runs the compiled template with the given variables and appends the result to `output`
+	void render(const CompiledTemplate& compiled, const TemplateArgs& args, std::string& output);
 	/**
-	 * @brief Sets the `__CASE__` variable in the sub-template
+	 * @brief Receives the output of a template piece by piece, as it is produced
 	 * 
+	 * Literals are texts of the compiled template, which live as long as it does. 
+	 * Other pieces, like variables and formatted numbers, may be gone after the call.
 	 */
-	class CaseChooserFunction : public TemplateFunction {
+	class RenderSink {
+		public:
+			virtual ~RenderSink() = default;
+			///a piece of output valid only during the call
+			virtual void put(std::string_view text) = 0;
+			///a text of the compiled template, which lives as long as the template
+			virtual void putLiteral(std::string_view text);
+	};
+	
+	///Writes the output to a stream, errors are left in the stream's state
+	class OstreamSink : public RenderSink {
+		public:
+			explicit OstreamSink(std::ostream& stream);
+			void put(std::string_view text) override;
 		private:
-			const std::string caseID;
-			const std::string variable;
+			std::ostream& stream;
+	};
+	
+	///Writes the output to a C file, errors are left for `std::ferror(...)`
+	class FileSink : public RenderSink {
 		public:
-			CaseChooserFunction(
-				std::string &&varName,
-				std::string &&case_id
-			);
+			explicit FileSink(std::FILE* file);
+			void put(std::string_view text) override;
+		private:
+			std::FILE* file;
+	};
+	
+	#if defined(_WIN32)
+	///A buffer of output, laid out like the POSIX `iovec`
+	struct IoSegment {
+		void* iov_base;
+		std::size_t iov_len;
+	};
+	#else
+	///A buffer of output for `writev(...)`
+	using IoSegment = ::iovec;
+	#endif
+	
+	/**
+	 * @brief Collects the output as a list of buffers, which can be written with one `writev(...)` call
+	 * 
+	 * Literals are referenced in place and only the other pieces are copied, 
+	 * so the compiled templates must outlive the segments.
+	 */
+	class IovecSink : public RenderSink {
+		public:
+			void put(std::string_view text) override;
+			void putLiteral(std::string_view text) override;
 			
-		virtual std::string produceString(std::map<std::string_view, variableValue> &variables) override;
+			///the output, valid until the sink is changed; `writev(...)` takes at most `IOV_MAX` segments at once
+			std::span<const IoSegment> segments();
+			///length of the whole output
+			std::size_t size() const;
+			///forgets the output, but keeps the memory for the next one
+			void clear();
+		private:
+			///a literal has its `data`, a copied piece starts at `offset` of `copies`
+			struct Piece {
+				const char* data;
+				std::size_t offset;
+				std::size_t size;
+			};
+			std::vector<Piece> pieces;
+			std::string copies;
+			std::vector<IoSegment> resolved;
+			std::size_t totalSize = 0u;
+	};
+	
+	///runs the compiled template with the given variables and passes the output to `sink`
+	void render(const CompiledTemplate& compiled, const TemplateArgs& args, RenderSink& sink);
+	/**
+	 * @brief Estimates the size of the template's output
+	 * 
+	 * The estimate is exact for texts and integers. For real numbers it is a guess that fits common values.
+	 */
+	std::size_t estimateSize(const CompiledTemplate& compiled, const TemplateArgs& args);
+	
+	///Values of one variable for every row of a batch, see `renderBatch(...)`
+	struct BatchColumn {
+		std::string_view name;
+		std::variant<std::span<const std::string_view>, std::span<const long>, std::span<const double>> values;
+	};
+	
+	///Rows rendered by `renderBatch(...)`, all in one buffer
+	struct BatchOutput {
+		std::string text;
+		///row `i` is the part of `text` between `offsets[i]` and `offsets[i + 1]`
+		std::vector<std::size_t> offsets;
+		
+		std::size_t size() const;
+		std::string_view row(std::size_t index) const;
+	};
+	
+	///How `renderBatch(...)` runs
+	enum class BatchPolicy {
+		SEQUENTIAL,
+		///splits the rows between threads, when there are enough of them
+		PARALLEL
 	};
 	
 	/**
-	 * @brief Pluralizes a word based on a numeric value in the variable
+	 * @brief Renders the compiled template once for every row of the columns
 	 * 
+	 * All columns must have the same number of rows, columns of variables the template doesn't use are ignored. 
+	 * The rows replace the contents of `output`, whose memory is reused. `maxThreads` limits the threads 
+	 * of `BatchPolicy::PARALLEL`, `0` allows one for each hardware thread.
 	 */
-	class PluralFunction : public TemplateFunction {
+	void renderBatch(
+		const CompiledTemplate& compiled, 
+		std::span<const BatchColumn> columns, 
+		BatchOutput& output, 
+		BatchPolicy policy = BatchPolicy::SEQUENTIAL, 
+		unsigned maxThreads = 0u
+	);
+	
+	///Template class used to make string out of a template string and a locale
+	class Template {
+		public:
+			///default ctor
+			Template();
+			///no copy ctor
+			Template(const Template& other) = delete;
+			///move ctor
+			Template(Template&& other);
+			///standard ctor
+			Template(std::string_view templateString, locale::Locale& locale);
+			///ctor using a parsed template, like `mls::literal<"...">`
+			Template(const preparse::TemplateSyntax& syntax, locale::Locale& locale);
+			///ctor using an already compiled template
+			Template(std::shared_ptr<const CompiledTemplate> compiledTemplate);
+			~Template();
+			
+			//apply function group
+			
+			///set a raw string for a variable
+			Template& apply(std::string_view varName, std::string_view rawString);
+			///set an integer number for a variable
+			Template& apply(std::string_view varName, long number);
+			///set a real number for a variable
+			Template& applyReal(std::string_view varName, double number);
+			///set another template for a variable
+			Template& apply(std::string_view varName, Template& t);
+			
+			///set a raw string for a variable slot
+			Template& apply(VariableSlot slot, std::string_view rawString);
+			///set an integer number for a variable slot
+			Template& apply(VariableSlot slot, long number);
+			///set a real number for a variable slot
+			Template& applyReal(VariableSlot slot, double number);
+			///set another template for a variable slot
+			Template& apply(VariableSlot slot, Template& t);
+			
+			//end apply
+			
+			///the slot of a variable, which sets it faster than its name
+			VariableSlot slot(std::string_view varName) const;
+			
+			///runs the template and produces a result string
+			std::string get();
+			///runs the template and appends the result to `output`, so one buffer can be reused for many runs
+			void get(std::string& output);
+			///runs the template and passes the result to `sink` piece by piece
+			void get(RenderSink& sink);
+			
+			std::string getGender();
+			
+			///the compiled template which may be shared with other `Template` objects
+			const std::shared_ptr<const CompiledTemplate>& getCompiled() const;
+			///variables applied so far
+			const TemplateArgs& getArgs() const;
 		private:
-			const locale::Locale &theLocale;
-			const std::string variable;
-			std::map<std::string, std::string> outputTexts;
+			std::shared_ptr<const CompiledTemplate> compiled;
+			TemplateArgs args;
+	
+	};//!class Template
+
+};
+
+
+
+namespace mls::backend {
+	
+	/**
+	 * @brief A GetText `.mo` file of one domain in one locale, read in place from a memory mapping
+	 * 
+	 * Lookups use the hash table of the file and return views into the mapping. 
+	 * The catalog doesn't touch the process locale nor any state of libintl and is never changed 
+	 * after construction, so any thread can use it without locks. A translation is parsed into a template 
+	 * the first time `translate(...)` gives it, later calls share that template, like they share the template 
+	 * of a message id without a translation.
+	 */
+	class Catalog {
 		public:
-			PluralFunction(
-				std::string &&varName,
-				std::vector<std::string> listOfOutputs,
-				const locale::Locale &locale
-			);
-			PluralFunction(
-				std::string &&varName,
-				std::map<std::string, std::string> &mapOfOutputs,
-				const locale::Locale &locale
-			);
+			///maps and checks the `.mo` file at `path`, throws `mls::InvalidCatalog` if it's broken
+			Catalog(const std::string& path, locale::Locale& locale);
 			
-			virtual std::string produceString(std::map<std::string_view, variableValue> &variables) override;
+			locale::Locale& getLocale() const;
+			///number of messages in the catalog, with the header entry
+			std::size_t size() const;
+			///the `index`-th message id in the order of the file, with its context
+			std::string_view original(std::size_t index) const;
+			///the translation of the `index`-th message, the first form for plural messages
+			std::string_view translation(std::size_t index) const;
+			
+			///the translation of `msgid`, the first form for plural messages
+			std::optional<std::string_view> find(std::string_view msgid) const;
+			///the translation of `msgid` in a `msgctxt` context
+			std::optional<std::string_view> find(std::string_view context, std::string_view msgid) const;
+			
+			///template of the translation of `msgid`, or of `msgid` itself if it has no translation
+			Template translate(std::string_view msgid) const;
+			/**
+			 * @brief Template of the translation of `msgid`, using `untranslated` if it has no translation
+			 * 
+			 * `untranslated` must be the syntax of `msgid` and live as long as the program, like `mls::literal<...>` does
+			 */
+			Template translate(std::string_view msgid, const preparse::TemplateSyntax& untranslated) const;
+		private:
+			std::shared_ptr<const MappedFile> file;
+			std::span<const std::byte> bytes;
+			locale::Locale *theLocale;
+			///the file was written with the other byte order
+			bool swapped;
+			std::uint32_t messagesCount;
+			std::uint32_t originalsOffset;
+			std::uint32_t translationsOffset;
+			std::uint32_t hashSize;
+			std::uint32_t hashOffset;
+			
+			std::uint32_t word(std::size_t offset) const;
+			///the string of the `index`-th descriptor of a table, up to its first NUL
+			std::string_view string(std::uint32_t tableOffset, std::uint32_t index) const;
+			///the index of `key`, `messagesCount` if it's not in the catalog
+			std::uint32_t indexOf(std::string_view key) const;
+			
+			///templates of translations made so far, shared by copies of the catalog
+			struct Templates;
+			std::shared_ptr<Templates> templates;
+			///the template of the `index`-th translation, parsed once
+			std::shared_ptr<const CompiledTemplate> compiled(std::uint32_t index) const;
 	};
 	
+	///version of template catalogs written by `writeTemplateCatalog(...)`
+	constexpr std::uint16_t TEMPLATE_CATALOG_VERSION = 2u;
+	
 	/**
-	 * @brief Formats an integer according to the locale's formater.
+	 * @brief Translations of one domain compiled into templates before the program runs
 	 * 
+	 * The file, made by `writeTemplateCatalog(...)` or the `mls-catalogc` tool, is mapped into memory and 
+	 * its records are checked once when it's opened. A template is made from the records the first time 
+	 * it's used, without parsing, and its texts stay in the mapping. Like `Catalog`, it can be used by 
+	 * many threads without locks.
 	 */
-	class IntegerFormaterFunction : public TemplateFunction {
-		private:
-			const locale::NumberFormat &formater;
-			const std::string variable;
+	class TemplateCatalog {
 		public:
-			IntegerFormaterFunction(
-				std::string &&varName,
-				std::string &formatName,
-				locale::Locale &theLocale
-			);
+			///maps and checks the file at `path`, throws `mls::InvalidCatalog` if it's broken or its locale is unknown
+			explicit TemplateCatalog(const std::string& path);
 			
-			virtual std::string produceString(std::map<std::string_view, variableValue> &variables) override;
+			locale::Locale& getLocale() const;
+			///number of messages in the catalog
+			std::size_t size() const;
+			
+			///the compiled translation of `msgid`, `nullptr` if it isn't in the catalog
+			std::shared_ptr<const CompiledTemplate> find(std::string_view msgid) const;
+			///the compiled translation of `msgid` in a `msgctxt` context
+			std::shared_ptr<const CompiledTemplate> find(std::string_view context, std::string_view msgid) const;
+			
+			///template of the translation of `msgid`, or of `msgid` itself if it has no translation
+			Template translate(std::string_view msgid) const;
+			///as above, using `untranslated` when there is no translation
+			Template translate(std::string_view msgid, const preparse::TemplateSyntax& untranslated) const;
+		private:
+			struct State;
+			std::shared_ptr<const State> state;
 	};
 	
 	/**
-	 * @brief Formats a real number according to the locale's formater.
+	 * @brief Compiles translations for `locale` and writes them as a template catalog
+	 * 
+	 * Keys of `messages` are message ids, with a `msgctxt` context before a `'\x04'` like in `.mo` files. 
+	 * Throws `mls::InvalidCatalog` naming the message id if a translation isn't a valid template, 
+	 * whether `MULANSTR_THROW_ON_INVALID_TEMPLATE` is defined or not, and if the file can't be written.
+	 */
+	void writeTemplateCatalog(
+		const std::string& path, 
+		locale::Locale& locale, 
+		const std::vector<std::pair<std::string, std::string>>& messages
+	);
+	
+	class UntranslatedTemplates;
+	
+	/**
+	 * @brief Catalogs of many domains and locales, found in a GetText locale folder
 	 * 
+	 * Catalogs are added while setting the program up. Afterwards the set is only read, 
+	 * so threads can translate into different locales at the same time.
 	 */
-	class RealFormaterFunction : public TemplateFunction {
+	class CatalogSet {
+		public:
+			///`localeDir` has the usual `<locale>/LC_MESSAGES/<domain>.mo` layout
+			explicit CatalogSet(std::string localeDir);
+			
+			/**
+			 * @brief Opens the catalog of `domain` in `locale`
+			 * 
+			 * Looks for the full locale name first, then for its language only, like GetText does. 
+			 * A template catalog, `<domain>.mlsc`, is taken before a `.mo` file in the same folder. 
+			 * Throws `mls::InvalidCatalog` if no file exists or the file is broken.
+			 */
+			void add(const std::string& domain, locale::Locale& locale);
+			
+			///`nullptr` if no `.mo` catalog was added
+			const Catalog* find(std::string_view domain, const locale::Locale& locale) const;
+			///`nullptr` if no template catalog was added
+			const TemplateCatalog* findCompiled(std::string_view domain, const locale::Locale& locale) const;
+			
+			///template of the translation of `msgid` in `domain`, or of `msgid` itself if it has no translation
+			Template translate(std::string_view domain, locale::Locale& locale, std::string_view msgid) const;
+			///as above, using `untranslated` when there is no translation
+			Template translate(
+				std::string_view domain, 
+				locale::Locale& locale, 
+				std::string_view msgid, 
+				const preparse::TemplateSyntax& untranslated
+			) const;
 		private:
-			const std::string variable;
-			short precision;
-			locale::NumberFormat *formater;
+			///holds one of the catalogs
+			struct Entry {
+				std::string domain;
+				const locale::Locale *theLocale;
+				std::optional<Catalog> messages;
+				std::optional<TemplateCatalog> templates;
+			};
+			std::string folder;
+			std::vector<Entry> catalogs;
+			///message ids without a catalog, shared by copies of the set
+			std::shared_ptr<UntranslatedTemplates> untranslated;
 			
-			bool isAllNumber(std::string &str);
+			const Entry* findEntry(std::string_view domain, const locale::Locale& locale) const;
+	};
+
+};
+
+namespace mls {
+	
+	/**
+	 * @brief Everything a translation needs: the locale, the catalogs and the domain used when none is given
+	 * 
+	 * A server makes a context for each language it serves and picks one for every request, 
+	 * either passing it to `mls::translate(...)` or installing it with `TranslationContextGuard`.
+	 */
+	class TranslationContext {
 		public:
-			RealFormaterFunction(
-				std::string &&varName,
-				std::vector<std::string> &listOfOptions,
-				locale::Locale &theLocale
-			);
-			RealFormaterFunction(
-				std::string &&varName,
-				std::map<std::string, std::string> &hashOfOptions,
-				locale::Locale &theLocale
-			);
+			///`catalogs` must live longer than the context
+			TranslationContext(locale::Locale& locale, const backend::CatalogSet& catalogs, std::string domain);
 			
-			virtual std::string produceString(std::map<std::string_view, variableValue> &variables) override;
+			locale::Locale& getLocale() const;
+			const backend::CatalogSet& getCatalogs() const;
+			std::string_view getDomain() const;
+		private:
+			locale::Locale *theLocale;
+			const backend::CatalogSet *theCatalogs;
+			std::string defaultDomain;
 	};
 	
-	//------------- Template class
+	/**
+	 * @brief Installs a context for the current thread until the guard is destroyed
+	 * 
+	 * Guards can be nested, the previous context comes back when the inner guard goes. 
+	 * With a context installed, `mls::translate(...)` of the GetText backend, and so `_(...)`, translates with it.
+	 */
+	class TranslationContextGuard {
+		public:
+			explicit TranslationContextGuard(const TranslationContext& context);
+			TranslationContextGuard(const TranslationContextGuard&) = delete;
+			TranslationContextGuard& operator=(const TranslationContextGuard&) = delete;
+			~TranslationContextGuard();
+		private:
+			const TranslationContext *previous;
+	};
 	
-	Template::Template():myLocale{nullptr}, genderID{""} {
-		//do nothing else
-	}
+	///the context installed for the current thread, `nullptr` if there is none
+	const TranslationContext* currentTranslationContext();
 	
-	Template::Template(Template&& other):genderID{""} {
-		myLocale = other.myLocale;
-		other.myLocale = nullptr;
-		
-		for(char* aString : other.stringsList) {
-			stringsList.push_back(aString);
-		}
-		other.stringsList.clear();
-		
-		for(auto aFunction : other.functionsList) {
-			functionsList.push_back(aFunction);
-		}
-		other.functionsList.clear();
+	///Get template for `msgid` string in the context's domain
+	Template translate(const TranslationContext& context, std::string_view msgid);
+	///Get template for `msgid` string in the context's domain, using `untranslated` if it has no translation
+	Template translate(const TranslationContext& context, std::string_view msgid, const preparse::TemplateSyntax& untranslated);
+	///Get template for `msgid` string in another `domain`
+	Template translate(const TranslationContext& context, std::string_view domain, std::string_view msgid);
+	///Get template for `msgid` string in another `domain`, using `untranslated` if it has no translation
+	Template translate(
+		const TranslationContext& context, 
+		std::string_view domain, 
+		std::string_view msgid, 
+		const preparse::TemplateSyntax& untranslated
+	);
+	
+	///Get template for a `msgid` literal in the context's domain, the literal is checked while compiling
+	template<preparse::FixedString msgid>
+	Template translate(const TranslationContext& context) {
+		return translate(context, msgid.view(), literal<msgid>);
 	}
+
+};
+
+
+
+namespace mls::backend {
 	
-	Template::Template(const std::string templateString, locale::Locale& locale):
-		myLocale{&locale} {
-		using namespace preparse;
-		using Type = ParsedTemplateFunction::Type;
-		auto[charList, fnList] = preparse_template(templateString);
-		
-		try{
-			for(char* aString : charList) {
-				stringsList.push_back(aString);
-			}
-			
-			for(auto& functionDesc : fnList) {
-				//test for comments
-				if( functionDesc == nullptr ) {
-					functionsList.push_back(nullptr);
-					continue;
-				}
-				//select function
-				TemplateFunction* function = nullptr;
-				switch( functionDesc->name[0] ) {
-					case '\0': //Variable put
-						if( functionDesc->getType() != Type::VAR_ONLY) {
+	class IntlNotInitialized : public std::exception {};
+	
+	/**
+	 * @brief initialize the GetText utility
+	 * 
+	 * @param packageName Name of the GetText unit to pass to `bindtextdomain(...)`
+	 * @param wantedLocale Force select a specific locale. Pass `nullptr` to use system locale
+	 * @param folderLookup Setup a specific folder to look for `*.mo` files. Pass `nullptr` to use the default `/usr/local/share/locale`
+	 */
+	void init(
+		const char* packageName, 
+		const char* wantedLocale = nullptr, 
+		const char* folderLookup = nullptr
+		);
+	
+	///Counters of the cache of parsed templates used by `mls::translate(...)`
+	struct CacheStats {
+		///how many times a template was taken from the cache
+		std::size_t hits;
+		///how many times a template had to be parsed
+		std::size_t misses;
+		///how many templates were dropped to make room for new ones
+		std::size_t evictions;
+		///how many templates are in the cache now
+		std::size_t size;
+		///the maximum number of templates in the cache
+		std::size_t capacity;
+	};
+	
+	/**
+	 * @brief set the maximum number of parsed templates kept by `mls::translate(...)`
+	 * 
+	 * @param capacity The new limit. Pass `0` to turn the cache off. Least recently used templates above the limit are dropped
+	 */
+	void setCacheCapacity(std::size_t capacity);
+	
+	///Get the current counters of the templates cache
+	CacheStats getCacheStats();
+	
+	///Remove all templates from the cache and reset its counters
+	void clearCache();
+};
+
+namespace mls {
+	
+	// With a `TranslationContext` installed for the thread these functions translate with it, not with GetText
+	
+	///Get template for `msgid` string
+	Template translate(const char* msgid);
+	
+	///Get template for `msgid` string in a .mo `catalog`
+	Template translate(const char* catalog, const char* msgid);
+	
+	/**
+	 * @brief Get template for `msgid` string in a .mo `catalog`, using `untranslated` if it has no translation
+	 * 
+	 * `untranslated` must be the syntax of `msgid` and live as long as the program, like `mls::literal<...>` does
+	 */
+	Template translate(const char* catalog, const char* msgid, const preparse::TemplateSyntax& untranslated);
+	
+	///Get template for a `msgid` literal, which is checked while compiling
+	template<preparse::FixedString msgid>
+	Template translate() {
+		return translate(nullptr, msgid.data, literal<msgid>);
+	}
+	
+	///Get template for a `msgid` literal in a .mo `catalog`, the literal is checked while compiling
+	template<preparse::FixedString msgid>
+	Template translate(const char* catalog) {
+		return translate(catalog, msgid.data, literal<msgid>);
+	}
+
+};
+
+#ifndef MULANSTR_DONT_USE_UNDERSCORE
+
+#	ifndef MULANSTR_DONT_CHECK_LITERALS
+#		define _(msgid) mls::translate<msgid>()
+#		define _c(catalog, msgid) mls::translate<msgid>(catalog)
+#	else
+#		define _(msgid) mls::translate(msgid)
+#		define _c(catalog, msgid) mls::translate(catalog, msgid)
+#	endif
+
+#endif
+
+
+
+
+
+#ifdef MULAN_STRING_IMPLEMENTATION
+
+
+
+
+namespace mls {
+	
+	InvalidTemplateState::InvalidTemplateState(std::string errString): err{errString} {};
+	const char* InvalidTemplateState::what() const noexcept {
+		return err.c_str();
+	}
+	
+	InvalidPluralRules::InvalidPluralRules(std::string errString): err{errString} {};
+	const char* InvalidPluralRules::what() const noexcept {
+		return err.c_str();
+	}
+	
+	InvalidLocaleData::InvalidLocaleData(std::string errString): err{errString} {};
+	const char* InvalidLocaleData::what() const noexcept {
+		return err.c_str();
+	}
+	
+	InvalidCatalog::InvalidCatalog(std::string errString): err{errString} {};
+	const char* InvalidCatalog::what() const noexcept {
+		return err.c_str();
+	}
+
+};
+
+
+
+namespace mls::locale {
+	
+	//------------- Operands
+	
+	namespace {
+		
+		///digits kept exactly; longer numbers keep their lowest digits over `10^18`, so modulus and comparisons still work
+		constexpr std::size_t MAX_OPERAND_DIGITS = 18u;
+		constexpr std::uint64_t OPERAND_OVERFLOW = 1'000'000'000'000'000'000u;
+		
+		std::uint64_t readOperandDigits(std::string_view digits) {
+			bool tooLong = digits.size() > MAX_OPERAND_DIGITS;
+			if( tooLong ) {
+				digits.remove_prefix(digits.size() - MAX_OPERAND_DIGITS);
+			}
+			std::uint64_t result = 0u;
+			for(char digit : digits) {
+				result = result * 10u + static_cast<std::uint64_t>(digit - '0');
+			}
+			return tooLong ? result + OPERAND_OVERFLOW : result;
+		}
+		
+		bool isDigit(char c) {
+			return c >= '0' && c <= '9';
+		}
+	
+	};
+	
+	PluralOperands pluralOperands(long integer) {
+		PluralOperands result;
+		//`-integer` overflows for the smallest `long`, its unsigned negation doesn't
+		result.i = integer < 0 ? 0ul - static_cast<unsigned long>(integer) : static_cast<unsigned long>(integer);
+		return result;
+	}
+	
+	PluralOperands pluralOperands(double real, short precision) {
+		//the sign, 309 integer digits, the dot and the fraction
+		char text[1 + 309 + 1 + 1074];
+		std::to_chars_result written;
+		if( precision < 0 ) {
+			written = std::to_chars(&text[0], &text[0] + sizeof(text), real, std::chars_format::fixed);
+		} else {
+			written = std::to_chars(&text[0], &text[0] + sizeof(text), real, std::chars_format::fixed, precision < 1074 ? precision : 1074);
+		}
+		if( written.ec != std::errc() ) {
+			return PluralOperands{};
+		}
+		return pluralOperands( std::string_view(&text[0], static_cast<std::size_t>(written.ptr - &text[0])) );
+	}
+	
+	PluralOperands pluralOperands(std::string_view decimal) {
+		if( !decimal.empty() && (decimal[0] == '-' || decimal[0] == '+') ) {
+			decimal.remove_prefix(1);
+		}
+		std::size_t integerEnd = 0u;
+		while( integerEnd < decimal.size() && isDigit(decimal[integerEnd]) ) {
+			++integerEnd;
+		}
+		PluralOperands result;
+		result.i = readOperandDigits( decimal.substr(0, integerEnd) );
+		if( integerEnd == decimal.size() || decimal[integerEnd] != '.' ) {
+			return result;
+		}
+		
+		std::string_view fraction = decimal.substr(integerEnd + 1u);
+		std::size_t fractionEnd = 0u;
+		while( fractionEnd < fraction.size() && isDigit(fraction[fractionEnd]) ) {
+			++fractionEnd;
+		}
+		//digits past the 18th are too small to matter
+		fraction = fraction.substr(0, fractionEnd < MAX_OPERAND_DIGITS ? fractionEnd : MAX_OPERAND_DIGITS);
+		result.v = static_cast<std::uint32_t>(fraction.size());
+		result.f = readOperandDigits(fraction);
+		
+		std::size_t significant = fraction.find_last_not_of('0');
+		fraction = significant == std::string_view::npos ? std::string_view{} : fraction.substr(0, significant + 1u);
+		result.w = static_cast<std::uint32_t>(fraction.size());
+		result.t = readOperandDigits(fraction);
+		return result;
+	}
+	
+	//------------- Parser
+	
+	namespace {
+		
+		///categories are stored in compiled programs as indexes of this list
+		constexpr const char* CATEGORY_NAMES[] = {"zero", "one", "two", "few", "many", "other"};
+		constexpr unsigned char OTHER_CATEGORY = 5u;
+		
+		std::string_view trimRule(std::string_view text) {
+			std::size_t begin = text.find_first_not_of(" \t\r\n");
+			if( begin == std::string_view::npos ) {
+				return std::string_view{};
+			}
+			std::size_t end = text.find_last_not_of(" \t\r\n");
+			return text.substr(begin, end - begin + 1u);
+		}
+		
+		bool isWordChar(char c) {
+			return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || isDigit(c) || c == '_';
+		}
+		
+		///reads a condition of a rule from the left, throwing on errors
+		class ConditionReader {
+				std::string_view text;
+				std::string_view wholeRules;
+			public:
+				ConditionReader(std::string_view condition, std::string_view rules): text{condition}, wholeRules{rules} {}
+				
+				[[noreturn]] void fail(const char* message) const {
+					throw InvalidPluralRules(std::string{message} + " at \"" + std::string{text} + "\" in: " + std::string{wholeRules});
+				}
+				
+				bool atEnd() {
+					text = trimRule(text);
+					return text.empty();
+				}
+				
+				///reads a symbol, or a keyword not followed by other letters
+				bool accept(std::string_view token) {
+					text = trimRule(text);
+					if( !text.starts_with(token) ) {
+						return false;
+					}
+					if( isWordChar(token.back()) && text.size() > token.size() && isWordChar(text[token.size()]) ) {
+						return false;
+					}
+					text.remove_prefix(token.size());
+					return true;
+				}
+				
+				std::uint64_t readValue() {
+					text = trimRule(text);
+					std::uint64_t value = 0u;
+					auto[lastPtr, err] = std::from_chars(text.data(), text.data() + text.size(), value);
+					if( err != std::errc() ) {
+						fail("A number expected");
+					}
+					text.remove_prefix(static_cast<std::size_t>(lastPtr - text.data()));
+					return value;
+				}
+				
+				char readOperand() {
+					text = trimRule(text);
+					if( text.empty() || (text.size() > 1u && isWordChar(text[1])) ) {
+						fail("An operand expected");
+					}
+					char operand = text[0];
+					text.remove_prefix(1);
+					return operand;
+				}
+		};
+	
+	};
+	
+	PluralRules::PluralRules() {
+		compile({}, {}, {}, {});
+	}
+	
+	PluralRules::PluralRules(std::string_view rules) {
+		using Operand = Relation::Operand;
+		std::vector<Range> newRanges;
+		std::vector<Relation> newRelations;
+		std::vector<std::uint32_t> newCategoryEnds;
+		std::vector<unsigned char> categoryCodes;
+		std::string_view rest = rules;
+		while( !rest.empty() ) {
+			std::size_t end = rest.find(';');
+			std::string_view rule = rest.substr(0, end);
+			rest = end == std::string_view::npos ? std::string_view{} : rest.substr(end + 1u);
+			if( trimRule(rule).empty() ) {
+				continue;
+			}
+			
+			std::size_t colon = rule.find(':');
+			if( colon == std::string_view::npos ) {
+				throw InvalidPluralRules("No ':' after the category name in: " + std::string{rules});
+			}
+			std::string_view name = trimRule(rule.substr(0, colon));
+			//samples are only for people
+			std::string_view condition = trimRule(rule.substr(colon + 1u, rule.find('@') - colon - 1u));
+			
+			unsigned char category = OTHER_CATEGORY + 1u;
+			for(unsigned char known=0u; known<=OTHER_CATEGORY; ++known) {
+				if( name == CATEGORY_NAMES[known] ) {
+					category = known;
+				}
+			}
+			if( category > OTHER_CATEGORY ) {
+				throw InvalidPluralRules("Unknown plural category \"" + std::string{name} + "\" in: " + std::string{rules});
+			}
+			if( std::find(categoryCodes.begin(), categoryCodes.end(), category) != categoryCodes.end() ) {
+				throw InvalidPluralRules("Repeated plural category \"" + std::string{name} + "\" in: " + std::string{rules});
+			}
+			if( category == OTHER_CATEGORY ) {
+				if( !condition.empty() ) {
+					throw InvalidPluralRules("The \"other\" category can't have a condition in: " + std::string{rules});
+				}
+				continue;
+			}
+			if( condition.empty() ) {
+				throw InvalidPluralRules("No condition of \"" + std::string{name} + "\" in: " + std::string{rules});
+			}
+			
+			ConditionReader reader{condition, rules};
+			do {
+				do {
+					Relation relation{0u, static_cast<std::uint32_t>(newRanges.size()), 0u, Operand::N, false, false, false};
+					switch( reader.readOperand() ) {
+						case 'n': relation.operand = Operand::N; break;
+						case 'i': relation.operand = Operand::I; break;
+						case 'v': relation.operand = Operand::V; break;
+						case 'w': relation.operand = Operand::W; break;
+						case 'f': relation.operand = Operand::F; break;
+						case 't': relation.operand = Operand::T; break;
+						//compact decimal exponent, numbers are never written in the compact form
+						case 'e':
+						case 'c': relation.operand = Operand::ZERO; break;
+						default: reader.fail("Unknown operand");
+					}
+					if( reader.accept("mod") || reader.accept("%") ) {
+						relation.modulus = reader.readValue();
+						if( relation.modulus == 0u ) {
+							reader.fail("Modulus of 0");
+						}
+					}
+					
+					if( reader.accept("!=") ) {
+						relation.negated = true;
+					} else if( reader.accept("is") ) {
+						relation.negated = reader.accept("not");
+					} else if( !reader.accept("=") ) {
+						relation.negated = reader.accept("not");
+						if( reader.accept("within") ) {
+							relation.within = true;
+						} else if( !reader.accept("in") ) {
+							reader.fail("A relation expected");
+						}
+					}
+					
+					do {
+						Range range;
+						range.from = reader.readValue();
+						range.to = reader.accept("..") ? reader.readValue() : range.from;
+						if( range.to < range.from ) {
+							reader.fail("An empty range");
+						}
+						newRanges.push_back(range);
+					} while( reader.accept(",") );
+					relation.rangesCount = static_cast<std::uint32_t>(newRanges.size()) - relation.firstRange;
+					newRelations.push_back(relation);
+				} while( reader.accept("and") );
+				newRelations.back().endsAndChain = true;
+			} while( reader.accept("or") );
+			if( !reader.atEnd() ) {
+				reader.fail("Unexpected text");
+			}
+			
+			categoryCodes.push_back(category);
+			newCategoryEnds.push_back( static_cast<std::uint32_t>(newRelations.size()) );
+		}
+		compile(newRanges, newRelations, newCategoryEnds, categoryCodes);
+	}
+	
+	PluralRules::PluralRules(std::span<const std::byte> program, std::shared_ptr<const void> owner): storage{std::move(owner)} {
+		readProgram(program);
+	}
+	
+	const std::vector<const char*>& PluralRules::getCategories() const {
+		return categories;
+	}
+	
+	std::span<const std::byte> PluralRules::program() const {
+		return programBytes;
+	}
+	
+	//------------- Compiled program
+	
+	namespace {
+		
+		///offsets of the parts of a compiled program
+		struct ProgramLayout {
+			std::uint64_t ranges;
+			std::uint64_t relations;
+			std::uint64_t categoryEnds;
+			std::uint64_t categoryCodes;
+			std::uint64_t integersTable;
+			std::uint64_t end;
+		};
+		
+		template<typename Header, typename Range, typename Relation>
+		ProgramLayout layoutOf(const Header& header) {
+			ProgramLayout layout;
+			layout.ranges = sizeof(Header);
+			layout.relations = layout.ranges + std::uint64_t{header.rangesCount} * sizeof(Range);
+			layout.categoryEnds = layout.relations + std::uint64_t{header.relationsCount} * sizeof(Relation);
+			layout.categoryCodes = layout.categoryEnds + std::uint64_t{header.categoriesCount} * sizeof(std::uint32_t);
+			layout.integersTable = layout.categoryCodes + header.categoriesCount;
+			layout.end = layout.integersTable + header.integersTableSize;
+			return layout;
+		}
+		
+		[[noreturn]] void failProgram(const char* reason) {
+			throw InvalidPluralRules(std::string{"Broken compiled plural rules: "} + reason);
+		}
+	
+	};
+	
+	void PluralRules::compile(
+		const std::vector<Range>& newRanges,
+		const std::vector<Relation>& newRelations,
+		const std::vector<std::uint32_t>& newCategoryEnds,
+		const std::vector<unsigned char>& categoryCodes
+	) {
+		static_assert(sizeof(ProgramHeader) == 24u && sizeof(Range) == 16u && sizeof(Relation) == 24u, "The compiled program has a fixed layout");
+		//the table's shape depends only on the relations, its entries are written after the program can be evaluated
+		ranges = newRanges;
+		relations = newRelations;
+		auto[tableSize, period] = integersTableShape();
+		
+		ProgramHeader header{
+			static_cast<std::uint32_t>(categoryCodes.size()),
+			static_cast<std::uint32_t>(newRelations.size()),
+			static_cast<std::uint32_t>(newRanges.size()),
+			static_cast<std::uint32_t>(tableSize),
+			period
+		};
+		const ProgramLayout layout = layoutOf<ProgramHeader, Range, Relation>(header);
+		//words keep the program aligned, and are zeroed
+		auto words = std::make_shared<std::uint64_t[]>( (layout.end + 7u) / 8u );
+		std::byte* bytes = reinterpret_cast<std::byte*>( words.get() );
+		std::memcpy(bytes, &header, sizeof(header));
+		std::memcpy(bytes + layout.ranges, newRanges.data(), newRanges.size() * sizeof(Range));
+		std::memcpy(bytes + layout.relations, newRelations.data(), newRelations.size() * sizeof(Relation));
+		std::memcpy(bytes + layout.categoryEnds, newCategoryEnds.data(), newCategoryEnds.size() * sizeof(std::uint32_t));
+		std::memcpy(bytes + layout.categoryCodes, categoryCodes.data(), categoryCodes.size());
+		storage = words;
+		readProgram( std::span<const std::byte>(bytes, layout.end) );
+		
+		unsigned char* table = reinterpret_cast<unsigned char*>(bytes + layout.integersTable);
+		for(std::uint64_t number=0u; number<tableSize; ++number) {
+			PluralOperands operands;
+			operands.i = number;
+			table[number] = static_cast<unsigned char>( evaluate(operands) );
+		}
+	}
+	
+	void PluralRules::readProgram(std::span<const std::byte> program) {
+		if( reinterpret_cast<std::uintptr_t>(program.data()) % alignof(std::uint64_t) != 0u ) {
+			failProgram("not aligned to 8 bytes");
+		}
+		if( program.size() < sizeof(ProgramHeader) ) {
+			failProgram("too short");
+		}
+		ProgramHeader header;
+		std::memcpy(&header, program.data(), sizeof(header));
+		const ProgramLayout layout = layoutOf<ProgramHeader, Range, Relation>(header);
+		if( layout.end > program.size() ) {
+			failProgram("too short");
+		}
+		if( header.categoriesCount > OTHER_CATEGORY ) {
+			failProgram("too many categories");
+		}
+		const std::byte* base = program.data();
+		
+		ranges = std::span<const Range>(reinterpret_cast<const Range*>(base + layout.ranges), header.rangesCount);
+		for(auto& range : ranges) {
+			if( range.to < range.from ) {
+				failProgram("an empty range");
+			}
+		}
+		//flags are checked as bytes before they are read as `bool`
+		for(std::uint32_t relation=0u; relation<header.relationsCount; ++relation) {
+			const std::byte* raw = base + layout.relations + relation * sizeof(Relation);
+			if(
+				std::to_integer<unsigned>(raw[offsetof(Relation, operand)]) > static_cast<unsigned>(Relation::Operand::ZERO)
+				|| std::to_integer<unsigned>(raw[offsetof(Relation, negated)]) > 1u
+				|| std::to_integer<unsigned>(raw[offsetof(Relation, within)]) > 1u
+				|| std::to_integer<unsigned>(raw[offsetof(Relation, endsAndChain)]) > 1u
+			) {
+				failProgram("an invalid relation");
+			}
+		}
+		relations = std::span<const Relation>(reinterpret_cast<const Relation*>(base + layout.relations), header.relationsCount);
+		for(auto& relation : relations) {
+			if( std::uint64_t{relation.firstRange} + relation.rangesCount > header.rangesCount ) {
+				failProgram("a relation past the ranges");
+			}
+		}
+		
+		categoryEnds = std::span<const std::uint32_t>(reinterpret_cast<const std::uint32_t*>(base + layout.categoryEnds), header.categoriesCount);
+		std::uint32_t previousEnd = 0u;
+		for(std::uint32_t end : categoryEnds) {
+			if( end < previousEnd || end > header.relationsCount ) {
+				failProgram("a category past the relations");
+			}
+			previousEnd = end;
+		}
+		categories.clear();
+		for(std::uint32_t category=0u; category<header.categoriesCount; ++category) {
+			const unsigned char code = std::to_integer<unsigned char>(base[layout.categoryCodes + category]);
+			if( code >= OTHER_CATEGORY ) {
+				failProgram("an unknown category");
+			}
+			if( std::find(categories.begin(), categories.end(), CATEGORY_NAMES[code]) != categories.end() ) {
+				failProgram("a repeated category");
+			}
+			categories.push_back(CATEGORY_NAMES[code]);
+		}
+		categories.push_back(CATEGORY_NAMES[OTHER_CATEGORY]);
+		
+		integersTable = std::span<const unsigned char>(reinterpret_cast<const unsigned char*>(base + layout.integersTable), header.integersTableSize);
+		integersPeriod = 1u;
+		if( !integersTable.empty() ) {
+			if( header.integersPeriod == 0u || header.integersPeriod > integersTable.size() ) {
+				failProgram("a wrong period of the table of integers");
+			}
+			for(unsigned char category : integersTable) {
+				if( category > header.categoriesCount ) {
+					failProgram("an unknown category in the table of integers");
+				}
+			}
+			integersPeriod = header.integersPeriod;
+		}
+		programBytes = program.first(layout.end);
+	}
+	
+	//------------- Evaluation
+	
+	bool PluralRules::matches(const Relation& relation, const PluralOperands& number) const {
+		using Operand = Relation::Operand;
+		std::uint64_t value = 0u;
+		//only `n` can have a fraction, its integer part is `i`
+		bool hasFraction = false;
+		switch( relation.operand ) {
+			case Operand::N: value = number.i; hasFraction = number.t != 0u; break;
+			case Operand::I: value = number.i; break;
+			case Operand::V: value = number.v; break;
+			case Operand::W: value = number.w; break;
+			case Operand::F: value = number.f; break;
+			case Operand::T: value = number.t; break;
+			case Operand::ZERO: break;
+		}
+		if( relation.modulus != 0u ) {
+			//32-bit division is a few times faster
+			if( (value | relation.modulus) <= 0xFFFF'FFFFu ) {
+				value = static_cast<std::uint32_t>(value) % static_cast<std::uint32_t>(relation.modulus);
+			} else {
+				value %= relation.modulus;
+			}
+		}
+		
+		bool found = false;
+		const Range* range = ranges.data() + relation.firstRange;
+		const Range* rangesEnd = range + relation.rangesCount;
+		if( hasFraction ) {
+			//a number with a fraction is never `in` a range of integers, but can be `within` it
+			for(; relation.within && range != rangesEnd; ++range) {
+				found |= (range->from <= value) & (value < range->to);
+			}
+		} else {
+			for(; range != rangesEnd; ++range) {
+				found |= (range->from <= value) & (value <= range->to);
+			}
+		}
+		return found != relation.negated;
+	}
+	
+	std::size_t PluralRules::evaluate(const PluralOperands& number) const {
+		std::uint32_t relation = 0u;
+		for(std::size_t category=0u; category<categoryEnds.size(); ++category) {
+			bool chainHolds = true;
+			bool anyChainHolds = false;
+			for(; relation<categoryEnds[category]; ++relation) {
+				//the rest of a failed `and` chain isn't checked
+				chainHolds = chainHolds && matches(relations[relation], number);
+				if( relations[relation].endsAndChain ) {
+					anyChainHolds |= chainHolds;
+					chainHolds = true;
+				}
+			}
+			if( anyChainHolds ) {
+				return category;
+			}
+		}
+		//other
+		return categories.size() - 1u;
+	}
+	
+	std::pair<std::uint64_t, std::uint64_t> PluralRules::integersTableShape() const {
+		using Operand = Relation::Operand;
+		//an integer's category depends only on `i`: ranges compared with `i` end below the `threshold`
+		// and categories of larger integers repeat with the `period`, the common multiple of moduli of `i`
+		std::uint64_t threshold = 0u;
+		std::uint64_t period = 1u;
+		for(auto& relation : relations) {
+			if( relation.operand != Operand::N && relation.operand != Operand::I ) {
+				continue;
+			}
+			if( relation.modulus != 0u ) {
+				period = std::lcm(period, relation.modulus);
+				if( period > MAX_INTEGERS_TABLE ) {
+					return {0u, 1u};
+				}
+				continue;
+			}
+			for(std::uint32_t range=relation.firstRange; range<relation.firstRange + relation.rangesCount; ++range) {
+				if( ranges[range].to >= MAX_INTEGERS_TABLE ) {
+					return {0u, 1u};
+				}
+				threshold = std::max(threshold, ranges[range].to + 1u);
+			}
+		}
+		
+		//the last period of the table starts at or above the threshold
+		const std::uint64_t size = ((threshold + period - 1u) / period + 1u) * period;
+		if( size > 2u * MAX_INTEGERS_TABLE ) {
+			return {0u, 1u};
+		}
+		return {size, period};
+	}
+	
+	std::size_t PluralRules::select(const PluralOperands& number) const {
+		if( number.v == 0u ) {
+			return select(number.i);
+		}
+		return evaluate(number);
+	}
+	
+	std::size_t PluralRules::select(std::uint64_t number) const {
+		if( integersTable.empty() ) {
+			PluralOperands operands;
+			operands.i = number;
+			return evaluate(operands);
+		}
+		if( number < integersTable.size() ) {
+			return integersTable[number];
+		}
+		return integersTable[integersTable.size() - integersPeriod + number % integersPeriod];
+	}
+	
+	//------------- Rules of languages
+	
+	/*
+	
+	=================== CLDR plural rules ===================
+	based on: https://unicode-org.github.io/cldr-staging/charts/latest/supplemental/language_plural_rules.html
+	
+	*/
+	
+	// cSpell: disable
+	namespace {
+		
+		struct LanguageRules {
+			std::string_view language;
+			const char* rules;
+		};
+		
+		constexpr const char* EAST_SLAVIC_RULES =
+			"one: v = 0 and i % 10 = 1 and i % 100 != 11;"
+			"few: v = 0 and i % 10 = 2..4 and i % 100 != 12..14;"
+			"many: v = 0 and i % 10 = 0 or v = 0 and i % 10 = 5..9 or v = 0 and i % 100 = 11..14";
+		constexpr const char* WEST_SLAVIC_RULES =
+			"one: i = 1 and v = 0; few: i = 2..4 and v = 0; many: v != 0";
+		constexpr const char* SOUTH_SLAVIC_RULES =
+			"one: v = 0 and i % 10 = 1 and i % 100 != 11 or f % 10 = 1 and f % 100 != 11;"
+			"few: v = 0 and i % 10 = 2..4 and i % 100 != 12..14 or f % 10 = 2..4 and f % 100 != 12..14";
+		constexpr const char* ONE_IF_INTEGER_1 = "one: i = 1 and v = 0";
+		constexpr const char* ONE_IF_1 = "one: n = 1";
+		constexpr const char* ONE_IF_0_OR_1 = "one: i = 0 or n = 1";
+		constexpr const char* ONLY_OTHER = "";
+		
+		///sorted by the language code
+		constexpr LanguageRules LANGUAGES_RULES[] = {
+			{"ar", "zero: n = 0; one: n = 1; two: n = 2; few: n % 100 = 3..10; many: n % 100 = 11..99"},
+			{"be",
+				"one: n % 10 = 1 and n % 100 != 11;"
+				"few: n % 10 = 2..4 and n % 100 != 12..14;"
+				"many: n % 10 = 0 or n % 10 = 5..9 or n % 100 = 11..14"},
+			{"bg", ONE_IF_1},
+			{"bn", ONE_IF_0_OR_1},
+			{"bs", SOUTH_SLAVIC_RULES},
+			{"ca", ONE_IF_INTEGER_1},
+			{"cs", WEST_SLAVIC_RULES},
+			{"cy", "zero: n = 0; one: n = 1; two: n = 2; few: n = 3; many: n = 6"},
+			{"da", "one: n = 1 or t != 0 and i = 0,1"},
+			{"de", ONE_IF_INTEGER_1},
+			{"el", ONE_IF_1},
+			{"en", ONE_IF_INTEGER_1},
+			{"es", ONE_IF_1},
+			{"et", ONE_IF_INTEGER_1},
+			{"fa", ONE_IF_0_OR_1},
+			{"fi", ONE_IF_INTEGER_1},
+			{"fr", "one: i = 0,1"},
+			{"ga", "one: n = 1; two: n = 2; few: n = 3..6; many: n = 7..10"},
+			{"gd", "one: n = 1,11; two: n = 2,12; few: n = 3..10,13..19"},
+			{"he", "one: i = 1 and v = 0; two: i = 2 and v = 0; many: v = 0 and n != 0..10 and n % 10 = 0"},
+			{"hi", ONE_IF_0_OR_1},
+			{"hr", SOUTH_SLAVIC_RULES},
+			{"hu", ONE_IF_1},
+			{"id", ONLY_OTHER},
+			{"is", "one: t = 0 and i % 10 = 1 and i % 100 != 11 or t != 0"},
+			{"it", ONE_IF_INTEGER_1},
+			{"ja", ONLY_OTHER},
+			{"ka", ONE_IF_1},
+			{"kk", ONE_IF_1},
+			{"ko", ONLY_OTHER},
+			{"lt", "one: n % 10 = 1 and n % 100 != 11..19; few: n % 10 = 2..9 and n % 100 != 11..19; many: f != 0"},
+			{"lv",
+				"zero: n % 10 = 0 or n % 100 = 11..19 or v = 2 and f % 100 = 11..19;"
+				"one: n % 10 = 1 and n % 100 != 11 or v = 2 and f % 10 = 1 and f % 100 != 11 or v != 2 and f % 10 = 1"},
+			{"mk", "one: v = 0 and i % 10 = 1 and i % 100 != 11 or f % 10 = 1 and f % 100 != 11"},
+			{"ms", ONLY_OTHER},
+			{"nb", ONE_IF_1},
+			{"nl", ONE_IF_INTEGER_1},
+			{"pl",
+				"one: i = 1 and v = 0;"
+				"few: v = 0 and i % 10 = 2..4 and i % 100 != 12..14;"
+				"many: v = 0 and i != 1 and i % 10 = 0..1 or v = 0 and i % 10 = 5..9 or v = 0 and i % 100 = 12..14"},
+			{"pt", "one: i = 0..1"},
+			{"ro", "one: i = 1 and v = 0; few: v != 0 or n = 0 or n % 100 = 2..19"},
+			{"ru", EAST_SLAVIC_RULES},
+			{"sk", WEST_SLAVIC_RULES},
+			{"sl", "one: v = 0 and i % 100 = 1; two: v = 0 and i % 100 = 2; few: v = 0 and i % 100 = 3..4 or v != 0"},
+			{"sq", ONE_IF_1},
+			{"sr", SOUTH_SLAVIC_RULES},
+			{"sv", ONE_IF_INTEGER_1},
+			{"th", ONLY_OTHER},
+			{"tr", ONE_IF_1},
+			{"uk", EAST_SLAVIC_RULES},
+			{"vi", ONLY_OTHER},
+			{"zh", ONLY_OTHER}
+		};
+	
+	};
+	// cSpell: enable
+	
+	const char* cldrPluralRules(std::string_view language) {
+		for(auto& entry : LANGUAGES_RULES) {
+			if( entry.language == language ) {
+				return entry.rules;
+			}
+		}
+		return nullptr;
+	}
+
+};
+
+
+
+#if defined(_WIN32)
+#	ifndef NOMINMAX
+#		define NOMINMAX
+#	endif
+#	include <windows.h>
+#else
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
+namespace mls {
+	
+	MappedFile::MappedFile(const std::byte* mappedData, std::size_t mappedSize): data{mappedData}, size{mappedSize} {}
+	
+	std::shared_ptr<const MappedFile> MappedFile::open(const std::string& path) {
+		#if defined(_WIN32)
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if( file == INVALID_HANDLE_VALUE ) {
+			return nullptr;
+		}
+		LARGE_INTEGER fileSize;
+		if( !GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0 ) {
+			CloseHandle(file);
+			return nullptr;
+		}
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		CloseHandle(file);
+		if( mapping == nullptr ) {
+			return nullptr;
+		}
+		//the view keeps the mapping open
+		void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(mapping);
+		if( view == nullptr ) {
+			return nullptr;
+		}
+		return std::shared_ptr<const MappedFile>( new MappedFile(static_cast<const std::byte*>(view), static_cast<std::size_t>(fileSize.QuadPart)) );
+		#else
+		int file = ::open(path.c_str(), O_RDONLY);
+		if( file < 0 ) {
+			return nullptr;
+		}
+		struct stat status;
+		if( ::fstat(file, &status) != 0 || status.st_size == 0 ) {
+			::close(file);
+			return nullptr;
+		}
+		//the mapping stays after the file is closed
+		void* view = ::mmap(nullptr, static_cast<std::size_t>(status.st_size), PROT_READ, MAP_SHARED, file, 0);
+		::close(file);
+		if( view == MAP_FAILED ) {
+			return nullptr;
+		}
+		return std::shared_ptr<const MappedFile>( new MappedFile(static_cast<const std::byte*>(view), static_cast<std::size_t>(status.st_size)) );
+		#endif
+	}
+	
+	MappedFile::~MappedFile() {
+		#if defined(_WIN32)
+		UnmapViewOfFile(data);
+		#else
+		::munmap(const_cast<std::byte*>(data), size);
+		#endif
+	}
+	
+	std::span<const std::byte> MappedFile::bytes() const {
+		return std::span<const std::byte>(data, size);
+	}
+
+};
+
+
+
+namespace mls::locale {
+	
+	namespace {
+		
+		///formats of built-in locales have the first IDs, so they need no work when the program starts
+		constexpr std::string_view BUILT_IN_FORMAT_NAMES[] = {"general", "grouped"};
+		constexpr std::size_t BUILT_IN_FORMATS_COUNT = std::size(BUILT_IN_FORMAT_NAMES);
+		
+		///names of other number formats, their IDs follow the built-in ones; a deque, so given out names never move
+		std::deque<std::string>& addedFormatNames() {
+			static std::deque<std::string> names;
+			return names;
+		}
+		
+		///guards `addedFormatNames()`, locales may be made on many threads
+		std::mutex& addedFormatNamesGuard() {
+			static std::mutex guard;
+			return guard;
+		}
+		
+		///the ID of an added name, `NO_NUMBER_FORMAT` if it wasn't added; the caller locks the names
+		NumberFormatID findAddedFormatID(std::string_view name) {
+			auto& names = addedFormatNames();
+			for(std::size_t id=0u; id<names.size(); ++id) {
+				if( names[id] == name ) {
+					return static_cast<NumberFormatID>(BUILT_IN_FORMATS_COUNT + id);
+				}
+			}
+			return NO_NUMBER_FORMAT;
+		}
+		
+		///there are a few names, and each is looked up once, when a template using it is made
+		NumberFormatID internNumberFormat(std::string_view name) {
+			for(std::size_t id=0u; id<BUILT_IN_FORMATS_COUNT; ++id) {
+				if( BUILT_IN_FORMAT_NAMES[id] == name ) {
+					return static_cast<NumberFormatID>(id);
+				}
+			}
+			std::lock_guard<std::mutex> lock{addedFormatNamesGuard()};
+			NumberFormatID id = findAddedFormatID(name);
+			if( id == NO_NUMBER_FORMAT ) {
+				auto& names = addedFormatNames();
+				id = static_cast<NumberFormatID>(BUILT_IN_FORMATS_COUNT + names.size());
+				names.emplace_back(name);
+			}
+			return id;
+		}
+		
+		///lists of a locale made at run time
+		struct OwnedLists {
+			std::vector<const char*> plurals;
+			std::vector<const char*> cases;
+			std::vector<const char*> genders;
+			///names of `formats`, never reallocated
+			std::vector<std::string> formatNames;
+			std::vector<NamedNumberFormat> formats;
+		};
+	
+	};
+	
+	NumberFormatID findNumberFormatID(std::string_view name) {
+		for(std::size_t id=0u; id<BUILT_IN_FORMATS_COUNT; ++id) {
+			if( BUILT_IN_FORMAT_NAMES[id] == name ) {
+				return static_cast<NumberFormatID>(id);
+			}
+		}
+		std::lock_guard<std::mutex> lock{addedFormatNamesGuard()};
+		return findAddedFormatID(name);
+	}
+	
+	std::string_view numberFormatName(NumberFormatID id) {
+		if( id < BUILT_IN_FORMATS_COUNT ) {
+			return BUILT_IN_FORMAT_NAMES[id];
+		}
+		std::lock_guard<std::mutex> lock{addedFormatNamesGuard()};
+		auto& names = addedFormatNames();
+		return id - BUILT_IN_FORMATS_COUNT < names.size() ? std::string_view{names[id - BUILT_IN_FORMATS_COUNT]} : std::string_view{};
+	}
+	
+	void Locale::ownLists(
+		std::initializer_list<const char*> pluralForms,
+		std::initializer_list<const char*> cases,
+		std::initializer_list<const char*> genders,
+		std::initializer_list<std::pair<std::string, NumberFormat>> numberFormats
+	) {
+		auto lists = std::make_shared<OwnedLists>();
+		lists->plurals.assign(pluralForms);
+		lists->cases.assign(cases);
+		lists->genders.assign(genders);
+		lists->formatNames.reserve(numberFormats.size());
+		for(auto& format : numberFormats) {
+			lists->formatNames.push_back(format.first);
+			lists->formats.push_back( NamedNumberFormat{lists->formatNames.back(), format.second} );
+		}
+		functionPlurals = lists->plurals;
+		casesList = lists->cases;
+		gendersList = lists->genders;
+		numFormats = lists->formats;
+		ownedLists = std::move(lists);
+		indexNumberFormats();
+	}
+	
+	void Locale::indexNumberFormats() {
+		for(auto& format : numFormats) {
+			NumberFormatID id = internNumberFormat(format.name);
+			//the first format of a name wins, like in a lookup by name
+			if( id < INDEXED_FORMATS_COUNT && formatsByID[id] == nullptr ) {
+				formatsByID[id] = &format.format;
+			}
+		}
+	}
+	
+	void Locale::fillPluralsTable() {
+		#ifdef MULANSTR_PLURAL_TABLE
+		for(unsigned long n=0u; n<SMALL_NUMBERS_COUNT; ++n) {
+			smallNumbersPlurals[n] = static_cast<unsigned char>( pluralFunction != nullptr ? pluralFunction(n) : pluralRules.select(n) );
+		}
+		#endif
+	}
+	
+	Locale::Locale(
+		std::string_view name,
+		std::initializer_list<const char*> pluralForms,
+		pluralizer pluralFn,
+		std::initializer_list<const char*> cases,
+		std::initializer_list<const char*> genders,
+		std::initializer_list<std::pair<std::string, NumberFormat>> numberFormats
+	): myName{name}, pluralFunction{pluralFn} {
+		ownLists(pluralForms, cases, genders, numberFormats);
+		fillPluralsTable();
+	}
+	
+	Locale::Locale(
+		std::string_view name,
+		std::string_view cldrPluralRules,
+		std::initializer_list<const char*> cases,
+		std::initializer_list<const char*> genders,
+		std::initializer_list<std::pair<std::string, NumberFormat>> numberFormats
+	): myName{name}, pluralRules{cldrPluralRules} {
+		ownLists({}, cases, genders, numberFormats);
+		fillPluralsTable();
+	}
+	
+	Locale::Locale(
+		std::string_view name,
+		PluralRules rules,
+		std::vector<const char*> cases,
+		std::vector<const char*> genders,
+		std::vector<NamedNumberFormat> numberFormats
+	): myName{name}, pluralRules{std::move(rules)} {
+		auto lists = std::make_shared<OwnedLists>();
+		lists->cases = std::move(cases);
+		lists->genders = std::move(genders);
+		lists->formats = std::move(numberFormats);
+		casesList = lists->cases;
+		gendersList = lists->genders;
+		numFormats = lists->formats;
+		ownedLists = std::move(lists);
+		indexNumberFormats();
+		fillPluralsTable();
+	}
+	
+	Locale::Locale(const LocaleDefinition& definition):
+		myName{definition.name}, pluralRules{definition.pluralRules},
+		casesList{definition.cases}, gendersList{definition.genders}, numFormats{definition.numberFormats} {
+		indexNumberFormats();
+		fillPluralsTable();
+	}
+	
+	bool Locale::isTheLocale(std::string_view localeName) const {
+		return myName == localeName;
+	}
+	
+	std::string_view Locale::getName() const {
+		return myName;
+	}
+	
+	std::span<const char* const> Locale::getCasesList() const {
+		return casesList;
+	}
+	
+	std::span<const char* const> Locale::getGendersList() const {
+		return gendersList;
+	}
+	
+	std::span<const char* const> Locale::getPluralsList() const {
+		if( pluralFunction != nullptr ) {
+			return functionPlurals;
+		}
+		return pluralRules.getCategories();
+	}
+	
+	const NumberFormat * Locale::getNumberFormat(std::string_view name) const {
+		//locales have a few formats
+		for(auto& format : numFormats) {
+			if( format.name == name ) {
+				return &format.format;
+			}
+		}
+		return nullptr;
+	}
+	
+	const NumberFormat * Locale::getNumberFormat(NumberFormatID id) const {
+		if( id < INDEXED_FORMATS_COUNT ) {
+			return formatsByID[id];
+		}
+		if( id == NO_NUMBER_FORMAT ) {
+			return nullptr;
+		}
+		return getNumberFormat( numberFormatName(id) );
+	}
+	
+	std::span<const NamedNumberFormat> Locale::getNumberFormats() const {
+		return numFormats;
+	}
+	
+	const PluralRules* Locale::getPluralRules() const {
+		return pluralFunction == nullptr ? &pluralRules : nullptr;
+	}
+	
+	std::size_t Locale::getPluralIndex(long number) const {
+		//`-number` overflows for the smallest `long`, its unsigned negation doesn't
+		unsigned long magnitude = number < 0 ? 0ul - static_cast<unsigned long>(number) : static_cast<unsigned long>(number);
+		#ifdef MULANSTR_PLURAL_TABLE
+		if( magnitude < SMALL_NUMBERS_COUNT ) {
+			return smallNumbersPlurals[magnitude];
+		}
+		#endif
+		return pluralFunction != nullptr ? pluralFunction(magnitude) : pluralRules.select(magnitude);
+	}
+	
+	std::size_t Locale::getPluralIndex(const PluralOperands& number) const {
+		if( number.v == 0u ) {
+			//an integer, maybe written from a real number
+			#ifdef MULANSTR_PLURAL_TABLE
+			if( number.i < SMALL_NUMBERS_COUNT ) {
+				return smallNumbersPlurals[number.i];
+			}
+			#endif
+		}
+		if( pluralFunction != nullptr ) {
+			//old rules know only integers
+			return pluralFunction(number.i);
+		}
+		return pluralRules.select(number);
+	}
+	
+	std::string Locale::getPluralID(long number) const {
+		return getPluralsList()[ getPluralIndex(number) ];
+	}
+	
+	std::string_view NumberFormat::getGroupingChar() const {
+		return integerGroupingChar;
+	}
+	
+	std::string_view NumberFormat::getFractionSeparator() const {
+		return fractionSeparator;
+	}
+	
+	std::span<const unsigned char> NumberFormat::getGroupingSchema() const {
+		return std::span<const unsigned char>(groupingSchema, groupsCount);
+	}
+	
+	std::string NumberFormat::formatInteger(long integer) const {
+		std::string result;
+		formatInteger(integer, result);
+		return result;
+	}
+	
+	std::size_t NumberFormat::groupSize(std::size_t groupNo) const {
+		if( groupsCount == 0u ) {
+			return 0u;
+		}
+		//the last group size repeats
+		return groupNo < groupsCount ? groupingSchema[groupNo] : groupingSchema[groupsCount - 1u];
+	}
+	
+	std::size_t NumberFormat::countSeparators(std::size_t digitsCount) const {
+		//groups are counted from the right, the first one is `groupingSchema[0]`; a size of 0 ends grouping
+		std::size_t separators = 0u;
+		for(std::size_t left = digitsCount, groupNo = 0u; ; ++groupNo) {
+			std::size_t group = groupSize(groupNo);
+			if( group == 0u || left <= group ) {
+				return separators;
+			}
+			left -= group;
+			++separators;
+		}
+	}
+	
+	char* NumberFormat::writeGrouped(char* outEnd, const char* digits, std::size_t digitsCount) const {
+		const char* digit = digits + digitsCount;
+		for(std::size_t groupNo = 0u, separators = countSeparators(digitsCount); separators > 0u; ++groupNo, --separators) {
+			std::size_t group = groupSize(groupNo);
+			outEnd -= group;
+			digit -= group;
+			std::memcpy(outEnd, digit, group);
+			outEnd -= integerGroupingChar.size();
+			std::memcpy(outEnd, integerGroupingChar.data(), integerGroupingChar.size());
+		}
+		outEnd -= digit - digits;
+		std::memcpy(outEnd, digits, static_cast<std::size_t>(digit - digits));
+		return outEnd;
+	}
+	
+	void NumberFormat::formatInteger(long integer, std::string& output) const {
+		char digits[24];
+		bool negative = integer < 0;
+		//`-integer` overflows for the smallest `long`, its unsigned negation doesn't
+		unsigned long magnitude = negative ? 0ul - static_cast<unsigned long>(integer) : static_cast<unsigned long>(integer);
+		auto[digitsEnd, err] = std::to_chars(&digits[0], &digits[0] + sizeof(digits), magnitude);
+		const std::size_t digitsCount = static_cast<std::size_t>(digitsEnd - &digits[0]);
+		
+		//the result is written backwards, straight into the output
+		const std::size_t start = output.size();
+		output.resize(start + (negative ? 1u : 0u) + digitsCount + countSeparators(digitsCount) * integerGroupingChar.size());
+		char* out = writeGrouped(output.data() + output.size(), &digits[0], digitsCount);
+		if( negative ) {
+			*--out = '-';
+		}
+	}
+	
+	std::string NumberFormat::formatReal(double real, short precision) const {
+		std::string result;
+		formatReal(real, result, precision);
+		return result;
+	}
+	
+	///`double` has no non-zero fractional digits past the 1074th
+	constexpr short MAX_FRACTION_DIGITS = 1074;
+	
+	void NumberFormat::formatReal(double real, std::string& output, short precision) const {
+		//the sign, 309 integer digits, the dot and the fraction
+		char text[1 + 309 + 1 + MAX_FRACTION_DIGITS];
+		char* const textBegin = &text[0];
+		char* textEnd;
+		if( precision < 0 ) {
+			//the shortest text which reads back as the same number
+			textEnd = std::to_chars(textBegin, textBegin + sizeof(text), real, std::chars_format::fixed).ptr;
+		} else {
+			textEnd = std::to_chars(textBegin, textBegin + sizeof(text), real, std::chars_format::fixed, std::min(precision, MAX_FRACTION_DIGITS)).ptr;
+		}
+		
+		if( !std::isfinite(real) ) {
+			output.append(textBegin, textEnd);
+			return;
+		}
+		
+		const bool negative = *textBegin == '-';
+		const char* digits = textBegin + (negative ? 1 : 0);
+		const char* dot = std::find(digits, static_cast<const char*>(textEnd), '.');
+		//trailing zeros of the fraction are not written
+		if( dot != textEnd ) {
+			while( textEnd[-1] == '0' ) {
+				--textEnd;
+			}
+			if( textEnd - 1 == dot ) {
+				--textEnd;
+			}
+		}
+		const std::size_t integerDigits = static_cast<std::size_t>(dot - digits);
+		const std::size_t fractionDigits = dot < textEnd ? static_cast<std::size_t>(textEnd - dot - 1) : 0u;
+		//a number rounded to zero has no sign
+		const bool writeSign = negative && !(integerDigits == 1u && *digits == '0' && fractionDigits == 0u);
+		
+		//the fraction is copied after its separator, then the integer part is written backwards
+		const std::size_t start = output.size();
+		output.resize(
+			start + (writeSign ? 1u : 0u)
+			+ integerDigits + countSeparators(integerDigits) * integerGroupingChar.size()
+			+ (fractionDigits > 0u ? fractionSeparator.size() + fractionDigits : 0u)
+		);
+		char* out = output.data() + output.size();
+		if( fractionDigits > 0u ) {
+			out -= fractionDigits;
+			std::memcpy(out, dot + 1, fractionDigits);
+			out -= fractionSeparator.size();
+			std::memcpy(out, fractionSeparator.data(), fractionSeparator.size());
+		}
+		out = writeGrouped(out, digits, integerDigits);
+		if( writeSign ) {
+			*--out = '-';
+		}
+	}
+	
+	std::size_t NumberFormat::maxLength(std::size_t integerDigits, std::size_t fractionDigits) const {
+		//the sign and the digits
+		std::size_t result = 1u + integerDigits;
+		if( groupsCount > 0u && integerDigits > 1u ) {
+			//the smallest group gives the most separators
+			unsigned char smallestGroup = 0xFF;
+			for(unsigned char group : getGroupingSchema()) {
+				if( group > 0u && group < smallestGroup ) {
+					smallestGroup = group;
+				}
+			}
+			result += ((integerDigits - 1u) / smallestGroup) * integerGroupingChar.size();
+		}
+		if( fractionDigits > 0u ) {
+			result += fractionSeparator.size() + fractionDigits;
+		}
+		return result;
+	}
+	
+	/*
+	
+	===================== Plurals ======================
+	based on: https://developer.mozilla.org/en-US/docs/Mozilla/Localization/Localization_and_Plurals
+	
+	*/
+	
+	// cSpell: disable
+	
+	//Families: Asian (Chinese, Japanese, Korean), Persian, Turkic/Altaic (Turkish), Thai, Lao
+	//Forms: other
+	std::size_t PluralRule0(unsigned long /*number*/) {
+		return 0u;
+	}
+	
+	//Families: Germanic, Finno-Ugric, Language isolate, Latin/Greek, Semitic, Romanic, Vietnamese
+	//Forms: one, other
+	std::size_t PluralRule1(unsigned long number) {
+		if( number == 1u ) return 0u;
+		return 1u;
+	}
+	
+	//Families: Romanic (French, Brazilian Portuguese), Lingala
+	//Forms: zero_one, other
+	std::size_t PluralRule2(unsigned long number) {
+		if( number == 1u || number == 0u ) return 0u;
+		return 1u;
+	}
+	
+	//Families: Baltic (Latvian, Latgalian)
+	//Forms: zero, one, other
+	std::size_t PluralRule3(unsigned long number) {
+		if( number % 10u == 0u ) return 0u;
+		if( number % 10u == 1u && number % 100u != 11u ) return 1u;
+		return 2u;
+	}
+	
+	//Families: Celtic (Scottish Gaelic)
+	//Forms: one, two, three, other
+	std::size_t PluralRule4(unsigned long number) {
+		if( number == 1u || number == 11u ) return 0u;
+		if( number == 2u || number == 12u ) return 1u;
+		if( 
+			(number >= 3u && number <= 10u)
+			||
+			(number >= 13u && number <= 19u)
+			) return 2u;
+		return 3u;
+	}
+	
+	//Families: Romanic (Romanian)
+	//Forms: one, few, other
+	std::size_t PluralRule5(unsigned long number) {
+		if( number == 1u ) return 0u;
+		unsigned long ending = number % 100u;
+		if( number == 0u || (ending >= 1u && ending <= 19u) ) return 1u;
+		return 2u;
+	}
+	
+	//Families: Baltic (Lithuanian)
+	//Forms: one, few, other
+	std::size_t PluralRule6(unsigned long number) {
+		if( number != 11u && number % 10u == 1u ) return 0u;
+		unsigned long ending = number % 100u;
+		if( number % 10u == 0u ||
+			(ending >= 11u && ending <= 19u)
+		) return 1u;
+		return 2u;
+	}
+	
+	//Families: Belarusian, Russian, Ukrainian
+	//Forms: one, few, other
+	std::size_t PluralRule7(unsigned long number) {
+		if( number % 10u == 1u && number != 11u ) return 0u;
+		unsigned long twoDigits = number % 100u;
+		unsigned long lastDigit = number % 10u;
+		if(
+			!( twoDigits >= 12u && twoDigits <= 14u )
+			&&
+			( lastDigit >= 2u && lastDigit <= 4u )
+		) return 1u;
+		return 2u;
+	}
+	
+	//Families: Slavic (Slovak, Czech)
+	//Forms: one, few, other
+	std::size_t PluralRule8(unsigned long number) {
+		if( number == 1u ) return 0u;
+		if( number >= 2u && number <= 4u ) return 1u;
+		return 2u;
+	}
+	
+	//Families: Slavic (Polish)
+	//Forms: one, few, other
+	std::size_t PluralRule9(unsigned long number) {
+		if( number == 1u ) return 0u;
+		unsigned long twoDigits = number % 100u;
+		unsigned long lastDigit = number % 10u;
+		if(
+			!( twoDigits >= 12u && twoDigits <= 14u )
+			&&
+			( lastDigit >= 2u && lastDigit <= 4u )
+		) return 1u;
+		return 2u;
+	}
+	
+	/*
+	
+	=========================== Supported locales =====================
+	
+	*/
+	
+	// cSpell: disable
+	namespace {
+		
+		constexpr NamedNumberFormat ENGLISH_FORMATS[] = {
+			{"general", {",", ".", {}}},
+			{"grouped", {",", ".", {3}}}
+		};
+		
+		constexpr std::string_view BRITISH_ALIASES[] = {"en-GB", "English_United Kingdom"};
+		constexpr std::string_view AMERICAN_ALIASES[] = {"en-US", "English_United States"};
+		
+		/*
+		(nom)inative = mianownik(kto? co?)
+		(gen)etive = dopełniacz(kogo? czego?)
+		(dat)ive = celownik (komu? czemu?)
+		(acc)usative = biernik (kogo? co?)
+		(ins)trumental = narzędnik (z kim? z czym?)
+		(loc)ative = miejscownik (o kim? o czym?)
+		(voc)ative = wołacz (O!)
+		*/
+		constexpr const char* POLISH_CASES[] = {"nom","gen","dat","acc","ins","loc","voc"};
+		constexpr const char* POLISH_GENDERS[] = {"m","f","n"};
+		constexpr NamedNumberFormat POLISH_FORMATS[] = {
+			{"general", {" ", ",", {}}},
+			{"grouped", {" ", ",", {3}}}
+		};
+		constexpr std::string_view POLISH_ALIASES[] = {"pl-PL", "Polish_Poland"};
+		
+		constexpr LocaleDefinition BUILT_IN_LOCALES[] = {
+			//British English, with the CLDR rules of English
+			{"en_GB", BRITISH_ALIASES, "one: i = 1 and v = 0", {}, {}, ENGLISH_FORMATS},
+			//American English
+			{"en_US", AMERICAN_ALIASES, "one: i = 1 and v = 0", {}, {}, ENGLISH_FORMATS},
+			//Polish
+			//the CLDR "many" form is "other" here, so fractions use it too
+			{"pl_PL", POLISH_ALIASES, "one: i = 1 and v = 0; few: v = 0 and i % 10 = 2..4 and i % 100 != 12..14", 
+				POLISH_CASES, POLISH_GENDERS, POLISH_FORMATS}
+		};
+	
+	};
+	// cSpell: enable
+	
+	std::span<const LocaleDefinition> builtInLocales() {
+		return BUILT_IN_LOCALES;
+	}
+	
+	std::vector<Locale> localesList;
+	std::vector<LocaleAlias> localeAliases;
+	std::vector<std::unique_ptr<Locale>> loadedLocales;
+	
+	namespace {
+		
+		///FNV-1a mixed with a seed
+		std::uint32_t hashLocaleName(std::string_view name, std::uint32_t seed) {
+			std::uint32_t hash = 2166136261u ^ seed;
+			for(char c : name) {
+				hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+			}
+			return hash ^ (hash >> 15);
+		}
+		
+		/**
+		 * @brief A perfect hash table of locale names and aliases
+		 * 
+		 * The seed is chosen so every name has its own slot, so a lookup hashes the name and compares it once.
+		 * Built-in locales are made from their definitions with the registry.
+		 * Lookups only read the table; `rebuild()` replaces it, so it must not run while other threads look locales up.
+		 */
+		class LocaleRegistry {
+				struct Slot {
+					std::string_view name;
+					Locale* locale = nullptr;
+				};
+				struct Table {
+					std::vector<Slot> slots;
+					std::uint32_t seed = 0u;
+					
+					///`false` if two names of different locales get the same slot
+					bool tryToFill(const std::vector<Slot>& entries) {
+						const std::size_t mask = slots.size() - 1u;
+						for(auto& slot : slots) {
+							slot = Slot{};
+						}
+						for(auto& entry : entries) {
+							Slot& slot = slots[ hashLocaleName(entry.name, seed) & mask ];
+							if( slot.locale != nullptr ) {
+								if( slot.name == entry.name ) {
+									//a repeated name, the first one stays
+									continue;
+								}
+								return false;
+							}
+							slot = entry;
+						}
+						return true;
+					}
+				};
+				///never resized, so pointers to its locales stay valid
+				std::vector<Locale> builtIn;
+				Table table;
+				
+				Table build() {
+					//loaded locales come first, so they hide other ones of the same name
+					std::vector<Slot> entries;
+					for(auto& locale : loadedLocales) {
+						entries.push_back( Slot{locale->getName(), locale.get()} );
+					}
+					for(auto& locale : localesList) {
+						entries.push_back( Slot{locale.getName(), &locale} );
+					}
+					for(auto& locale : builtIn) {
+						entries.push_back( Slot{locale.getName(), &locale} );
+					}
+					const std::size_t localeEntries = entries.size();
+					auto addAlias = [&entries, localeEntries](std::string_view alias, std::string_view localeName) {
+						for(std::size_t entry=0u; entry<localeEntries; ++entry) {
+							if( entries[entry].name == localeName ) {
+								entries.push_back( Slot{alias, entries[entry].locale} );
+								return;
+							}
+						}
+					};
+					for(auto& alias : localeAliases) {
+						addAlias(alias.alias, alias.localeName);
+					}
+					for(auto& definition : builtInLocales()) {
+						for(auto alias : definition.aliases) {
+							addAlias(alias, definition.name);
+						}
+					}
+					
+					//with 4 slots per name a few seeds are enough
+					Table result;
+					std::size_t size = 4u;
+					while( size < 4u * entries.size() ) {
+						size *= 2u;
+					}
+					result.slots.resize(size);
+					while( !result.tryToFill(entries) ) {
+						if( ++result.seed % 64u == 0u ) {
+							result.slots.resize(result.slots.size() * 2u);
+						}
+					}
+					return result;
+				}
+			public:
+				///built while the function's static is made, so the first lookups are safe from many threads
+				LocaleRegistry() {
+					builtIn.reserve(builtInLocales().size());
+					for(auto& definition : builtInLocales()) {
+						builtIn.emplace_back(definition);
+					}
+					rebuild();
+				}
+				
+				void rebuild() {
+					table = build();
+				}
+				
+				Locale* find(std::string_view name) const {
+					const Slot& slot = table.slots[ hashLocaleName(name, table.seed) & (table.slots.size() - 1u) ];
+					return slot.name == name ? slot.locale : nullptr;
+				}
+		};
+		
+		LocaleRegistry& registry() {
+			static LocaleRegistry theRegistry;
+			return theRegistry;
+		}
+	
+	};
+	
+	void registerLocales() {
+		registry().rebuild();
+	}
+	
+	Locale* findLocale(std::string_view nameOrAlias) {
+		return registry().find(nameOrAlias);
+	}
+	
+	Locale& getLocale(std::string_view localeName) {
+		if( Locale* found = findLocale(localeName) ) {
+			return *found;
+		}
+		return *findLocale("en_US");
+	}
+
+};
+
+
+
+namespace mls::locale {
+	
+	//------------- The layout
+	// A file starts with its header, then come tables of locales, aliases, number formats and names
+	// (offsets of strings), then plural rules of each locale aligned to 8 bytes and at the end a pool
+	// of NUL-terminated strings. Strings are given by offsets in the pool, all other offsets are from
+	// the start of the file. Numbers are written in the byte order of the machine which made the file.
+	
+	namespace {
+		
+		constexpr char LOCALE_DATA_MAGIC[4] = {'M', 'L', 'S', 'L'};
+		///a file of the other byte order reads it as `0x0201`
+		constexpr std::uint16_t BYTE_ORDER_MARK = 0x0102u;
+		
+		struct FileHeader {
+			char magic[4];
+			std::uint16_t version;
+			std::uint16_t byteOrder;
+			std::uint32_t fileSize;
+			std::uint32_t localesCount;
+			std::uint32_t localesOffset;
+			std::uint32_t aliasesCount;
+			std::uint32_t aliasesOffset;
+			std::uint32_t formatsCount;
+			std::uint32_t formatsOffset;
+			std::uint32_t namesCount;
+			std::uint32_t namesOffset;
+			std::uint32_t stringsSize;
+			std::uint32_t stringsOffset;
+			std::uint32_t reserved[3];
+		};
+		
+		struct LocaleRecord {
+			std::uint32_t name;
+			///cases and genders are ranges of the names table
+			std::uint32_t firstCase;
+			std::uint32_t casesCount;
+			std::uint32_t firstGender;
+			std::uint32_t gendersCount;
+			///a range of the formats table
+			std::uint32_t firstFormat;
+			std::uint32_t formatsCount;
+			///the output of `PluralRules::program()`
+			std::uint32_t pluralRulesOffset;
+			std::uint32_t pluralRulesSize;
+			std::uint32_t reserved;
+		};
+		
+		struct AliasRecord {
+			std::uint32_t alias;
+			///an index in the locales table
+			std::uint32_t locale;
+		};
+		
+		struct FormatRecord {
+			std::uint32_t name;
+			std::uint32_t groupingChar;
+			std::uint32_t fractionSeparator;
+			///sizes of digit groups, as bytes of the strings pool
+			std::uint32_t groupingSchema;
+			std::uint32_t groupingSchemaSize;
+		};
+		
+		static_assert(sizeof(FileHeader) == 64u && sizeof(LocaleRecord) == 40u, "Locale data files have a fixed layout");
+		
+		constexpr std::size_t PROGRAM_ALIGNMENT = 8u;
+		
+		[[noreturn]] void failData(const std::string& path, const std::string& reason) {
+			throw InvalidLocaleData("Invalid locale data file \"" + path + "\": " + reason);
+		}
+	
+	};
+	
+	//------------- Reading
+	
+	namespace {
+		
+		///checks the parts of a mapped file and reads them in place
+		class LocaleDataReader {
+				const std::string& path;
+				std::span<const std::byte> bytes;
+				FileHeader header;
+			public:
+				LocaleDataReader(const std::string& filePath, std::span<const std::byte> fileBytes): path{filePath}, bytes{fileBytes} {
+					if( bytes.size() < sizeof(FileHeader) ) {
+						failData(path, "too short");
+					}
+					std::memcpy(&header, bytes.data(), sizeof(header));
+					if( std::memcmp(header.magic, LOCALE_DATA_MAGIC, sizeof(LOCALE_DATA_MAGIC)) != 0 ) {
+						failData(path, "not a locale data file");
+					}
+					if( header.byteOrder != BYTE_ORDER_MARK ) {
+						failData(path, "written on a machine with another byte order");
+					}
+					if( header.version != LOCALE_DATA_VERSION ) {
+						failData(path, "version " + std::to_string(header.version) + " instead of " + std::to_string(LOCALE_DATA_VERSION));
+					}
+					if( header.fileSize != bytes.size() ) {
+						failData(path, "the file's size doesn't match its header");
+					}
+					checkTable(header.localesOffset, header.localesCount, sizeof(LocaleRecord));
+					checkTable(header.aliasesOffset, header.aliasesCount, sizeof(AliasRecord));
+					checkTable(header.formatsOffset, header.formatsCount, sizeof(FormatRecord));
+					checkTable(header.namesOffset, header.namesCount, sizeof(std::uint32_t));
+					checkTable(header.stringsOffset, header.stringsSize, 1u);
+					//so every string of the pool ends in it
+					if( header.stringsSize == 0u || bytes[header.stringsOffset + header.stringsSize - 1u] != std::byte{0} ) {
+						failData(path, "the strings pool doesn't end with NUL");
+					}
+				}
+				
+				const FileHeader& getHeader() const {
+					return header;
+				}
+				
+				void checkTable(std::uint32_t offset, std::uint32_t count, std::size_t recordSize) const {
+					if( std::uint64_t{offset} + std::uint64_t{count} * recordSize > bytes.size() ) {
+						failData(path, "a table past the end of the file");
+					}
+				}
+				
+				template<typename Record>
+				Record record(std::uint32_t tableOffset, std::uint32_t index) const {
+					Record result;
+					std::memcpy(&result, bytes.data() + tableOffset + std::size_t{index} * sizeof(Record), sizeof(Record));
+					return result;
+				}
+				
+				///a string of the pool, read in place
+				const char* string(std::uint32_t offset) const {
+					if( offset >= header.stringsSize ) {
+						failData(path, "a string past the strings pool");
+					}
+					return reinterpret_cast<const char*>(bytes.data() + header.stringsOffset + offset);
+				}
+				
+				///strings given by a range of the names table
+				std::vector<const char*> names(std::uint32_t first, std::uint32_t count) const {
+					if( std::uint64_t{first} + count > header.namesCount ) {
+						failData(path, "a list past the names table");
+					}
+					std::vector<const char*> result;
+					result.reserve(count);
+					for(std::uint32_t name=first; name<first + count; ++name) {
+						result.push_back( string(record<std::uint32_t>(header.namesOffset, name)) );
+					}
+					return result;
+				}
+				
+				std::span<const std::byte> part(std::uint32_t offset, std::uint32_t size) const {
+					if( std::uint64_t{offset} + size > bytes.size() ) {
+						failData(path, "a part past the end of the file");
+					}
+					return bytes.subspan(offset, size);
+				}
+		};
+	
+	};
+	
+	std::size_t loadLocaleData(const std::string& path) {
+		auto file = MappedFile::open(path);
+		if( file == nullptr ) {
+			failData(path, "can't open and map the file");
+		}
+		LocaleDataReader reader{path, file->bytes()};
+		const FileHeader& header = reader.getHeader();
+		
+		//everything is read and checked before anything is added
+		std::vector<Locale> locales;
+		locales.reserve(header.localesCount);
+		for(std::uint32_t index=0u; index<header.localesCount; ++index) {
+			auto localeRecord = reader.record<LocaleRecord>(header.localesOffset, index);
+			
+			if( std::uint64_t{localeRecord.firstFormat} + localeRecord.formatsCount > header.formatsCount ) {
+				failData(path, "a list past the formats table");
+			}
+			std::vector<NamedNumberFormat> formats;
+			for(std::uint32_t format=localeRecord.firstFormat; format<localeRecord.firstFormat + localeRecord.formatsCount; ++format) {
+				auto formatRecord = reader.record<FormatRecord>(header.formatsOffset, format);
+				if( std::uint64_t{formatRecord.groupingSchema} + formatRecord.groupingSchemaSize > header.stringsSize ) {
+					failData(path, "a grouping schema past the strings pool");
+				}
+				const char* schema = formatRecord.groupingSchemaSize == 0u ? nullptr : reader.string(formatRecord.groupingSchema);
+				formats.push_back( NamedNumberFormat{
+					reader.string(formatRecord.name),
+					NumberFormat{
+						reader.string(formatRecord.groupingChar),
+						reader.string(formatRecord.fractionSeparator),
+						std::span<const unsigned char>(reinterpret_cast<const unsigned char*>(schema), formatRecord.groupingSchemaSize)
+					}
+				} );
+			}
+			
+			std::shared_ptr<const void> owner = file;
+			PluralRules rules;
+			try {
+				rules = PluralRules(reader.part(localeRecord.pluralRulesOffset, localeRecord.pluralRulesSize), std::move(owner));
+			} catch(const InvalidPluralRules& error) {
+				failData(path, error.what());
+			}
+			locales.emplace_back(
+				reader.string(localeRecord.name),
+				std::move(rules),
+				reader.names(localeRecord.firstCase, localeRecord.casesCount),
+				reader.names(localeRecord.firstGender, localeRecord.gendersCount),
+				std::move(formats)
+			);
+		}
+		
+		std::vector<LocaleAlias> aliases;
+		for(std::uint32_t index=0u; index<header.aliasesCount; ++index) {
+			auto aliasRecord = reader.record<AliasRecord>(header.aliasesOffset, index);
+			if( aliasRecord.locale >= locales.size() ) {
+				failData(path, "an alias of a missing locale");
+			}
+			aliases.push_back( LocaleAlias{reader.string(aliasRecord.alias), locales[aliasRecord.locale].getName()} );
+		}
+		
+		for(auto& locale : locales) {
+			loadedLocales.push_back( std::make_unique<Locale>(std::move(locale)) );
+		}
+		localeAliases.insert(localeAliases.end(), aliases.begin(), aliases.end());
+		registerLocales();
+		return locales.size();
+	}
+	
+	//------------- Writing
+	
+	namespace {
+		
+		///NUL-terminated strings, each written once
+		class StringsPool {
+				std::string pool{'\0'};
+				std::map<std::string, std::uint32_t, std::less<>> offsets;
+			public:
+				std::uint32_t add(std::string_view text) {
+					if( text.empty() ) {
+						return 0u;
+					}
+					auto found = offsets.find(text);
+					if( found != offsets.end() ) {
+						return found->second;
+					}
+					auto offset = static_cast<std::uint32_t>(pool.size());
+					pool.append(text);
+					pool.push_back('\0');
+					offsets.emplace(std::string{text}, offset);
+					return offset;
+				}
+				
+				const std::string& getPool() const {
+					return pool;
+				}
+		};
+		
+		template<typename Record>
+		void appendRecords(std::vector<std::byte>& output, const std::vector<Record>& records) {
+			const std::size_t start = output.size();
+			output.resize(start + records.size() * sizeof(Record));
+			std::memcpy(output.data() + start, records.data(), records.size() * sizeof(Record));
+		}
+	
+	};
+	
+	void writeLocaleData(const std::string& path, const std::vector<const Locale*>& locales, const std::vector<LocaleAlias>& aliases) {
+		StringsPool strings;
+		std::vector<LocaleRecord> localeRecords;
+		std::vector<AliasRecord> aliasRecords;
+		std::vector<FormatRecord> formatRecords;
+		std::vector<std::uint32_t> names;
+		std::vector<std::span<const std::byte>> programs;
+		
+		for(const Locale* locale : locales) {
+			const PluralRules* rules = locale->getPluralRules();
+			if( rules == nullptr ) {
+				throw InvalidLocaleData("The locale \"" + std::string{locale->getName()} + "\" has no CLDR plural rules to write");
+			}
+			programs.push_back( rules->program() );
+			
+			LocaleRecord localeRecord{};
+			localeRecord.name = strings.add(locale->getName());
+			localeRecord.firstCase = static_cast<std::uint32_t>(names.size());
+			localeRecord.casesCount = static_cast<std::uint32_t>(locale->getCasesList().size());
+			for(const char* caseName : locale->getCasesList()) {
+				names.push_back( strings.add(caseName) );
+			}
+			localeRecord.firstGender = static_cast<std::uint32_t>(names.size());
+			localeRecord.gendersCount = static_cast<std::uint32_t>(locale->getGendersList().size());
+			for(const char* gender : locale->getGendersList()) {
+				names.push_back( strings.add(gender) );
+			}
+			
+			localeRecord.firstFormat = static_cast<std::uint32_t>(formatRecords.size());
+			for(auto& format : locale->getNumberFormats()) {
+				auto schema = format.format.getGroupingSchema();
+				formatRecords.push_back( FormatRecord{
+					strings.add(format.name),
+					strings.add(format.format.getGroupingChar()),
+					strings.add(format.format.getFractionSeparator()),
+					strings.add( std::string_view(reinterpret_cast<const char*>(schema.data()), schema.size()) ),
+					static_cast<std::uint32_t>(schema.size())
+				} );
+			}
+			localeRecord.formatsCount = static_cast<std::uint32_t>(formatRecords.size()) - localeRecord.firstFormat;
+			localeRecords.push_back(localeRecord);
+		}
+		
+		for(auto& alias : aliases) {
+			std::size_t index = 0u;
+			while( index < locales.size() && locales[index]->getName() != alias.localeName ) {
+				++index;
+			}
+			if( index == locales.size() ) {
+				throw InvalidLocaleData("The alias \"" + std::string{alias.alias} + "\" names a locale which isn't written");
+			}
+			aliasRecords.push_back( AliasRecord{strings.add(alias.alias), static_cast<std::uint32_t>(index)} );
+		}
+		
+		FileHeader header{};
+		std::memcpy(header.magic, LOCALE_DATA_MAGIC, sizeof(LOCALE_DATA_MAGIC));
+		header.version = LOCALE_DATA_VERSION;
+		header.byteOrder = BYTE_ORDER_MARK;
+		std::vector<std::byte> output(sizeof(FileHeader));
+		header.localesCount = static_cast<std::uint32_t>(localeRecords.size());
+		header.localesOffset = static_cast<std::uint32_t>(output.size());
+		output.resize(output.size() + localeRecords.size() * sizeof(LocaleRecord));
+		header.aliasesCount = static_cast<std::uint32_t>(aliasRecords.size());
+		header.aliasesOffset = static_cast<std::uint32_t>(output.size());
+		appendRecords(output, aliasRecords);
+		header.formatsCount = static_cast<std::uint32_t>(formatRecords.size());
+		header.formatsOffset = static_cast<std::uint32_t>(output.size());
+		appendRecords(output, formatRecords);
+		header.namesCount = static_cast<std::uint32_t>(names.size());
+		header.namesOffset = static_cast<std::uint32_t>(output.size());
+		appendRecords(output, names);
+		
+		//plural rules are read in place, so they keep their alignment
+		for(std::size_t locale=0u; locale<programs.size(); ++locale) {
+			output.resize( (output.size() + PROGRAM_ALIGNMENT - 1u) / PROGRAM_ALIGNMENT * PROGRAM_ALIGNMENT );
+			localeRecords[locale].pluralRulesOffset = static_cast<std::uint32_t>(output.size());
+			localeRecords[locale].pluralRulesSize = static_cast<std::uint32_t>(programs[locale].size());
+			output.insert(output.end(), programs[locale].begin(), programs[locale].end());
+		}
+		std::memcpy(output.data() + header.localesOffset, localeRecords.data(), localeRecords.size() * sizeof(LocaleRecord));
+		
+		auto& pool = strings.getPool();
+		header.stringsSize = static_cast<std::uint32_t>(pool.size());
+		header.stringsOffset = static_cast<std::uint32_t>(output.size());
+		output.resize(output.size() + pool.size());
+		std::memcpy(output.data() + header.stringsOffset, pool.data(), pool.size());
+		header.fileSize = static_cast<std::uint32_t>(output.size());
+		std::memcpy(output.data(), &header, sizeof(header));
+		
+		std::FILE* file = std::fopen(path.c_str(), "wb");
+		if( file == nullptr ) {
+			throw InvalidLocaleData("Can't write the locale data file \"" + path + "\"");
+		}
+		const bool written = std::fwrite(output.data(), 1u, output.size(), file) == output.size();
+		if( std::fclose(file) != 0 || !written ) {
+			throw InvalidLocaleData("Can't write the locale data file \"" + path + "\"");
+		}
+	}
+
+};
+
+
+
+#if !defined(MULANSTR_NO_SIMD) && (defined(__x86_64__) || defined(_M_X64))
+#	define MULANSTR_SIMD_X86
+#	include <immintrin.h>
+#	ifdef _MSC_VER
+#		include <intrin.h>
+#	endif
+#endif
+
+namespace mls::preparse {
+	
+	//-------------- Searching with vector instructions
+	// Blocks of text are compared with the first and the last character of the searched text at once, 
+	// only positions matching both are compared in full. Text without the first character is skipped 
+	// at the speed of reading memory.
+	
+	std::size_t findTextScalar(std::string_view source, std::string_view searched) {
+		return source.find(searched);
+	}
+	
+	#ifdef MULANSTR_SIMD_X86
+	
+	///checks positions `offset + n` for every bit `n` set in the `mask`
+	inline std::size_t checkCandidates(
+		std::string_view source, 
+		std::string_view searched, 
+		std::size_t offset, 
+		std::uint32_t mask
+	) {
+		while( mask != 0u ) {
+			std::size_t pos = offset + static_cast<std::size_t>( std::countr_zero(mask) );
+			if( std::memcmp(source.data() + pos + 1, searched.data() + 1, searched.size() - 1u) == 0 ) {
+				return pos;
+			}
+			mask &= mask - 1u;
+		}
+		return std::string_view::npos;
+	}
+	
+	///the rest of the text, too short for a block
+	inline std::size_t findInTail(std::string_view source, std::string_view searched, std::size_t offset) {
+		auto found = source.substr(offset).find(searched);
+		return found == std::string_view::npos ? found : offset + found;
+	}
+	
+	std::size_t findTextSSE2(std::string_view source, std::string_view searched) {
+		constexpr std::size_t BLOCK = 16u;
+		if( searched.empty() || source.size() < searched.size() + BLOCK ) {
+			return findTextScalar(source, searched);
+		}
+		const std::size_t lastOffset = searched.size() - 1u;
+		const __m128i first = _mm_set1_epi8(searched.front());
+		const __m128i last = _mm_set1_epi8(searched.back());
+		
+		std::size_t i = 0u;
+		for(; i + lastOffset + BLOCK <= source.size(); i += BLOCK) {
+			const __m128i blockFirst = _mm_loadu_si128( reinterpret_cast<const __m128i*>(source.data() + i) );
+			const __m128i blockLast = _mm_loadu_si128( reinterpret_cast<const __m128i*>(source.data() + i + lastOffset) );
+			const __m128i matches = _mm_and_si128( _mm_cmpeq_epi8(first, blockFirst), _mm_cmpeq_epi8(last, blockLast) );
+			auto found = checkCandidates(source, searched, i, static_cast<std::uint32_t>( _mm_movemask_epi8(matches) ));
+			if( found != std::string_view::npos ) {
+				return found;
+			}
+		}
+		return findInTail(source, searched, i);
+	}
+	
+	#if defined(__GNUC__) || defined(__clang__)
+	#	define MULANSTR_TARGET_AVX2 __attribute__((target("avx2")))
+	#else
+	#	define MULANSTR_TARGET_AVX2
+	#endif
+	
+	///bytes of a 32 bytes block which match the first and the last character of the searched text
+	MULANSTR_TARGET_AVX2
+	inline std::uint32_t matchesAVX2(const char* block, std::size_t lastOffset, __m256i first, __m256i last) {
+		const __m256i blockFirst = _mm256_loadu_si256( reinterpret_cast<const __m256i*>(block) );
+		const __m256i blockLast = _mm256_loadu_si256( reinterpret_cast<const __m256i*>(block + lastOffset) );
+		const __m256i matches = _mm256_and_si256( _mm256_cmpeq_epi8(first, blockFirst), _mm256_cmpeq_epi8(last, blockLast) );
+		return static_cast<std::uint32_t>( _mm256_movemask_epi8(matches) );
+	}
+	
+	///whether any byte of a 128 bytes chunk, aligned to 32 bytes, is the first character of the searched text
+	MULANSTR_TARGET_AVX2
+	inline bool anyFirstAVX2(const char* chunk, __m256i first) {
+		const __m256i* blocks = reinterpret_cast<const __m256i*>(chunk);
+		const __m256i any = _mm256_or_si256(
+			_mm256_or_si256( 
+				_mm256_cmpeq_epi8(first, _mm256_load_si256(blocks)), 
+				_mm256_cmpeq_epi8(first, _mm256_load_si256(blocks + 1)) 
+			),
+			_mm256_or_si256( 
+				_mm256_cmpeq_epi8(first, _mm256_load_si256(blocks + 2)), 
+				_mm256_cmpeq_epi8(first, _mm256_load_si256(blocks + 3)) 
+			)
+		);
+		return !_mm256_testz_si256(any, any);
+	}
+	
+	MULANSTR_TARGET_AVX2
+	std::size_t findTextAVX2(std::string_view source, std::string_view searched) {
+		constexpr std::size_t BLOCK = 32u;
+		constexpr std::size_t CHUNK = 4u * BLOCK;
+		if( searched.empty() || source.size() < searched.size() + CHUNK ) {
+			return findTextSSE2(source, searched);
+		}
+		const std::size_t lastOffset = searched.size() - 1u;
+		const __m256i first = _mm256_set1_epi8(searched.front());
+		const __m256i last = _mm256_set1_epi8(searched.back());
+		
+		//the text up to the first aligned chunk
+		std::size_t i = (BLOCK - reinterpret_cast<std::uintptr_t>(source.data()) % BLOCK) % BLOCK;
+		auto found = findTextSSE2(source.substr(0u, i + lastOffset), searched);
+		if( found != std::string_view::npos ) {
+			return found;
+		}
+		for(; i + lastOffset + CHUNK <= source.size(); i += CHUNK) {
+			//text without the first character is skipped with one branch per chunk
+			if( !anyFirstAVX2(source.data() + i, first) ) {
+				continue;
+			}
+			for(std::size_t block = i; block < i + CHUNK; block += BLOCK) {
+				found = checkCandidates(source, searched, block, matchesAVX2(source.data() + block, lastOffset, first, last));
+				if( found != std::string_view::npos ) {
+					return found;
+				}
+			}
+		}
+		return findInTail(source, searched, i);
+	}
+	
+	bool hasAVX2() {
+		#if defined(__GNUC__) || defined(__clang__)
+		//templates may be parsed by constructors of global objects, before the CPU info is ready
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2");
+		#elif defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 1);
+		bool savesYmmRegisters = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6u) == 6u;
+		__cpuidex(info, 7, 0);
+		return savesYmmRegisters && (info[1] & (1 << 5)) != 0;
+		#else
+		return false;
+		#endif
+	}
+	
+	#endif //MULANSTR_SIMD_X86
+	
+	std::size_t find_text(std::string_view source, std::string_view searched) {
+		#ifdef MULANSTR_SIMD_X86
+		using FindFunction = std::size_t (*)(std::string_view, std::string_view);
+		static const FindFunction findBest = hasAVX2() ? findTextAVX2 : findTextSSE2;
+		return findBest(source, searched);
+		#else
+		return findTextScalar(source, searched);
+		#endif
+	}
+	
+	//-------------- The main functions
+	
+	///copies the template string into `source` and returns a view of the copy
+	std::string_view copySource(std::unique_ptr<char[]> &source, std::string_view templateString) {
+		source.reset( new char[templateString.size() + 1] );
+		templateString.copy( source.get(), templateString.size() );
+		source[templateString.size()] = '\0';
+		return std::string_view{ source.get(), templateString.size() };
+	}
+	
+	PreparsedSyntax preparse_syntax(std::string_view templateString) 
+	{
+		PreparsedSyntax result;
+		//the only copy of the template string, everything else is a view into it
+		templateString = copySource(result.source, templateString);
+		
+		const char* error = scan_template(templateString, 
+			[&result](std::string_view text) {
+				result.strings.push_back( text );
+			},
+			[&result](std::string_view templateContent) -> const char* {
+				TagSyntax tag;
+				auto firstArgument = result.arguments.size();
+				auto tagError = parse_tag(templateContent, tag, 
+					[&result](std::string_view key, std::string_view value) {
+						result.arguments.push_back( ArgumentSyntax{key, value} );
+					}
+				);
+				if( tagError != nullptr ) {
+					#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
+					return tagError;
+					#else
+					//an invalid tag is skipped like a comment
+					result.arguments.resize(firstArgument);
+					tag = TagSyntax{};
+					tag.isComment = true;
+					#endif
+				}
+				tag.firstArgument = static_cast<std::uint32_t>(firstArgument);
+				result.tags.push_back( tag );
+				return nullptr;
+			}
+		);
+		
+		if( error != nullptr ) {//Wrong template
+			#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
+			throw InvalidTemplateState{error};
+			#endif
+		}
+		
+		return result;
+	}
+	
+};
+
+
+
+namespace mls {
+	
+	//------------- Compiler helpers
+	
+	///makes an instruction with no choices, no argument and no number format
+	Instruction makeInstruction(Instruction::Code code, std::string_view text) {
+		return Instruction{code, -1, 0u, 0u, VariableSlot::NONE, text, std::string_view{}, nullptr, Instruction::NO_INDEX};
+	}
+	
+	///the index of the key in the list, `Instruction::NO_INDEX` if it isn't there
+	std::uint32_t indexOf(std::span<const char* const> keys, std::string_view key) {
+		for(std::size_t i=0u; i<keys.size(); ++i) {
+			if( key == keys[i] ) {
+				return static_cast<std::uint32_t>(i);
+			}
+		}
+		return Instruction::NO_INDEX;
+	}
+	
+	/**
+	 * @brief Adds outputs given as a table to the choices of an instruction
+	 * 
+	 * Outputs are matched with keys (plural forms, genders or cases of the locale) by their position
+	 */
+	void addChoices(
+		Instruction &step,
+		std::vector<Choice> &choices,
+		std::span<const preparse::ArgumentSyntax> listOfOutputs,
+		std::span<const char* const> keys,
+		const char* wrongSizeError
+	) {
+		if( listOfOutputs.size() != keys.size() ) {
+			throw InvalidTemplateState(wrongSizeError);
+		}
+		
+		step.firstChoice = static_cast<std::uint32_t>(choices.size());
+		step.choicesCount = static_cast<std::uint32_t>(listOfOutputs.size());
+		for(std::size_t i=0u; i<listOfOutputs.size(); ++i) {
+			choices.push_back( Choice{keys[i], listOfOutputs[i].value} );
+		}
+	}
+	
+	///returns `nullptr` if the hash of arguments has no such key
+	const preparse::ArgumentSyntax* findArgument(
+		std::span<const preparse::ArgumentSyntax> hashOfOptions, 
+		std::string_view key
+	) {
+		for(auto& option : hashOfOptions) {
+			if( option.key == key ) {
+				return &option;
+			}
+		}
+		return nullptr;
+	}
+	
+	/**
+	 * @brief Adds outputs given as a hash to the choices of an instruction in the order of the keys
+	 * 
+	 * So a choice can be found by the key's index. A key missing in the hash gets a choice with an empty key, 
+	 * a key of the hash which isn't one of `keys` is an error.
+	 */
+	void addIndexedChoices(
+		Instruction &step,
+		std::vector<Choice> &choices,
+		std::span<const preparse::ArgumentSyntax> hashOfOutputs,
+		std::span<const char* const> keys,
+		const char* unknownKeyError
+	) {
+		for(auto& output : hashOfOutputs) {
+			if( indexOf(keys, output.key) == Instruction::NO_INDEX ) {
+				throw InvalidTemplateState(unknownKeyError + std::string{output.key});
+			}
+		}
+		
+		step.firstChoice = static_cast<std::uint32_t>(choices.size());
+		step.choicesCount = static_cast<std::uint32_t>(keys.size());
+		for(const char* key : keys) {
+			if( auto output = findArgument(hashOfOutputs, key) ) {
+				choices.push_back( Choice{output->key, output->value} );
+			} else {
+				choices.push_back( Choice{std::string_view{}, std::string_view{}} );
+			}
+		}
+	}
+	
+	bool isAllNumber(std::string_view str) {
+		//IMPORTANT: we don check for *negative* numbers
+		for(auto c : str) {
+			if( !std::isdigit(c) ) {
+				return false;
+			}
+		}
+		return true;
+	}
+	
+	short readPrecision(std::string_view str) {
+		if( str.empty() || !isAllNumber(str) ) {
+			throw InvalidTemplateState("Invalid precision: " + std::string{str});
+		}
+		short result = -1;
+		auto[lastPtr, err] = std::from_chars(str.data(), str.data() + str.size(), result);
+		if( err != std::errc() ) {
+			throw InvalidTemplateState("Invalid precision: " + std::string{str});
+		}
+		return result;
+	}
+	
+	//------------- Compiled template class
+	
+	CompiledTemplate::CompiledTemplate(std::string_view templateString, locale::Locale& locale):
+		myLocale{&locale}, genderID{""} {
+		auto parsed = preparse::preparse_syntax(templateString);
+		//all texts of the program are views into the `source` buffer
+		source = std::move(parsed.source);
+		compile( parsed.view() );
+		resolveIndices();
+	}
+	
+	CompiledTemplate::CompiledTemplate(const preparse::TemplateSyntax& syntax, locale::Locale& locale):
+		myLocale{&locale}, genderID{""} {
+		compile(syntax);
+		resolveIndices();
+	}
+	
+	CompiledTemplate::CompiledTemplate(
+		locale::Locale& locale, 
+		std::string_view gender, 
+		std::vector<Instruction> compiledProgram, 
+		std::vector<Choice> compiledChoices, 
+		std::vector<std::string_view> names
+	):
+		myLocale{&locale}, genderID{gender}, program{std::move(compiledProgram)}, 
+		choices{std::move(compiledChoices)}, variableNames{std::move(names)} {
+		resolveIndices();
+	}
+	
+	void CompiledTemplate::resolveIndices() {
+		genderIndex = indexOf(myLocale->getGendersList(), genderID);
+		for(Instruction &step : program) {
+			if( step.code == Instruction::Code::CASE_SELECT ) {
+				step.caseIndex = indexOf(myLocale->getCasesList(), step.argument);
+			}
+		}
+	}
+	
+	void CompiledTemplate::compile(const preparse::TemplateSyntax& syntax) {
+		using namespace preparse;
+		using Type = TagType;
+		using Code = Instruction::Code;
+		
+		try{
+			program.reserve( syntax.strings.size() + syntax.tags.size() );
+			for(std::size_t i=0u; i<syntax.strings.size(); ++i) {
+				if( !syntax.strings[i].empty() ) {
+					program.push_back( makeInstruction(Code::EMIT_LITERAL, syntax.strings[i]) );
+				}
+				if( i >= syntax.tags.size() ) {
+					continue;
+				}
+				
+				auto* functionDesc = &syntax.tags[i];
+				//test for comments
+				if( functionDesc->isComment ) {
+					continue;
+				}
+				auto arguments = syntax.arguments.subspan(functionDesc->firstArgument, functionDesc->argumentsCount);
+				//select function
+				Instruction step = makeInstruction(Code::PUT_VAR, functionDesc->varName);
+				bool hasOutput = true;
+				switch( functionDesc->name[0] ) {
+					case '\0': //Variable put
+						if( functionDesc->type != Type::VAR_ONLY) {
 							throw InvalidTemplateState{"Wrong type of function"};
 						}
-						function = new VariablePutter(std::move(functionDesc->varName));
 						break;
 					case 'S': //Setter of...
+						hasOutput = false;
 						switch( functionDesc->name[1] ) {
 							case 'G': //gender
-								if( functionDesc->getType() == Type::ONE_ARG ) {
-									genderID = static_cast<OneArgFunction*>(
-										functionDesc
-									)->argument;
+								if( functionDesc->type == Type::ONE_ARG ) {
+									genderID = arguments[0].value;
 								} else {
 									throw InvalidTemplateState("Gender setter has invalid argument type");
 								}
@@ -1158,638 +3879,2204 @@ namespace mls {
 						if( functionDesc->varName.empty() ) {
 							throw InvalidTemplateState("Variable name can't be empty");
 						}
-						if( functionDesc->getType() == Type::TABLE_ARG ) {
-							function = new GenderFunction(
-								std::move(functionDesc->varName),
-								static_cast<TableArgFunction*>(functionDesc)->arguments,
-								*myLocale
+						step.code = Code::GENDER_SELECT;
+						if( functionDesc->type == Type::TABLE_ARG ) {
+							addChoices(
+								step, choices,
+								arguments,
+								myLocale->getGendersList(),
+								"Invalid list of genders"
+							);
+						} else if( functionDesc->type == Type::HASH_ARG ) {
+							addIndexedChoices(
+								step, choices,
+								arguments,
+								myLocale->getGendersList(),
+								"Unknown gender: "
+							);
+						} else {
+							throw InvalidTemplateState("Gender set called with wrong type of arguments");
+						}
+						break;
+					case 'C': //case...
+						if( functionDesc->varName.empty() ) {// ...writer
+							step.code = Code::CASE_WRITE;
+							if( functionDesc->type == Type::TABLE_ARG ) {
+								addChoices(
+									step, choices,
+									arguments,
+									myLocale->getCasesList(),
+									"Invalid list of cases"
+								);
+							} else if( functionDesc->type == Type::HASH_ARG ) {
+								addIndexedChoices(
+									step, choices,
+									arguments,
+									myLocale->getCasesList(),
+									"Unknown case: "
+								);
+							} else {
+								throw InvalidTemplateState("Case writer called with wrong type of arguments");
+							}
+						} else {// ...chooser
+							step.code = Code::CASE_SELECT;
+							if( functionDesc->type == Type::ONE_ARG ) {
+								step.argument = arguments[0].value;
+							} else {
+								throw InvalidTemplateState("Case chooser called with wrong type of arguments");
+							}
+						}
+						break;
+					case 'P'://Plural function
+						if( functionDesc->varName.empty() ) {
+							throw InvalidTemplateState("Variable name empty");
+						}
+						
+						step.code = Code::PLURAL_SELECT;
+						if( functionDesc->type == Type::TABLE_ARG ) {
+							addChoices(
+								step, choices,
+								arguments,
+								myLocale->getPluralsList(),
+								"Wrong number of arguments"
 							);
-						} else if( functionDesc->getType() == Type::HASH_ARG ) {
-							function = new GenderFunction(
-								std::move(functionDesc->varName),
-								static_cast<HashArgFunction*>(functionDesc)->arguments
+						} else if( functionDesc->type == Type::HASH_ARG ) {
+							addIndexedChoices(
+								step, choices,
+								arguments,
+								myLocale->getPluralsList(),
+								"Unknown plural form: "
+							);
+						} else {
+							throw InvalidTemplateState("Plural function called with invalid arguments type");
+						}
+						break;
+					case 'I': //Integer
+						if( functionDesc->varName.empty() ) {
+							throw InvalidTemplateState("Variable name empty");
+						}
+						
+						step.code = Code::INT_FORMAT;
+						if( functionDesc->type == Type::ONE_ARG ) {
+							step.format = myLocale->getNumberFormat(
+								arguments[0].value
 							);
 						} else {
-							throw InvalidTemplateState("Gender set called with wrong type of arguments");
+							throw InvalidTemplateState("Integer function called with invalid arguments list");
+						}
+						
+						if( step.format == nullptr ) {
+							throw InvalidTemplateState("Unknown formater type");
+						}
+						break;
+					case 'R': //Real
+						if( functionDesc->varName.empty() ) {
+							throw InvalidTemplateState("Variable name empty");
+						}
+						
+						step.code = Code::REAL_FORMAT;
+						if( functionDesc->type == Type::TABLE_ARG ) {
+							auto& listOfOptions = arguments;
+							if( listOfOptions.size() == 1u ) {
+								//only formater
+								step.format = myLocale->getNumberFormat(listOfOptions[0].value);
+							} else if( listOfOptions.size() == 2u ) {
+								//formater and precision
+								step.format = myLocale->getNumberFormat(listOfOptions[0].value);
+								step.precision = readPrecision(listOfOptions[1].value);
+							}
+						} else if( functionDesc->type == Type::HASH_ARG ) {
+							auto& hashOfOptions = arguments;
+							if( auto format = findArgument(hashOfOptions, "format") ) {
+								step.format = myLocale->getNumberFormat(format->value);
+							} else {
+								step.format = myLocale->getNumberFormat("general");
+							}
+							if( auto prec = findArgument(hashOfOptions, "prec") ) {
+								step.precision = readPrecision(prec->value);
+							}
+						} else {
+							throw InvalidTemplateState("Real function called with invalid arguments list");
+						}
+						
+						if( step.format == nullptr ) {
+							throw InvalidTemplateState("Unknown formater type");
+						}
+						break;
+					default:
+						throw InvalidTemplateState(std::string{"Unknown function: "} + functionDesc->name[0] + functionDesc->name[1]);
+				}
+				//-----
+				if( hasOutput ) {
+					step.slot = addVariable(
+						step.code == Code::CASE_WRITE ? std::string_view{"__CASE__"} : step.text
+					);
+					program.push_back(step);
+				}
+			}
+		} catch(const InvalidTemplateState& error) {
+			//clear all data
+			program.clear();
+			choices.clear();
+			variableNames.clear();
+			compileError = error.what();
+			//return an error
+			#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
+			throw;
+			#else
+			return;
+			#endif
+		}
+	}
+	
+	CompiledTemplate::~CompiledTemplate() {}
+	
+	locale::Locale& CompiledTemplate::getLocale() const {
+		return *myLocale;
+	}
+	
+	std::string_view CompiledTemplate::getGender() const {
+		return genderID;
+	}
+	
+	std::uint32_t CompiledTemplate::getGenderIndex() const {
+		return genderIndex;
+	}
+	
+	std::string_view CompiledTemplate::getError() const {
+		return compileError;
+	}
+	
+	std::span<const Instruction> CompiledTemplate::getProgram() const {
+		return program;
+	}
+	
+	std::span<const Choice> CompiledTemplate::getChoices() const {
+		return choices;
+	}
+	
+	std::span<const std::string_view> CompiledTemplate::getVariableNames() const {
+		return variableNames;
+	}
+	
+	VariableSlot CompiledTemplate::slot(std::string_view varName) const {
+		for(std::size_t i=0u; i<variableNames.size(); ++i) {
+			if( variableNames[i] == varName ) {
+				return VariableSlot{ static_cast<std::uint32_t>(i) };
+			}
+		}
+		return VariableSlot{};
+	}
+	
+	std::size_t CompiledTemplate::slotsCount() const {
+		return variableNames.size();
+	}
+	
+	std::uint32_t CompiledTemplate::addVariable(std::string_view varName) {
+		auto found = slot(varName);
+		if( found.index != VariableSlot::NONE ) {
+			return found.index;
+		}
+		variableNames.push_back(varName);
+		return static_cast<std::uint32_t>(variableNames.size() - 1u);
+	}
+	
+	//------------- The interpreter
+	
+	/**
+	 * @brief Reports an invalid state found while rendering
+	 * 
+	 * Without `MULANSTR_THROW_ON_INVALID_TEMPLATE` the instruction just produces no output
+	 */
+	void renderingError(const std::string &message) {
+		#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
+		throw InvalidTemplateState(message);
+		#else
+		(void)message;
+		#endif
+	}
+	
+	///reads a number for integer functions, real numbers lose their fractional part
+	bool readInteger(const variableValue &content, long &number) {
+		if( auto integer = std::get_if<long>(&content) ) {
+			number = *integer;
+			return true;
+		}
+		if( auto real = std::get_if<double>(&content) ) {
+			//keep only the integer part
+			number = static_cast<long>(*real);
+			return true;
+		}
+		return false;
+	}
+	
+	///reads a number for real functions
+	bool readReal(const variableValue &content, double &number) {
+		if( auto real = std::get_if<double>(&content) ) {
+			number = *real;
+			return true;
+		}
+		if( auto integer = std::get_if<long>(&content) ) {
+			number = static_cast<double>(*integer);
+			return true;
+		}
+		return false;
+	}
+	
+	///the choice of the instruction at the index of a plural form, gender or case, `nullptr` if it has none
+	const Choice* indexedChoice(const Instruction &step, std::span<const Choice> choices, std::size_t index) {
+		if( index >= step.choicesCount || choices[step.firstChoice + index].key.empty() ) {
+			return nullptr;
+		}
+		return &choices[step.firstChoice + index];
+	}
+	
+	///most nested outputs remembered in one run, later ones are rendered every time
+	constexpr std::size_t MAX_NESTED_OUTPUTS = 8u;
+	
+	/**
+	 * @brief Outputs of nested templates rendered in one run, keyed by the template and the case
+	 * 
+	 * A nested template is rendered once and its output is repeated for every later tag using it.
+	 * `first` and `last` are positions whose meaning depends on the output type.
+	 */
+	class NestedOutputs {
+		public:
+			struct Entry {
+				const Template* nested;
+				std::string_view caseID;
+				std::size_t first;
+				std::size_t last;
+			};
+			
+			const Entry* find(const Template& nested, std::string_view caseID) const {
+				for(std::size_t i=0u; i<count; ++i) {
+					if( entries[i].nested == &nested && entries[i].caseID == caseID ) {
+						return &entries[i];
+					}
+				}
+				return nullptr;
+			}
+			void add(const Template& nested, std::string_view caseID, std::size_t first, std::size_t last) {
+				if( count < entries.size() ) {
+					entries[count++] = Entry{&nested, caseID, first, last};
+				}
+			}
+		private:
+			std::array<Entry, MAX_NESTED_OUTPUTS> entries;
+			std::size_t count = 0u;
+	};
+	
+	///The case asked by a `CASE_SELECT` instruction of the parent template, read by `CASE_WRITE`
+	struct CaseRequest {
+		///the name of the case, empty if none was asked
+		std::string_view name;
+		///the index of the case in the parent's locale
+		std::uint32_t index = Instruction::NO_INDEX;
+		const locale::Locale* parentLocale = nullptr;
+	};
+	
+	template<typename Output>
+	void runProgram(const CompiledTemplate& compiled, const TemplateArgs& args, Output& output, const CaseRequest& caseRequest);
+	
+	///renders a nested template with the parent's output, the nested template isn't changed
+	template<typename Output>
+	void renderNested(const Template& nested, const CaseRequest& caseRequest, Output& output) {
+		auto& nestedCompiled = nested.getCompiled();
+		if( nestedCompiled == nullptr ) {
+			renderingError("Template not initialized");
+			return;
+		}
+		runProgram(*nestedCompiled, nested.getArgs(), output, caseRequest);
+	}
+	
+	///appends the output to a string
+	class StringOutput {
+		public:
+			explicit StringOutput(std::string& text): text{text} {}
+			
+			void put(std::string_view piece) {
+				text.append(piece);
+			}
+			void putLiteral(std::string_view piece) {
+				text.append(piece);
+			}
+			///number formats append straight to the output
+			std::string& formatBuffer() {
+				return text;
+			}
+			void putFormatted() {}
+			///nested templates append to the same string, where a repeated one is copied from
+			void putTemplate(const Template& nested, const CaseRequest& caseRequest) {
+				if( auto done = nestedOutputs.find(nested, caseRequest.name) ) {
+					const std::size_t length = done->last - done->first;
+					//no reallocation may happen between taking the pointer and appending
+					text.reserve(text.size() + length);
+					text.append(text.data() + done->first, length);
+					return;
+				}
+				const std::size_t first = text.size();
+				renderNested(nested, caseRequest, *this);
+				nestedOutputs.add(nested, caseRequest.name, first, text.size());
+			}
+		private:
+			std::string& text;
+			NestedOutputs nestedOutputs;
+	};
+	
+	///passes the output to a sink, numbers are formatted in a buffer reused for the whole run
+	class SinkOutput {
+		public:
+			explicit SinkOutput(RenderSink& sink): sink{sink} {}
+			
+			void put(std::string_view piece) {
+				sink.put(piece);
+				if( recording > 0u && !piece.empty() ) {
+					recorded.push_back( RecordedPiece{std::string_view{}, copies.size(), piece.size()} );
+					copies.append(piece);
+				}
+			}
+			void putLiteral(std::string_view piece) {
+				sink.putLiteral(piece);
+				if( recording > 0u && !piece.empty() ) {
+					recorded.push_back( RecordedPiece{piece, 0u, piece.size()} );
+				}
+			}
+			std::string& formatBuffer() {
+				buffer.clear();
+				return buffer;
+			}
+			void putFormatted() {
+				put(buffer);
+			}
+			///nested templates write to the same sink, their pieces are recorded to be put again
+			void putTemplate(const Template& nested, const CaseRequest& caseRequest) {
+				if( auto done = nestedOutputs.find(nested, caseRequest.name) ) {
+					for(std::size_t i=done->first; i<done->last; ++i) {
+						const RecordedPiece piece = recorded[i];
+						if( piece.literal.data() != nullptr ) {
+							sink.putLiteral(piece.literal);
+						} else {
+							sink.put( std::string_view{copies}.substr(piece.offset, piece.size) );
 						}
-						break;
-					case 'C': //case...
-						if( functionDesc->varName.empty() ) {// ...writer
-							if( functionDesc->getType() == Type::TABLE_ARG ) {
-								function = new CaseWriterFunction(
-									static_cast<TableArgFunction*>(functionDesc)->arguments,
-									*myLocale
-								);
-							} else if( functionDesc->getType() == Type::HASH_ARG ) {
-								function = new CaseWriterFunction(
-									static_cast<HashArgFunction*>(functionDesc)->arguments
-								);
-							} else {
-								throw InvalidTemplateState("Case writer called with wrong type of arguments");
-							}
-						} else {// ...chooser
-							if( functionDesc->getType() == Type::ONE_ARG ) {
-								function = new CaseChooserFunction(
-									std::move(functionDesc->varName),
-									std::move(static_cast<OneArgFunction*>(functionDesc)->argument)
-								);
-							} else {
-								throw InvalidTemplateState("Case chooser called with wrong type of arguments");
-							}
+						//a template nested deeper is put again as a part of its parent
+						if( recording > 0u ) {
+							recorded.push_back(piece);
 						}
+					}
+					return;
+				}
+				const std::size_t first = recorded.size();
+				++recording;
+				renderNested(nested, caseRequest, *this);
+				--recording;
+				nestedOutputs.add(nested, caseRequest.name, first, recorded.size());
+			}
+		private:
+			///a literal is referenced, other pieces are copied to `copies`
+			struct RecordedPiece {
+				std::string_view literal;
+				std::size_t offset;
+				std::size_t size;
+			};
+			
+			RenderSink& sink;
+			std::string buffer;
+			NestedOutputs nestedOutputs;
+			///the depth of nested templates being recorded
+			std::size_t recording = 0u;
+			std::vector<RecordedPiece> recorded;
+			std::string copies;
+	};
+	
+	///puts a variable content as is
+	template<typename Output>
+	void putVariable(const Instruction &step, const variableValue &content, Output &output) {
+		if( auto rawString = std::get_if<std::string_view>(&content) ) {
+			//raw strings are returned as is
+			output.put(*rawString);
+		} else if( auto subTemplate = std::get_if<Template*>(&content) ) {
+			output.putTemplate( **subTemplate, CaseRequest{} );
+		} else if( auto integer = std::get_if<long>(&content) ) {
+			//simple number formating
+			char buffer[24];
+			auto[lastPtr, err] = std::to_chars(&buffer[0], &buffer[sizeof(buffer)], *integer);
+			output.put( std::string_view(&buffer[0], static_cast<std::size_t>(lastPtr - &buffer[0])) );
+		} else if( auto real = std::get_if<double>(&content) ) {
+			//the same output as std::to_string(double)
+			char buffer[512];
+			int length = std::snprintf(&buffer[0], sizeof(buffer), "%f", *real);
+			if( length > 0 ) {
+				output.put( std::string_view(&buffer[0], static_cast<std::size_t>(length)) );
+			}
+		} else {
+			//other types of data are incompatible with this function
+			renderingError("Unsupported type of data for variable: " + std::string{step.text});
+		}
+	}
+	
+	///count of digits of an integer
+	std::size_t countDigits(long number) {
+		unsigned long value = number < 0 ? 0ul - static_cast<unsigned long>(number) : static_cast<unsigned long>(number);
+		std::size_t digits = 1u;
+		while( value >= 10ul ) {
+			value /= 10ul;
+			++digits;
+		}
+		return digits;
+	}
+	
+	///count of digits in the integer part of a real number
+	std::size_t countDigits(double number) {
+		//`double` can't have more than 309 digits
+		if( !(std::abs(number) < 1e18) ) return 309u;
+		return countDigits( static_cast<long>(number) );
+	}
+	
+	///digits of the fractional part of a real number written with the given precision
+	constexpr std::size_t FRACTION_DIGITS_GUESS = 17u;
+	
+	std::size_t estimateSize(const CompiledTemplate& compiled, const TemplateArgs& args) {
+		using Code = Instruction::Code;
+		std::size_t result = 0u;
+		//variables can be read only from arguments made for this template
+		const bool hasArgs = args.getCompiled() == &compiled;
+		
+		for(const Instruction &step : compiled.program) {
+			if( step.code == Code::EMIT_LITERAL ) {
+				result += step.text.size();
+				continue;
+			}
+			if( step.code == Code::PLURAL_SELECT || step.code == Code::GENDER_SELECT || step.code == Code::CASE_WRITE ) {
+				std::size_t longest = 0u;
+				for(std::uint32_t i=step.firstChoice; i<step.firstChoice + step.choicesCount; ++i) {
+					longest = std::max(longest, compiled.choices[i].text.size());
+				}
+				result += longest;
+				continue;
+			}
+			
+			if( !hasArgs ) {
+				continue;
+			}
+			const variableValue *content = &args.get(step.slot);
+			if( auto rawString = std::get_if<std::string_view>(content) ) {
+				result += rawString->size();
+			} else if( auto subTemplate = std::get_if<Template*>(content) ) {
+				auto& subCompiled = (*subTemplate)->getCompiled();
+				if( subCompiled != nullptr ) {
+					result += estimateSize(*subCompiled, (*subTemplate)->getArgs());
+				}
+			} else if( auto integer = std::get_if<long>(content) ) {
+				if( step.code == Code::INT_FORMAT || step.code == Code::REAL_FORMAT ) {
+					result += step.format->maxLength( countDigits(*integer) );
+				} else {
+					result += 1u + countDigits(*integer);
+				}
+			} else if( auto real = std::get_if<double>(content) ) {
+				if( step.code == Code::INT_FORMAT ) {
+					result += step.format->maxLength( countDigits(*real) );
+				} else if( step.code == Code::REAL_FORMAT ) {
+					result += step.format->maxLength(
+						countDigits(*real),
+						step.precision >= 0 ? static_cast<std::size_t>(step.precision) : FRACTION_DIGITS_GUESS
+					);
+				} else {
+					//the "%f" format
+					result += 1u + countDigits(*real) + 7u;
+				}
+			}
+		}
+		
+		return result;
+	}
+	
+	std::string render(const CompiledTemplate& compiled, const TemplateArgs& args) {
+		std::string output;
+		render(compiled, args, output);
+		return output;
+	}
+	
+	///runs the program of the compiled template, see `StringOutput` and `SinkOutput`
+	template<typename Output>
+	void runProgram(const CompiledTemplate& compiled, const TemplateArgs& args, Output& output, const CaseRequest& caseRequest) {
+		using Code = Instruction::Code;
+		const variableValue *content = nullptr;
+		
+		if( args.getCompiled() != &compiled && !compiled.getVariableNames().empty() ) {
+			renderingError("The arguments were made for another template");
+			return;
+		}
+		const auto choices = compiled.getChoices();
+		locale::Locale& myLocale = compiled.getLocale();
+		
+		for(const Instruction &step : compiled.getProgram()) {
+			//all instructions but these two work on a variable
+			if( step.code != Code::EMIT_LITERAL && step.code != Code::CASE_WRITE ) {
+				content = &args.get(step.slot);
+				if( std::holds_alternative<std::monostate>(*content) ) {
+					renderingError("The variable doesn't exists: " + std::string{step.text});
+					continue;
+				}
+			}
+			
+			switch( step.code ) {
+				case Code::EMIT_LITERAL:
+					output.putLiteral(step.text);
+					break;
+				case Code::PUT_VAR:
+					putVariable(step, *content, output);
+					break;
+				case Code::PLURAL_SELECT: {
+					//choices are in the order of the locale's plural forms
+					std::size_t form;
+					if( auto integer = std::get_if<long>(content) ) {
+						form = myLocale.getPluralIndex(*integer);
+					} else if( auto real = std::get_if<double>(content) ) {
+						//the fraction matters, "1.5" may have another form than "1"
+						form = myLocale.getPluralIndex( locale::pluralOperands(*real) );
+					} else {
+						renderingError("Invalid type of the variable: " + std::string{step.text});
 						break;
-					case 'P'://Plural function
-						if( functionDesc->varName.empty() ) {
-							throw InvalidTemplateState("Variable name empty");
-						}
-						
-						if( functionDesc->getType() == Type::TABLE_ARG ) {
-							function = new PluralFunction(
-								std::move(functionDesc->varName),
-								static_cast<TableArgFunction*>(functionDesc)->arguments,
-								*myLocale
-							);
-						} else if( functionDesc->getType() == Type::HASH_ARG ) {
-							function = new PluralFunction(
-								std::move(functionDesc->varName),
-								static_cast<HashArgFunction*>(functionDesc)->arguments,
-								*myLocale
-							);
-						} else {
-							throw InvalidTemplateState("Plural function called with invalid arguments type");
-						}
+					}
+					
+					const Choice* choice = indexedChoice(step, choices, form);
+					if( choice == nullptr ) {
+						const auto& forms = myLocale.getPluralsList();
+						renderingError("Unknown plural type: " + std::string{form < forms.size() ? forms[form] : "?"});
+					} else {
+						output.putLiteral(choice->text);
+					}
+					break;
+				}
+				case Code::GENDER_SELECT: {
+					auto subTemplate = std::get_if<Template*>(content);
+					if( subTemplate == nullptr ) {
+						//other types are incompatible with this function
+						renderingError("Unsupported type of the variable");
 						break;
-					case 'I': //Integer
-						if( functionDesc->varName.empty() ) {
-							throw InvalidTemplateState("Variable name empty");
+					}
+					auto& subCompiled = (*subTemplate)->getCompiled();
+					std::uint32_t gender = Instruction::NO_INDEX;
+					if( subCompiled != nullptr ) {
+						//the index of a template of another locale doesn't count here
+						gender = &subCompiled->getLocale() == &myLocale ? 
+							subCompiled->getGenderIndex() : indexOf(myLocale.getGendersList(), subCompiled->getGender());
+					}
+					auto choice = indexedChoice(step, choices, gender);
+					if( choice == nullptr ) {
+						renderingError("Unknown gender: " + std::string{subCompiled != nullptr ? subCompiled->getGender() : ""});
+					} else {
+						output.putLiteral(choice->text);
+					}
+					break;
+				}
+				case Code::CASE_WRITE: {
+					std::size_t caseIndex;
+					if( !caseRequest.name.empty() ) {
+						//the index counts only in the parent's locale
+						caseIndex = caseRequest.parentLocale == &myLocale && caseRequest.index != Instruction::NO_INDEX ? 
+							caseRequest.index : indexOf(myLocale.getCasesList(), caseRequest.name);
+					} else {
+						//without a parent the case may be given by the `__CASE__` variable
+						content = &args.get(step.slot);
+						if( std::holds_alternative<std::monostate>(*content) ) {
+							//not an error
+							break;
 						}
-						
-						if( functionDesc->getType() == Type::ONE_ARG ) {
-							function = new IntegerFormaterFunction(
-								std::move(functionDesc->varName),
-								static_cast<OneArgFunction*>(functionDesc)->argument,
-								*myLocale
-							);
-						} else {
-							throw InvalidTemplateState("Integer function called with invalid arguments list");
+						auto caseID = std::get_if<std::string_view>(content);
+						if( caseID == nullptr ) {
+							renderingError("Unsupported type of the __CASE__ variable");
+							break;
 						}
+						caseIndex = indexOf(myLocale.getCasesList(), *caseID);
+					}
+					auto choice = indexedChoice(step, choices, caseIndex);
+					if( choice == nullptr ) {
+						renderingError("Wrong case");
+					} else {
+						output.putLiteral(choice->text);
+					}
+					break;
+				}
+				case Code::CASE_SELECT: {
+					auto subTemplate = std::get_if<Template*>(content);
+					if( subTemplate == nullptr ) {
+						//other types of data are incompatible with this function
+						renderingError("Invalid type of variable: " + std::string{step.text});
 						break;
-					case 'R': //Real
-						if( functionDesc->varName.empty() ) {
-							throw InvalidTemplateState("Variable name empty");
-						}
-						
-						if( functionDesc->getType() == Type::TABLE_ARG ) {
-							function = new RealFormaterFunction(
-								std::move(functionDesc->varName),
-								static_cast<TableArgFunction*>(functionDesc)->arguments,
-								*myLocale
-							);
-						} else if( functionDesc->getType() == Type::HASH_ARG ) {
-							function = new RealFormaterFunction(
-								std::move(functionDesc->varName),
-								static_cast<HashArgFunction*>(functionDesc)->arguments,
-								*myLocale
-							);
-						} else {
-							throw InvalidTemplateState("Real function called with invalid arguments list");
-						}
+					}
+					output.putTemplate( **subTemplate, CaseRequest{step.argument, step.caseIndex, &myLocale} );
+					break;
+				}
+				case Code::INT_FORMAT: {
+					long number;
+					if( !readInteger(*content, number) ) {
+						renderingError("The variable has improper content: " + std::string{step.text});
 						break;
-					default:
-						throw InvalidTemplateState(std::string{"Unknown function: "} + functionDesc->name[0] + functionDesc->name[1]);
+					}
+					step.format->formatInteger(number, output.formatBuffer());
+					output.putFormatted();
+					break;
+				}
+				case Code::REAL_FORMAT: {
+					double number;
+					if( !readReal(*content, number) ) {
+						renderingError("The variable has improper content: " + std::string{step.text});
+						break;
+					}
+					step.format->formatReal(number, output.formatBuffer(), step.precision);
+					output.putFormatted();
+					break;
 				}
-				//-----
-				delete functionDesc;
-				functionDesc = nullptr;
-				functionsList.push_back(function);
 			}
-		} catch(InvalidTemplateState e) {
-			//clear all data
-			for(char* aString : stringsList) {
-				delete[] aString;
+		}
+	}
+	
+	///makes room for `needed` more bytes, growing the string geometrically when it must grow
+	void reserveMore(std::string& output, std::size_t needed) {
+		if( output.capacity() - output.size() < needed ) {
+			//`reserve` may allocate exactly the asked size, which would make every append copy the string
+			output.reserve( std::max(output.size() + needed, 2u * output.capacity()) );
+		}
+	}
+	
+	void render(const CompiledTemplate& compiled, const TemplateArgs& args, std::string& output) {
+		reserveMore( output, estimateSize(compiled, args) );
+		StringOutput stringOutput{output};
+		runProgram(compiled, args, stringOutput, CaseRequest{});
+	}
+	
+	void render(const CompiledTemplate& compiled, const TemplateArgs& args, RenderSink& sink) {
+		SinkOutput sinkOutput{sink};
+		runProgram(compiled, args, sinkOutput, CaseRequest{});
+	}
+	
+	//------------- Sinks
+	
+	void RenderSink::putLiteral(std::string_view text) {
+		put(text);
+	}
+	
+	OstreamSink::OstreamSink(std::ostream& stream): stream{stream} {}
+	
+	void OstreamSink::put(std::string_view text) {
+		stream.write(text.data(), static_cast<std::streamsize>(text.size()));
+	}
+	
+	FileSink::FileSink(std::FILE* file): file{file} {}
+	
+	void FileSink::put(std::string_view text) {
+		std::fwrite(text.data(), 1u, text.size(), file);
+	}
+	
+	void IovecSink::put(std::string_view text) {
+		if( text.empty() ) {
+			return;
+		}
+		//copies are appended one after another, so a copy following another one joins it
+		if( !pieces.empty() && pieces.back().data == nullptr ) {
+			pieces.back().size += text.size();
+		} else {
+			pieces.push_back( Piece{nullptr, copies.size(), text.size()} );
+		}
+		copies.append(text);
+		totalSize += text.size();
+	}
+	
+	void IovecSink::putLiteral(std::string_view text) {
+		if( text.empty() ) {
+			return;
+		}
+		if( !pieces.empty() && pieces.back().data != nullptr && pieces.back().data + pieces.back().size == text.data() ) {
+			//the literal follows the previous one in memory
+			pieces.back().size += text.size();
+		} else {
+			pieces.push_back( Piece{text.data(), 0u, text.size()} );
+		}
+		totalSize += text.size();
+	}
+	
+	std::span<const IoSegment> IovecSink::segments() {
+		//copies may have moved since they were put, so their addresses are known only now
+		resolved.clear();
+		for(const Piece& piece : pieces) {
+			const char* start = piece.data != nullptr ? piece.data : copies.data() + piece.offset;
+			IoSegment segment;
+			segment.iov_base = const_cast<char*>(start);
+			segment.iov_len = piece.size;
+			resolved.push_back(segment);
+		}
+		return resolved;
+	}
+	
+	std::size_t IovecSink::size() const {
+		return totalSize;
+	}
+	
+	void IovecSink::clear() {
+		pieces.clear();
+		copies.clear();
+		resolved.clear();
+		totalSize = 0u;
+	}
+	
+	//------------- Template arguments class
+	
+	TemplateArgs::TemplateArgs():compiled{nullptr} {}
+	
+	TemplateArgs::TemplateArgs(const CompiledTemplate& compiled):compiled{&compiled} {
+		if( compiled.slotsCount() > INLINE_SLOTS ) {
+			moreValues.resize( compiled.slotsCount() );
+		}
+	}
+	
+	variableValue* TemplateArgs::values() {
+		return moreValues.empty() ? inlineValues.data() : moreValues.data();
+	}
+	
+	const variableValue* TemplateArgs::values() const {
+		return moreValues.empty() ? inlineValues.data() : moreValues.data();
+	}
+	
+	void TemplateArgs::set(VariableSlot slot, variableValue value) {
+		if( compiled == nullptr || slot.index >= compiled->slotsCount() ) {
+			//the template doesn't use the variable
+			return;
+		}
+		values()[slot.index] = value;
+	}
+	
+	TemplateArgs& TemplateArgs::apply(std::string_view varName, std::string_view rawString) {
+		if( compiled != nullptr ) {
+			set( compiled->slot(varName), variableValue{rawString} );
+		}
+		return *this;
+	}
+	
+	TemplateArgs& TemplateArgs::apply(std::string_view varName, long number) {
+		if( compiled != nullptr ) {
+			set( compiled->slot(varName), variableValue{number} );
+		}
+		return *this;
+	}
+	
+	TemplateArgs& TemplateArgs::applyReal(std::string_view varName, double number) {
+		if( compiled != nullptr ) {
+			set( compiled->slot(varName), variableValue{number} );
+		}
+		return *this;
+	}
+	
+	TemplateArgs& TemplateArgs::apply(std::string_view varName, Template& t) {
+		if( compiled != nullptr ) {
+			set( compiled->slot(varName), variableValue{&t} );
+		}
+		return *this;
+	}
+	
+	TemplateArgs& TemplateArgs::apply(VariableSlot slot, std::string_view rawString) {
+		set( slot, variableValue{rawString} );
+		return *this;
+	}
+	
+	TemplateArgs& TemplateArgs::apply(VariableSlot slot, long number) {
+		set( slot, variableValue{number} );
+		return *this;
+	}
+	
+	TemplateArgs& TemplateArgs::applyReal(VariableSlot slot, double number) {
+		set( slot, variableValue{number} );
+		return *this;
+	}
+	
+	TemplateArgs& TemplateArgs::apply(VariableSlot slot, Template& t) {
+		set( slot, variableValue{&t} );
+		return *this;
+	}
+	
+	const variableValue* TemplateArgs::find(std::string_view varName) const {
+		if( compiled == nullptr ) {
+			return nullptr;
+		}
+		auto slot = compiled->slot(varName);
+		if( slot.index == VariableSlot::NONE ) {
+			return nullptr;
+		}
+		const variableValue& value = values()[slot.index];
+		if( std::holds_alternative<std::monostate>(value) ) {
+			return nullptr;
+		}
+		return &value;
+	}
+	
+	const variableValue& TemplateArgs::get(std::uint32_t slotIndex) const {
+		return values()[slotIndex];
+	}
+	
+	const CompiledTemplate* TemplateArgs::getCompiled() const {
+		return compiled;
+	}
+	
+	void TemplateArgs::clear() {
+		if( compiled == nullptr ) {
+			return;
+		}
+		auto count = compiled->slotsCount();
+		auto theValues = values();
+		for(std::size_t i=0u; i<count; ++i) {
+			theValues[i] = std::monostate{};
+		}
+	}
+	
+	//------------- Batches
+	
+	std::size_t BatchOutput::size() const {
+		return offsets.empty() ? 0u : offsets.size() - 1u;
+	}
+	
+	std::string_view BatchOutput::row(std::size_t index) const {
+		return std::string_view{text}.substr(offsets[index], offsets[index + 1u] - offsets[index]);
+	}
+	
+	///fewer rows than this aren't worth a thread
+	constexpr std::size_t MIN_BATCH_ROWS_PER_THREAD = 1024u;
+	
+	///renders rows `[first, last)` appending them to `text` and their ends to `ends`
+	void renderRows(
+		const CompiledTemplate& compiled, 
+		std::span<const BatchColumn> columns, 
+		std::span<const VariableSlot> slots, 
+		std::size_t first, 
+		std::size_t last, 
+		std::string& text, 
+		std::vector<std::size_t>& ends
+	) {
+		TemplateArgs args{compiled};
+		ends.reserve(ends.size() + (last - first));
+		for(std::size_t row=first; row<last; ++row) {
+			//every used slot gets a new value, so nothing has to be cleared
+			for(std::size_t column=0u; column<columns.size(); ++column) {
+				std::visit([&args, slot = slots[column], row](auto values) {
+					if constexpr( std::is_same_v<decltype(values), std::span<const double>> ) {
+						args.applyReal(slot, values[row]);
+					} else {
+						args.apply(slot, values[row]);
+					}
+				}, columns[column].values);
+			}
+			//the first row's size is the guess for all of them, later rows let the string grow by itself
+			if( row == first ) {
+				reserveMore( text, estimateSize(compiled, args) * (last - first) );
+			}
+			StringOutput rowOutput{text};
+			runProgram(compiled, args, rowOutput, CaseRequest{});
+			ends.push_back(text.size());
+		}
+	}
+	
+	void renderBatch(
+		const CompiledTemplate& compiled, 
+		std::span<const BatchColumn> columns, 
+		BatchOutput& output, 
+		BatchPolicy policy, 
+		unsigned maxThreads
+	) {
+		auto columnSize = [](const BatchColumn& column) {
+			return std::visit([](auto values) { return values.size(); }, column.values);
+		};
+		const std::size_t rows = columns.empty() ? 0u : columnSize(columns[0]);
+		std::vector<VariableSlot> slots;
+		slots.reserve(columns.size());
+		for(auto& column : columns) {
+			if( columnSize(column) != rows ) {
+				throw InvalidTemplateState("Columns of a batch have different sizes");
+			}
+			slots.push_back( compiled.slot(column.name) );
+		}
+		
+		output.text.clear();
+		output.offsets.clear();
+		output.offsets.reserve(rows + 1u);
+		output.offsets.push_back(0u);
+		
+		std::size_t threadsCount = 1u;
+		if( policy == BatchPolicy::PARALLEL ) {
+			if( maxThreads == 0u ) {
+				maxThreads = std::max(1u, std::thread::hardware_concurrency());
+			}
+			threadsCount = std::min<std::size_t>(maxThreads, rows / MIN_BATCH_ROWS_PER_THREAD);
+		}
+		if( threadsCount <= 1u ) {
+			renderRows(compiled, columns, slots, 0u, rows, output.text, output.offsets);
+			return;
+		}
+		
+		//each thread renders its part of the rows into its own buffer, which are joined afterwards
+		struct Part {
+			std::string text;
+			std::vector<std::size_t> ends;
+			std::exception_ptr error;
+		};
+		std::vector<Part> parts(threadsCount);
+		auto renderPart = [&](std::size_t index) {
+			try {
+				renderRows(compiled, columns, slots, rows * index / threadsCount, rows * (index + 1u) / threadsCount, parts[index].text, parts[index].ends);
+			} catch(...) {
+				parts[index].error = std::current_exception();
 			}
-			stringsList.clear();
-			for(auto functionDesc : fnList) {
-				delete functionDesc;
+		};
+		std::vector<std::thread> threads;
+		threads.reserve(threadsCount - 1u);
+		for(std::size_t index=1u; index<threadsCount; ++index) {
+			threads.emplace_back(renderPart, index);
+		}
+		renderPart(0u);
+		for(auto& thread : threads) {
+			thread.join();
+		}
+		
+		std::size_t textSize = 0u;
+		for(auto& part : parts) {
+			if( part.error ) {
+				std::rethrow_exception(part.error);
 			}
-			for(auto function : functionsList) {
-				delete function;
+			textSize += part.text.size();
+		}
+		output.text.reserve(textSize);
+		for(auto& part : parts) {
+			const std::size_t base = output.text.size();
+			output.text.append(part.text);
+			for(auto end : part.ends) {
+				output.offsets.push_back(base + end);
 			}
-			functionsList.clear();
-			//return an error
-			#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
-			throw e;
-			#else
-			return;
-			#endif
 		}
 	}
 	
-	Template::~Template() {
-		for(char* aString : stringsList) {
-			delete[] aString;
-		}
-		for(auto function : functionsList) {
-			delete function;
+	//------------- Template class
+	
+	Template::Template():compiled{nullptr} {
+		//do nothing else
+	}
+	
+	Template::Template(Template&& other):
+		compiled{std::move(other.compiled)}, args{std::move(other.args)} {
+		other.compiled = nullptr;
+		other.args = TemplateArgs{};
+	}
+	
+	Template::Template(std::string_view templateString, locale::Locale& locale):
+		compiled{std::make_shared<const CompiledTemplate>(templateString, locale)}, args{*compiled} {}
+	
+	Template::Template(const preparse::TemplateSyntax& syntax, locale::Locale& locale):
+		compiled{std::make_shared<const CompiledTemplate>(syntax, locale)}, args{*compiled} {}
+	
+	Template::Template(std::shared_ptr<const CompiledTemplate> compiledTemplate):
+		compiled{std::move(compiledTemplate)} {
+		if( compiled != nullptr ) {
+			args = TemplateArgs{*compiled};
 		}
 	}
 	
+	Template::~Template() {}
+	
 	Template& Template::apply(std::string_view varName, std::string_view rawString) {
-		if( myLocale == nullptr ) {
+		if( compiled == nullptr ) {
 			#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
 			throw InvalidTemplateState("Template not initialized");
 			#else
 			return *this;
 			#endif
 		}
-		variables.insert_or_assign( varName, variableValue{rawString} );
+		args.apply(varName, rawString);
 		return *this;
 	}
 	
 	Template& Template::apply(std::string_view varName, long number) {
-		if( myLocale == nullptr ) {
+		if( compiled == nullptr ) {
 			#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
 			throw InvalidTemplateState("Template not initialized");
 			#else
 			return *this;
 			#endif
 		}
-		variables.insert_or_assign( varName, variableValue{number} );
+		args.apply(varName, number);
 		return *this;
 	}
 	
 	Template& Template::applyReal(std::string_view varName, double number) {
-		if( myLocale == nullptr ) {
+		if( compiled == nullptr ) {
 			#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
 			throw InvalidTemplateState("Template not initialized");
 			#else
 			return *this;
 			#endif
 		}
-		variables.insert_or_assign( varName, variableValue{number} );
+		args.applyReal(varName, number);
 		return *this;
 	}
 	
 	Template& Template::apply(std::string_view varName, Template& t) {
-		if( myLocale == nullptr ) {
+		if( compiled == nullptr ) {
 			#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
 			throw InvalidTemplateState("Template not initialized");
 			#else
 			return *this;
 			#endif
 		}
-		variables.insert_or_assign( varName, variableValue{&t} );
+		args.apply(varName, t);
+		return *this;
+	}
+	
+	Template& Template::apply(VariableSlot slot, std::string_view rawString) {
+		args.apply(slot, rawString);
+		return *this;
+	}
+	
+	Template& Template::apply(VariableSlot slot, long number) {
+		args.apply(slot, number);
 		return *this;
 	}
 	
+	Template& Template::applyReal(VariableSlot slot, double number) {
+		args.applyReal(slot, number);
+		return *this;
+	}
+	
+	Template& Template::apply(VariableSlot slot, Template& t) {
+		args.apply(slot, t);
+		return *this;
+	}
+	
+	VariableSlot Template::slot(std::string_view varName) const {
+		if( compiled == nullptr ) {
+			return VariableSlot{};
+		}
+		return compiled->slot(varName);
+	}
+	
 	std::string Template::get() {
-		if( myLocale == nullptr ) {
+		if( compiled == nullptr ) {
 			#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
 			throw InvalidTemplateState("Template not initialized");
 			#else
 			return "";
 			#endif
 		}
-		std::ostringstream output;
-		std::size_t i=0u;
+		std::string result = render(*compiled, args);
+		
+		//clear variables data
+		args.clear();
+		
+		//return the result
+		return result;
+	}
+	
+	void Template::get(std::string& output) {
+		if( compiled == nullptr ) {
+			#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
+			throw InvalidTemplateState("Template not initialized");
+			#else
+			return;
+			#endif
+		}
+		render(*compiled, args, output);
+		
+		//clear variables data
+		args.clear();
+	}
+	
+	void Template::get(RenderSink& sink) {
+		if( compiled == nullptr ) {
+			#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
+			throw InvalidTemplateState("Template not initialized");
+			#else
+			return;
+			#endif
+		}
+		render(*compiled, args, sink);
+		
+		//clear variables data
+		args.clear();
+	}
+	
+	std::string Template::getGender() {
+		if( compiled == nullptr ) {
+			return "";
+		}
+		return std::string{ compiled->getGender() };
+	}
+	
+	const std::shared_ptr<const CompiledTemplate>& Template::getCompiled() const {
+		return compiled;
+	}
+	
+	const TemplateArgs& Template::getArgs() const {
+		return args;
+	}
+
+};
+
+
+
+namespace mls::backend {
+	
+	namespace {
+		
+		constexpr std::uint32_t MO_MAGIC = 0x950412deu;
+		constexpr std::uint32_t MO_MAGIC_SWAPPED = 0xde120495u;
+		///separates `msgctxt` from `msgid` in keys of the catalog
+		constexpr char CONTEXT_SEPARATOR = '\x04';
+		
+		//offsets of the fields of the .mo header
+		constexpr std::size_t REVISION_FIELD = 4u;
+		constexpr std::size_t COUNT_FIELD = 8u;
+		constexpr std::size_t ORIGINALS_FIELD = 12u;
+		constexpr std::size_t TRANSLATIONS_FIELD = 16u;
+		constexpr std::size_t HASH_SIZE_FIELD = 20u;
+		constexpr std::size_t HASH_OFFSET_FIELD = 24u;
+		constexpr std::size_t HEADER_SIZE = 28u;
+		
+		std::uint32_t swapBytes(std::uint32_t value) {
+			return (value >> 24) | ((value >> 8) & 0xff00u) | ((value << 8) & 0xff0000u) | (value << 24);
+		}
+		
+		///the `hashpjw` function GetText uses to build the hash tables of .mo files
+		std::uint32_t hashString(std::string_view key) {
+			std::uint32_t hash = 0u;
+			for(unsigned char c : key) {
+				hash = (hash << 4) + c;
+				std::uint32_t high = hash & 0xf0000000u;
+				if( high != 0u ) {
+					hash ^= high >> 24;
+					hash ^= high;
+				}
+			}
+			return hash;
+		}
+		
+		///the key of a message in a `msgctxt` context
+		std::string contextKey(std::string_view context, std::string_view msgid) {
+			std::string key;
+			key.reserve(context.size() + 1u + msgid.size());
+			key.append(context).append(1u, CONTEXT_SEPARATOR).append(msgid);
+			return key;
+		}
+		
+		/**
+		 * @brief The next slot of the probe sequence of a hash table like in .mo files
+		 * 
+		 * `tableSize` is a prime, so the sequence visits all slots
+		 */
+		std::uint32_t nextProbe(std::uint32_t index, std::uint32_t step, std::uint32_t tableSize) {
+			return index >= tableSize - step ? index - (tableSize - step) : index + step;
+		}
+		
+		[[noreturn]] void failCatalog(const std::string& path, const std::string& reason) {
+			throw InvalidCatalog("Broken catalog \"" + path + "\": " + reason);
+		}
+		
+		[[noreturn]] void failTranslation(std::string_view msgid, const std::string& reason) {
+			throw InvalidCatalog("Invalid translation of \"" + std::string{msgid} + "\": " + reason);
+		}
+		
+		/**
+		 * @brief Compiles a translation for a template catalog, throws `mls::InvalidCatalog` if it's invalid
+		 * 
+		 * Run time parsing skips invalid tags, so the syntax is checked with the grammar first.
+		 */
+		std::unique_ptr<CompiledTemplate> compileTranslation(std::string_view msgid, std::string_view translation, locale::Locale& locale) {
+			preparse::TagSyntax tag;
+			const char* syntaxError = preparse::scan_template(translation,
+				[](std::string_view) {},
+				[&tag](std::string_view content) {
+					return preparse::parse_tag(content, tag, [](std::string_view, std::string_view) {});
+				}
+			);
+			if( syntaxError != nullptr ) {
+				failTranslation(msgid, syntaxError);
+			}
+			std::unique_ptr<CompiledTemplate> compiled;
+			try {
+				compiled = std::make_unique<CompiledTemplate>(translation, locale);
+			} catch(const InvalidTemplateState& error) {
+				failTranslation(msgid, error.what());
+			}
+			if( !compiled->getError().empty() ) {
+				failTranslation(msgid, std::string{compiled->getError()});
+			}
+			return compiled;
+		}
+	
+	};
+	
+	/**
+	 * @brief Templates of message ids which have no translation, parsed once per locale
+	 * 
+	 * They stay as long as the catalog keeping them. Guarded by a mutex, so it can be used from many threads.
+	 */
+	class UntranslatedTemplates {
+		private:
+			std::mutex guard;
+			std::map<const locale::Locale*, std::map<std::string, std::shared_ptr<const CompiledTemplate>, std::less<>>> parsed;
+		public:
+			std::shared_ptr<const CompiledTemplate> get(std::string_view msgid, locale::Locale& theLocale) {
+				{
+					std::lock_guard<std::mutex> lock{guard};
+					auto& templates = parsed[&theLocale];
+					if( auto found = templates.find(msgid); found != templates.end() ) {
+						return found->second;
+					}
+				}
+				//parsed without the lock, another thread may put its template first
+				auto made = std::make_shared<const CompiledTemplate>(msgid, theLocale);
+				std::lock_guard<std::mutex> lock{guard};
+				return parsed[&theLocale].try_emplace(std::string{msgid}, std::move(made)).first->second;
+			}
+	};
+	
+	Catalog::Catalog(const std::string& path, locale::Locale& locale): theLocale{&locale} {
+		file = MappedFile::open(path);
+		if( file == nullptr ) {
+			throw InvalidCatalog("Can't open and map the catalog \"" + path + "\"");
+		}
+		bytes = file->bytes();
+		if( bytes.size() < HEADER_SIZE ) {
+			failCatalog(path, "too short");
+		}
+		
+		std::uint32_t magic;
+		std::memcpy(&magic, bytes.data(), sizeof(magic));
+		if( magic != MO_MAGIC && magic != MO_MAGIC_SWAPPED ) {
+			failCatalog(path, "not a .mo file");
+		}
+		swapped = magic == MO_MAGIC_SWAPPED;
+		//only the major revisions 0 and 1 are known
+		if( (word(REVISION_FIELD) >> 16) > 1u ) {
+			failCatalog(path, "unknown revision");
+		}
+		messagesCount = word(COUNT_FIELD);
+		originalsOffset = word(ORIGINALS_FIELD);
+		translationsOffset = word(TRANSLATIONS_FIELD);
+		hashSize = word(HASH_SIZE_FIELD);
+		hashOffset = word(HASH_OFFSET_FIELD);
+		//the probe step needs a modulus above 0, GetText writes primes anyway
+		if( hashSize < 3u ) {
+			hashSize = 0u;
+		}
+		
+		auto fits = [this](std::uint64_t offset, std::uint64_t size) {
+			return offset + size <= bytes.size();
+		};
+		if( !fits(originalsOffset, std::uint64_t{messagesCount} * 8u) || !fits(translationsOffset, std::uint64_t{messagesCount} * 8u) ) {
+			failCatalog(path, "a strings table past the end");
+		}
+		if( !fits(hashOffset, std::uint64_t{hashSize} * 4u) ) {
+			failCatalog(path, "the hash table past the end");
+		}
+		//lookups trust the tables, so all of them are checked once here
+		for(auto table : {originalsOffset, translationsOffset}) {
+			for(std::uint32_t index=0u; index<messagesCount; ++index) {
+				std::uint32_t length = word(table + index * 8u);
+				std::uint32_t offset = word(table + index * 8u + 4u);
+				if( !fits(offset, std::uint64_t{length} + 1u) || bytes[std::size_t{offset} + length] != std::byte{0} ) {
+					failCatalog(path, "a string past the end or not ended with NUL");
+				}
+			}
+		}
+		for(std::uint32_t index=0u; index<hashSize; ++index) {
+			if( word(hashOffset + index * 4u) > messagesCount ) {
+				failCatalog(path, "a hash table entry past the strings table");
+			}
+		}
+		templates = std::make_shared<Templates>(messagesCount);
+	}
+	
+	struct Catalog::Templates {
+		std::uint32_t count;
+		///indexed like messages, `nullptr` for translations not parsed yet
+		std::unique_ptr<std::atomic<const CompiledTemplate*>[]> built;
+		UntranslatedTemplates untranslated;
+		
+		explicit Templates(std::uint32_t messagesCount): 
+			count{messagesCount}, built{std::make_unique<std::atomic<const CompiledTemplate*>[]>(messagesCount)} {}
+		Templates(const Templates&) = delete;
+		
+		~Templates() {
+			for(std::uint32_t index=0u; index<count; ++index) {
+				delete built[index].load();
+			}
+		}
+	};
+	
+	std::shared_ptr<const CompiledTemplate> Catalog::compiled(std::uint32_t index) const {
+		auto* ready = templates->built[index].load(std::memory_order_acquire);
+		if( ready == nullptr ) {
+			//the template copies the translation, so it doesn't depend on the mapping
+			auto made = std::make_unique<const CompiledTemplate>(string(translationsOffset, index), *theLocale);
+			const CompiledTemplate* expected = nullptr;
+			//another thread may have made it first
+			if( templates->built[index].compare_exchange_strong(expected, made.get(), std::memory_order_acq_rel, std::memory_order_acquire) ) {
+				ready = made.release();
+			} else {
+				ready = expected;
+			}
+		}
+		//the template lives as long as any copy of the catalog
+		return std::shared_ptr<const CompiledTemplate>(templates, ready);
+	}
+	
+	std::uint32_t Catalog::word(std::size_t offset) const {
+		std::uint32_t value;
+		std::memcpy(&value, bytes.data() + offset, sizeof(value));
+		return swapped ? swapBytes(value) : value;
+	}
+	
+	std::string_view Catalog::string(std::uint32_t tableOffset, std::uint32_t index) const {
+		std::uint32_t length = word(tableOffset + index * 8u);
+		std::uint32_t offset = word(tableOffset + index * 8u + 4u);
+		std::string_view result{reinterpret_cast<const char*>(bytes.data() + offset), length};
+		//plural messages keep their forms after NULs
+		return result.substr(0u, result.find('\0'));
+	}
+	
+	std::uint32_t Catalog::indexOf(std::string_view key) const {
+		if( hashSize == 0u ) {
+			//the originals are sorted like by `strcmp`
+			std::uint32_t low = 0u, high = messagesCount;
+			while( low < high ) {
+				std::uint32_t middle = low + (high - low) / 2u;
+				auto original = string(originalsOffset, middle);
+				int order = std::char_traits<char>::compare(
+					original.data(), key.data(), std::min(original.size(), key.size())
+				);
+				if( order == 0 ) {
+					if( original.size() == key.size() ) {
+						return middle;
+					}
+					order = original.size() < key.size() ? -1 : 1;
+				}
+				if( order < 0 ) {
+					low = middle + 1u;
+				} else {
+					high = middle;
+				}
+			}
+			return messagesCount;
+		}
+		
+		std::uint32_t hash = hashString(key);
+		std::uint32_t index = hash % hashSize;
+		std::uint32_t step = 1u + hash % (hashSize - 2u);
+		//an empty slot ends the probe sequence and the table always has one
+		for(std::uint32_t probes=0u; probes<hashSize; ++probes) {
+			std::uint32_t entry = word(hashOffset + index * 4u);
+			if( entry == 0u ) {
+				break;
+			}
+			//entries count messages from 1
+			if( string(originalsOffset, entry - 1u) == key ) {
+				return entry - 1u;
+			}
+			index = nextProbe(index, step, hashSize);
+		}
+		return messagesCount;
+	}
+	
+	locale::Locale& Catalog::getLocale() const {
+		return *theLocale;
+	}
+	
+	std::size_t Catalog::size() const {
+		return messagesCount;
+	}
+	
+	std::string_view Catalog::original(std::size_t index) const {
+		return string(originalsOffset, static_cast<std::uint32_t>(index));
+	}
+	
+	std::string_view Catalog::translation(std::size_t index) const {
+		return string(translationsOffset, static_cast<std::uint32_t>(index));
+	}
+	
+	std::optional<std::string_view> Catalog::find(std::string_view msgid) const {
+		std::uint32_t index = indexOf(msgid);
+		if( index == messagesCount ) {
+			return std::nullopt;
+		}
+		return string(translationsOffset, index);
+	}
+	
+	std::optional<std::string_view> Catalog::find(std::string_view context, std::string_view msgid) const {
+		std::uint32_t index = indexOf( contextKey(context, msgid) );
+		if( index == messagesCount ) {
+			return std::nullopt;
+		}
+		return string(translationsOffset, index);
+	}
+	
+	Template Catalog::translate(std::string_view msgid) const {
+		std::uint32_t index = indexOf(msgid);
+		if( index == messagesCount ) {
+			return Template{templates->untranslated.get(msgid, *theLocale)};
+		}
+		return Template{compiled(index)};
+	}
+	
+	Template Catalog::translate(std::string_view msgid, const preparse::TemplateSyntax& untranslated) const {
+		std::uint32_t index = indexOf(msgid);
+		if( index == messagesCount ) {
+			return Template{untranslated, *theLocale};
+		}
+		return Template{compiled(index)};
+	}
+	
+	//------------- Template catalogs
+	// A template catalog starts with its header, then come tables of messages, the hash table (indexes
+	// of messages counted from 1, like in .mo files), tables of instructions, choices and variable names
+	// and at the end a pool of texts. Texts are given by their offsets in the pool and sizes, all other
+	// offsets are from the start of the file. Numbers are written in the byte order of the machine
+	// which made the file.
+	
+	///not in an anonymous namespace, as `TemplateCatalog::State` keeps the header
+	namespace layout {
+		
+		struct TextRef {
+			std::uint32_t offset;
+			std::uint32_t size;
+		};
+		
+		struct CatalogHeader {
+			char magic[4];
+			std::uint16_t version;
+			std::uint16_t byteOrder;
+			std::uint32_t fileSize;
+			///the number of plural forms of the locale, which index the choices of plural functions
+			std::uint32_t pluralsCount;
+			TextRef localeName;
+			std::uint32_t messagesCount;
+			std::uint32_t messagesOffset;
+			std::uint32_t hashSize;
+			std::uint32_t hashOffset;
+			std::uint32_t instructionsCount;
+			std::uint32_t instructionsOffset;
+			std::uint32_t choicesCount;
+			std::uint32_t choicesOffset;
+			std::uint32_t namesCount;
+			std::uint32_t namesOffset;
+			std::uint32_t stringsSize;
+			std::uint32_t stringsOffset;
+			std::uint32_t reserved[2];
+		};
+	
+	};
+	
+	namespace {
+		
+		constexpr char TEMPLATE_CATALOG_MAGIC[4] = {'M', 'L', 'S', 'C'};
+		///a file of the other byte order reads it as `0x0201`
+		constexpr std::uint16_t BYTE_ORDER_MARK = 0x0102u;
+		
+		using layout::TextRef;
+		using layout::CatalogHeader;
+		
+		struct MessageRecord {
+			TextRef key;
+			TextRef gender;
+			///ranges of the instructions, choices and names tables
+			std::uint32_t firstInstruction;
+			std::uint32_t instructionsCount;
+			std::uint32_t firstChoice;
+			std::uint32_t choicesCount;
+			std::uint32_t firstName;
+			std::uint32_t namesCount;
+		};
+		
+		///an `Instruction` with texts in the pool
+		struct InstructionRecord {
+			std::uint8_t code;
+			std::uint8_t reserved;
+			std::int16_t precision;
+			///a range of the message's choices
+			std::uint32_t firstChoice;
+			std::uint32_t choicesCount;
+			///an index of the message's names, `VariableSlot::NONE` for texts
+			std::uint32_t slot;
+			TextRef text;
+			TextRef argument;
+			///the name of the number format, empty if there is none
+			TextRef format;
+		};
+		
+		struct ChoiceRecord {
+			TextRef key;
+			TextRef text;
+		};
+		
+		static_assert(sizeof(CatalogHeader) == 80u && sizeof(MessageRecord) == 40u && sizeof(InstructionRecord) == 40u, "Template catalogs have a fixed layout");
+		
+		bool isPrime(std::uint32_t number) {
+			if( number < 2u ) {
+				return false;
+			}
+			for(std::uint32_t divisor=2u; divisor * divisor <= number; ++divisor) {
+				if( number % divisor == 0u ) {
+					return false;
+				}
+			}
+			return true;
+		}
+	
+	};
+	
+	struct TemplateCatalog::State {
+		std::shared_ptr<const MappedFile> file;
+		std::span<const std::byte> bytes;
+		CatalogHeader header;
+		locale::Locale *theLocale;
+		///templates made so far, indexed like messages
+		std::unique_ptr<std::atomic<const CompiledTemplate*>[]> built;
+		mutable UntranslatedTemplates untranslated;
+		
+		State() = default;
+		State(const State&) = delete;
+		
+		~State() {
+			if( built != nullptr ) {
+				for(std::uint32_t index=0u; index<header.messagesCount; ++index) {
+					delete built[index].load();
+				}
+			}
+		}
+		
+		template<typename Record>
+		Record record(std::uint32_t tableOffset, std::uint32_t index) const {
+			Record result;
+			std::memcpy(&result, bytes.data() + tableOffset + std::size_t{index} * sizeof(Record), sizeof(Record));
+			return result;
+		}
+		
+		std::string_view text(TextRef ref) const {
+			return std::string_view{reinterpret_cast<const char*>(bytes.data() + header.stringsOffset + ref.offset), ref.size};
+		}
+		
+		///the index of `key`, `messagesCount` if it's not in the catalog
+		std::uint32_t indexOf(std::string_view key) const {
+			std::uint32_t hash = hashString(key);
+			std::uint32_t index = hash % header.hashSize;
+			std::uint32_t step = 1u + hash % (header.hashSize - 2u);
+			for(std::uint32_t probes=0u; probes<header.hashSize; ++probes) {
+				std::uint32_t entry = record<std::uint32_t>(header.hashOffset, index);
+				if( entry == 0u ) {
+					break;
+				}
+				if( text(record<MessageRecord>(header.messagesOffset, entry - 1u).key) == key ) {
+					return entry - 1u;
+				}
+				index = nextProbe(index, step, header.hashSize);
+			}
+			return header.messagesCount;
+		}
+		
+		///makes the template of a message once, all records were checked when the file was opened
+		const CompiledTemplate& compiled(std::uint32_t index) const {
+			if( auto* ready = built[index].load(std::memory_order_acquire) ) {
+				return *ready;
+			}
+			auto message = record<MessageRecord>(header.messagesOffset, index);
+			std::vector<Instruction> program;
+			program.reserve(message.instructionsCount);
+			for(std::uint32_t i=0u; i<message.instructionsCount; ++i) {
+				auto step = record<InstructionRecord>(header.instructionsOffset, message.firstInstruction + i);
+				program.push_back( Instruction{
+					static_cast<Instruction::Code>(step.code), step.precision, step.firstChoice, step.choicesCount, step.slot,
+					text(step.text), text(step.argument),
+					step.format.size == 0u ? nullptr : theLocale->getNumberFormat( text(step.format) )
+				} );
+			}
+			std::vector<Choice> choices;
+			choices.reserve(message.choicesCount);
+			for(std::uint32_t i=0u; i<message.choicesCount; ++i) {
+				auto choice = record<ChoiceRecord>(header.choicesOffset, message.firstChoice + i);
+				choices.push_back( Choice{text(choice.key), text(choice.text)} );
+			}
+			std::vector<std::string_view> names;
+			names.reserve(message.namesCount);
+			for(std::uint32_t i=0u; i<message.namesCount; ++i) {
+				names.push_back( text(record<TextRef>(header.namesOffset, message.firstName + i)) );
+			}
+			
+			auto made = std::make_unique<const CompiledTemplate>(
+				*theLocale, text(message.gender), std::move(program), std::move(choices), std::move(names)
+			);
+			const CompiledTemplate* expected = nullptr;
+			//another thread may have made it first
+			if( built[index].compare_exchange_strong(expected, made.get(), std::memory_order_acq_rel, std::memory_order_acquire) ) {
+				return *made.release();
+			}
+			return *expected;
+		}
+	};
+	
+	TemplateCatalog::TemplateCatalog(const std::string& path) {
+		auto newState = std::make_shared<State>();
+		newState->file = MappedFile::open(path);
+		if( newState->file == nullptr ) {
+			throw InvalidCatalog("Can't open and map the catalog \"" + path + "\"");
+		}
+		auto& bytes = newState->bytes;
+		auto& header = newState->header;
+		bytes = newState->file->bytes();
+		if( bytes.size() < sizeof(CatalogHeader) ) {
+			failCatalog(path, "too short");
+		}
+		std::memcpy(&header, bytes.data(), sizeof(header));
+		if( std::memcmp(header.magic, TEMPLATE_CATALOG_MAGIC, sizeof(TEMPLATE_CATALOG_MAGIC)) != 0 ) {
+			failCatalog(path, "not a template catalog");
+		}
+		if( header.byteOrder != BYTE_ORDER_MARK ) {
+			failCatalog(path, "written on a machine with another byte order");
+		}
+		if( header.version != TEMPLATE_CATALOG_VERSION ) {
+			failCatalog(path, "version " + std::to_string(header.version) + " instead of " + std::to_string(TEMPLATE_CATALOG_VERSION));
+		}
+		if( header.fileSize != bytes.size() ) {
+			failCatalog(path, "the file's size doesn't match its header");
+		}
+		auto checkTable = [&](std::uint32_t offset, std::uint32_t count, std::size_t recordSize) {
+			if( std::uint64_t{offset} + std::uint64_t{count} * recordSize > bytes.size() ) {
+				failCatalog(path, "a table past the end of the file");
+			}
+		};
+		checkTable(header.messagesOffset, header.messagesCount, sizeof(MessageRecord));
+		checkTable(header.hashOffset, header.hashSize, sizeof(std::uint32_t));
+		checkTable(header.instructionsOffset, header.instructionsCount, sizeof(InstructionRecord));
+		checkTable(header.choicesOffset, header.choicesCount, sizeof(ChoiceRecord));
+		checkTable(header.namesOffset, header.namesCount, sizeof(TextRef));
+		checkTable(header.stringsOffset, header.stringsSize, 1u);
+		if( !isPrime(header.hashSize) || header.hashSize < 3u ) {
+			failCatalog(path, "the hash table's size isn't a prime");
+		}
 		
-		for(i=0u; i<functionsList.size(); ++i) {
-			if( stringsList[i] != nullptr ) {
-				output << stringsList[i];
+		//rendering trusts the records, so all of them are checked once here
+		auto checkText = [&](TextRef ref) {
+			if( std::uint64_t{ref.offset} + ref.size > header.stringsSize ) {
+				failCatalog(path, "a text past the texts pool");
 			}
-			if( functionsList[i] != nullptr ) {
-				output << functionsList[i]->produceString(variables);
+		};
+		auto checkRange = [&](std::uint32_t first, std::uint32_t count, std::uint32_t tableSize) {
+			if( std::uint64_t{first} + count > tableSize ) {
+				failCatalog(path, "a range past its table");
+			}
+		};
+		checkText(header.localeName);
+		newState->theLocale = locale::findLocale( newState->text(header.localeName) );
+		if( newState->theLocale == nullptr ) {
+			failCatalog(path, "unknown locale \"" + std::string{newState->text(header.localeName)} + "\"");
+		}
+		auto& theLocale = *newState->theLocale;
+		if( header.pluralsCount != theLocale.getPluralsList().size() ) {
+			failCatalog(path, "compiled for other plural forms of the locale");
+		}
+		for(std::uint32_t index=0u; index<header.hashSize; ++index) {
+			if( newState->record<std::uint32_t>(header.hashOffset, index) > header.messagesCount ) {
+				failCatalog(path, "a hash table entry past the messages");
+			}
+		}
+		for(std::uint32_t index=0u; index<header.messagesCount; ++index) {
+			auto message = newState->record<MessageRecord>(header.messagesOffset, index);
+			checkText(message.key);
+			checkText(message.gender);
+			checkRange(message.firstInstruction, message.instructionsCount, header.instructionsCount);
+			checkRange(message.firstChoice, message.choicesCount, header.choicesCount);
+			checkRange(message.firstName, message.namesCount, header.namesCount);
+			
+			for(std::uint32_t i=0u; i<message.instructionsCount; ++i) {
+				auto step = newState->record<InstructionRecord>(header.instructionsOffset, message.firstInstruction + i);
+				using Code = Instruction::Code;
+				auto code = static_cast<Code>(step.code);
+				if( step.code > static_cast<std::uint8_t>(Code::REAL_FORMAT) ) {
+					failCatalog(path, "an unknown instruction");
+				}
+				checkText(step.text);
+				checkText(step.argument);
+				checkText(step.format);
+				checkRange(step.firstChoice, step.choicesCount, message.choicesCount);
+				if( code != Code::EMIT_LITERAL && step.slot >= message.namesCount ) {
+					failCatalog(path, "an instruction uses a variable past the names");
+				}
+				if( code == Code::PLURAL_SELECT && step.choicesCount != header.pluralsCount ) {
+					failCatalog(path, "plural choices don't match the plural forms");
+				}
+				if( code == Code::GENDER_SELECT && step.choicesCount != theLocale.getGendersList().size() ) {
+					failCatalog(path, "gender choices don't match the genders");
+				}
+				if( code == Code::CASE_WRITE && step.choicesCount != theLocale.getCasesList().size() ) {
+					failCatalog(path, "case choices don't match the cases");
+				}
+				if( (code == Code::INT_FORMAT || code == Code::REAL_FORMAT) && theLocale.getNumberFormat( newState->text(step.format) ) == nullptr ) {
+					failCatalog(path, "unknown number format \"" + std::string{newState->text(step.format)} + "\"");
+				}
 			}
 		}
-		//the last string
-		if( stringsList[i] != nullptr ) {
-			output << stringsList[i];
+		for(std::uint32_t index=0u; index<header.choicesCount; ++index) {
+			auto choice = newState->record<ChoiceRecord>(header.choicesOffset, index);
+			checkText(choice.key);
+			checkText(choice.text);
+		}
+		for(std::uint32_t index=0u; index<header.namesCount; ++index) {
+			checkText( newState->record<TextRef>(header.namesOffset, index) );
 		}
 		
-		//clear variables data
-		variables.clear();
-		
-		//return the result
-		return output.str();
+		newState->built = std::make_unique<std::atomic<const CompiledTemplate*>[]>(header.messagesCount);
+		state = std::move(newState);
 	}
 	
-	std::string Template::getGender() {
-		return genderID;
+	locale::Locale& TemplateCatalog::getLocale() const {
+		return *state->theLocale;
 	}
 	
-	//------------- Methods for functions classes
+	std::size_t TemplateCatalog::size() const {
+		return state->header.messagesCount;
+	}
 	
-	std::string VariablePutter::produceString(std::map<std::string_view, variableValue> &variables) {
-		if( !variables.contains(variable) ) {
-			//error
-			#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
-			throw InvalidTemplateState("The variable doesn't exists: " + variable);
-			#else
-			return "";
-			#endif
-		}
-		
-		auto content = variables.at(variable);
-		
-		if( std::holds_alternative<std::string_view>(content) ) {
-			//raw strings are returned as is
-			auto sv = std::get<std::string_view>(content);
-			char* sc = new char[sv.size()+1];
-			sv.copy(sc, sv.size());
-			sc[sv.size()] = '\0';
-			std::string result{sc};
-			delete[] sc;
-			
-			return result;
-		}
-		
-		if( std::holds_alternative<Template*>(content) ) {
-			return std::get<Template*>(content)->get();
+	std::shared_ptr<const CompiledTemplate> TemplateCatalog::find(std::string_view msgid) const {
+		std::uint32_t index = state->indexOf(msgid);
+		if( index == state->header.messagesCount ) {
+			return nullptr;
 		}
-		
-		//simple number formating
-		if( std::holds_alternative<long>(content) ) {
-			return std::to_string(
-				std::get<long>(content)
-			);
+		//the template lives as long as the catalog's state
+		return std::shared_ptr<const CompiledTemplate>(state, &state->compiled(index));
+	}
+	
+	std::shared_ptr<const CompiledTemplate> TemplateCatalog::find(std::string_view context, std::string_view msgid) const {
+		return find( contextKey(context, msgid) );
+	}
+	
+	Template TemplateCatalog::translate(std::string_view msgid) const {
+		auto compiled = find(msgid);
+		if( compiled == nullptr ) {
+			return Template{state->untranslated.get(msgid, *state->theLocale)};
 		}
-		
-		if( std::holds_alternative<double>(content) ) {
-			return std::to_string(
-				std::get<double>(content)
-			);
+		return Template{std::move(compiled)};
+	}
+	
+	Template TemplateCatalog::translate(std::string_view msgid, const preparse::TemplateSyntax& untranslated) const {
+		auto compiled = find(msgid);
+		if( compiled == nullptr ) {
+			return Template{untranslated, *state->theLocale};
 		}
-		
-		//other types of data are incompatible with this function
-		#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
-		throw InvalidTemplateState("Unsupported type of data for variable: " + variable);
-		#else
-		return "";
-		#endif
+		return Template{std::move(compiled)};
 	}
 	
-	GenderFunction::GenderFunction(
-		std::string &&varName,
-		std::vector<std::string> &listOfOutputs,
-		const locale::Locale &locale
-	):variable{varName} {
-		std::size_t i;
+	namespace {
+		
+		///texts of a template catalog, each written once
+		class TextsPool {
+				std::string pool;
+				std::map<std::string, std::uint32_t, std::less<>> offsets;
+			public:
+				TextRef add(std::string_view text) {
+					if( text.empty() ) {
+						return TextRef{0u, 0u};
+					}
+					auto found = offsets.find(text);
+					if( found == offsets.end() ) {
+						found = offsets.emplace(std::string{text}, static_cast<std::uint32_t>(pool.size())).first;
+						pool.append(text);
+					}
+					return TextRef{found->second, static_cast<std::uint32_t>(text.size())};
+				}
+				
+				const std::string& getPool() const {
+					return pool;
+				}
+		};
 		
-		if( listOfOutputs.size() != locale.getGendersList().size() ) {
-			throw InvalidTemplateState("Invalid list of genders");
+		template<typename Record>
+		std::uint32_t appendTable(std::vector<std::byte>& output, const std::vector<Record>& records) {
+			const std::size_t start = output.size();
+			output.resize(start + records.size() * sizeof(Record));
+			std::memcpy(output.data() + start, records.data(), records.size() * sizeof(Record));
+			return static_cast<std::uint32_t>(start);
 		}
 		
-		for(i=0u; i<listOfOutputs.size(); ++i) {
-			outputTexts.emplace(
-				locale.getGendersList()[i],
-				listOfOutputs[i]
-			);
+		///the name of a number format of the locale
+		std::string_view formatName(const locale::Locale& locale, const locale::NumberFormat* format) {
+			for(auto& named : locale.getNumberFormats()) {
+				if( &named.format == format ) {
+					return named.name;
+				}
+			}
+			return std::string_view{};
 		}
-	}
 	
-	GenderFunction::GenderFunction(
-		std::string &&varName,
-		std::map<std::string, std::string> &mapOfOutputs
-	):variable{varName} {
-		outputTexts = std::move(mapOfOutputs);
-	}
+	};
 	
-	std::string GenderFunction::produceString(std::map<std::string_view, variableValue> &variables) {
-		if( !variables.contains(variable) ) {
-			//error
-			#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
-			throw InvalidTemplateState("The variable doesn't exists: " + variable);
-			#else
-			return "";
-			#endif
-		}
+	void writeTemplateCatalog(
+		const std::string& path, 
+		locale::Locale& locale, 
+		const std::vector<std::pair<std::string, std::string>>& messages
+	) {
+		TextsPool texts;
+		std::vector<MessageRecord> messageRecords;
+		std::vector<InstructionRecord> instructions;
+		std::vector<ChoiceRecord> choices;
+		std::vector<TextRef> names;
 		
-		auto content = variables.at(variable);
+		std::uint32_t hashSize = static_cast<std::uint32_t>(messages.size() + messages.size() / 3u + 3u);
+		while( !isPrime(hashSize) ) {
+			++hashSize;
+		}
+		std::vector<std::uint32_t> hashTable(hashSize, 0u);
+		///keys of the records
+		std::vector<std::string_view> keys;
 		
-		if( std::holds_alternative<Template*>(content) ) {
-			auto subTemplateGender = std::get<Template*>(content)->getGender();
+		for(auto& [key, translation] : messages) {
+			std::uint32_t hash = hashString(key);
+			std::uint32_t slot = hash % hashSize;
+			std::uint32_t step = 1u + hash % (hashSize - 2u);
+			while( hashTable[slot] != 0u && keys[hashTable[slot] - 1u] != key ) {
+				slot = nextProbe(slot, step, hashSize);
+			}
+			if( hashTable[slot] != 0u ) {
+				//the first of repeated keys wins
+				continue;
+			}
 			
-			if( !outputTexts.contains(subTemplateGender) ) {
-				//error
-				#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
-				throw InvalidTemplateState("Unknown gender: " + subTemplateGender);
-				#else
-				return "";
-				#endif
+			auto compiledPtr = compileTranslation(key, translation, locale);
+			const CompiledTemplate& compiled = *compiledPtr;
+			MessageRecord message{};
+			message.key = texts.add(key);
+			message.gender = texts.add(compiled.getGender());
+			message.firstInstruction = static_cast<std::uint32_t>(instructions.size());
+			message.instructionsCount = static_cast<std::uint32_t>(compiled.getProgram().size());
+			message.firstChoice = static_cast<std::uint32_t>(choices.size());
+			message.choicesCount = static_cast<std::uint32_t>(compiled.getChoices().size());
+			message.firstName = static_cast<std::uint32_t>(names.size());
+			message.namesCount = static_cast<std::uint32_t>(compiled.getVariableNames().size());
+			for(auto& instruction : compiled.getProgram()) {
+				InstructionRecord record{};
+				record.code = static_cast<std::uint8_t>(instruction.code);
+				record.precision = instruction.precision;
+				record.firstChoice = instruction.firstChoice;
+				record.choicesCount = instruction.choicesCount;
+				record.slot = instruction.slot;
+				record.text = texts.add(instruction.text);
+				record.argument = texts.add(instruction.argument);
+				record.format = texts.add( formatName(locale, instruction.format) );
+				instructions.push_back(record);
+			}
+			for(auto& choice : compiled.getChoices()) {
+				choices.push_back( ChoiceRecord{texts.add(choice.key), texts.add(choice.text)} );
+			}
+			for(auto name : compiled.getVariableNames()) {
+				names.push_back( texts.add(name) );
 			}
 			
-			return outputTexts[subTemplateGender];
+			messageRecords.push_back(message);
+			keys.push_back(key);
+			//entries count messages from 1
+			hashTable[slot] = static_cast<std::uint32_t>(messageRecords.size());
 		}
 		
-		//other types are incompatible with this function
-		#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
-		throw InvalidTemplateState("Unsupported type of the variable");
-		#else
-		return "";
-		#endif
-	}
-	
-	CaseWriterFunction::CaseWriterFunction(
-		std::vector<std::string> &listOfOutputs,
-		const locale::Locale &locale
-	) {
-		if( listOfOutputs.size() != locale.getCasesList().size() ) {
-			throw InvalidTemplateState("Invalid list of cases");
-		}
+		CatalogHeader header{};
+		std::memcpy(header.magic, TEMPLATE_CATALOG_MAGIC, sizeof(TEMPLATE_CATALOG_MAGIC));
+		header.version = TEMPLATE_CATALOG_VERSION;
+		header.byteOrder = BYTE_ORDER_MARK;
+		header.pluralsCount = static_cast<std::uint32_t>(locale.getPluralsList().size());
+		header.localeName = texts.add(locale.getName());
+		std::vector<std::byte> output(sizeof(CatalogHeader));
+		header.messagesCount = static_cast<std::uint32_t>(messageRecords.size());
+		header.messagesOffset = appendTable(output, messageRecords);
+		header.hashSize = hashSize;
+		header.hashOffset = appendTable(output, hashTable);
+		header.instructionsCount = static_cast<std::uint32_t>(instructions.size());
+		header.instructionsOffset = appendTable(output, instructions);
+		header.choicesCount = static_cast<std::uint32_t>(choices.size());
+		header.choicesOffset = appendTable(output, choices);
+		header.namesCount = static_cast<std::uint32_t>(names.size());
+		header.namesOffset = appendTable(output, names);
+		auto& pool = texts.getPool();
+		header.stringsSize = static_cast<std::uint32_t>(pool.size());
+		header.stringsOffset = static_cast<std::uint32_t>(output.size());
+		output.resize(output.size() + pool.size());
+		std::memcpy(output.data() + header.stringsOffset, pool.data(), pool.size());
+		header.fileSize = static_cast<std::uint32_t>(output.size());
+		std::memcpy(output.data(), &header, sizeof(header));
 		
-		for(std::size_t i=0u; i<listOfOutputs.size(); ++i) {
-			outputTexts.emplace(
-				locale.getCasesList()[i],
-				listOfOutputs[i]
-			);
+		std::FILE* file = std::fopen(path.c_str(), "wb");
+		if( file == nullptr ) {
+			throw InvalidCatalog("Can't write the template catalog \"" + path + "\"");
+		}
+		const bool written = std::fwrite(output.data(), 1u, output.size(), file) == output.size();
+		if( std::fclose(file) != 0 || !written ) {
+			throw InvalidCatalog("Can't write the template catalog \"" + path + "\"");
 		}
 	}
 	
-	CaseWriterFunction::CaseWriterFunction(
-		std::map<std::string, std::string> &mapOfOutputs
-	) {
-		outputTexts = std::move(mapOfOutputs);
-	}
+	//------------- Sets of catalogs
 	
-	std::string CaseWriterFunction::produceString(std::map<std::string_view, variableValue> &variables) {
-		if( !variables.contains("__CASE__") ) {
-			//not an error
-			return "";
-		}
-		
-		auto content = variables.at("__CASE__");
-		
-		if( std::holds_alternative<std::string_view>(content) ) {
-			auto sv = std::get<std::string_view>(content);
-			
-			for(auto&[key, value] : outputTexts) {
-				if( key == sv ) {
-					return value;
+	CatalogSet::CatalogSet(std::string localeDir): 
+		folder{std::move(localeDir)}, untranslated{std::make_shared<UntranslatedTemplates>()} {}
+	
+	void CatalogSet::add(const std::string& domain, locale::Locale& locale) {
+		std::string localeName{locale.getName()};
+		//`pl_PL` falls back to `pl`
+		for(auto& localeFolder : {localeName, localeName.substr(0u, localeName.find('_'))}) {
+			auto messagesFolder = std::filesystem::path{folder} / localeFolder / "LC_MESSAGES";
+			auto compiledPath = messagesFolder / (domain + ".mlsc");
+			if( std::filesystem::exists(compiledPath) ) {
+				TemplateCatalog templates{compiledPath.string()};
+				if( &templates.getLocale() != &locale ) {
+					throw InvalidCatalog("The template catalog \"" + compiledPath.string() + "\" is compiled for another locale");
 				}
+				catalogs.push_back( Entry{domain, &locale, std::nullopt, std::move(templates)} );
+				return;
+			}
+			auto messagesPath = messagesFolder / (domain + ".mo");
+			if( std::filesystem::exists(messagesPath) ) {
+				catalogs.push_back( Entry{domain, &locale, Catalog{messagesPath.string(), locale}, std::nullopt} );
+				return;
 			}
-			//other cases are errors
-			#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
-			throw InvalidTemplateState("Wrong case");
-			#else
-			return "";
-			#endif
 		}
-		//other types of data are errors
-		#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
-		throw InvalidTemplateState("Unsupported type of the __CASE__ variable");
-		#else
-		return "";
-		#endif
+		throw InvalidCatalog("No catalog of \"" + domain + "\" for the locale \"" + localeName + "\" in \"" + folder + "\"");
 	}
 	
-	CaseChooserFunction::CaseChooserFunction(
-		std::string &&varName,
-		std::string &&case_id
-	):variable{varName}, caseID{case_id} { }
-	
-	std::string CaseChooserFunction::produceString(std::map<std::string_view, variableValue> &variables) {
-		if( !variables.contains(variable) ) {
-			//error
-			#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
-			throw InvalidTemplateState("The variable doesn't exists: " + variable);
-			#else
-			return "";
-			#endif
-		}
-		
-		auto content = variables.at(variable);
-		
-		if( std::holds_alternative<Template*>(content) ) {
-			return std::get<Template*>(content)->apply("__CASE__", caseID).get();
+	const CatalogSet::Entry* CatalogSet::findEntry(std::string_view domain, const locale::Locale& locale) const {
+		for(auto& entry : catalogs) {
+			if( entry.theLocale == &locale && entry.domain == domain ) {
+				return &entry;
+			}
 		}
-		
-		//other types of data are incompatible with this function
-		#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
-		throw InvalidTemplateState("Invalid type of variable: " + variable);
-		#else
-		return "";
-		#endif
+		return nullptr;
 	}
 	
-	PluralFunction::PluralFunction(
-		std::string &&varName,
-		std::vector<std::string> listOfOutputs,
-		const locale::Locale &locale
-	):variable{varName}, theLocale{locale} {
-		if( listOfOutputs.size() != locale.getPluralsList().size() ) {
-			throw InvalidTemplateState("Wrong number of arguments");
-		}
-		
-		for(std::size_t i=0u; i<listOfOutputs.size(); ++i) {
-			outputTexts.emplace(
-				locale.getPluralsList()[i],
-				listOfOutputs[i]
-			);
-		}
+	const Catalog* CatalogSet::find(std::string_view domain, const locale::Locale& locale) const {
+		auto* entry = findEntry(domain, locale);
+		return entry != nullptr && entry->messages.has_value() ? &*entry->messages : nullptr;
 	}
 	
-	PluralFunction::PluralFunction(
-		std::string &&varName,
-		std::map<std::string, std::string> &mapOfOutputs,
-		const locale::Locale &locale
-	):variable{varName}, theLocale{locale} {
-		outputTexts = std::move(mapOfOutputs);
+	const TemplateCatalog* CatalogSet::findCompiled(std::string_view domain, const locale::Locale& locale) const {
+		auto* entry = findEntry(domain, locale);
+		return entry != nullptr && entry->templates.has_value() ? &*entry->templates : nullptr;
 	}
 	
-	std::string PluralFunction::produceString(std::map<std::string_view, variableValue> &variables) {
-		if( !variables.contains(variable) ) {
-			//error
-			#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
-			throw InvalidTemplateState("The variable doesn't exists: " + variable);
-			#else
-			return "";
-			#endif
-		}
-		
-		long number;
-		auto content = variables.at(variable);
-		if( std::holds_alternative<long>(content) ) {
-			number = std::get<long>(content);
-		} else if( std::holds_alternative<double>(content) ) {
-			//keep only the integer part
-			number = static_cast<long>(std::get<double>(content));
-		} else {
-			//error
-			#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
-			throw InvalidTemplateState("Invalid type of the variable: " + variable);
-			#else
-			return "";
-			#endif
+	Template CatalogSet::translate(std::string_view domain, locale::Locale& locale, std::string_view msgid) const {
+		auto* entry = findEntry(domain, locale);
+		if( entry == nullptr ) {
+			return Template{untranslated->get(msgid, locale)};
 		}
-		
-		if( number < 0 ) number *= -1;
-		
-		std::string pluralID = theLocale.getPluralID(number);
-		if( ! outputTexts.contains(pluralID) ) {
-			#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
-			throw InvalidTemplateState("Unknown plural type: " + pluralID);
-			#else
-			return "";
-			#endif
-		} else {
-			return outputTexts[pluralID];
+		if( entry->templates.has_value() ) {
+			return entry->templates->translate(msgid);
 		}
+		return entry->messages->translate(msgid);
 	}
 	
-	IntegerFormaterFunction::IntegerFormaterFunction(
-		std::string &&varName,
-		std::string &formatName,
-		locale::Locale &theLocale
-	):variable{varName}, formater{*(theLocale.getNumberFormat(formatName))} {}
-	
-	std::string IntegerFormaterFunction::produceString(std::map<std::string_view, variableValue> &variables) {
-		if( !variables.contains(variable) ) {
-			//error
-			#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
-			throw InvalidTemplateState("The variable doesn't exists: " + variable);
-			#else
-			return "";
-			#endif
+	Template CatalogSet::translate(
+		std::string_view domain, 
+		locale::Locale& locale, 
+		std::string_view msgid, 
+		const preparse::TemplateSyntax& untranslated
+	) const {
+		auto* entry = findEntry(domain, locale);
+		if( entry == nullptr ) {
+			return Template{untranslated, locale};
 		}
-		
-		long number;
-		auto content = variables.at(variable);
-		
-		if( std::holds_alternative<long>(content) ) {
-			number = std::get<long>(content);
-		} else if( std::holds_alternative<double>(content) ) {
-			//keep only the integer part
-			number = static_cast<long>(std::get<double>(content));
-		} else {
-			#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
-			throw InvalidTemplateState("The variable has improper content: " + variable);
-			#else
-			return "";
-			#endif
+		if( entry->templates.has_value() ) {
+			return entry->templates->translate(msgid, untranslated);
 		}
+		return entry->messages->translate(msgid, untranslated);
+	}
+
+};
+
+namespace mls {
+	
+	namespace {
 		
-		return formater.formatInteger(number);
+		thread_local const TranslationContext* installedContext = nullptr;
+	
+	};
+	
+	TranslationContext::TranslationContext(locale::Locale& locale, const backend::CatalogSet& catalogs, std::string domain):
+		theLocale{&locale}, theCatalogs{&catalogs}, defaultDomain{std::move(domain)} {}
+	
+	locale::Locale& TranslationContext::getLocale() const {
+		return *theLocale;
 	}
 	
-	bool RealFormaterFunction::isAllNumber(std::string &str) {
-		//IMPORTANT: we don check for *negative* numbers
-		for(auto c : str) {
-			if( !std::isdigit(c) ) {
-				return false;
-			}
-		}
-		return true;
+	const backend::CatalogSet& TranslationContext::getCatalogs() const {
+		return *theCatalogs;
 	}
 	
-	RealFormaterFunction::RealFormaterFunction(
-		std::string &&varName,
-		std::vector<std::string> &listOfOptions,
-		locale::Locale &theLocale
-	):variable{varName} {
-		formater = nullptr;
-		if( listOfOptions.size() == 1u ) {
-			//only formater
-			formater = theLocale.getNumberFormat(listOfOptions[0]);
-			precision = -1;
-		} else if( listOfOptions.size() == 2u ) {
-			//formater and precision
-			formater = theLocale.getNumberFormat(listOfOptions[0]);
-			if( ! isAllNumber(listOfOptions[1]) ) {
-				throw InvalidTemplateState("Invalid precision: " + listOfOptions[1]);
-			} else {
-				precision = static_cast<short>(std::stoi(listOfOptions[1]));
-			}
-		}
-		
-		if( formater == nullptr ) {
-			throw InvalidTemplateState("Unknow formater type");
-		}
+	std::string_view TranslationContext::getDomain() const {
+		return defaultDomain;
 	}
 	
-	RealFormaterFunction::RealFormaterFunction(
-		std::string &&varName,
-		std::map<std::string, std::string> &hashOfOptions,
-		locale::Locale &theLocale
-	):variable{varName} {
-		formater = nullptr;
-		if( hashOfOptions.contains("format") ) {
-			formater = theLocale.getNumberFormat(hashOfOptions["format"]);
-		} else {
-			formater = theLocale.getNumberFormat("general");
-		}
-		
-		precision = -1;
-		if( hashOfOptions.contains("prec") ) {
-			if( isAllNumber(hashOfOptions["prec"]) ) {
-				precision = static_cast<short>(
-					std::stoi(hashOfOptions["prec"])
-				);
-			} else {
-				throw InvalidTemplateState("Invalid number for precision: " + hashOfOptions["prec"]);
-			}
-		}
-		
-		if( formater == nullptr ) {
-			throw InvalidTemplateState("Unknown formater type");
-		}
+	TranslationContextGuard::TranslationContextGuard(const TranslationContext& context): previous{installedContext} {
+		installedContext = &context;
 	}
 	
-	std::string RealFormaterFunction::produceString(std::map<std::string_view, variableValue> &variables) {
-		if( !variables.contains(variable) ) {
-			//error
-			#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
-			throw InvalidTemplateState("The variable doesn't exists: " + variable);
-			#else
-			return "";
-			#endif
-		}
-		
-		double number;
-		auto content = variables.at(variable);
-		
-		if( std::holds_alternative<double>(content) ) {
-			number = std::get<double>(content);
-		} else if( std::holds_alternative<long>(content) ) {
-			//keep only the integer part
-			number = static_cast<double>(std::get<long>(content));
-		} else {
-			#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
-			throw InvalidTemplateState("The variable has improper content: " + variable);
-			#else
-			return "";
-			#endif
-		}
-		
-		return formater->formatReal(number, precision);
+	TranslationContextGuard::~TranslationContextGuard() {
+		installedContext = previous;
+	}
+	
+	const TranslationContext* currentTranslationContext() {
+		return installedContext;
+	}
+	
+	Template translate(const TranslationContext& context, std::string_view msgid) {
+		return context.getCatalogs().translate(context.getDomain(), context.getLocale(), msgid);
+	}
+	
+	Template translate(const TranslationContext& context, std::string_view msgid, const preparse::TemplateSyntax& untranslated) {
+		return context.getCatalogs().translate(context.getDomain(), context.getLocale(), msgid, untranslated);
+	}
+	
+	Template translate(const TranslationContext& context, std::string_view domain, std::string_view msgid) {
+		return context.getCatalogs().translate(domain, context.getLocale(), msgid);
+	}
+	
+	Template translate(
+		const TranslationContext& context, 
+		std::string_view domain, 
+		std::string_view msgid, 
+		const preparse::TemplateSyntax& untranslated
+	) {
+		return context.getCatalogs().translate(domain, context.getLocale(), msgid, untranslated);
 	}
+
 };
 
 
 
+#ifndef MULANSTR_TRANSLATION_CACHE_SIZE
+#	define MULANSTR_TRANSLATION_CACHE_SIZE 512
+#endif
+
 namespace mls::backend {
 	
 	locale::Locale *defaultLocale = nullptr;
 	
-	locale::Locale *getLocaleFromName(std::string_view searchLocaleName) {
-		static std::map<std::string, std::vector<std::string>> LOCALES{
-			//English - United Kingdom
-			{"en_GB", {"en_GB","en-GB","English_United Kingdom"}},
-			//English - American
-			{"en_US", {"en_US","en-US","English_United States"}},
-			//Polish
-			{"pl_PL", {"pl_PL","pl-PL","Polish_Poland"}}
-		};
-		
-		//Search for supported locales
-		for(auto&[locale_name, locale_list] : LOCALES) {
-			for(auto& some_locale_name : locale_list) {
-				if( some_locale_name == searchLocaleName ) {
-					return &(locale::getLocale(locale_name));
+	/**
+	 * @brief Parsed templates keyed by (domain, msgid, locale)
+	 * 
+	 * Keeps at most `capacity` templates and drops the least recently used ones.
+	 * All methods are guarded by a mutex, so it can be used from many threads.
+	 */
+	class TemplateCache {
+		private:
+			struct Entry {
+				std::string domain;
+				std::string msgid;
+				const locale::Locale *theLocale;
+				std::shared_ptr<const CompiledTemplate> parsed;
+			};
+			///views into an entry's strings, so a lookup doesn't allocate
+			struct Key {
+				std::string_view domain;
+				std::string_view msgid;
+				const locale::Locale *theLocale;
+				
+				bool operator==(const Key& other) const = default;
+			};
+			struct KeyHash {
+				std::size_t operator()(const Key& key) const {
+					std::size_t hash = std::hash<std::string_view>{}(key.domain);
+					hash ^= std::hash<std::string_view>{}(key.msgid) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+					hash ^= std::hash<const locale::Locale*>{}(key.theLocale) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+					return hash;
+				}
+			};
+			
+			std::mutex guard;
+			//the most recently used entry is at the front
+			std::list<Entry> entries;
+			std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index;
+			CacheStats stats;
+			
+			void trim() {
+				while( entries.size() > stats.capacity ) {
+					auto& last = entries.back();
+					index.erase( Key{last.domain, last.msgid, last.theLocale} );
+					entries.pop_back();
+					++stats.evictions;
 				}
+				stats.size = entries.size();
 			}
-		}
-		//unable to find the locale
-		return nullptr;
+		public:
+			TemplateCache(): stats{0u, 0u, 0u, 0u, MULANSTR_TRANSLATION_CACHE_SIZE} {}
+			
+			///returns `nullptr` if the template isn't cached
+			std::shared_ptr<const CompiledTemplate> find(std::string_view domain, std::string_view msgid, const locale::Locale &theLocale) {
+				std::lock_guard<std::mutex> lock{guard};
+				auto found = index.find( Key{domain, msgid, &theLocale} );
+				if( found == index.end() ) {
+					++stats.misses;
+					return nullptr;
+				}
+				++stats.hits;
+				entries.splice(entries.begin(), entries, found->second);
+				return found->second->parsed;
+			}
+			
+			///returns the cached template, which may be other than `parsed` if another thread was faster
+			std::shared_ptr<const CompiledTemplate> insert(
+				std::string_view domain, 
+				std::string_view msgid, 
+				const locale::Locale &theLocale, 
+				std::shared_ptr<const CompiledTemplate> parsed
+			) {
+				std::lock_guard<std::mutex> lock{guard};
+				if( stats.capacity == 0u ) {
+					return parsed;
+				}
+				auto found = index.find( Key{domain, msgid, &theLocale} );
+				if( found != index.end() ) {
+					return found->second->parsed;
+				}
+				entries.push_front( Entry{std::string{domain}, std::string{msgid}, &theLocale, std::move(parsed)} );
+				auto& entry = entries.front();
+				index.emplace( Key{entry.domain, entry.msgid, entry.theLocale}, entries.begin() );
+				trim();
+				return entry.parsed;
+			}
+			
+			void setCapacity(std::size_t capacity) {
+				std::lock_guard<std::mutex> lock{guard};
+				stats.capacity = capacity;
+				trim();
+			}
+			
+			CacheStats getStats() {
+				std::lock_guard<std::mutex> lock{guard};
+				return stats;
+			}
+			
+			void clear() {
+				std::lock_guard<std::mutex> lock{guard};
+				index.clear();
+				entries.clear();
+				stats = CacheStats{0u, 0u, 0u, 0u, stats.capacity};
+			}
+	};
+	
+	TemplateCache& templateCache() {
+		static TemplateCache cache;
+		return cache;
+	}
+	
+	void setCacheCapacity(std::size_t capacity) {
+		templateCache().setCapacity(capacity);
+	}
+	
+	CacheStats getCacheStats() {
+		return templateCache().getStats();
+	}
+	
+	void clearCache() {
+		templateCache().clear();
 	}
 	
 	void init(const char* packageName, const char* wantedLocale, const char* folderLookup) {
@@ -1816,7 +6103,7 @@ namespace mls::backend {
 			correctLocale.remove_suffix( correctLocale.size() - at );
 		}
 		
-		defaultLocale = getLocaleFromName(correctLocale);
+		defaultLocale = locale::findLocale(correctLocale);
 		if( defaultLocale == nullptr ) {//unable to find supported locale?
 			defaultLocale = &(locale::getLocale("en_US"));//fallback to English
 			setlocale(LC_ALL, "C");//Force non-translated strings
@@ -1830,26 +6117,71 @@ namespace mls::backend {
 		
 		bind_textdomain_codeset(packageName, "utf-8");
 		textdomain(packageName);
+		
+		//translations may have changed
+		clearCache();
 	}
-	
+
 };
 
 namespace mls {
 	
 	Template translate(const char* msgid) {
+		if( auto* context = currentTranslationContext() ) {
+			return translate(*context, msgid);
+		}
 		if( backend::defaultLocale == nullptr ) {
 			throw backend::IntlNotInitialized();
 		}
-		return Template{std::string{ gettext(msgid) }, *backend::defaultLocale};
+		return translate(textdomain(nullptr), msgid);
 	}
 	
 	Template translate(const char* catalog, const char* msgid) {
+		if( auto* context = currentTranslationContext() ) {
+			return catalog == nullptr ? translate(*context, msgid) : translate(*context, catalog, msgid);
+		}
 		if( backend::defaultLocale == nullptr ) {
 			throw backend::IntlNotInitialized();
 		}
-		return Template{std::string{ dgettext(catalog, msgid) }, *backend::defaultLocale};
+		if( catalog == nullptr ) {
+			catalog = textdomain(nullptr);
+		}
+		auto& cache = backend::templateCache();
+		auto parsed = cache.find(catalog, msgid, *backend::defaultLocale);
+		if( parsed == nullptr ) {
+			parsed = cache.insert(
+				catalog, msgid, *backend::defaultLocale,
+				std::make_shared<const CompiledTemplate>(dgettext(catalog, msgid), *backend::defaultLocale)
+			);
+		}
+		return Template{std::move(parsed)};
 	}
 	
+	Template translate(const char* catalog, const char* msgid, const preparse::TemplateSyntax& untranslated) {
+		if( auto* context = currentTranslationContext() ) {
+			return catalog == nullptr ? translate(*context, msgid, untranslated) : translate(*context, catalog, msgid, untranslated);
+		}
+		if( backend::defaultLocale == nullptr ) {
+			throw backend::IntlNotInitialized();
+		}
+		if( catalog == nullptr ) {
+			catalog = textdomain(nullptr);
+		}
+		auto& cache = backend::templateCache();
+		auto parsed = cache.find(catalog, msgid, *backend::defaultLocale);
+		if( parsed == nullptr ) {
+			const char* translated = dgettext(catalog, msgid);
+			//GetText returns the very same pointer when there's no translation
+			parsed = cache.insert(
+				catalog, msgid, *backend::defaultLocale,
+				translated == msgid
+					? std::make_shared<const CompiledTemplate>(untranslated, *backend::defaultLocale)
+					: std::make_shared<const CompiledTemplate>(translated, *backend::defaultLocale)
+			);
+		}
+		return Template{std::move(parsed)};
+	}
+
 };
 
 
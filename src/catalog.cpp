@@ -0,0 +1,948 @@
+/**
+ * @file catalog.cpp
+ * @brief GetText `.mo` catalogs read from memory-mapped files, without libintl
+ * 
+ */
+
+#include "catalog.h"
+#include "errors.h"
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <mutex>
+
+//CUT-START
+
+namespace mls::backend {
+	
+	namespace {
+		
+		constexpr std::uint32_t MO_MAGIC = 0x950412deu;
+		constexpr std::uint32_t MO_MAGIC_SWAPPED = 0xde120495u;
+		///separates `msgctxt` from `msgid` in keys of the catalog
+		constexpr char CONTEXT_SEPARATOR = '\x04';
+		
+		//offsets of the fields of the .mo header
+		constexpr std::size_t REVISION_FIELD = 4u;
+		constexpr std::size_t COUNT_FIELD = 8u;
+		constexpr std::size_t ORIGINALS_FIELD = 12u;
+		constexpr std::size_t TRANSLATIONS_FIELD = 16u;
+		constexpr std::size_t HASH_SIZE_FIELD = 20u;
+		constexpr std::size_t HASH_OFFSET_FIELD = 24u;
+		constexpr std::size_t HEADER_SIZE = 28u;
+		
+		std::uint32_t swapBytes(std::uint32_t value) {
+			return (value >> 24) | ((value >> 8) & 0xff00u) | ((value << 8) & 0xff0000u) | (value << 24);
+		}
+		
+		///the `hashpjw` function GetText uses to build the hash tables of .mo files
+		std::uint32_t hashString(std::string_view key) {
+			std::uint32_t hash = 0u;
+			for(unsigned char c : key) {
+				hash = (hash << 4) + c;
+				std::uint32_t high = hash & 0xf0000000u;
+				if( high != 0u ) {
+					hash ^= high >> 24;
+					hash ^= high;
+				}
+			}
+			return hash;
+		}
+		
+		///the key of a message in a `msgctxt` context
+		std::string contextKey(std::string_view context, std::string_view msgid) {
+			std::string key;
+			key.reserve(context.size() + 1u + msgid.size());
+			key.append(context).append(1u, CONTEXT_SEPARATOR).append(msgid);
+			return key;
+		}
+		
+		/**
+		 * @brief The next slot of the probe sequence of a hash table like in .mo files
+		 * 
+		 * `tableSize` is a prime, so the sequence visits all slots
+		 */
+		std::uint32_t nextProbe(std::uint32_t index, std::uint32_t step, std::uint32_t tableSize) {
+			return index >= tableSize - step ? index - (tableSize - step) : index + step;
+		}
+		
+		[[noreturn]] void failCatalog(const std::string& path, const std::string& reason) {
+			throw InvalidCatalog("Broken catalog \"" + path + "\": " + reason);
+		}
+		
+		[[noreturn]] void failTranslation(std::string_view msgid, const std::string& reason) {
+			throw InvalidCatalog("Invalid translation of \"" + std::string{msgid} + "\": " + reason);
+		}
+		
+		/**
+		 * @brief Compiles a translation for a template catalog, throws `mls::InvalidCatalog` if it's invalid
+		 * 
+		 * Run time parsing skips invalid tags, so the syntax is checked with the grammar first.
+		 */
+		std::unique_ptr<CompiledTemplate> compileTranslation(std::string_view msgid, std::string_view translation, locale::Locale& locale) {
+			preparse::TagSyntax tag;
+			const char* syntaxError = preparse::scan_template(translation,
+				[](std::string_view) {},
+				[&tag](std::string_view content) {
+					return preparse::parse_tag(content, tag, [](std::string_view, std::string_view) {});
+				}
+			);
+			if( syntaxError != nullptr ) {
+				failTranslation(msgid, syntaxError);
+			}
+			std::unique_ptr<CompiledTemplate> compiled;
+			try {
+				compiled = std::make_unique<CompiledTemplate>(translation, locale);
+			} catch(const InvalidTemplateState& error) {
+				failTranslation(msgid, error.what());
+			}
+			if( !compiled->getError().empty() ) {
+				failTranslation(msgid, std::string{compiled->getError()});
+			}
+			return compiled;
+		}
+	
+	};
+	
+	/**
+	 * @brief Templates of message ids which have no translation, parsed once per locale
+	 * 
+	 * They stay as long as the catalog keeping them. Guarded by a mutex, so it can be used from many threads.
+	 */
+	class UntranslatedTemplates {
+		private:
+			std::mutex guard;
+			std::map<const locale::Locale*, std::map<std::string, std::shared_ptr<const CompiledTemplate>, std::less<>>> parsed;
+		public:
+			std::shared_ptr<const CompiledTemplate> get(std::string_view msgid, locale::Locale& theLocale) {
+				{
+					std::lock_guard<std::mutex> lock{guard};
+					auto& templates = parsed[&theLocale];
+					if( auto found = templates.find(msgid); found != templates.end() ) {
+						return found->second;
+					}
+				}
+				//parsed without the lock, another thread may put its template first
+				auto made = std::make_shared<const CompiledTemplate>(msgid, theLocale);
+				std::lock_guard<std::mutex> lock{guard};
+				return parsed[&theLocale].try_emplace(std::string{msgid}, std::move(made)).first->second;
+			}
+	};
+	
+	Catalog::Catalog(const std::string& path, locale::Locale& locale): theLocale{&locale} {
+		file = MappedFile::open(path);
+		if( file == nullptr ) {
+			throw InvalidCatalog("Can't open and map the catalog \"" + path + "\"");
+		}
+		bytes = file->bytes();
+		if( bytes.size() < HEADER_SIZE ) {
+			failCatalog(path, "too short");
+		}
+		
+		std::uint32_t magic;
+		std::memcpy(&magic, bytes.data(), sizeof(magic));
+		if( magic != MO_MAGIC && magic != MO_MAGIC_SWAPPED ) {
+			failCatalog(path, "not a .mo file");
+		}
+		swapped = magic == MO_MAGIC_SWAPPED;
+		//only the major revisions 0 and 1 are known
+		if( (word(REVISION_FIELD) >> 16) > 1u ) {
+			failCatalog(path, "unknown revision");
+		}
+		messagesCount = word(COUNT_FIELD);
+		originalsOffset = word(ORIGINALS_FIELD);
+		translationsOffset = word(TRANSLATIONS_FIELD);
+		hashSize = word(HASH_SIZE_FIELD);
+		hashOffset = word(HASH_OFFSET_FIELD);
+		//the probe step needs a modulus above 0, GetText writes primes anyway
+		if( hashSize < 3u ) {
+			hashSize = 0u;
+		}
+		
+		auto fits = [this](std::uint64_t offset, std::uint64_t size) {
+			return offset + size <= bytes.size();
+		};
+		if( !fits(originalsOffset, std::uint64_t{messagesCount} * 8u) || !fits(translationsOffset, std::uint64_t{messagesCount} * 8u) ) {
+			failCatalog(path, "a strings table past the end");
+		}
+		if( !fits(hashOffset, std::uint64_t{hashSize} * 4u) ) {
+			failCatalog(path, "the hash table past the end");
+		}
+		//lookups trust the tables, so all of them are checked once here
+		for(auto table : {originalsOffset, translationsOffset}) {
+			for(std::uint32_t index=0u; index<messagesCount; ++index) {
+				std::uint32_t length = word(table + index * 8u);
+				std::uint32_t offset = word(table + index * 8u + 4u);
+				if( !fits(offset, std::uint64_t{length} + 1u) || bytes[std::size_t{offset} + length] != std::byte{0} ) {
+					failCatalog(path, "a string past the end or not ended with NUL");
+				}
+			}
+		}
+		for(std::uint32_t index=0u; index<hashSize; ++index) {
+			if( word(hashOffset + index * 4u) > messagesCount ) {
+				failCatalog(path, "a hash table entry past the strings table");
+			}
+		}
+		templates = std::make_shared<Templates>(messagesCount);
+	}
+	
+	struct Catalog::Templates {
+		std::uint32_t count;
+		///indexed like messages, `nullptr` for translations not parsed yet
+		std::unique_ptr<std::atomic<const CompiledTemplate*>[]> built;
+		UntranslatedTemplates untranslated;
+		
+		explicit Templates(std::uint32_t messagesCount): 
+			count{messagesCount}, built{std::make_unique<std::atomic<const CompiledTemplate*>[]>(messagesCount)} {}
+		Templates(const Templates&) = delete;
+		
+		~Templates() {
+			for(std::uint32_t index=0u; index<count; ++index) {
+				delete built[index].load();
+			}
+		}
+	};
+	
+	std::shared_ptr<const CompiledTemplate> Catalog::compiled(std::uint32_t index) const {
+		auto* ready = templates->built[index].load(std::memory_order_acquire);
+		if( ready == nullptr ) {
+			//the template copies the translation, so it doesn't depend on the mapping
+			auto made = std::make_unique<const CompiledTemplate>(string(translationsOffset, index), *theLocale);
+			const CompiledTemplate* expected = nullptr;
+			//another thread may have made it first
+			if( templates->built[index].compare_exchange_strong(expected, made.get(), std::memory_order_acq_rel, std::memory_order_acquire) ) {
+				ready = made.release();
+			} else {
+				ready = expected;
+			}
+		}
+		//the template lives as long as any copy of the catalog
+		return std::shared_ptr<const CompiledTemplate>(templates, ready);
+	}
+	
+	std::uint32_t Catalog::word(std::size_t offset) const {
+		std::uint32_t value;
+		std::memcpy(&value, bytes.data() + offset, sizeof(value));
+		return swapped ? swapBytes(value) : value;
+	}
+	
+	std::string_view Catalog::string(std::uint32_t tableOffset, std::uint32_t index) const {
+		std::uint32_t length = word(tableOffset + index * 8u);
+		std::uint32_t offset = word(tableOffset + index * 8u + 4u);
+		std::string_view result{reinterpret_cast<const char*>(bytes.data() + offset), length};
+		//plural messages keep their forms after NULs
+		return result.substr(0u, result.find('\0'));
+	}
+	
+	std::uint32_t Catalog::indexOf(std::string_view key) const {
+		if( hashSize == 0u ) {
+			//the originals are sorted like by `strcmp`
+			std::uint32_t low = 0u, high = messagesCount;
+			while( low < high ) {
+				std::uint32_t middle = low + (high - low) / 2u;
+				auto original = string(originalsOffset, middle);
+				int order = std::char_traits<char>::compare(
+					original.data(), key.data(), std::min(original.size(), key.size())
+				);
+				if( order == 0 ) {
+					if( original.size() == key.size() ) {
+						return middle;
+					}
+					order = original.size() < key.size() ? -1 : 1;
+				}
+				if( order < 0 ) {
+					low = middle + 1u;
+				} else {
+					high = middle;
+				}
+			}
+			return messagesCount;
+		}
+		
+		std::uint32_t hash = hashString(key);
+		std::uint32_t index = hash % hashSize;
+		std::uint32_t step = 1u + hash % (hashSize - 2u);
+		//an empty slot ends the probe sequence and the table always has one
+		for(std::uint32_t probes=0u; probes<hashSize; ++probes) {
+			std::uint32_t entry = word(hashOffset + index * 4u);
+			if( entry == 0u ) {
+				break;
+			}
+			//entries count messages from 1
+			if( string(originalsOffset, entry - 1u) == key ) {
+				return entry - 1u;
+			}
+			index = nextProbe(index, step, hashSize);
+		}
+		return messagesCount;
+	}
+	
+	locale::Locale& Catalog::getLocale() const {
+		return *theLocale;
+	}
+	
+	std::size_t Catalog::size() const {
+		return messagesCount;
+	}
+	
+	std::string_view Catalog::original(std::size_t index) const {
+		return string(originalsOffset, static_cast<std::uint32_t>(index));
+	}
+	
+	std::string_view Catalog::translation(std::size_t index) const {
+		return string(translationsOffset, static_cast<std::uint32_t>(index));
+	}
+	
+	std::optional<std::string_view> Catalog::find(std::string_view msgid) const {
+		std::uint32_t index = indexOf(msgid);
+		if( index == messagesCount ) {
+			return std::nullopt;
+		}
+		return string(translationsOffset, index);
+	}
+	
+	std::optional<std::string_view> Catalog::find(std::string_view context, std::string_view msgid) const {
+		std::uint32_t index = indexOf( contextKey(context, msgid) );
+		if( index == messagesCount ) {
+			return std::nullopt;
+		}
+		return string(translationsOffset, index);
+	}
+	
+	Template Catalog::translate(std::string_view msgid) const {
+		std::uint32_t index = indexOf(msgid);
+		if( index == messagesCount ) {
+			return Template{templates->untranslated.get(msgid, *theLocale)};
+		}
+		return Template{compiled(index)};
+	}
+	
+	Template Catalog::translate(std::string_view msgid, const preparse::TemplateSyntax& untranslated) const {
+		std::uint32_t index = indexOf(msgid);
+		if( index == messagesCount ) {
+			return Template{untranslated, *theLocale};
+		}
+		return Template{compiled(index)};
+	}
+	
+	//------------- Template catalogs
+	// A template catalog starts with its header, then come tables of messages, the hash table (indexes
+	// of messages counted from 1, like in .mo files), tables of instructions, choices and variable names
+	// and at the end a pool of texts. Texts are given by their offsets in the pool and sizes, all other
+	// offsets are from the start of the file. Numbers are written in the byte order of the machine
+	// which made the file.
+	
+	///not in an anonymous namespace, as `TemplateCatalog::State` keeps the header
+	namespace layout {
+		
+		struct TextRef {
+			std::uint32_t offset;
+			std::uint32_t size;
+		};
+		
+		struct CatalogHeader {
+			char magic[4];
+			std::uint16_t version;
+			std::uint16_t byteOrder;
+			std::uint32_t fileSize;
+			///the number of plural forms of the locale, which index the choices of plural functions
+			std::uint32_t pluralsCount;
+			TextRef localeName;
+			std::uint32_t messagesCount;
+			std::uint32_t messagesOffset;
+			std::uint32_t hashSize;
+			std::uint32_t hashOffset;
+			std::uint32_t instructionsCount;
+			std::uint32_t instructionsOffset;
+			std::uint32_t choicesCount;
+			std::uint32_t choicesOffset;
+			std::uint32_t namesCount;
+			std::uint32_t namesOffset;
+			std::uint32_t stringsSize;
+			std::uint32_t stringsOffset;
+			std::uint32_t reserved[2];
+		};
+	
+	};
+	
+	namespace {
+		
+		constexpr char TEMPLATE_CATALOG_MAGIC[4] = {'M', 'L', 'S', 'C'};
+		///a file of the other byte order reads it as `0x0201`
+		constexpr std::uint16_t BYTE_ORDER_MARK = 0x0102u;
+		
+		using layout::TextRef;
+		using layout::CatalogHeader;
+		
+		struct MessageRecord {
+			TextRef key;
+			TextRef gender;
+			///ranges of the instructions, choices and names tables
+			std::uint32_t firstInstruction;
+			std::uint32_t instructionsCount;
+			std::uint32_t firstChoice;
+			std::uint32_t choicesCount;
+			std::uint32_t firstName;
+			std::uint32_t namesCount;
+		};
+		
+		///an `Instruction` with texts in the pool
+		struct InstructionRecord {
+			std::uint8_t code;
+			std::uint8_t reserved;
+			std::int16_t precision;
+			///a range of the message's choices
+			std::uint32_t firstChoice;
+			std::uint32_t choicesCount;
+			///an index of the message's names, `VariableSlot::NONE` for texts
+			std::uint32_t slot;
+			TextRef text;
+			TextRef argument;
+			///the name of the number format, empty if there is none
+			TextRef format;
+		};
+		
+		struct ChoiceRecord {
+			TextRef key;
+			TextRef text;
+		};
+		
+		static_assert(sizeof(CatalogHeader) == 80u && sizeof(MessageRecord) == 40u && sizeof(InstructionRecord) == 40u, "Template catalogs have a fixed layout");
+		
+		bool isPrime(std::uint32_t number) {
+			if( number < 2u ) {
+				return false;
+			}
+			for(std::uint32_t divisor=2u; divisor * divisor <= number; ++divisor) {
+				if( number % divisor == 0u ) {
+					return false;
+				}
+			}
+			return true;
+		}
+	
+	};
+	
+	struct TemplateCatalog::State {
+		std::shared_ptr<const MappedFile> file;
+		std::span<const std::byte> bytes;
+		CatalogHeader header;
+		locale::Locale *theLocale;
+		///templates made so far, indexed like messages
+		std::unique_ptr<std::atomic<const CompiledTemplate*>[]> built;
+		mutable UntranslatedTemplates untranslated;
+		
+		State() = default;
+		State(const State&) = delete;
+		
+		~State() {
+			if( built != nullptr ) {
+				for(std::uint32_t index=0u; index<header.messagesCount; ++index) {
+					delete built[index].load();
+				}
+			}
+		}
+		
+		template<typename Record>
+		Record record(std::uint32_t tableOffset, std::uint32_t index) const {
+			Record result;
+			std::memcpy(&result, bytes.data() + tableOffset + std::size_t{index} * sizeof(Record), sizeof(Record));
+			return result;
+		}
+		
+		std::string_view text(TextRef ref) const {
+			return std::string_view{reinterpret_cast<const char*>(bytes.data() + header.stringsOffset + ref.offset), ref.size};
+		}
+		
+		///the index of `key`, `messagesCount` if it's not in the catalog
+		std::uint32_t indexOf(std::string_view key) const {
+			std::uint32_t hash = hashString(key);
+			std::uint32_t index = hash % header.hashSize;
+			std::uint32_t step = 1u + hash % (header.hashSize - 2u);
+			for(std::uint32_t probes=0u; probes<header.hashSize; ++probes) {
+				std::uint32_t entry = record<std::uint32_t>(header.hashOffset, index);
+				if( entry == 0u ) {
+					break;
+				}
+				if( text(record<MessageRecord>(header.messagesOffset, entry - 1u).key) == key ) {
+					return entry - 1u;
+				}
+				index = nextProbe(index, step, header.hashSize);
+			}
+			return header.messagesCount;
+		}
+		
+		///makes the template of a message once, all records were checked when the file was opened
+		const CompiledTemplate& compiled(std::uint32_t index) const {
+			if( auto* ready = built[index].load(std::memory_order_acquire) ) {
+				return *ready;
+			}
+			auto message = record<MessageRecord>(header.messagesOffset, index);
+			std::vector<Instruction> program;
+			program.reserve(message.instructionsCount);
+			for(std::uint32_t i=0u; i<message.instructionsCount; ++i) {
+				auto step = record<InstructionRecord>(header.instructionsOffset, message.firstInstruction + i);
+				program.push_back( Instruction{
+					static_cast<Instruction::Code>(step.code), step.precision, step.firstChoice, step.choicesCount, step.slot,
+					text(step.text), text(step.argument),
+					step.format.size == 0u ? nullptr : theLocale->getNumberFormat( text(step.format) )
+				} );
+			}
+			std::vector<Choice> choices;
+			choices.reserve(message.choicesCount);
+			for(std::uint32_t i=0u; i<message.choicesCount; ++i) {
+				auto choice = record<ChoiceRecord>(header.choicesOffset, message.firstChoice + i);
+				choices.push_back( Choice{text(choice.key), text(choice.text)} );
+			}
+			std::vector<std::string_view> names;
+			names.reserve(message.namesCount);
+			for(std::uint32_t i=0u; i<message.namesCount; ++i) {
+				names.push_back( text(record<TextRef>(header.namesOffset, message.firstName + i)) );
+			}
+			
+			auto made = std::make_unique<const CompiledTemplate>(
+				*theLocale, text(message.gender), std::move(program), std::move(choices), std::move(names)
+			);
+			const CompiledTemplate* expected = nullptr;
+			//another thread may have made it first
+			if( built[index].compare_exchange_strong(expected, made.get(), std::memory_order_acq_rel, std::memory_order_acquire) ) {
+				return *made.release();
+			}
+			return *expected;
+		}
+	};
+	
+	TemplateCatalog::TemplateCatalog(const std::string& path) {
+		auto newState = std::make_shared<State>();
+		newState->file = MappedFile::open(path);
+		if( newState->file == nullptr ) {
+			throw InvalidCatalog("Can't open and map the catalog \"" + path + "\"");
+		}
+		auto& bytes = newState->bytes;
+		auto& header = newState->header;
+		bytes = newState->file->bytes();
+		if( bytes.size() < sizeof(CatalogHeader) ) {
+			failCatalog(path, "too short");
+		}
+		std::memcpy(&header, bytes.data(), sizeof(header));
+		if( std::memcmp(header.magic, TEMPLATE_CATALOG_MAGIC, sizeof(TEMPLATE_CATALOG_MAGIC)) != 0 ) {
+			failCatalog(path, "not a template catalog");
+		}
+		if( header.byteOrder != BYTE_ORDER_MARK ) {
+			failCatalog(path, "written on a machine with another byte order");
+		}
+		if( header.version != TEMPLATE_CATALOG_VERSION ) {
+			failCatalog(path, "version " + std::to_string(header.version) + " instead of " + std::to_string(TEMPLATE_CATALOG_VERSION));
+		}
+		if( header.fileSize != bytes.size() ) {
+			failCatalog(path, "the file's size doesn't match its header");
+		}
+		auto checkTable = [&](std::uint32_t offset, std::uint32_t count, std::size_t recordSize) {
+			if( std::uint64_t{offset} + std::uint64_t{count} * recordSize > bytes.size() ) {
+				failCatalog(path, "a table past the end of the file");
+			}
+		};
+		checkTable(header.messagesOffset, header.messagesCount, sizeof(MessageRecord));
+		checkTable(header.hashOffset, header.hashSize, sizeof(std::uint32_t));
+		checkTable(header.instructionsOffset, header.instructionsCount, sizeof(InstructionRecord));
+		checkTable(header.choicesOffset, header.choicesCount, sizeof(ChoiceRecord));
+		checkTable(header.namesOffset, header.namesCount, sizeof(TextRef));
+		checkTable(header.stringsOffset, header.stringsSize, 1u);
+		if( !isPrime(header.hashSize) || header.hashSize < 3u ) {
+			failCatalog(path, "the hash table's size isn't a prime");
+		}
+		
+		//rendering trusts the records, so all of them are checked once here
+		auto checkText = [&](TextRef ref) {
+			if( std::uint64_t{ref.offset} + ref.size > header.stringsSize ) {
+				failCatalog(path, "a text past the texts pool");
+			}
+		};
+		auto checkRange = [&](std::uint32_t first, std::uint32_t count, std::uint32_t tableSize) {
+			if( std::uint64_t{first} + count > tableSize ) {
+				failCatalog(path, "a range past its table");
+			}
+		};
+		checkText(header.localeName);
+		newState->theLocale = locale::findLocale( newState->text(header.localeName) );
+		if( newState->theLocale == nullptr ) {
+			failCatalog(path, "unknown locale \"" + std::string{newState->text(header.localeName)} + "\"");
+		}
+		auto& theLocale = *newState->theLocale;
+		if( header.pluralsCount != theLocale.getPluralsList().size() ) {
+			failCatalog(path, "compiled for other plural forms of the locale");
+		}
+		for(std::uint32_t index=0u; index<header.hashSize; ++index) {
+			if( newState->record<std::uint32_t>(header.hashOffset, index) > header.messagesCount ) {
+				failCatalog(path, "a hash table entry past the messages");
+			}
+		}
+		for(std::uint32_t index=0u; index<header.messagesCount; ++index) {
+			auto message = newState->record<MessageRecord>(header.messagesOffset, index);
+			checkText(message.key);
+			checkText(message.gender);
+			checkRange(message.firstInstruction, message.instructionsCount, header.instructionsCount);
+			checkRange(message.firstChoice, message.choicesCount, header.choicesCount);
+			checkRange(message.firstName, message.namesCount, header.namesCount);
+			
+			for(std::uint32_t i=0u; i<message.instructionsCount; ++i) {
+				auto step = newState->record<InstructionRecord>(header.instructionsOffset, message.firstInstruction + i);
+				using Code = Instruction::Code;
+				auto code = static_cast<Code>(step.code);
+				if( step.code > static_cast<std::uint8_t>(Code::REAL_FORMAT) ) {
+					failCatalog(path, "an unknown instruction");
+				}
+				checkText(step.text);
+				checkText(step.argument);
+				checkText(step.format);
+				checkRange(step.firstChoice, step.choicesCount, message.choicesCount);
+				if( code != Code::EMIT_LITERAL && step.slot >= message.namesCount ) {
+					failCatalog(path, "an instruction uses a variable past the names");
+				}
+				if( code == Code::PLURAL_SELECT && step.choicesCount != header.pluralsCount ) {
+					failCatalog(path, "plural choices don't match the plural forms");
+				}
+				if( code == Code::GENDER_SELECT && step.choicesCount != theLocale.getGendersList().size() ) {
+					failCatalog(path, "gender choices don't match the genders");
+				}
+				if( code == Code::CASE_WRITE && step.choicesCount != theLocale.getCasesList().size() ) {
+					failCatalog(path, "case choices don't match the cases");
+				}
+				if( (code == Code::INT_FORMAT || code == Code::REAL_FORMAT) && theLocale.getNumberFormat( newState->text(step.format) ) == nullptr ) {
+					failCatalog(path, "unknown number format \"" + std::string{newState->text(step.format)} + "\"");
+				}
+			}
+		}
+		for(std::uint32_t index=0u; index<header.choicesCount; ++index) {
+			auto choice = newState->record<ChoiceRecord>(header.choicesOffset, index);
+			checkText(choice.key);
+			checkText(choice.text);
+		}
+		for(std::uint32_t index=0u; index<header.namesCount; ++index) {
+			checkText( newState->record<TextRef>(header.namesOffset, index) );
+		}
+		
+		newState->built = std::make_unique<std::atomic<const CompiledTemplate*>[]>(header.messagesCount);
+		state = std::move(newState);
+	}
+	
+	locale::Locale& TemplateCatalog::getLocale() const {
+		return *state->theLocale;
+	}
+	
+	std::size_t TemplateCatalog::size() const {
+		return state->header.messagesCount;
+	}
+	
+	std::shared_ptr<const CompiledTemplate> TemplateCatalog::find(std::string_view msgid) const {
+		std::uint32_t index = state->indexOf(msgid);
+		if( index == state->header.messagesCount ) {
+			return nullptr;
+		}
+		//the template lives as long as the catalog's state
+		return std::shared_ptr<const CompiledTemplate>(state, &state->compiled(index));
+	}
+	
+	std::shared_ptr<const CompiledTemplate> TemplateCatalog::find(std::string_view context, std::string_view msgid) const {
+		return find( contextKey(context, msgid) );
+	}
+	
+	Template TemplateCatalog::translate(std::string_view msgid) const {
+		auto compiled = find(msgid);
+		if( compiled == nullptr ) {
+			return Template{state->untranslated.get(msgid, *state->theLocale)};
+		}
+		return Template{std::move(compiled)};
+	}
+	
+	Template TemplateCatalog::translate(std::string_view msgid, const preparse::TemplateSyntax& untranslated) const {
+		auto compiled = find(msgid);
+		if( compiled == nullptr ) {
+			return Template{untranslated, *state->theLocale};
+		}
+		return Template{std::move(compiled)};
+	}
+	
+	namespace {
+		
+		///texts of a template catalog, each written once
+		class TextsPool {
+				std::string pool;
+				std::map<std::string, std::uint32_t, std::less<>> offsets;
+			public:
+				TextRef add(std::string_view text) {
+					if( text.empty() ) {
+						return TextRef{0u, 0u};
+					}
+					auto found = offsets.find(text);
+					if( found == offsets.end() ) {
+						found = offsets.emplace(std::string{text}, static_cast<std::uint32_t>(pool.size())).first;
+						pool.append(text);
+					}
+					return TextRef{found->second, static_cast<std::uint32_t>(text.size())};
+				}
+				
+				const std::string& getPool() const {
+					return pool;
+				}
+		};
+		
+		template<typename Record>
+		std::uint32_t appendTable(std::vector<std::byte>& output, const std::vector<Record>& records) {
+			const std::size_t start = output.size();
+			output.resize(start + records.size() * sizeof(Record));
+			std::memcpy(output.data() + start, records.data(), records.size() * sizeof(Record));
+			return static_cast<std::uint32_t>(start);
+		}
+		
+		///the name of a number format of the locale
+		std::string_view formatName(const locale::Locale& locale, const locale::NumberFormat* format) {
+			for(auto& named : locale.getNumberFormats()) {
+				if( &named.format == format ) {
+					return named.name;
+				}
+			}
+			return std::string_view{};
+		}
+	
+	};
+	
+	void writeTemplateCatalog(
+		const std::string& path, 
+		locale::Locale& locale, 
+		const std::vector<std::pair<std::string, std::string>>& messages
+	) {
+		TextsPool texts;
+		std::vector<MessageRecord> messageRecords;
+		std::vector<InstructionRecord> instructions;
+		std::vector<ChoiceRecord> choices;
+		std::vector<TextRef> names;
+		
+		std::uint32_t hashSize = static_cast<std::uint32_t>(messages.size() + messages.size() / 3u + 3u);
+		while( !isPrime(hashSize) ) {
+			++hashSize;
+		}
+		std::vector<std::uint32_t> hashTable(hashSize, 0u);
+		///keys of the records
+		std::vector<std::string_view> keys;
+		
+		for(auto& [key, translation] : messages) {
+			std::uint32_t hash = hashString(key);
+			std::uint32_t slot = hash % hashSize;
+			std::uint32_t step = 1u + hash % (hashSize - 2u);
+			while( hashTable[slot] != 0u && keys[hashTable[slot] - 1u] != key ) {
+				slot = nextProbe(slot, step, hashSize);
+			}
+			if( hashTable[slot] != 0u ) {
+				//the first of repeated keys wins
+				continue;
+			}
+			
+			auto compiledPtr = compileTranslation(key, translation, locale);
+			const CompiledTemplate& compiled = *compiledPtr;
+			MessageRecord message{};
+			message.key = texts.add(key);
+			message.gender = texts.add(compiled.getGender());
+			message.firstInstruction = static_cast<std::uint32_t>(instructions.size());
+			message.instructionsCount = static_cast<std::uint32_t>(compiled.getProgram().size());
+			message.firstChoice = static_cast<std::uint32_t>(choices.size());
+			message.choicesCount = static_cast<std::uint32_t>(compiled.getChoices().size());
+			message.firstName = static_cast<std::uint32_t>(names.size());
+			message.namesCount = static_cast<std::uint32_t>(compiled.getVariableNames().size());
+			for(auto& instruction : compiled.getProgram()) {
+				InstructionRecord record{};
+				record.code = static_cast<std::uint8_t>(instruction.code);
+				record.precision = instruction.precision;
+				record.firstChoice = instruction.firstChoice;
+				record.choicesCount = instruction.choicesCount;
+				record.slot = instruction.slot;
+				record.text = texts.add(instruction.text);
+				record.argument = texts.add(instruction.argument);
+				record.format = texts.add( formatName(locale, instruction.format) );
+				instructions.push_back(record);
+			}
+			for(auto& choice : compiled.getChoices()) {
+				choices.push_back( ChoiceRecord{texts.add(choice.key), texts.add(choice.text)} );
+			}
+			for(auto name : compiled.getVariableNames()) {
+				names.push_back( texts.add(name) );
+			}
+			
+			messageRecords.push_back(message);
+			keys.push_back(key);
+			//entries count messages from 1
+			hashTable[slot] = static_cast<std::uint32_t>(messageRecords.size());
+		}
+		
+		CatalogHeader header{};
+		std::memcpy(header.magic, TEMPLATE_CATALOG_MAGIC, sizeof(TEMPLATE_CATALOG_MAGIC));
+		header.version = TEMPLATE_CATALOG_VERSION;
+		header.byteOrder = BYTE_ORDER_MARK;
+		header.pluralsCount = static_cast<std::uint32_t>(locale.getPluralsList().size());
+		header.localeName = texts.add(locale.getName());
+		std::vector<std::byte> output(sizeof(CatalogHeader));
+		header.messagesCount = static_cast<std::uint32_t>(messageRecords.size());
+		header.messagesOffset = appendTable(output, messageRecords);
+		header.hashSize = hashSize;
+		header.hashOffset = appendTable(output, hashTable);
+		header.instructionsCount = static_cast<std::uint32_t>(instructions.size());
+		header.instructionsOffset = appendTable(output, instructions);
+		header.choicesCount = static_cast<std::uint32_t>(choices.size());
+		header.choicesOffset = appendTable(output, choices);
+		header.namesCount = static_cast<std::uint32_t>(names.size());
+		header.namesOffset = appendTable(output, names);
+		auto& pool = texts.getPool();
+		header.stringsSize = static_cast<std::uint32_t>(pool.size());
+		header.stringsOffset = static_cast<std::uint32_t>(output.size());
+		output.resize(output.size() + pool.size());
+		std::memcpy(output.data() + header.stringsOffset, pool.data(), pool.size());
+		header.fileSize = static_cast<std::uint32_t>(output.size());
+		std::memcpy(output.data(), &header, sizeof(header));
+		
+		std::FILE* file = std::fopen(path.c_str(), "wb");
+		if( file == nullptr ) {
+			throw InvalidCatalog("Can't write the template catalog \"" + path + "\"");
+		}
+		const bool written = std::fwrite(output.data(), 1u, output.size(), file) == output.size();
+		if( std::fclose(file) != 0 || !written ) {
+			throw InvalidCatalog("Can't write the template catalog \"" + path + "\"");
+		}
+	}
+	
+	//------------- Sets of catalogs
+	
+	CatalogSet::CatalogSet(std::string localeDir): 
+		folder{std::move(localeDir)}, untranslated{std::make_shared<UntranslatedTemplates>()} {}
+	
+	void CatalogSet::add(const std::string& domain, locale::Locale& locale) {
+		std::string localeName{locale.getName()};
+		//`pl_PL` falls back to `pl`
+		for(auto& localeFolder : {localeName, localeName.substr(0u, localeName.find('_'))}) {
+			auto messagesFolder = std::filesystem::path{folder} / localeFolder / "LC_MESSAGES";
+			auto compiledPath = messagesFolder / (domain + ".mlsc");
+			if( std::filesystem::exists(compiledPath) ) {
+				TemplateCatalog templates{compiledPath.string()};
+				if( &templates.getLocale() != &locale ) {
+					throw InvalidCatalog("The template catalog \"" + compiledPath.string() + "\" is compiled for another locale");
+				}
+				catalogs.push_back( Entry{domain, &locale, std::nullopt, std::move(templates)} );
+				return;
+			}
+			auto messagesPath = messagesFolder / (domain + ".mo");
+			if( std::filesystem::exists(messagesPath) ) {
+				catalogs.push_back( Entry{domain, &locale, Catalog{messagesPath.string(), locale}, std::nullopt} );
+				return;
+			}
+		}
+		throw InvalidCatalog("No catalog of \"" + domain + "\" for the locale \"" + localeName + "\" in \"" + folder + "\"");
+	}
+	
+	const CatalogSet::Entry* CatalogSet::findEntry(std::string_view domain, const locale::Locale& locale) const {
+		for(auto& entry : catalogs) {
+			if( entry.theLocale == &locale && entry.domain == domain ) {
+				return &entry;
+			}
+		}
+		return nullptr;
+	}
+	
+	const Catalog* CatalogSet::find(std::string_view domain, const locale::Locale& locale) const {
+		auto* entry = findEntry(domain, locale);
+		return entry != nullptr && entry->messages.has_value() ? &*entry->messages : nullptr;
+	}
+	
+	const TemplateCatalog* CatalogSet::findCompiled(std::string_view domain, const locale::Locale& locale) const {
+		auto* entry = findEntry(domain, locale);
+		return entry != nullptr && entry->templates.has_value() ? &*entry->templates : nullptr;
+	}
+	
+	Template CatalogSet::translate(std::string_view domain, locale::Locale& locale, std::string_view msgid) const {
+		auto* entry = findEntry(domain, locale);
+		if( entry == nullptr ) {
+			return Template{untranslated->get(msgid, locale)};
+		}
+		if( entry->templates.has_value() ) {
+			return entry->templates->translate(msgid);
+		}
+		return entry->messages->translate(msgid);
+	}
+	
+	Template CatalogSet::translate(
+		std::string_view domain, 
+		locale::Locale& locale, 
+		std::string_view msgid, 
+		const preparse::TemplateSyntax& untranslated
+	) const {
+		auto* entry = findEntry(domain, locale);
+		if( entry == nullptr ) {
+			return Template{untranslated, locale};
+		}
+		if( entry->templates.has_value() ) {
+			return entry->templates->translate(msgid, untranslated);
+		}
+		return entry->messages->translate(msgid, untranslated);
+	}
+
+};
+
+namespace mls {
+	
+	namespace {
+		
+		thread_local const TranslationContext* installedContext = nullptr;
+	
+	};
+	
+	TranslationContext::TranslationContext(locale::Locale& locale, const backend::CatalogSet& catalogs, std::string domain):
+		theLocale{&locale}, theCatalogs{&catalogs}, defaultDomain{std::move(domain)} {}
+	
+	locale::Locale& TranslationContext::getLocale() const {
+		return *theLocale;
+	}
+	
+	const backend::CatalogSet& TranslationContext::getCatalogs() const {
+		return *theCatalogs;
+	}
+	
+	std::string_view TranslationContext::getDomain() const {
+		return defaultDomain;
+	}
+	
+	TranslationContextGuard::TranslationContextGuard(const TranslationContext& context): previous{installedContext} {
+		installedContext = &context;
+	}
+	
+	TranslationContextGuard::~TranslationContextGuard() {
+		installedContext = previous;
+	}
+	
+	const TranslationContext* currentTranslationContext() {
+		return installedContext;
+	}
+	
+	Template translate(const TranslationContext& context, std::string_view msgid) {
+		return context.getCatalogs().translate(context.getDomain(), context.getLocale(), msgid);
+	}
+	
+	Template translate(const TranslationContext& context, std::string_view msgid, const preparse::TemplateSyntax& untranslated) {
+		return context.getCatalogs().translate(context.getDomain(), context.getLocale(), msgid, untranslated);
+	}
+	
+	Template translate(const TranslationContext& context, std::string_view domain, std::string_view msgid) {
+		return context.getCatalogs().translate(domain, context.getLocale(), msgid);
+	}
+	
+	Template translate(
+		const TranslationContext& context, 
+		std::string_view domain, 
+		std::string_view msgid, 
+		const preparse::TemplateSyntax& untranslated
+	) {
+		return context.getCatalogs().translate(domain, context.getLocale(), msgid, untranslated);
+	}
+
+};
+
+//CUT-END
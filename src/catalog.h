@@ -0,0 +1,246 @@
+#pragma once
+#ifndef MULAN_STRING_CATALOG
+#define MULAN_STRING_CATALOG
+
+#include "mapped_file.h"
+#include "mls_locale.h"
+#include "template.h"
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+//CUT-START
+
+namespace mls::backend {
+	
+	/**
+	 * @brief A GetText `.mo` file of one domain in one locale, read in place from a memory mapping
+	 * 
+	 * Lookups use the hash table of the file and return views into the mapping. 
+	 * The catalog doesn't touch the process locale nor any state of libintl and is never changed 
+	 * after construction, so any thread can use it without locks. A translation is parsed into a template 
+	 * the first time `translate(...)` gives it, later calls share that template, like they share the template 
+	 * of a message id without a translation.
+	 */
+	class Catalog {
+		public:
+			///maps and checks the `.mo` file at `path`, throws `mls::InvalidCatalog` if it's broken
+			Catalog(const std::string& path, locale::Locale& locale);
+			
+			locale::Locale& getLocale() const;
+			///number of messages in the catalog, with the header entry
+			std::size_t size() const;
+			///the `index`-th message id in the order of the file, with its context
+			std::string_view original(std::size_t index) const;
+			///the translation of the `index`-th message, the first form for plural messages
+			std::string_view translation(std::size_t index) const;
+			
+			///the translation of `msgid`, the first form for plural messages
+			std::optional<std::string_view> find(std::string_view msgid) const;
+			///the translation of `msgid` in a `msgctxt` context
+			std::optional<std::string_view> find(std::string_view context, std::string_view msgid) const;
+			
+			///template of the translation of `msgid`, or of `msgid` itself if it has no translation
+			Template translate(std::string_view msgid) const;
+			/**
+			 * @brief Template of the translation of `msgid`, using `untranslated` if it has no translation
+			 * 
+			 * `untranslated` must be the syntax of `msgid` and live as long as the program, like `mls::literal<...>` does
+			 */
+			Template translate(std::string_view msgid, const preparse::TemplateSyntax& untranslated) const;
+		private:
+			std::shared_ptr<const MappedFile> file;
+			std::span<const std::byte> bytes;
+			locale::Locale *theLocale;
+			///the file was written with the other byte order
+			bool swapped;
+			std::uint32_t messagesCount;
+			std::uint32_t originalsOffset;
+			std::uint32_t translationsOffset;
+			std::uint32_t hashSize;
+			std::uint32_t hashOffset;
+			
+			std::uint32_t word(std::size_t offset) const;
+			///the string of the `index`-th descriptor of a table, up to its first NUL
+			std::string_view string(std::uint32_t tableOffset, std::uint32_t index) const;
+			///the index of `key`, `messagesCount` if it's not in the catalog
+			std::uint32_t indexOf(std::string_view key) const;
+			
+			///templates of translations made so far, shared by copies of the catalog
+			struct Templates;
+			std::shared_ptr<Templates> templates;
+			///the template of the `index`-th translation, parsed once
+			std::shared_ptr<const CompiledTemplate> compiled(std::uint32_t index) const;
+	};
+	
+	///version of template catalogs written by `writeTemplateCatalog(...)`
+	constexpr std::uint16_t TEMPLATE_CATALOG_VERSION = 2u;
+	
+	/**
+	 * @brief Translations of one domain compiled into templates before the program runs
+	 * 
+	 * The file, made by `writeTemplateCatalog(...)` or the `mls-catalogc` tool, is mapped into memory and 
+	 * its records are checked once when it's opened. A template is made from the records the first time 
+	 * it's used, without parsing, and its texts stay in the mapping. Like `Catalog`, it can be used by 
+	 * many threads without locks.
+	 */
+	class TemplateCatalog {
+		public:
+			///maps and checks the file at `path`, throws `mls::InvalidCatalog` if it's broken or its locale is unknown
+			explicit TemplateCatalog(const std::string& path);
+			
+			locale::Locale& getLocale() const;
+			///number of messages in the catalog
+			std::size_t size() const;
+			
+			///the compiled translation of `msgid`, `nullptr` if it isn't in the catalog
+			std::shared_ptr<const CompiledTemplate> find(std::string_view msgid) const;
+			///the compiled translation of `msgid` in a `msgctxt` context
+			std::shared_ptr<const CompiledTemplate> find(std::string_view context, std::string_view msgid) const;
+			
+			///template of the translation of `msgid`, or of `msgid` itself if it has no translation
+			Template translate(std::string_view msgid) const;
+			///as above, using `untranslated` when there is no translation
+			Template translate(std::string_view msgid, const preparse::TemplateSyntax& untranslated) const;
+		private:
+			struct State;
+			std::shared_ptr<const State> state;
+	};
+	
+	/**
+	 * @brief Compiles translations for `locale` and writes them as a template catalog
+	 * 
+	 * Keys of `messages` are message ids, with a `msgctxt` context before a `'\x04'` like in `.mo` files. 
+	 * Throws `mls::InvalidCatalog` naming the message id if a translation isn't a valid template, 
+	 * whether `MULANSTR_THROW_ON_INVALID_TEMPLATE` is defined or not, and if the file can't be written.
+	 */
+	void writeTemplateCatalog(
+		const std::string& path, 
+		locale::Locale& locale, 
+		const std::vector<std::pair<std::string, std::string>>& messages
+	);
+	
+	class UntranslatedTemplates;
+	
+	/**
+	 * @brief Catalogs of many domains and locales, found in a GetText locale folder
+	 * 
+	 * Catalogs are added while setting the program up. Afterwards the set is only read, 
+	 * so threads can translate into different locales at the same time.
+	 */
+	class CatalogSet {
+		public:
+			///`localeDir` has the usual `<locale>/LC_MESSAGES/<domain>.mo` layout
+			explicit CatalogSet(std::string localeDir);
+			
+			/**
+			 * @brief Opens the catalog of `domain` in `locale`
+			 * 
+			 * Looks for the full locale name first, then for its language only, like GetText does. 
+			 * A template catalog, `<domain>.mlsc`, is taken before a `.mo` file in the same folder. 
+			 * Throws `mls::InvalidCatalog` if no file exists or the file is broken.
+			 */
+			void add(const std::string& domain, locale::Locale& locale);
+			
+			///`nullptr` if no `.mo` catalog was added
+			const Catalog* find(std::string_view domain, const locale::Locale& locale) const;
+			///`nullptr` if no template catalog was added
+			const TemplateCatalog* findCompiled(std::string_view domain, const locale::Locale& locale) const;
+			
+			///template of the translation of `msgid` in `domain`, or of `msgid` itself if it has no translation
+			Template translate(std::string_view domain, locale::Locale& locale, std::string_view msgid) const;
+			///as above, using `untranslated` when there is no translation
+			Template translate(
+				std::string_view domain, 
+				locale::Locale& locale, 
+				std::string_view msgid, 
+				const preparse::TemplateSyntax& untranslated
+			) const;
+		private:
+			///holds one of the catalogs
+			struct Entry {
+				std::string domain;
+				const locale::Locale *theLocale;
+				std::optional<Catalog> messages;
+				std::optional<TemplateCatalog> templates;
+			};
+			std::string folder;
+			std::vector<Entry> catalogs;
+			///message ids without a catalog, shared by copies of the set
+			std::shared_ptr<UntranslatedTemplates> untranslated;
+			
+			const Entry* findEntry(std::string_view domain, const locale::Locale& locale) const;
+	};
+
+};
+
+namespace mls {
+	
+	/**
+	 * @brief Everything a translation needs: the locale, the catalogs and the domain used when none is given
+	 * 
+	 * A server makes a context for each language it serves and picks one for every request, 
+	 * either passing it to `mls::translate(...)` or installing it with `TranslationContextGuard`.
+	 */
+	class TranslationContext {
+		public:
+			///`catalogs` must live longer than the context
+			TranslationContext(locale::Locale& locale, const backend::CatalogSet& catalogs, std::string domain);
+			
+			locale::Locale& getLocale() const;
+			const backend::CatalogSet& getCatalogs() const;
+			std::string_view getDomain() const;
+		private:
+			locale::Locale *theLocale;
+			const backend::CatalogSet *theCatalogs;
+			std::string defaultDomain;
+	};
+	
+	/**
+	 * @brief Installs a context for the current thread until the guard is destroyed
+	 * 
+	 * Guards can be nested, the previous context comes back when the inner guard goes. 
+	 * With a context installed, `mls::translate(...)` of the GetText backend, and so `_(...)`, translates with it.
+	 */
+	class TranslationContextGuard {
+		public:
+			explicit TranslationContextGuard(const TranslationContext& context);
+			TranslationContextGuard(const TranslationContextGuard&) = delete;
+			TranslationContextGuard& operator=(const TranslationContextGuard&) = delete;
+			~TranslationContextGuard();
+		private:
+			const TranslationContext *previous;
+	};
+	
+	///the context installed for the current thread, `nullptr` if there is none
+	const TranslationContext* currentTranslationContext();
+	
+	///Get template for `msgid` string in the context's domain
+	Template translate(const TranslationContext& context, std::string_view msgid);
+	///Get template for `msgid` string in the context's domain, using `untranslated` if it has no translation
+	Template translate(const TranslationContext& context, std::string_view msgid, const preparse::TemplateSyntax& untranslated);
+	///Get template for `msgid` string in another `domain`
+	Template translate(const TranslationContext& context, std::string_view domain, std::string_view msgid);
+	///Get template for `msgid` string in another `domain`, using `untranslated` if it has no translation
+	Template translate(
+		const TranslationContext& context, 
+		std::string_view domain, 
+		std::string_view msgid, 
+		const preparse::TemplateSyntax& untranslated
+	);
+	
+	///Get template for a `msgid` literal in the context's domain, the literal is checked while compiling
+	template<preparse::FixedString msgid>
+	Template translate(const TranslationContext& context) {
+		return translate(context, msgid.view(), literal<msgid>);
+	}
+
+};
+
+//CUT-END
+
+#endif //!MULAN_STRING_CATALOG
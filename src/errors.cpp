@@ -15,6 +15,21 @@ namespace mls {
 		return err.c_str();
 	}
 	
+	InvalidPluralRules::InvalidPluralRules(std::string errString): err{errString} {};
+	const char* InvalidPluralRules::what() const noexcept {
+		return err.c_str();
+	}
+	
+	InvalidLocaleData::InvalidLocaleData(std::string errString): err{errString} {};
+	const char* InvalidLocaleData::what() const noexcept {
+		return err.c_str();
+	}
+	
+	InvalidCatalog::InvalidCatalog(std::string errString): err{errString} {};
+	const char* InvalidCatalog::what() const noexcept {
+		return err.c_str();
+	}
+
 };
 
 //CUT-END
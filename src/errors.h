@@ -15,6 +15,27 @@ namespace mls {
 			const char* what() const noexcept override;
 	};
 	
+	class InvalidPluralRules : public std::exception {
+			const std::string err;
+		public:
+			InvalidPluralRules(std::string errString);
+			const char* what() const noexcept override;
+	};
+	
+	class InvalidLocaleData : public std::exception {
+			const std::string err;
+		public:
+			InvalidLocaleData(std::string errString);
+			const char* what() const noexcept override;
+	};
+	
+	class InvalidCatalog : public std::exception {
+			const std::string err;
+		public:
+			InvalidCatalog(std::string errString);
+			const char* what() const noexcept override;
+	};
+
 };
 
 //CUT-END
@@ -7,37 +7,143 @@
 #include <libintl.h>
 #include <locale.h>
 #include <string>
-#include <map>
 #include <vector>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 
 #include "gettext_backend.h"
+#include "catalog.h"
 
 //CUT-START
 
+#ifndef MULANSTR_TRANSLATION_CACHE_SIZE
+#	define MULANSTR_TRANSLATION_CACHE_SIZE 512
+#endif
+
 namespace mls::backend {
 	
 	locale::Locale *defaultLocale = nullptr;
 	
-	locale::Locale *getLocaleFromName(std::string_view searchLocaleName) {
-		static std::map<std::string, std::vector<std::string>> LOCALES{
-			//English - United Kingdom
-			{"en_GB", {"en_GB","en-GB","English_United Kingdom"}},
-			//English - American
-			{"en_US", {"en_US","en-US","English_United States"}},
-			//Polish
-			{"pl_PL", {"pl_PL","pl-PL","Polish_Poland"}}
-		};
-		
-		//Search for supported locales
-		for(auto&[locale_name, locale_list] : LOCALES) {
-			for(auto& some_locale_name : locale_list) {
-				if( some_locale_name == searchLocaleName ) {
-					return &(locale::getLocale(locale_name));
+	/**
+	 * @brief Parsed templates keyed by (domain, msgid, locale)
+	 * 
+	 * Keeps at most `capacity` templates and drops the least recently used ones.
+	 * All methods are guarded by a mutex, so it can be used from many threads.
+	 */
+	class TemplateCache {
+		private:
+			struct Entry {
+				std::string domain;
+				std::string msgid;
+				const locale::Locale *theLocale;
+				std::shared_ptr<const CompiledTemplate> parsed;
+			};
+			///views into an entry's strings, so a lookup doesn't allocate
+			struct Key {
+				std::string_view domain;
+				std::string_view msgid;
+				const locale::Locale *theLocale;
+				
+				bool operator==(const Key& other) const = default;
+			};
+			struct KeyHash {
+				std::size_t operator()(const Key& key) const {
+					std::size_t hash = std::hash<std::string_view>{}(key.domain);
+					hash ^= std::hash<std::string_view>{}(key.msgid) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+					hash ^= std::hash<const locale::Locale*>{}(key.theLocale) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+					return hash;
+				}
+			};
+			
+			std::mutex guard;
+			//the most recently used entry is at the front
+			std::list<Entry> entries;
+			std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index;
+			CacheStats stats;
+			
+			void trim() {
+				while( entries.size() > stats.capacity ) {
+					auto& last = entries.back();
+					index.erase( Key{last.domain, last.msgid, last.theLocale} );
+					entries.pop_back();
+					++stats.evictions;
 				}
+				stats.size = entries.size();
 			}
-		}
-		//unable to find the locale
-		return nullptr;
+		public:
+			TemplateCache(): stats{0u, 0u, 0u, 0u, MULANSTR_TRANSLATION_CACHE_SIZE} {}
+			
+			///returns `nullptr` if the template isn't cached
+			std::shared_ptr<const CompiledTemplate> find(std::string_view domain, std::string_view msgid, const locale::Locale &theLocale) {
+				std::lock_guard<std::mutex> lock{guard};
+				auto found = index.find( Key{domain, msgid, &theLocale} );
+				if( found == index.end() ) {
+					++stats.misses;
+					return nullptr;
+				}
+				++stats.hits;
+				entries.splice(entries.begin(), entries, found->second);
+				return found->second->parsed;
+			}
+			
+			///returns the cached template, which may be other than `parsed` if another thread was faster
+			std::shared_ptr<const CompiledTemplate> insert(
+				std::string_view domain, 
+				std::string_view msgid, 
+				const locale::Locale &theLocale, 
+				std::shared_ptr<const CompiledTemplate> parsed
+			) {
+				std::lock_guard<std::mutex> lock{guard};
+				if( stats.capacity == 0u ) {
+					return parsed;
+				}
+				auto found = index.find( Key{domain, msgid, &theLocale} );
+				if( found != index.end() ) {
+					return found->second->parsed;
+				}
+				entries.push_front( Entry{std::string{domain}, std::string{msgid}, &theLocale, std::move(parsed)} );
+				auto& entry = entries.front();
+				index.emplace( Key{entry.domain, entry.msgid, entry.theLocale}, entries.begin() );
+				trim();
+				return entry.parsed;
+			}
+			
+			void setCapacity(std::size_t capacity) {
+				std::lock_guard<std::mutex> lock{guard};
+				stats.capacity = capacity;
+				trim();
+			}
+			
+			CacheStats getStats() {
+				std::lock_guard<std::mutex> lock{guard};
+				return stats;
+			}
+			
+			void clear() {
+				std::lock_guard<std::mutex> lock{guard};
+				index.clear();
+				entries.clear();
+				stats = CacheStats{0u, 0u, 0u, 0u, stats.capacity};
+			}
+	};
+	
+	TemplateCache& templateCache() {
+		static TemplateCache cache;
+		return cache;
+	}
+	
+	void setCacheCapacity(std::size_t capacity) {
+		templateCache().setCapacity(capacity);
+	}
+	
+	CacheStats getCacheStats() {
+		return templateCache().getStats();
+	}
+	
+	void clearCache() {
+		templateCache().clear();
 	}
 	
 	void init(const char* packageName, const char* wantedLocale, const char* folderLookup) {
@@ -64,7 +170,7 @@ namespace mls::backend {
 			correctLocale.remove_suffix( correctLocale.size() - at );
 		}
 		
-		defaultLocale = getLocaleFromName(correctLocale);
+		defaultLocale = locale::findLocale(correctLocale);
 		if( defaultLocale == nullptr ) {//unable to find supported locale?
 			defaultLocale = &(locale::getLocale("en_US"));//fallback to English
 			setlocale(LC_ALL, "C");//Force non-translated strings
@@ -78,26 +184,71 @@ namespace mls::backend {
 		
 		bind_textdomain_codeset(packageName, "utf-8");
 		textdomain(packageName);
+		
+		//translations may have changed
+		clearCache();
 	}
-	
+
 };
 
 namespace mls {
 	
 	Template translate(const char* msgid) {
+		if( auto* context = currentTranslationContext() ) {
+			return translate(*context, msgid);
+		}
 		if( backend::defaultLocale == nullptr ) {
 			throw backend::IntlNotInitialized();
 		}
-		return Template{std::string{ gettext(msgid) }, *backend::defaultLocale};
+		return translate(textdomain(nullptr), msgid);
 	}
 	
 	Template translate(const char* catalog, const char* msgid) {
+		if( auto* context = currentTranslationContext() ) {
+			return catalog == nullptr ? translate(*context, msgid) : translate(*context, catalog, msgid);
+		}
 		if( backend::defaultLocale == nullptr ) {
 			throw backend::IntlNotInitialized();
 		}
-		return Template{std::string{ dgettext(catalog, msgid) }, *backend::defaultLocale};
+		if( catalog == nullptr ) {
+			catalog = textdomain(nullptr);
+		}
+		auto& cache = backend::templateCache();
+		auto parsed = cache.find(catalog, msgid, *backend::defaultLocale);
+		if( parsed == nullptr ) {
+			parsed = cache.insert(
+				catalog, msgid, *backend::defaultLocale,
+				std::make_shared<const CompiledTemplate>(dgettext(catalog, msgid), *backend::defaultLocale)
+			);
+		}
+		return Template{std::move(parsed)};
 	}
 	
+	Template translate(const char* catalog, const char* msgid, const preparse::TemplateSyntax& untranslated) {
+		if( auto* context = currentTranslationContext() ) {
+			return catalog == nullptr ? translate(*context, msgid, untranslated) : translate(*context, catalog, msgid, untranslated);
+		}
+		if( backend::defaultLocale == nullptr ) {
+			throw backend::IntlNotInitialized();
+		}
+		if( catalog == nullptr ) {
+			catalog = textdomain(nullptr);
+		}
+		auto& cache = backend::templateCache();
+		auto parsed = cache.find(catalog, msgid, *backend::defaultLocale);
+		if( parsed == nullptr ) {
+			const char* translated = dgettext(catalog, msgid);
+			//GetText returns the very same pointer when there's no translation
+			parsed = cache.insert(
+				catalog, msgid, *backend::defaultLocale,
+				translated == msgid
+					? std::make_shared<const CompiledTemplate>(untranslated, *backend::defaultLocale)
+					: std::make_shared<const CompiledTemplate>(translated, *backend::defaultLocale)
+			);
+		}
+		return Template{std::move(parsed)};
+	}
+
 };
 
 //CUT-END
@@ -4,6 +4,7 @@
 
 #include "mls_locale.h"
 #include "template.h"
+#include "catalog.h"
 
 //CUT-START
 
@@ -23,22 +24,75 @@ namespace mls::backend {
 		const char* wantedLocale = nullptr, 
 		const char* folderLookup = nullptr
 		);
+	
+	///Counters of the cache of parsed templates used by `mls::translate(...)`
+	struct CacheStats {
+		///how many times a template was taken from the cache
+		std::size_t hits;
+		///how many times a template had to be parsed
+		std::size_t misses;
+		///how many templates were dropped to make room for new ones
+		std::size_t evictions;
+		///how many templates are in the cache now
+		std::size_t size;
+		///the maximum number of templates in the cache
+		std::size_t capacity;
+	};
+	
+	/**
+	 * @brief set the maximum number of parsed templates kept by `mls::translate(...)`
+	 * 
+	 * @param capacity The new limit. Pass `0` to turn the cache off. Least recently used templates above the limit are dropped
+	 */
+	void setCacheCapacity(std::size_t capacity);
+	
+	///Get the current counters of the templates cache
+	CacheStats getCacheStats();
+	
+	///Remove all templates from the cache and reset its counters
+	void clearCache();
 };
 
 namespace mls {
 	
+	// With a `TranslationContext` installed for the thread these functions translate with it, not with GetText
+	
 	///Get template for `msgid` string
 	Template translate(const char* msgid);
 	
 	///Get template for `msgid` string in a .mo `catalog`
 	Template translate(const char* catalog, const char* msgid);
 	
+	/**
+	 * @brief Get template for `msgid` string in a .mo `catalog`, using `untranslated` if it has no translation
+	 * 
+	 * `untranslated` must be the syntax of `msgid` and live as long as the program, like `mls::literal<...>` does
+	 */
+	Template translate(const char* catalog, const char* msgid, const preparse::TemplateSyntax& untranslated);
+	
+	///Get template for a `msgid` literal, which is checked while compiling
+	template<preparse::FixedString msgid>
+	Template translate() {
+		return translate(nullptr, msgid.data, literal<msgid>);
+	}
+	
+	///Get template for a `msgid` literal in a .mo `catalog`, the literal is checked while compiling
+	template<preparse::FixedString msgid>
+	Template translate(const char* catalog) {
+		return translate(catalog, msgid.data, literal<msgid>);
+	}
+
 };
 
 #ifndef MULANSTR_DONT_USE_UNDERSCORE
 
-#	define _(msgid) mls::translate(msgid)
-#	define _c(catalog, msgid) mls::translate(catalog, msgid)
+#	ifndef MULANSTR_DONT_CHECK_LITERALS
+#		define _(msgid) mls::translate<msgid>()
+#		define _c(catalog, msgid) mls::translate<msgid>(catalog)
+#	else
+#		define _(msgid) mls::translate(msgid)
+#		define _c(catalog, msgid) mls::translate(catalog, msgid)
+#	endif
 
 #endif
 
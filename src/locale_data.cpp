@@ -0,0 +1,384 @@
+/**
+ * @file locale_data.cpp
+ * @brief Binary locale data files: the layout, the memory-mapped loader and the writer
+ *
+ */
+
+#include "locale_data.h"
+#include "errors.h"
+#include "mapped_file.h"
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <span>
+
+//CUT-START
+
+namespace mls::locale {
+	
+	//------------- The layout
+	// A file starts with its header, then come tables of locales, aliases, number formats and names
+	// (offsets of strings), then plural rules of each locale aligned to 8 bytes and at the end a pool
+	// of NUL-terminated strings. Strings are given by offsets in the pool, all other offsets are from
+	// the start of the file. Numbers are written in the byte order of the machine which made the file.
+	
+	namespace {
+		
+		constexpr char LOCALE_DATA_MAGIC[4] = {'M', 'L', 'S', 'L'};
+		///a file of the other byte order reads it as `0x0201`
+		constexpr std::uint16_t BYTE_ORDER_MARK = 0x0102u;
+		
+		struct FileHeader {
+			char magic[4];
+			std::uint16_t version;
+			std::uint16_t byteOrder;
+			std::uint32_t fileSize;
+			std::uint32_t localesCount;
+			std::uint32_t localesOffset;
+			std::uint32_t aliasesCount;
+			std::uint32_t aliasesOffset;
+			std::uint32_t formatsCount;
+			std::uint32_t formatsOffset;
+			std::uint32_t namesCount;
+			std::uint32_t namesOffset;
+			std::uint32_t stringsSize;
+			std::uint32_t stringsOffset;
+			std::uint32_t reserved[3];
+		};
+		
+		struct LocaleRecord {
+			std::uint32_t name;
+			///cases and genders are ranges of the names table
+			std::uint32_t firstCase;
+			std::uint32_t casesCount;
+			std::uint32_t firstGender;
+			std::uint32_t gendersCount;
+			///a range of the formats table
+			std::uint32_t firstFormat;
+			std::uint32_t formatsCount;
+			///the output of `PluralRules::program()`
+			std::uint32_t pluralRulesOffset;
+			std::uint32_t pluralRulesSize;
+			std::uint32_t reserved;
+		};
+		
+		struct AliasRecord {
+			std::uint32_t alias;
+			///an index in the locales table
+			std::uint32_t locale;
+		};
+		
+		struct FormatRecord {
+			std::uint32_t name;
+			std::uint32_t groupingChar;
+			std::uint32_t fractionSeparator;
+			///sizes of digit groups, as bytes of the strings pool
+			std::uint32_t groupingSchema;
+			std::uint32_t groupingSchemaSize;
+		};
+		
+		static_assert(sizeof(FileHeader) == 64u && sizeof(LocaleRecord) == 40u, "Locale data files have a fixed layout");
+		
+		constexpr std::size_t PROGRAM_ALIGNMENT = 8u;
+		
+		[[noreturn]] void failData(const std::string& path, const std::string& reason) {
+			throw InvalidLocaleData("Invalid locale data file \"" + path + "\": " + reason);
+		}
+	
+	};
+	
+	//------------- Reading
+	
+	namespace {
+		
+		///checks the parts of a mapped file and reads them in place
+		class LocaleDataReader {
+				const std::string& path;
+				std::span<const std::byte> bytes;
+				FileHeader header;
+			public:
+				LocaleDataReader(const std::string& filePath, std::span<const std::byte> fileBytes): path{filePath}, bytes{fileBytes} {
+					if( bytes.size() < sizeof(FileHeader) ) {
+						failData(path, "too short");
+					}
+					std::memcpy(&header, bytes.data(), sizeof(header));
+					if( std::memcmp(header.magic, LOCALE_DATA_MAGIC, sizeof(LOCALE_DATA_MAGIC)) != 0 ) {
+						failData(path, "not a locale data file");
+					}
+					if( header.byteOrder != BYTE_ORDER_MARK ) {
+						failData(path, "written on a machine with another byte order");
+					}
+					if( header.version != LOCALE_DATA_VERSION ) {
+						failData(path, "version " + std::to_string(header.version) + " instead of " + std::to_string(LOCALE_DATA_VERSION));
+					}
+					if( header.fileSize != bytes.size() ) {
+						failData(path, "the file's size doesn't match its header");
+					}
+					checkTable(header.localesOffset, header.localesCount, sizeof(LocaleRecord));
+					checkTable(header.aliasesOffset, header.aliasesCount, sizeof(AliasRecord));
+					checkTable(header.formatsOffset, header.formatsCount, sizeof(FormatRecord));
+					checkTable(header.namesOffset, header.namesCount, sizeof(std::uint32_t));
+					checkTable(header.stringsOffset, header.stringsSize, 1u);
+					//so every string of the pool ends in it
+					if( header.stringsSize == 0u || bytes[header.stringsOffset + header.stringsSize - 1u] != std::byte{0} ) {
+						failData(path, "the strings pool doesn't end with NUL");
+					}
+				}
+				
+				const FileHeader& getHeader() const {
+					return header;
+				}
+				
+				void checkTable(std::uint32_t offset, std::uint32_t count, std::size_t recordSize) const {
+					if( std::uint64_t{offset} + std::uint64_t{count} * recordSize > bytes.size() ) {
+						failData(path, "a table past the end of the file");
+					}
+				}
+				
+				template<typename Record>
+				Record record(std::uint32_t tableOffset, std::uint32_t index) const {
+					Record result;
+					std::memcpy(&result, bytes.data() + tableOffset + std::size_t{index} * sizeof(Record), sizeof(Record));
+					return result;
+				}
+				
+				///a string of the pool, read in place
+				const char* string(std::uint32_t offset) const {
+					if( offset >= header.stringsSize ) {
+						failData(path, "a string past the strings pool");
+					}
+					return reinterpret_cast<const char*>(bytes.data() + header.stringsOffset + offset);
+				}
+				
+				///strings given by a range of the names table
+				std::vector<const char*> names(std::uint32_t first, std::uint32_t count) const {
+					if( std::uint64_t{first} + count > header.namesCount ) {
+						failData(path, "a list past the names table");
+					}
+					std::vector<const char*> result;
+					result.reserve(count);
+					for(std::uint32_t name=first; name<first + count; ++name) {
+						result.push_back( string(record<std::uint32_t>(header.namesOffset, name)) );
+					}
+					return result;
+				}
+				
+				std::span<const std::byte> part(std::uint32_t offset, std::uint32_t size) const {
+					if( std::uint64_t{offset} + size > bytes.size() ) {
+						failData(path, "a part past the end of the file");
+					}
+					return bytes.subspan(offset, size);
+				}
+		};
+	
+	};
+	
+	std::size_t loadLocaleData(const std::string& path) {
+		auto file = MappedFile::open(path);
+		if( file == nullptr ) {
+			failData(path, "can't open and map the file");
+		}
+		LocaleDataReader reader{path, file->bytes()};
+		const FileHeader& header = reader.getHeader();
+		
+		//everything is read and checked before anything is added
+		std::vector<Locale> locales;
+		locales.reserve(header.localesCount);
+		for(std::uint32_t index=0u; index<header.localesCount; ++index) {
+			auto localeRecord = reader.record<LocaleRecord>(header.localesOffset, index);
+			
+			if( std::uint64_t{localeRecord.firstFormat} + localeRecord.formatsCount > header.formatsCount ) {
+				failData(path, "a list past the formats table");
+			}
+			std::vector<NamedNumberFormat> formats;
+			for(std::uint32_t format=localeRecord.firstFormat; format<localeRecord.firstFormat + localeRecord.formatsCount; ++format) {
+				auto formatRecord = reader.record<FormatRecord>(header.formatsOffset, format);
+				if( std::uint64_t{formatRecord.groupingSchema} + formatRecord.groupingSchemaSize > header.stringsSize ) {
+					failData(path, "a grouping schema past the strings pool");
+				}
+				const char* schema = formatRecord.groupingSchemaSize == 0u ? nullptr : reader.string(formatRecord.groupingSchema);
+				formats.push_back( NamedNumberFormat{
+					reader.string(formatRecord.name),
+					NumberFormat{
+						reader.string(formatRecord.groupingChar),
+						reader.string(formatRecord.fractionSeparator),
+						std::span<const unsigned char>(reinterpret_cast<const unsigned char*>(schema), formatRecord.groupingSchemaSize)
+					}
+				} );
+			}
+			
+			std::shared_ptr<const void> owner = file;
+			PluralRules rules;
+			try {
+				rules = PluralRules(reader.part(localeRecord.pluralRulesOffset, localeRecord.pluralRulesSize), std::move(owner));
+			} catch(const InvalidPluralRules& error) {
+				failData(path, error.what());
+			}
+			locales.emplace_back(
+				reader.string(localeRecord.name),
+				std::move(rules),
+				reader.names(localeRecord.firstCase, localeRecord.casesCount),
+				reader.names(localeRecord.firstGender, localeRecord.gendersCount),
+				std::move(formats)
+			);
+		}
+		
+		std::vector<LocaleAlias> aliases;
+		for(std::uint32_t index=0u; index<header.aliasesCount; ++index) {
+			auto aliasRecord = reader.record<AliasRecord>(header.aliasesOffset, index);
+			if( aliasRecord.locale >= locales.size() ) {
+				failData(path, "an alias of a missing locale");
+			}
+			aliases.push_back( LocaleAlias{reader.string(aliasRecord.alias), locales[aliasRecord.locale].getName()} );
+		}
+		
+		for(auto& locale : locales) {
+			loadedLocales.push_back( std::make_unique<Locale>(std::move(locale)) );
+		}
+		localeAliases.insert(localeAliases.end(), aliases.begin(), aliases.end());
+		registerLocales();
+		return locales.size();
+	}
+	
+	//------------- Writing
+	
+	namespace {
+		
+		///NUL-terminated strings, each written once
+		class StringsPool {
+				std::string pool{'\0'};
+				std::map<std::string, std::uint32_t, std::less<>> offsets;
+			public:
+				std::uint32_t add(std::string_view text) {
+					if( text.empty() ) {
+						return 0u;
+					}
+					auto found = offsets.find(text);
+					if( found != offsets.end() ) {
+						return found->second;
+					}
+					auto offset = static_cast<std::uint32_t>(pool.size());
+					pool.append(text);
+					pool.push_back('\0');
+					offsets.emplace(std::string{text}, offset);
+					return offset;
+				}
+				
+				const std::string& getPool() const {
+					return pool;
+				}
+		};
+		
+		template<typename Record>
+		void appendRecords(std::vector<std::byte>& output, const std::vector<Record>& records) {
+			const std::size_t start = output.size();
+			output.resize(start + records.size() * sizeof(Record));
+			std::memcpy(output.data() + start, records.data(), records.size() * sizeof(Record));
+		}
+	
+	};
+	
+	void writeLocaleData(const std::string& path, const std::vector<const Locale*>& locales, const std::vector<LocaleAlias>& aliases) {
+		StringsPool strings;
+		std::vector<LocaleRecord> localeRecords;
+		std::vector<AliasRecord> aliasRecords;
+		std::vector<FormatRecord> formatRecords;
+		std::vector<std::uint32_t> names;
+		std::vector<std::span<const std::byte>> programs;
+		
+		for(const Locale* locale : locales) {
+			const PluralRules* rules = locale->getPluralRules();
+			if( rules == nullptr ) {
+				throw InvalidLocaleData("The locale \"" + std::string{locale->getName()} + "\" has no CLDR plural rules to write");
+			}
+			programs.push_back( rules->program() );
+			
+			LocaleRecord localeRecord{};
+			localeRecord.name = strings.add(locale->getName());
+			localeRecord.firstCase = static_cast<std::uint32_t>(names.size());
+			localeRecord.casesCount = static_cast<std::uint32_t>(locale->getCasesList().size());
+			for(const char* caseName : locale->getCasesList()) {
+				names.push_back( strings.add(caseName) );
+			}
+			localeRecord.firstGender = static_cast<std::uint32_t>(names.size());
+			localeRecord.gendersCount = static_cast<std::uint32_t>(locale->getGendersList().size());
+			for(const char* gender : locale->getGendersList()) {
+				names.push_back( strings.add(gender) );
+			}
+			
+			localeRecord.firstFormat = static_cast<std::uint32_t>(formatRecords.size());
+			for(auto& format : locale->getNumberFormats()) {
+				auto schema = format.format.getGroupingSchema();
+				formatRecords.push_back( FormatRecord{
+					strings.add(format.name),
+					strings.add(format.format.getGroupingChar()),
+					strings.add(format.format.getFractionSeparator()),
+					strings.add( std::string_view(reinterpret_cast<const char*>(schema.data()), schema.size()) ),
+					static_cast<std::uint32_t>(schema.size())
+				} );
+			}
+			localeRecord.formatsCount = static_cast<std::uint32_t>(formatRecords.size()) - localeRecord.firstFormat;
+			localeRecords.push_back(localeRecord);
+		}
+		
+		for(auto& alias : aliases) {
+			std::size_t index = 0u;
+			while( index < locales.size() && locales[index]->getName() != alias.localeName ) {
+				++index;
+			}
+			if( index == locales.size() ) {
+				throw InvalidLocaleData("The alias \"" + std::string{alias.alias} + "\" names a locale which isn't written");
+			}
+			aliasRecords.push_back( AliasRecord{strings.add(alias.alias), static_cast<std::uint32_t>(index)} );
+		}
+		
+		FileHeader header{};
+		std::memcpy(header.magic, LOCALE_DATA_MAGIC, sizeof(LOCALE_DATA_MAGIC));
+		header.version = LOCALE_DATA_VERSION;
+		header.byteOrder = BYTE_ORDER_MARK;
+		std::vector<std::byte> output(sizeof(FileHeader));
+		header.localesCount = static_cast<std::uint32_t>(localeRecords.size());
+		header.localesOffset = static_cast<std::uint32_t>(output.size());
+		output.resize(output.size() + localeRecords.size() * sizeof(LocaleRecord));
+		header.aliasesCount = static_cast<std::uint32_t>(aliasRecords.size());
+		header.aliasesOffset = static_cast<std::uint32_t>(output.size());
+		appendRecords(output, aliasRecords);
+		header.formatsCount = static_cast<std::uint32_t>(formatRecords.size());
+		header.formatsOffset = static_cast<std::uint32_t>(output.size());
+		appendRecords(output, formatRecords);
+		header.namesCount = static_cast<std::uint32_t>(names.size());
+		header.namesOffset = static_cast<std::uint32_t>(output.size());
+		appendRecords(output, names);
+		
+		//plural rules are read in place, so they keep their alignment
+		for(std::size_t locale=0u; locale<programs.size(); ++locale) {
+			output.resize( (output.size() + PROGRAM_ALIGNMENT - 1u) / PROGRAM_ALIGNMENT * PROGRAM_ALIGNMENT );
+			localeRecords[locale].pluralRulesOffset = static_cast<std::uint32_t>(output.size());
+			localeRecords[locale].pluralRulesSize = static_cast<std::uint32_t>(programs[locale].size());
+			output.insert(output.end(), programs[locale].begin(), programs[locale].end());
+		}
+		std::memcpy(output.data() + header.localesOffset, localeRecords.data(), localeRecords.size() * sizeof(LocaleRecord));
+		
+		auto& pool = strings.getPool();
+		header.stringsSize = static_cast<std::uint32_t>(pool.size());
+		header.stringsOffset = static_cast<std::uint32_t>(output.size());
+		output.resize(output.size() + pool.size());
+		std::memcpy(output.data() + header.stringsOffset, pool.data(), pool.size());
+		header.fileSize = static_cast<std::uint32_t>(output.size());
+		std::memcpy(output.data(), &header, sizeof(header));
+		
+		std::FILE* file = std::fopen(path.c_str(), "wb");
+		if( file == nullptr ) {
+			throw InvalidLocaleData("Can't write the locale data file \"" + path + "\"");
+		}
+		const bool written = std::fwrite(output.data(), 1u, output.size(), file) == output.size();
+		if( std::fclose(file) != 0 || !written ) {
+			throw InvalidLocaleData("Can't write the locale data file \"" + path + "\"");
+		}
+	}
+
+};
+
+//CUT-END
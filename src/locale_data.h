@@ -0,0 +1,40 @@
+#pragma once
+#ifndef MULAN_STRING_LOCALE_DATA
+#define MULAN_STRING_LOCALE_DATA
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mls_locale.h"
+
+//CUT-START
+
+namespace mls::locale {
+	
+	///the version of binary locale data files written and read by this library
+	constexpr std::uint16_t LOCALE_DATA_VERSION = 1u;
+	
+	/**
+	 * @brief Reads locales from a binary locale data file into `loadedLocales` and their aliases into `localeAliases`, then registers them
+	 * 
+	 * The file is mapped into memory and nothing is parsed: names, cases, genders and compiled plural rules 
+	 * are read in place, so processes loading the same file share its pages. The file stays mapped as long 
+	 * as its locales live. Files are made by `writeLocaleData(...)` on a machine with the same byte order.
+	 * Don't call it while other threads look up locales. A broken file throws `InvalidLocaleData` and adds nothing.
+	 * @return the count of loaded locales
+	 */
+	std::size_t loadLocaleData(const std::string& path);
+	
+	/**
+	 * @brief Writes locales and aliases of their names to a binary locale data file
+	 * 
+	 * Only locales with CLDR plural rules can be written, a locale with a `pluralizer` function throws `InvalidLocaleData`.
+	 */
+	void writeLocaleData(const std::string& path, const std::vector<const Locale*>& locales, const std::vector<LocaleAlias>& aliases);
+
+};
+
+//CUT-END
+
+#endif //!MULAN_STRING_LOCALE_DATA
@@ -0,0 +1,84 @@
+/**
+ * @file mapped_file.cpp
+ * @brief Files mapped into memory, with POSIX `mmap` or Windows file mappings
+ * 
+ */
+
+#include "mapped_file.h"
+
+//CUT-START
+
+#if defined(_WIN32)
+#	ifndef NOMINMAX
+#		define NOMINMAX
+#	endif
+#	include <windows.h>
+#else
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
+namespace mls {
+	
+	MappedFile::MappedFile(const std::byte* mappedData, std::size_t mappedSize): data{mappedData}, size{mappedSize} {}
+	
+	std::shared_ptr<const MappedFile> MappedFile::open(const std::string& path) {
+		#if defined(_WIN32)
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if( file == INVALID_HANDLE_VALUE ) {
+			return nullptr;
+		}
+		LARGE_INTEGER fileSize;
+		if( !GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0 ) {
+			CloseHandle(file);
+			return nullptr;
+		}
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		CloseHandle(file);
+		if( mapping == nullptr ) {
+			return nullptr;
+		}
+		//the view keeps the mapping open
+		void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(mapping);
+		if( view == nullptr ) {
+			return nullptr;
+		}
+		return std::shared_ptr<const MappedFile>( new MappedFile(static_cast<const std::byte*>(view), static_cast<std::size_t>(fileSize.QuadPart)) );
+		#else
+		int file = ::open(path.c_str(), O_RDONLY);
+		if( file < 0 ) {
+			return nullptr;
+		}
+		struct stat status;
+		if( ::fstat(file, &status) != 0 || status.st_size == 0 ) {
+			::close(file);
+			return nullptr;
+		}
+		//the mapping stays after the file is closed
+		void* view = ::mmap(nullptr, static_cast<std::size_t>(status.st_size), PROT_READ, MAP_SHARED, file, 0);
+		::close(file);
+		if( view == MAP_FAILED ) {
+			return nullptr;
+		}
+		return std::shared_ptr<const MappedFile>( new MappedFile(static_cast<const std::byte*>(view), static_cast<std::size_t>(status.st_size)) );
+		#endif
+	}
+	
+	MappedFile::~MappedFile() {
+		#if defined(_WIN32)
+		UnmapViewOfFile(data);
+		#else
+		::munmap(const_cast<std::byte*>(data), size);
+		#endif
+	}
+	
+	std::span<const std::byte> MappedFile::bytes() const {
+		return std::span<const std::byte>(data, size);
+	}
+
+};
+
+//CUT-END
@@ -0,0 +1,39 @@
+#pragma once
+#ifndef MULAN_STRING_MAPPED_FILE
+#define MULAN_STRING_MAPPED_FILE
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <string>
+
+//CUT-START
+
+namespace mls {
+	
+	/**
+	 * @brief A read-only mapping of a whole file, unmapped when destroyed
+	 * 
+	 * Processes mapping the same file share its pages.
+	 */
+	class MappedFile {
+			const std::byte* data;
+			std::size_t size;
+			
+			MappedFile(const std::byte* mappedData, std::size_t mappedSize);
+		public:
+			///`nullptr` if the file can't be opened or mapped, or is empty
+			static std::shared_ptr<const MappedFile> open(const std::string& path);
+			
+			MappedFile(const MappedFile&) = delete;
+			MappedFile& operator=(const MappedFile&) = delete;
+			~MappedFile();
+			
+			std::span<const std::byte> bytes() const;
+	};
+
+};
+
+//CUT-END
+
+#endif //!MULAN_STRING_MAPPED_FILE
@@ -5,271 +5,526 @@
  */
 
 #include "mls_locale.h"
+#include <algorithm>
 #include <charconv>
 #include <cmath>
+#include <cstring>
+#include <iterator>
+#include <deque>
+#include <mutex>
 
 // cSpell: words pluralizer
 //CUT-START
 
 namespace mls::locale {
 	
-	Locale::Locale(
-		std::string_view name,
+	namespace {
+		
+		///formats of built-in locales have the first IDs, so they need no work when the program starts
+		constexpr std::string_view BUILT_IN_FORMAT_NAMES[] = {"general", "grouped"};
+		constexpr std::size_t BUILT_IN_FORMATS_COUNT = std::size(BUILT_IN_FORMAT_NAMES);
+		
+		///names of other number formats, their IDs follow the built-in ones; a deque, so given out names never move
+		std::deque<std::string>& addedFormatNames() {
+			static std::deque<std::string> names;
+			return names;
+		}
+		
+		///guards `addedFormatNames()`, locales may be made on many threads
+		std::mutex& addedFormatNamesGuard() {
+			static std::mutex guard;
+			return guard;
+		}
+		
+		///the ID of an added name, `NO_NUMBER_FORMAT` if it wasn't added; the caller locks the names
+		NumberFormatID findAddedFormatID(std::string_view name) {
+			auto& names = addedFormatNames();
+			for(std::size_t id=0u; id<names.size(); ++id) {
+				if( names[id] == name ) {
+					return static_cast<NumberFormatID>(BUILT_IN_FORMATS_COUNT + id);
+				}
+			}
+			return NO_NUMBER_FORMAT;
+		}
+		
+		///there are a few names, and each is looked up once, when a template using it is made
+		NumberFormatID internNumberFormat(std::string_view name) {
+			for(std::size_t id=0u; id<BUILT_IN_FORMATS_COUNT; ++id) {
+				if( BUILT_IN_FORMAT_NAMES[id] == name ) {
+					return static_cast<NumberFormatID>(id);
+				}
+			}
+			std::lock_guard<std::mutex> lock{addedFormatNamesGuard()};
+			NumberFormatID id = findAddedFormatID(name);
+			if( id == NO_NUMBER_FORMAT ) {
+				auto& names = addedFormatNames();
+				id = static_cast<NumberFormatID>(BUILT_IN_FORMATS_COUNT + names.size());
+				names.emplace_back(name);
+			}
+			return id;
+		}
+		
+		///lists of a locale made at run time
+		struct OwnedLists {
+			std::vector<const char*> plurals;
+			std::vector<const char*> cases;
+			std::vector<const char*> genders;
+			///names of `formats`, never reallocated
+			std::vector<std::string> formatNames;
+			std::vector<NamedNumberFormat> formats;
+		};
+	
+	};
+	
+	NumberFormatID findNumberFormatID(std::string_view name) {
+		for(std::size_t id=0u; id<BUILT_IN_FORMATS_COUNT; ++id) {
+			if( BUILT_IN_FORMAT_NAMES[id] == name ) {
+				return static_cast<NumberFormatID>(id);
+			}
+		}
+		std::lock_guard<std::mutex> lock{addedFormatNamesGuard()};
+		return findAddedFormatID(name);
+	}
+	
+	std::string_view numberFormatName(NumberFormatID id) {
+		if( id < BUILT_IN_FORMATS_COUNT ) {
+			return BUILT_IN_FORMAT_NAMES[id];
+		}
+		std::lock_guard<std::mutex> lock{addedFormatNamesGuard()};
+		auto& names = addedFormatNames();
+		return id - BUILT_IN_FORMATS_COUNT < names.size() ? std::string_view{names[id - BUILT_IN_FORMATS_COUNT]} : std::string_view{};
+	}
+	
+	void Locale::ownLists(
 		std::initializer_list<const char*> pluralForms,
-		pluralizer pluralFn,
 		std::initializer_list<const char*> cases,
 		std::initializer_list<const char*> genders,
 		std::initializer_list<std::pair<std::string, NumberFormat>> numberFormats
 	) {
-		myName = name;
-		pluralFunction = pluralFn;
-		for(const char* pl : pluralForms) {
-			pluralsList.push_back(pl);
-		}
-		pluralsList.shrink_to_fit();
-		for(const char* caseName : cases) {
-			casesList.push_back(caseName);
+		auto lists = std::make_shared<OwnedLists>();
+		lists->plurals.assign(pluralForms);
+		lists->cases.assign(cases);
+		lists->genders.assign(genders);
+		lists->formatNames.reserve(numberFormats.size());
+		for(auto& format : numberFormats) {
+			lists->formatNames.push_back(format.first);
+			lists->formats.push_back( NamedNumberFormat{lists->formatNames.back(), format.second} );
 		}
-		casesList.shrink_to_fit();
-		for(const char* gender : genders) {
-			gendersList.push_back(gender);
+		functionPlurals = lists->plurals;
+		casesList = lists->cases;
+		gendersList = lists->genders;
+		numFormats = lists->formats;
+		ownedLists = std::move(lists);
+		indexNumberFormats();
+	}
+	
+	void Locale::indexNumberFormats() {
+		for(auto& format : numFormats) {
+			NumberFormatID id = internNumberFormat(format.name);
+			//the first format of a name wins, like in a lookup by name
+			if( id < INDEXED_FORMATS_COUNT && formatsByID[id] == nullptr ) {
+				formatsByID[id] = &format.format;
+			}
 		}
-		gendersList.shrink_to_fit();
-		for(auto format : numberFormats) {
-			numFormats.emplace( format.first, format.second );
+	}
+	
+	void Locale::fillPluralsTable() {
+		#ifdef MULANSTR_PLURAL_TABLE
+		for(unsigned long n=0u; n<SMALL_NUMBERS_COUNT; ++n) {
+			smallNumbersPlurals[n] = static_cast<unsigned char>( pluralFunction != nullptr ? pluralFunction(n) : pluralRules.select(n) );
 		}
+		#endif
+	}
+	
+	Locale::Locale(
+		std::string_view name,
+		std::initializer_list<const char*> pluralForms,
+		pluralizer pluralFn,
+		std::initializer_list<const char*> cases,
+		std::initializer_list<const char*> genders,
+		std::initializer_list<std::pair<std::string, NumberFormat>> numberFormats
+	): myName{name}, pluralFunction{pluralFn} {
+		ownLists(pluralForms, cases, genders, numberFormats);
+		fillPluralsTable();
+	}
+	
+	Locale::Locale(
+		std::string_view name,
+		std::string_view cldrPluralRules,
+		std::initializer_list<const char*> cases,
+		std::initializer_list<const char*> genders,
+		std::initializer_list<std::pair<std::string, NumberFormat>> numberFormats
+	): myName{name}, pluralRules{cldrPluralRules} {
+		ownLists({}, cases, genders, numberFormats);
+		fillPluralsTable();
+	}
+	
+	Locale::Locale(
+		std::string_view name,
+		PluralRules rules,
+		std::vector<const char*> cases,
+		std::vector<const char*> genders,
+		std::vector<NamedNumberFormat> numberFormats
+	): myName{name}, pluralRules{std::move(rules)} {
+		auto lists = std::make_shared<OwnedLists>();
+		lists->cases = std::move(cases);
+		lists->genders = std::move(genders);
+		lists->formats = std::move(numberFormats);
+		casesList = lists->cases;
+		gendersList = lists->genders;
+		numFormats = lists->formats;
+		ownedLists = std::move(lists);
+		indexNumberFormats();
+		fillPluralsTable();
+	}
+	
+	Locale::Locale(const LocaleDefinition& definition):
+		myName{definition.name}, pluralRules{definition.pluralRules},
+		casesList{definition.cases}, gendersList{definition.genders}, numFormats{definition.numberFormats} {
+		indexNumberFormats();
+		fillPluralsTable();
 	}
 	
 	bool Locale::isTheLocale(std::string_view localeName) const {
 		return myName == localeName;
 	}
 	
-	const std::vector<const char*>& Locale::getCasesList() const {
+	std::string_view Locale::getName() const {
+		return myName;
+	}
+	
+	std::span<const char* const> Locale::getCasesList() const {
 		return casesList;
 	}
 	
-	const std::vector<const char*>& Locale::getGendersList() const {
+	std::span<const char* const> Locale::getGendersList() const {
 		return gendersList;
 	}
 	
-	const std::vector<const char*>& Locale::getPluralsList() const {
-		return pluralsList;
+	std::span<const char* const> Locale::getPluralsList() const {
+		if( pluralFunction != nullptr ) {
+			return functionPlurals;
+		}
+		return pluralRules.getCategories();
 	}
 	
-	NumberFormat * Locale::getNumberFormat(std::string_view name) {
+	const NumberFormat * Locale::getNumberFormat(std::string_view name) const {
+		//locales have a few formats
 		for(auto& format : numFormats) {
-			if( format.first == name ) {
-				return &(format.second);
+			if( format.name == name ) {
+				return &format.format;
 			}
 		}
-		//no match
 		return nullptr;
 	}
 	
-	std::string Locale::getPluralID(long number) const {
-		std::string asString = std::to_string(number);
-		return pluralFunction(number, asString);
-	}
-	
-	NumberFormat::NumberFormat(
-		std::string groupChar, 
-		std::string fractionChar,
-		std::initializer_list<unsigned char> schema
-		) {
-		integerGroupingChar = groupChar;
-		fractionSeparator = fractionChar;
-		for(unsigned char s : schema) {
-			groupingSchema.push_back(s);
+	const NumberFormat * Locale::getNumberFormat(NumberFormatID id) const {
+		if( id < INDEXED_FORMATS_COUNT ) {
+			return formatsByID[id];
+		}
+		if( id == NO_NUMBER_FORMAT ) {
+			return nullptr;
+		}
+		return getNumberFormat( numberFormatName(id) );
+	}
+	
+	std::span<const NamedNumberFormat> Locale::getNumberFormats() const {
+		return numFormats;
+	}
+	
+	const PluralRules* Locale::getPluralRules() const {
+		return pluralFunction == nullptr ? &pluralRules : nullptr;
+	}
+	
+	std::size_t Locale::getPluralIndex(long number) const {
+		//`-number` overflows for the smallest `long`, its unsigned negation doesn't
+		unsigned long magnitude = number < 0 ? 0ul - static_cast<unsigned long>(number) : static_cast<unsigned long>(number);
+		#ifdef MULANSTR_PLURAL_TABLE
+		if( magnitude < SMALL_NUMBERS_COUNT ) {
+			return smallNumbersPlurals[magnitude];
 		}
-		groupingSchema.shrink_to_fit();
+		#endif
+		return pluralFunction != nullptr ? pluralFunction(magnitude) : pluralRules.select(magnitude);
+	}
+	
+	std::size_t Locale::getPluralIndex(const PluralOperands& number) const {
+		if( number.v == 0u ) {
+			//an integer, maybe written from a real number
+			#ifdef MULANSTR_PLURAL_TABLE
+			if( number.i < SMALL_NUMBERS_COUNT ) {
+				return smallNumbersPlurals[number.i];
+			}
+			#endif
+		}
+		if( pluralFunction != nullptr ) {
+			//old rules know only integers
+			return pluralFunction(number.i);
+		}
+		return pluralRules.select(number);
+	}
+	
+	std::string Locale::getPluralID(long number) const {
+		return getPluralsList()[ getPluralIndex(number) ];
+	}
+	
+	std::string_view NumberFormat::getGroupingChar() const {
+		return integerGroupingChar;
+	}
+	
+	std::string_view NumberFormat::getFractionSeparator() const {
+		return fractionSeparator;
+	}
+	
+	std::span<const unsigned char> NumberFormat::getGroupingSchema() const {
+		return std::span<const unsigned char>(groupingSchema, groupsCount);
 	}
 	
 	std::string NumberFormat::formatInteger(long integer) const {
-		char intStr[50];
-		bool negative = integer < 0;
-		auto[lastPtr, err] = std::to_chars(&intStr[0], &intStr[49], std::abs(integer), 10);
-		
 		std::string result;
-		
-		if( groupingSchema.size() == 0u ) {
-			//no grouping
-			result = std::string(&intStr[0], lastPtr - &intStr[0]);
-		} else {
-			unsigned char currentGroup = groupingSchema[0];
-			unsigned char groupNo = 0u;
-			char* charGroup;
-			
-			while( lastPtr != &intStr[0] ) {
-				if( groupNo < groupingSchema.size() - 1 ) {
-					++groupNo;
-					currentGroup = groupingSchema[groupNo];
-				}
-				
-				if( lastPtr - &intStr[0] <= currentGroup ) {
-					result = std::string(&intStr[0], lastPtr - &intStr[0]) + result;
-					lastPtr = &intStr[0];
-					break;
-				} else {
-					charGroup = lastPtr - currentGroup;
-					result = std::string(charGroup, currentGroup) + result;
-					lastPtr = charGroup;
-				}
-				
-				if( lastPtr != &intStr[0]) {
-					result = integerGroupingChar + result;
-				}
+		formatInteger(integer, result);
+		return result;
+	}
+	
+	std::size_t NumberFormat::groupSize(std::size_t groupNo) const {
+		if( groupsCount == 0u ) {
+			return 0u;
+		}
+		//the last group size repeats
+		return groupNo < groupsCount ? groupingSchema[groupNo] : groupingSchema[groupsCount - 1u];
+	}
+	
+	std::size_t NumberFormat::countSeparators(std::size_t digitsCount) const {
+		//groups are counted from the right, the first one is `groupingSchema[0]`; a size of 0 ends grouping
+		std::size_t separators = 0u;
+		for(std::size_t left = digitsCount, groupNo = 0u; ; ++groupNo) {
+			std::size_t group = groupSize(groupNo);
+			if( group == 0u || left <= group ) {
+				return separators;
 			}
+			left -= group;
+			++separators;
 		}
+	}
+	
+	char* NumberFormat::writeGrouped(char* outEnd, const char* digits, std::size_t digitsCount) const {
+		const char* digit = digits + digitsCount;
+		for(std::size_t groupNo = 0u, separators = countSeparators(digitsCount); separators > 0u; ++groupNo, --separators) {
+			std::size_t group = groupSize(groupNo);
+			outEnd -= group;
+			digit -= group;
+			std::memcpy(outEnd, digit, group);
+			outEnd -= integerGroupingChar.size();
+			std::memcpy(outEnd, integerGroupingChar.data(), integerGroupingChar.size());
+		}
+		outEnd -= digit - digits;
+		std::memcpy(outEnd, digits, static_cast<std::size_t>(digit - digits));
+		return outEnd;
+	}
+	
+	void NumberFormat::formatInteger(long integer, std::string& output) const {
+		char digits[24];
+		bool negative = integer < 0;
+		//`-integer` overflows for the smallest `long`, its unsigned negation doesn't
+		unsigned long magnitude = negative ? 0ul - static_cast<unsigned long>(integer) : static_cast<unsigned long>(integer);
+		auto[digitsEnd, err] = std::to_chars(&digits[0], &digits[0] + sizeof(digits), magnitude);
+		const std::size_t digitsCount = static_cast<std::size_t>(digitsEnd - &digits[0]);
 		
-		if(negative)
-			return std::string("-") + result;
-		else
-			return result;
+		//the result is written backwards, straight into the output
+		const std::size_t start = output.size();
+		output.resize(start + (negative ? 1u : 0u) + digitsCount + countSeparators(digitsCount) * integerGroupingChar.size());
+		char* out = writeGrouped(output.data() + output.size(), &digits[0], digitsCount);
+		if( negative ) {
+			*--out = '-';
+		}
 	}
 	
 	std::string NumberFormat::formatReal(double real, short precision) const {
-		long integerPart = static_cast<long>(real);
-		real -= integerPart; //only fractions
-		
-		if( precision == 0 ) {
-			return formatInteger(integerPart);
+		std::string result;
+		formatReal(real, result, precision);
+		return result;
+	}
+	
+	///`double` has no non-zero fractional digits past the 1074th
+	constexpr short MAX_FRACTION_DIGITS = 1074;
+	
+	void NumberFormat::formatReal(double real, std::string& output, short precision) const {
+		//the sign, 309 integer digits, the dot and the fraction
+		char text[1 + 309 + 1 + MAX_FRACTION_DIGITS];
+		char* const textBegin = &text[0];
+		char* textEnd;
+		if( precision < 0 ) {
+			//the shortest text which reads back as the same number
+			textEnd = std::to_chars(textBegin, textBegin + sizeof(text), real, std::chars_format::fixed).ptr;
+		} else {
+			textEnd = std::to_chars(textBegin, textBegin + sizeof(text), real, std::chars_format::fixed, std::min(precision, MAX_FRACTION_DIGITS)).ptr;
 		}
 		
-		if( precision > 0 ) {
-			const double modifer = std::pow(10.0, precision);
-			real = std::round( real * modifer ) / modifer;
+		if( !std::isfinite(real) ) {
+			output.append(textBegin, textEnd);
+			return;
 		}
 		
-		std::string result = formatInteger(integerPart);
-		
-		if( real == 0.0 )
-			return result;
-		
-		char realStr[50];
-		auto[lastPtr, err] = std::to_chars(&realStr[0], &realStr[49], real, std::chars_format::fixed);
-		
-		char* dotPos = &realStr[0];
-		while( dotPos != lastPtr ) {
-			if( *dotPos == '.' ) {
-				++dotPos;
-				break;
+		const bool negative = *textBegin == '-';
+		const char* digits = textBegin + (negative ? 1 : 0);
+		const char* dot = std::find(digits, static_cast<const char*>(textEnd), '.');
+		//trailing zeros of the fraction are not written
+		if( dot != textEnd ) {
+			while( textEnd[-1] == '0' ) {
+				--textEnd;
+			}
+			if( textEnd - 1 == dot ) {
+				--textEnd;
 			}
-			++dotPos;
 		}
+		const std::size_t integerDigits = static_cast<std::size_t>(dot - digits);
+		const std::size_t fractionDigits = dot < textEnd ? static_cast<std::size_t>(textEnd - dot - 1) : 0u;
+		//a number rounded to zero has no sign
+		const bool writeSign = negative && !(integerDigits == 1u && *digits == '0' && fractionDigits == 0u);
 		
-		result = result + fractionSeparator + std::string(dotPos, lastPtr - dotPos);
-		return result;
+		//the fraction is copied after its separator, then the integer part is written backwards
+		const std::size_t start = output.size();
+		output.resize(
+			start + (writeSign ? 1u : 0u)
+			+ integerDigits + countSeparators(integerDigits) * integerGroupingChar.size()
+			+ (fractionDigits > 0u ? fractionSeparator.size() + fractionDigits : 0u)
+		);
+		char* out = output.data() + output.size();
+		if( fractionDigits > 0u ) {
+			out -= fractionDigits;
+			std::memcpy(out, dot + 1, fractionDigits);
+			out -= fractionSeparator.size();
+			std::memcpy(out, fractionSeparator.data(), fractionSeparator.size());
+		}
+		out = writeGrouped(out, digits, integerDigits);
+		if( writeSign ) {
+			*--out = '-';
+		}
 	}
 	
-	// helper functions used by pluralizer functions
-	bool hasEnding (std::string const &fullString, std::string_view ending) {
-		if (fullString.length() >= ending.length()) {
-			return (fullString.compare (fullString.length() - ending.length(), ending.length(), ending) == 0);
-		} else {
-			return false;
+	std::size_t NumberFormat::maxLength(std::size_t integerDigits, std::size_t fractionDigits) const {
+		//the sign and the digits
+		std::size_t result = 1u + integerDigits;
+		if( groupsCount > 0u && integerDigits > 1u ) {
+			//the smallest group gives the most separators
+			unsigned char smallestGroup = 0xFF;
+			for(unsigned char group : getGroupingSchema()) {
+				if( group > 0u && group < smallestGroup ) {
+					smallestGroup = group;
+				}
+			}
+			result += ((integerDigits - 1u) / smallestGroup) * integerGroupingChar.size();
 		}
+		if( fractionDigits > 0u ) {
+			result += fractionSeparator.size() + fractionDigits;
+		}
+		return result;
 	}
-
-	int twoDigitsEnding(std::string &number) {
-		if(number.length() >= 2)
-			return std::stoi(number.substr(number.length() - 2));
-		else
-			return  std::stoi(number);
-	}
+	
 	/*
 	
 	===================== Plurals ======================
 	based on: https://developer.mozilla.org/en-US/docs/Mozilla/Localization/Localization_and_Plurals
 	
 	*/
-
+	
 	// cSpell: disable
-
+	
 	//Families: Asian (Chinese, Japanese, Korean), Persian, Turkic/Altaic (Turkish), Thai, Lao
-	std::string PluralRule0(long numberAsInt, std::string &numberAsString) {
-		return "other";
+	//Forms: other
+	std::size_t PluralRule0(unsigned long /*number*/) {
+		return 0u;
 	}
-
+	
 	//Families: Germanic, Finno-Ugric, Language isolate, Latin/Greek, Semitic, Romanic, Vietnamese
-	std::string PluralRule1(long numberAsInt, std::string &numberAsString) {
-		if(numberAsInt == 1) return "one";
-		return "other";
+	//Forms: one, other
+	std::size_t PluralRule1(unsigned long number) {
+		if( number == 1u ) return 0u;
+		return 1u;
 	}
-
+	
 	//Families: Romanic (French, Brazilian Portuguese), Lingala
-	std::string PluralRule2(long numberAsInt, std::string &numberAsString) {
-		if( numberAsInt == 1 || numberAsInt == 0) return "zero_one";
-		return "other";
+	//Forms: zero_one, other
+	std::size_t PluralRule2(unsigned long number) {
+		if( number == 1u || number == 0u ) return 0u;
+		return 1u;
 	}
-
+	
 	//Families: Baltic (Latvian, Latgalian)
-	std::string PluralRule3(long numberAsInt, std::string &numberAsString) {
-		if( hasEnding(numberAsString,"0")) return "zero";
-		if( hasEnding(numberAsString,"1") && !hasEnding(numberAsString,"11")) return "one";
-		return "other";
+	//Forms: zero, one, other
+	std::size_t PluralRule3(unsigned long number) {
+		if( number % 10u == 0u ) return 0u;
+		if( number % 10u == 1u && number % 100u != 11u ) return 1u;
+		return 2u;
 	}
-
+	
 	//Families: Celtic (Scottish Gaelic)
-	std::string PluralRule4(long numberAsInt, std::string &numberAsString) {
-		if( numberAsInt == 1 || numberAsInt == 11 ) return "one";
-		if( numberAsInt == 2 || numberAsInt == 12 ) return "two";
+	//Forms: one, two, three, other
+	std::size_t PluralRule4(unsigned long number) {
+		if( number == 1u || number == 11u ) return 0u;
+		if( number == 2u || number == 12u ) return 1u;
 		if( 
-			(numberAsInt >= 3 && numberAsInt <= 10)
+			(number >= 3u && number <= 10u)
 			||
-			(numberAsInt >= 13 && numberAsInt <= 19)
-			) return "three";
-		return "other";
+			(number >= 13u && number <= 19u)
+			) return 2u;
+		return 3u;
 	}
-
+	
 	//Families: Romanic (Romanian)
-	std::string PluralRule5(long numberAsInt, std::string &numberAsString) {
-		if( numberAsInt == 1 ) return "one";
-		int ending = twoDigitsEnding(numberAsString);
-		if( numberAsInt == 0 || (ending >= 1 && ending <= 19) ) return "few";
-		return "other";
+	//Forms: one, few, other
+	std::size_t PluralRule5(unsigned long number) {
+		if( number == 1u ) return 0u;
+		unsigned long ending = number % 100u;
+		if( number == 0u || (ending >= 1u && ending <= 19u) ) return 1u;
+		return 2u;
 	}
-
+	
 	//Families: Baltic (Lithuanian)
-	std::string PluralRule6(long numberAsInt, std::string &numberAsString) {
-		if( numberAsInt != 11 && hasEnding(numberAsString,"1") ) return "one";
-		int ending = twoDigitsEnding(numberAsString);
-		if( hasEnding(numberAsString,"0") ||
-			(ending >= 11 && ending <= 19)
-		) return "few";
-		return "other";
+	//Forms: one, few, other
+	std::size_t PluralRule6(unsigned long number) {
+		if( number != 11u && number % 10u == 1u ) return 0u;
+		unsigned long ending = number % 100u;
+		if( number % 10u == 0u ||
+			(ending >= 11u && ending <= 19u)
+		) return 1u;
+		return 2u;
 	}
-
+	
 	//Families: Belarusian, Russian, Ukrainian
-	std::string PluralRule7(long numberAsInt, std::string &numberAsString) {
-		if( hasEnding(numberAsString,"1") && numberAsInt != 11 ) return "one";
-		int twoDigits = twoDigitsEnding(numberAsString);
+	//Forms: one, few, other
+	std::size_t PluralRule7(unsigned long number) {
+		if( number % 10u == 1u && number != 11u ) return 0u;
+		unsigned long twoDigits = number % 100u;
+		unsigned long lastDigit = number % 10u;
 		if(
-			!( twoDigits >= 12 && twoDigits <= 14 )
+			!( twoDigits >= 12u && twoDigits <= 14u )
 			&&
-			( hasEnding(numberAsString,"2") || hasEnding(numberAsString,"3") || hasEnding(numberAsString,"4") )
-		) return "few";
-		return "other";
+			( lastDigit >= 2u && lastDigit <= 4u )
+		) return 1u;
+		return 2u;
 	}
-
+	
 	//Families: Slavic (Slovak, Czech)
-	std::string PluralRule8(long numberAsInt, std::string &numberAsString) {
-		if( numberAsInt == 1 ) return "one";
-		if( numberAsInt >=2 && numberAsInt <= 4) return "few";
-		return "other";
+	//Forms: one, few, other
+	std::size_t PluralRule8(unsigned long number) {
+		if( number == 1u ) return 0u;
+		if( number >= 2u && number <= 4u ) return 1u;
+		return 2u;
 	}
-
+	
 	//Families: Slavic (Polish)
-	std::string PluralRule9(long numberAsInt, std::string &numberAsString) {
-		if( numberAsInt == 1 ) return "one";
+	//Forms: one, few, other
+	std::size_t PluralRule9(unsigned long number) {
+		if( number == 1u ) return 0u;
+		unsigned long twoDigits = number % 100u;
+		unsigned long lastDigit = number % 10u;
 		if(
-			!( hasEnding(numberAsString,"12") || hasEnding(numberAsString,"13") || hasEnding(numberAsString,"14") )
+			!( twoDigits >= 12u && twoDigits <= 14u )
 			&&
-			( hasEnding(numberAsString,"2") || hasEnding(numberAsString,"3") || hasEnding(numberAsString,"4") )
-		) return "few";
-		return "other";
+			( lastDigit >= 2u && lastDigit <= 4u )
+		) return 1u;
+		return 2u;
 	}
-
-	//TODO: make rules for the 10-19 positions
 	
 	/*
 	
@@ -277,18 +532,17 @@ namespace mls::locale {
 	
 	*/
 	
-	std::vector<Locale> localesList{
-		//British English
-		{"en_GB", {"one","other"}, PluralRule1, {}, {}, {
-			{"general", {",", ".", {}}},
-			{"grouped", {",", ".", {3}}}
-		}},
-		//American English
-		{"en_US", {"one","other"}, PluralRule1, {}, {}, {
+	// cSpell: disable
+	namespace {
+		
+		constexpr NamedNumberFormat ENGLISH_FORMATS[] = {
 			{"general", {",", ".", {}}},
 			{"grouped", {",", ".", {3}}}
-		}},
-		//Polish
+		};
+		
+		constexpr std::string_view BRITISH_ALIASES[] = {"en-GB", "English_United Kingdom"};
+		constexpr std::string_view AMERICAN_ALIASES[] = {"en-US", "English_United States"};
+		
 		/*
 		(nom)inative = mianownik(kto? co?)
 		(gen)etive = dopełniacz(kogo? czego?)
@@ -298,27 +552,173 @@ namespace mls::locale {
 		(loc)ative = miejscownik (o kim? o czym?)
 		(voc)ative = wołacz (O!)
 		*/
-		{"pl_PL", {"one","few","other"}, PluralRule9, 
-		{"nom","gen","dat","acc","ins","loc","voc"}, {"m","f","n"}, {
+		constexpr const char* POLISH_CASES[] = {"nom","gen","dat","acc","ins","loc","voc"};
+		constexpr const char* POLISH_GENDERS[] = {"m","f","n"};
+		constexpr NamedNumberFormat POLISH_FORMATS[] = {
 			{"general", {" ", ",", {}}},
 			{"grouped", {" ", ",", {3}}}
-		}}
+		};
+		constexpr std::string_view POLISH_ALIASES[] = {"pl-PL", "Polish_Poland"};
+		
+		constexpr LocaleDefinition BUILT_IN_LOCALES[] = {
+			//British English, with the CLDR rules of English
+			{"en_GB", BRITISH_ALIASES, "one: i = 1 and v = 0", {}, {}, ENGLISH_FORMATS},
+			//American English
+			{"en_US", AMERICAN_ALIASES, "one: i = 1 and v = 0", {}, {}, ENGLISH_FORMATS},
+			//Polish
+			//the CLDR "many" form is "other" here, so fractions use it too
+			{"pl_PL", POLISH_ALIASES, "one: i = 1 and v = 0; few: v = 0 and i % 10 = 2..4 and i % 100 != 12..14", 
+				POLISH_CASES, POLISH_GENDERS, POLISH_FORMATS}
+		};
+	
 	};
+	// cSpell: enable
+	
+	std::span<const LocaleDefinition> builtInLocales() {
+		return BUILT_IN_LOCALES;
+	}
+	
+	std::vector<Locale> localesList;
+	std::vector<LocaleAlias> localeAliases;
+	std::vector<std::unique_ptr<Locale>> loadedLocales;
+	
+	namespace {
 		
-	Locale& getLocale(std::string_view localeName) {
-		Locale* found = nullptr;
-		for( auto& locale : localesList ) {
-			if( locale.isTheLocale(localeName) ) {
-				found = &locale;
+		///FNV-1a mixed with a seed
+		std::uint32_t hashLocaleName(std::string_view name, std::uint32_t seed) {
+			std::uint32_t hash = 2166136261u ^ seed;
+			for(char c : name) {
+				hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
 			}
+			return hash ^ (hash >> 15);
 		}
 		
-		if( found != nullptr )
-			return *found;
-		else
-			return getLocale("en_US");
+		/**
+		 * @brief A perfect hash table of locale names and aliases
+		 * 
+		 * The seed is chosen so every name has its own slot, so a lookup hashes the name and compares it once.
+		 * Built-in locales are made from their definitions with the registry.
+		 * Lookups only read the table; `rebuild()` replaces it, so it must not run while other threads look locales up.
+		 */
+		class LocaleRegistry {
+				struct Slot {
+					std::string_view name;
+					Locale* locale = nullptr;
+				};
+				struct Table {
+					std::vector<Slot> slots;
+					std::uint32_t seed = 0u;
+					
+					///`false` if two names of different locales get the same slot
+					bool tryToFill(const std::vector<Slot>& entries) {
+						const std::size_t mask = slots.size() - 1u;
+						for(auto& slot : slots) {
+							slot = Slot{};
+						}
+						for(auto& entry : entries) {
+							Slot& slot = slots[ hashLocaleName(entry.name, seed) & mask ];
+							if( slot.locale != nullptr ) {
+								if( slot.name == entry.name ) {
+									//a repeated name, the first one stays
+									continue;
+								}
+								return false;
+							}
+							slot = entry;
+						}
+						return true;
+					}
+				};
+				///never resized, so pointers to its locales stay valid
+				std::vector<Locale> builtIn;
+				Table table;
+				
+				Table build() {
+					//loaded locales come first, so they hide other ones of the same name
+					std::vector<Slot> entries;
+					for(auto& locale : loadedLocales) {
+						entries.push_back( Slot{locale->getName(), locale.get()} );
+					}
+					for(auto& locale : localesList) {
+						entries.push_back( Slot{locale.getName(), &locale} );
+					}
+					for(auto& locale : builtIn) {
+						entries.push_back( Slot{locale.getName(), &locale} );
+					}
+					const std::size_t localeEntries = entries.size();
+					auto addAlias = [&entries, localeEntries](std::string_view alias, std::string_view localeName) {
+						for(std::size_t entry=0u; entry<localeEntries; ++entry) {
+							if( entries[entry].name == localeName ) {
+								entries.push_back( Slot{alias, entries[entry].locale} );
+								return;
+							}
+						}
+					};
+					for(auto& alias : localeAliases) {
+						addAlias(alias.alias, alias.localeName);
+					}
+					for(auto& definition : builtInLocales()) {
+						for(auto alias : definition.aliases) {
+							addAlias(alias, definition.name);
+						}
+					}
+					
+					//with 4 slots per name a few seeds are enough
+					Table result;
+					std::size_t size = 4u;
+					while( size < 4u * entries.size() ) {
+						size *= 2u;
+					}
+					result.slots.resize(size);
+					while( !result.tryToFill(entries) ) {
+						if( ++result.seed % 64u == 0u ) {
+							result.slots.resize(result.slots.size() * 2u);
+						}
+					}
+					return result;
+				}
+			public:
+				///built while the function's static is made, so the first lookups are safe from many threads
+				LocaleRegistry() {
+					builtIn.reserve(builtInLocales().size());
+					for(auto& definition : builtInLocales()) {
+						builtIn.emplace_back(definition);
+					}
+					rebuild();
+				}
+				
+				void rebuild() {
+					table = build();
+				}
+				
+				Locale* find(std::string_view name) const {
+					const Slot& slot = table.slots[ hashLocaleName(name, table.seed) & (table.slots.size() - 1u) ];
+					return slot.name == name ? slot.locale : nullptr;
+				}
+		};
+		
+		LocaleRegistry& registry() {
+			static LocaleRegistry theRegistry;
+			return theRegistry;
+		}
+	
+	};
+	
+	void registerLocales() {
+		registry().rebuild();
+	}
+	
+	Locale* findLocale(std::string_view nameOrAlias) {
+		return registry().find(nameOrAlias);
 	}
 	
+	Locale& getLocale(std::string_view localeName) {
+		if( Locale* found = findLocale(localeName) ) {
+			return *found;
+		}
+		return *findLocale("en_US");
+	}
+
 };
 
 //CUT-END
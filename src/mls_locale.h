@@ -7,38 +7,151 @@
 #include <initializer_list>
 #include <utility>
 #include <vector>
-#include <map>
+#include <memory>
+#include <span>
+#include <optional>
+
+#include "plural_rules.h"
 
 // cSpell: words pluralizer
 //CUT-START
 
 namespace mls::locale {
 	
+	/**
+	 * @brief Separators and sizes of digit groups of numbers
+	 * 
+	 * The separators are not copied, they must live as long as the format, like string literals do.
+	 * Formats can be made while compiling, so built-in locales keep them in read-only memory.
+	 */
 	class NumberFormat {
 		public:
-			NumberFormat(
-				std::string groupChar, 
-				std::string fractionChar,
+			///the most sizes of digit groups, a longer schema keeps its first ones
+			static constexpr std::size_t MAX_GROUPS = 8u;
+			
+			constexpr NumberFormat(
+				std::string_view groupChar, 
+				std::string_view fractionChar,
 				std::initializer_list<unsigned char> schema
-				);
+				): NumberFormat(groupChar, fractionChar, std::span<const unsigned char>(schema.begin(), schema.size())) {}
+			constexpr NumberFormat(
+				std::string_view groupChar, 
+				std::string_view fractionChar,
+				std::span<const unsigned char> schema
+				): integerGroupingChar{groupChar}, fractionSeparator{fractionChar} {
+				for(unsigned char size : schema.first(schema.size() < MAX_GROUPS ? schema.size() : MAX_GROUPS)) {
+					groupingSchema[groupsCount++] = size;
+				}
+			}
 			
 			std::string formatInteger(long integer) const;
+			///appends the formatted integer to `output`, which doesn't allocate memory if `output` has room for it
+			void formatInteger(long integer, std::string& output) const;
+			///`precision` is the count of fractional digits, `-1` writes the shortest text which reads back as the same number
 			std::string formatReal(double real, short precision = -1) const;
+			///appends the formatted real number to `output`, which doesn't allocate memory if `output` has room for it
+			void formatReal(double real, std::string& output, short precision = -1) const;
+			///the longest output for a number with the given count of digits
+			std::size_t maxLength(std::size_t integerDigits, std::size_t fractionDigits = 0u) const;
+			
+			std::string_view getGroupingChar() const;
+			std::string_view getFractionSeparator() const;
+			///sizes of digit groups from the right, the last one repeats
+			std::span<const unsigned char> getGroupingSchema() const;
 		private:
-			std::string integerGroupingChar;
-			std::string fractionSeparator;
-			std::vector<unsigned char> groupingSchema;
+			std::string_view integerGroupingChar;
+			std::string_view fractionSeparator;
+			///sizes of digit groups from the right, the last one repeats
+			unsigned char groupingSchema[MAX_GROUPS] = {};
+			unsigned char groupsCount = 0u;
+			
+			std::size_t groupSize(std::size_t groupNo) const;
+			std::size_t countSeparators(std::size_t digitsCount) const;
+			///writes grouped digits backwards ending at `outEnd`, returns the beginning of the written text
+			char* writeGrouped(char* outEnd, const char* digits, std::size_t digitsCount) const;
+	};
+	
+	///returns the index of the plural form of the number in the locale's list of plural forms
+	typedef std::size_t (*pluralizer)(unsigned long);
+	
+	///Plural rules of language families, each rule's list of forms is written by its definition
+	std::size_t PluralRule0(unsigned long number);
+	std::size_t PluralRule1(unsigned long number);
+	std::size_t PluralRule2(unsigned long number);
+	std::size_t PluralRule3(unsigned long number);
+	std::size_t PluralRule4(unsigned long number);
+	std::size_t PluralRule5(unsigned long number);
+	std::size_t PluralRule6(unsigned long number);
+	std::size_t PluralRule7(unsigned long number);
+	std::size_t PluralRule8(unsigned long number);
+	std::size_t PluralRule9(unsigned long number);
+	
+	///identifies a number format by its name, the same in all locales
+	typedef std::uint32_t NumberFormatID;
+	constexpr NumberFormatID NO_NUMBER_FORMAT = 0xFFFF'FFFFu;
+	///the ID of a number format name, `NO_NUMBER_FORMAT` if no locale has such a format
+	NumberFormatID findNumberFormatID(std::string_view name);
+	///the name of a number format, empty if there is no such ID
+	std::string_view numberFormatName(NumberFormatID id);
+	
+	struct NamedNumberFormat {
+		std::string_view name;
+		NumberFormat format;
+	};
+	
+	/**
+	 * @brief A built-in locale, kept in read-only memory
+	 * 
+	 * Definitions are constant tables: making them takes no work when the program starts. 
+	 * The `Locale` of a definition is made on the first lookup of a locale.
+	 */
+	struct LocaleDefinition {
+		std::string_view name;
+		///other names of the locale, like `pl-PL` for `pl_PL`
+		std::span<const std::string_view> aliases;
+		///CLDR plural rules, see `PluralRules`
+		std::string_view pluralRules;
+		std::span<const char* const> cases;
+		std::span<const char* const> genders;
+		std::span<const NamedNumberFormat> numberFormats;
 	};
 	
-	typedef std::string (*pluralizer)(long, std::string&);
+	///definitions of locales built into the library
+	std::span<const LocaleDefinition> builtInLocales();
 	
 	class Locale {
 		std::string_view myName;
-		pluralizer pluralFunction;
-		std::vector<const char*> pluralsList;
-		std::vector<const char*> casesList;
-		std::vector<const char*> gendersList;
-		std::map<std::string, NumberFormat> numFormats;
+		///`nullptr` if the locale uses `pluralRules`
+		pluralizer pluralFunction = nullptr;
+		PluralRules pluralRules;
+		///plural forms of `pluralFunction`
+		std::span<const char* const> functionPlurals;
+		std::span<const char* const> casesList;
+		std::span<const char* const> gendersList;
+		std::span<const NamedNumberFormat> numFormats;
+		///lists made at run time, which the spans above may point to; shared by copies, empty for built-in locales
+		std::shared_ptr<const void> ownedLists;
+		///formats with the first IDs, looked up by ID without comparing names
+		static constexpr std::size_t INDEXED_FORMATS_COUNT = 16u;
+		///points into `numFormats`, `nullptr` for formats the locale doesn't have
+		const NumberFormat* formatsByID[INDEXED_FORMATS_COUNT] = {};
+		#ifdef MULANSTR_PLURAL_TABLE
+		///plural forms of numbers below `SMALL_NUMBERS_COUNT`, computed once
+		static constexpr unsigned long SMALL_NUMBERS_COUNT = 1000u;
+		unsigned char smallNumbersPlurals[SMALL_NUMBERS_COUNT];
+		#endif
+		
+		///copies the lists to `ownedLists`
+		void ownLists(
+			std::initializer_list<const char*> pluralForms,
+			std::initializer_list<const char*> cases,
+			std::initializer_list<const char*> genders,
+			std::initializer_list<std::pair<std::string, NumberFormat>> numberFormats
+		);
+		///interns names of `numFormats` and fills `formatsByID`
+		void indexNumberFormats();
+		///fills the table of small numbers
+		void fillPluralsTable();
 		public:
 			Locale(
 				std::string_view name,
@@ -48,18 +161,70 @@ namespace mls::locale {
 				std::initializer_list<const char*> genders,
 				std::initializer_list<std::pair<std::string, NumberFormat>> numberFormats
 			);
+			///plural forms given by CLDR plural rules, see `PluralRules`
+			Locale(
+				std::string_view name,
+				std::string_view cldrPluralRules,
+				std::initializer_list<const char*> cases,
+				std::initializer_list<const char*> genders,
+				std::initializer_list<std::pair<std::string, NumberFormat>> numberFormats
+			);
+			///plural forms given by compiled rules, like the ones read by `loadLocaleData(...)`; names aren't copied
+			Locale(
+				std::string_view name,
+				PluralRules rules,
+				std::vector<const char*> cases,
+				std::vector<const char*> genders,
+				std::vector<NamedNumberFormat> numberFormats
+			);
+			///a locale using the tables of the definition, only its plural rules are compiled
+			explicit Locale(const LocaleDefinition& definition);
 			
 			bool isTheLocale(std::string_view localeName) const;
+			std::string_view getName() const;
 			
-			const std::vector<const char*>& getCasesList() const;
-			const std::vector<const char*>& getGendersList() const;
-			const std::vector<const char*>& getPluralsList() const;
+			std::span<const char* const> getCasesList() const;
+			std::span<const char* const> getGendersList() const;
+			std::span<const char* const> getPluralsList() const;
 			
+			///the index of the number's plural form in `getPluralsList()`
+			std::size_t getPluralIndex(long number) const;
+			///the index of the plural form of a number with a fraction, like `pluralOperands(1.5)`
+			std::size_t getPluralIndex(const PluralOperands& number) const;
 			std::string getPluralID(long number) const;
-			NumberFormat * getNumberFormat(std::string_view name);
+			///`nullptr` if the locale's plural forms are given by a `pluralizer` function
+			const PluralRules* getPluralRules() const;
+			///`nullptr` if the locale has no such format
+			const NumberFormat * getNumberFormat(std::string_view name) const;
+			///an index into a table of the locale, no names are compared for the first IDs
+			const NumberFormat * getNumberFormat(NumberFormatID id) const;
+			std::span<const NamedNumberFormat> getNumberFormats() const;
+	};
+	
+	///another name of a locale, like `pl-PL` for `pl_PL`
+	struct LocaleAlias {
+		std::string_view alias;
+		std::string_view localeName;
 	};
 	
+	/**
+	 * @brief Locales added by the program, known to `findLocale(...)` and `getLocale(...)` with built-in ones
+	 * 
+	 * Their names and aliases are put in a hash table on the first lookup; after changing the lists call `registerLocales()`. 
+	 * Adding to `localesList` may move its locales, so changing the lists and registering them must be done 
+	 * before other threads use `findLocale(...)` or `getLocale(...)`, or while they don't.
+	 * A name of `loadedLocales` hides the same name in `localesList`, which hides a built-in locale.
+	 * The lists are empty when the program starts.
+	 */
 	extern std::vector<Locale> localesList;
+	extern std::vector<LocaleAlias> localeAliases;
+	///locales read by `loadLocaleData(...)`, kept apart so they never move
+	extern std::vector<std::unique_ptr<Locale>> loadedLocales;
+	///builds the hash table of `findLocale(...)` again from the lists above, no other thread may look locales up meanwhile
+	void registerLocales();
+	///finds a locale by its name or alias, `nullptr` if there is no such locale
+	Locale* findLocale(std::string_view nameOrAlias);
+	///finds a locale by its name or alias, unknown names give `en_US`
 	Locale& getLocale(std::string_view localeName);
 };
 
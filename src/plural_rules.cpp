@@ -0,0 +1,667 @@
+/**
+ * @file plural_rules.cpp
+ * @brief CLDR plural rules: the parser, the evaluator and rules of languages
+ * 
+ */
+
+#include "plural_rules.h"
+#include "errors.h"
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstring>
+#include <numeric>
+#include <string>
+
+// cSpell: words CLDR
+//CUT-START
+
+namespace mls::locale {
+	
+	//------------- Operands
+	
+	namespace {
+		
+		///digits kept exactly; longer numbers keep their lowest digits over `10^18`, so modulus and comparisons still work
+		constexpr std::size_t MAX_OPERAND_DIGITS = 18u;
+		constexpr std::uint64_t OPERAND_OVERFLOW = 1'000'000'000'000'000'000u;
+		
+		std::uint64_t readOperandDigits(std::string_view digits) {
+			bool tooLong = digits.size() > MAX_OPERAND_DIGITS;
+			if( tooLong ) {
+				digits.remove_prefix(digits.size() - MAX_OPERAND_DIGITS);
+			}
+			std::uint64_t result = 0u;
+			for(char digit : digits) {
+				result = result * 10u + static_cast<std::uint64_t>(digit - '0');
+			}
+			return tooLong ? result + OPERAND_OVERFLOW : result;
+		}
+		
+		bool isDigit(char c) {
+			return c >= '0' && c <= '9';
+		}
+	
+	};
+	
+	PluralOperands pluralOperands(long integer) {
+		PluralOperands result;
+		//`-integer` overflows for the smallest `long`, its unsigned negation doesn't
+		result.i = integer < 0 ? 0ul - static_cast<unsigned long>(integer) : static_cast<unsigned long>(integer);
+		return result;
+	}
+	
+	PluralOperands pluralOperands(double real, short precision) {
+		//the sign, 309 integer digits, the dot and the fraction
+		char text[1 + 309 + 1 + 1074];
+		std::to_chars_result written;
+		if( precision < 0 ) {
+			written = std::to_chars(&text[0], &text[0] + sizeof(text), real, std::chars_format::fixed);
+		} else {
+			written = std::to_chars(&text[0], &text[0] + sizeof(text), real, std::chars_format::fixed, precision < 1074 ? precision : 1074);
+		}
+		if( written.ec != std::errc() ) {
+			return PluralOperands{};
+		}
+		return pluralOperands( std::string_view(&text[0], static_cast<std::size_t>(written.ptr - &text[0])) );
+	}
+	
+	PluralOperands pluralOperands(std::string_view decimal) {
+		if( !decimal.empty() && (decimal[0] == '-' || decimal[0] == '+') ) {
+			decimal.remove_prefix(1);
+		}
+		std::size_t integerEnd = 0u;
+		while( integerEnd < decimal.size() && isDigit(decimal[integerEnd]) ) {
+			++integerEnd;
+		}
+		PluralOperands result;
+		result.i = readOperandDigits( decimal.substr(0, integerEnd) );
+		if( integerEnd == decimal.size() || decimal[integerEnd] != '.' ) {
+			return result;
+		}
+		
+		std::string_view fraction = decimal.substr(integerEnd + 1u);
+		std::size_t fractionEnd = 0u;
+		while( fractionEnd < fraction.size() && isDigit(fraction[fractionEnd]) ) {
+			++fractionEnd;
+		}
+		//digits past the 18th are too small to matter
+		fraction = fraction.substr(0, fractionEnd < MAX_OPERAND_DIGITS ? fractionEnd : MAX_OPERAND_DIGITS);
+		result.v = static_cast<std::uint32_t>(fraction.size());
+		result.f = readOperandDigits(fraction);
+		
+		std::size_t significant = fraction.find_last_not_of('0');
+		fraction = significant == std::string_view::npos ? std::string_view{} : fraction.substr(0, significant + 1u);
+		result.w = static_cast<std::uint32_t>(fraction.size());
+		result.t = readOperandDigits(fraction);
+		return result;
+	}
+	
+	//------------- Parser
+	
+	namespace {
+		
+		///categories are stored in compiled programs as indexes of this list
+		constexpr const char* CATEGORY_NAMES[] = {"zero", "one", "two", "few", "many", "other"};
+		constexpr unsigned char OTHER_CATEGORY = 5u;
+		
+		std::string_view trimRule(std::string_view text) {
+			std::size_t begin = text.find_first_not_of(" \t\r\n");
+			if( begin == std::string_view::npos ) {
+				return std::string_view{};
+			}
+			std::size_t end = text.find_last_not_of(" \t\r\n");
+			return text.substr(begin, end - begin + 1u);
+		}
+		
+		bool isWordChar(char c) {
+			return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || isDigit(c) || c == '_';
+		}
+		
+		///reads a condition of a rule from the left, throwing on errors
+		class ConditionReader {
+				std::string_view text;
+				std::string_view wholeRules;
+			public:
+				ConditionReader(std::string_view condition, std::string_view rules): text{condition}, wholeRules{rules} {}
+				
+				[[noreturn]] void fail(const char* message) const {
+					throw InvalidPluralRules(std::string{message} + " at \"" + std::string{text} + "\" in: " + std::string{wholeRules});
+				}
+				
+				bool atEnd() {
+					text = trimRule(text);
+					return text.empty();
+				}
+				
+				///reads a symbol, or a keyword not followed by other letters
+				bool accept(std::string_view token) {
+					text = trimRule(text);
+					if( !text.starts_with(token) ) {
+						return false;
+					}
+					if( isWordChar(token.back()) && text.size() > token.size() && isWordChar(text[token.size()]) ) {
+						return false;
+					}
+					text.remove_prefix(token.size());
+					return true;
+				}
+				
+				std::uint64_t readValue() {
+					text = trimRule(text);
+					std::uint64_t value = 0u;
+					auto[lastPtr, err] = std::from_chars(text.data(), text.data() + text.size(), value);
+					if( err != std::errc() ) {
+						fail("A number expected");
+					}
+					text.remove_prefix(static_cast<std::size_t>(lastPtr - text.data()));
+					return value;
+				}
+				
+				char readOperand() {
+					text = trimRule(text);
+					if( text.empty() || (text.size() > 1u && isWordChar(text[1])) ) {
+						fail("An operand expected");
+					}
+					char operand = text[0];
+					text.remove_prefix(1);
+					return operand;
+				}
+		};
+	
+	};
+	
+	PluralRules::PluralRules() {
+		compile({}, {}, {}, {});
+	}
+	
+	PluralRules::PluralRules(std::string_view rules) {
+		using Operand = Relation::Operand;
+		std::vector<Range> newRanges;
+		std::vector<Relation> newRelations;
+		std::vector<std::uint32_t> newCategoryEnds;
+		std::vector<unsigned char> categoryCodes;
+		std::string_view rest = rules;
+		while( !rest.empty() ) {
+			std::size_t end = rest.find(';');
+			std::string_view rule = rest.substr(0, end);
+			rest = end == std::string_view::npos ? std::string_view{} : rest.substr(end + 1u);
+			if( trimRule(rule).empty() ) {
+				continue;
+			}
+			
+			std::size_t colon = rule.find(':');
+			if( colon == std::string_view::npos ) {
+				throw InvalidPluralRules("No ':' after the category name in: " + std::string{rules});
+			}
+			std::string_view name = trimRule(rule.substr(0, colon));
+			//samples are only for people
+			std::string_view condition = trimRule(rule.substr(colon + 1u, rule.find('@') - colon - 1u));
+			
+			unsigned char category = OTHER_CATEGORY + 1u;
+			for(unsigned char known=0u; known<=OTHER_CATEGORY; ++known) {
+				if( name == CATEGORY_NAMES[known] ) {
+					category = known;
+				}
+			}
+			if( category > OTHER_CATEGORY ) {
+				throw InvalidPluralRules("Unknown plural category \"" + std::string{name} + "\" in: " + std::string{rules});
+			}
+			if( std::find(categoryCodes.begin(), categoryCodes.end(), category) != categoryCodes.end() ) {
+				throw InvalidPluralRules("Repeated plural category \"" + std::string{name} + "\" in: " + std::string{rules});
+			}
+			if( category == OTHER_CATEGORY ) {
+				if( !condition.empty() ) {
+					throw InvalidPluralRules("The \"other\" category can't have a condition in: " + std::string{rules});
+				}
+				continue;
+			}
+			if( condition.empty() ) {
+				throw InvalidPluralRules("No condition of \"" + std::string{name} + "\" in: " + std::string{rules});
+			}
+			
+			ConditionReader reader{condition, rules};
+			do {
+				do {
+					Relation relation{0u, static_cast<std::uint32_t>(newRanges.size()), 0u, Operand::N, false, false, false};
+					switch( reader.readOperand() ) {
+						case 'n': relation.operand = Operand::N; break;
+						case 'i': relation.operand = Operand::I; break;
+						case 'v': relation.operand = Operand::V; break;
+						case 'w': relation.operand = Operand::W; break;
+						case 'f': relation.operand = Operand::F; break;
+						case 't': relation.operand = Operand::T; break;
+						//compact decimal exponent, numbers are never written in the compact form
+						case 'e':
+						case 'c': relation.operand = Operand::ZERO; break;
+						default: reader.fail("Unknown operand");
+					}
+					if( reader.accept("mod") || reader.accept("%") ) {
+						relation.modulus = reader.readValue();
+						if( relation.modulus == 0u ) {
+							reader.fail("Modulus of 0");
+						}
+					}
+					
+					if( reader.accept("!=") ) {
+						relation.negated = true;
+					} else if( reader.accept("is") ) {
+						relation.negated = reader.accept("not");
+					} else if( !reader.accept("=") ) {
+						relation.negated = reader.accept("not");
+						if( reader.accept("within") ) {
+							relation.within = true;
+						} else if( !reader.accept("in") ) {
+							reader.fail("A relation expected");
+						}
+					}
+					
+					do {
+						Range range;
+						range.from = reader.readValue();
+						range.to = reader.accept("..") ? reader.readValue() : range.from;
+						if( range.to < range.from ) {
+							reader.fail("An empty range");
+						}
+						newRanges.push_back(range);
+					} while( reader.accept(",") );
+					relation.rangesCount = static_cast<std::uint32_t>(newRanges.size()) - relation.firstRange;
+					newRelations.push_back(relation);
+				} while( reader.accept("and") );
+				newRelations.back().endsAndChain = true;
+			} while( reader.accept("or") );
+			if( !reader.atEnd() ) {
+				reader.fail("Unexpected text");
+			}
+			
+			categoryCodes.push_back(category);
+			newCategoryEnds.push_back( static_cast<std::uint32_t>(newRelations.size()) );
+		}
+		compile(newRanges, newRelations, newCategoryEnds, categoryCodes);
+	}
+	
+	PluralRules::PluralRules(std::span<const std::byte> program, std::shared_ptr<const void> owner): storage{std::move(owner)} {
+		readProgram(program);
+	}
+	
+	const std::vector<const char*>& PluralRules::getCategories() const {
+		return categories;
+	}
+	
+	std::span<const std::byte> PluralRules::program() const {
+		return programBytes;
+	}
+	
+	//------------- Compiled program
+	
+	namespace {
+		
+		///offsets of the parts of a compiled program
+		struct ProgramLayout {
+			std::uint64_t ranges;
+			std::uint64_t relations;
+			std::uint64_t categoryEnds;
+			std::uint64_t categoryCodes;
+			std::uint64_t integersTable;
+			std::uint64_t end;
+		};
+		
+		template<typename Header, typename Range, typename Relation>
+		ProgramLayout layoutOf(const Header& header) {
+			ProgramLayout layout;
+			layout.ranges = sizeof(Header);
+			layout.relations = layout.ranges + std::uint64_t{header.rangesCount} * sizeof(Range);
+			layout.categoryEnds = layout.relations + std::uint64_t{header.relationsCount} * sizeof(Relation);
+			layout.categoryCodes = layout.categoryEnds + std::uint64_t{header.categoriesCount} * sizeof(std::uint32_t);
+			layout.integersTable = layout.categoryCodes + header.categoriesCount;
+			layout.end = layout.integersTable + header.integersTableSize;
+			return layout;
+		}
+		
+		[[noreturn]] void failProgram(const char* reason) {
+			throw InvalidPluralRules(std::string{"Broken compiled plural rules: "} + reason);
+		}
+	
+	};
+	
+	void PluralRules::compile(
+		const std::vector<Range>& newRanges,
+		const std::vector<Relation>& newRelations,
+		const std::vector<std::uint32_t>& newCategoryEnds,
+		const std::vector<unsigned char>& categoryCodes
+	) {
+		static_assert(sizeof(ProgramHeader) == 24u && sizeof(Range) == 16u && sizeof(Relation) == 24u, "The compiled program has a fixed layout");
+		//the table's shape depends only on the relations, its entries are written after the program can be evaluated
+		ranges = newRanges;
+		relations = newRelations;
+		auto[tableSize, period] = integersTableShape();
+		
+		ProgramHeader header{
+			static_cast<std::uint32_t>(categoryCodes.size()),
+			static_cast<std::uint32_t>(newRelations.size()),
+			static_cast<std::uint32_t>(newRanges.size()),
+			static_cast<std::uint32_t>(tableSize),
+			period
+		};
+		const ProgramLayout layout = layoutOf<ProgramHeader, Range, Relation>(header);
+		//words keep the program aligned, and are zeroed
+		auto words = std::make_shared<std::uint64_t[]>( (layout.end + 7u) / 8u );
+		std::byte* bytes = reinterpret_cast<std::byte*>( words.get() );
+		std::memcpy(bytes, &header, sizeof(header));
+		std::memcpy(bytes + layout.ranges, newRanges.data(), newRanges.size() * sizeof(Range));
+		std::memcpy(bytes + layout.relations, newRelations.data(), newRelations.size() * sizeof(Relation));
+		std::memcpy(bytes + layout.categoryEnds, newCategoryEnds.data(), newCategoryEnds.size() * sizeof(std::uint32_t));
+		std::memcpy(bytes + layout.categoryCodes, categoryCodes.data(), categoryCodes.size());
+		storage = words;
+		readProgram( std::span<const std::byte>(bytes, layout.end) );
+		
+		unsigned char* table = reinterpret_cast<unsigned char*>(bytes + layout.integersTable);
+		for(std::uint64_t number=0u; number<tableSize; ++number) {
+			PluralOperands operands;
+			operands.i = number;
+			table[number] = static_cast<unsigned char>( evaluate(operands) );
+		}
+	}
+	
+	void PluralRules::readProgram(std::span<const std::byte> program) {
+		if( reinterpret_cast<std::uintptr_t>(program.data()) % alignof(std::uint64_t) != 0u ) {
+			failProgram("not aligned to 8 bytes");
+		}
+		if( program.size() < sizeof(ProgramHeader) ) {
+			failProgram("too short");
+		}
+		ProgramHeader header;
+		std::memcpy(&header, program.data(), sizeof(header));
+		const ProgramLayout layout = layoutOf<ProgramHeader, Range, Relation>(header);
+		if( layout.end > program.size() ) {
+			failProgram("too short");
+		}
+		if( header.categoriesCount > OTHER_CATEGORY ) {
+			failProgram("too many categories");
+		}
+		const std::byte* base = program.data();
+		
+		ranges = std::span<const Range>(reinterpret_cast<const Range*>(base + layout.ranges), header.rangesCount);
+		for(auto& range : ranges) {
+			if( range.to < range.from ) {
+				failProgram("an empty range");
+			}
+		}
+		//flags are checked as bytes before they are read as `bool`
+		for(std::uint32_t relation=0u; relation<header.relationsCount; ++relation) {
+			const std::byte* raw = base + layout.relations + relation * sizeof(Relation);
+			if(
+				std::to_integer<unsigned>(raw[offsetof(Relation, operand)]) > static_cast<unsigned>(Relation::Operand::ZERO)
+				|| std::to_integer<unsigned>(raw[offsetof(Relation, negated)]) > 1u
+				|| std::to_integer<unsigned>(raw[offsetof(Relation, within)]) > 1u
+				|| std::to_integer<unsigned>(raw[offsetof(Relation, endsAndChain)]) > 1u
+			) {
+				failProgram("an invalid relation");
+			}
+		}
+		relations = std::span<const Relation>(reinterpret_cast<const Relation*>(base + layout.relations), header.relationsCount);
+		for(auto& relation : relations) {
+			if( std::uint64_t{relation.firstRange} + relation.rangesCount > header.rangesCount ) {
+				failProgram("a relation past the ranges");
+			}
+		}
+		
+		categoryEnds = std::span<const std::uint32_t>(reinterpret_cast<const std::uint32_t*>(base + layout.categoryEnds), header.categoriesCount);
+		std::uint32_t previousEnd = 0u;
+		for(std::uint32_t end : categoryEnds) {
+			if( end < previousEnd || end > header.relationsCount ) {
+				failProgram("a category past the relations");
+			}
+			previousEnd = end;
+		}
+		categories.clear();
+		for(std::uint32_t category=0u; category<header.categoriesCount; ++category) {
+			const unsigned char code = std::to_integer<unsigned char>(base[layout.categoryCodes + category]);
+			if( code >= OTHER_CATEGORY ) {
+				failProgram("an unknown category");
+			}
+			if( std::find(categories.begin(), categories.end(), CATEGORY_NAMES[code]) != categories.end() ) {
+				failProgram("a repeated category");
+			}
+			categories.push_back(CATEGORY_NAMES[code]);
+		}
+		categories.push_back(CATEGORY_NAMES[OTHER_CATEGORY]);
+		
+		integersTable = std::span<const unsigned char>(reinterpret_cast<const unsigned char*>(base + layout.integersTable), header.integersTableSize);
+		integersPeriod = 1u;
+		if( !integersTable.empty() ) {
+			if( header.integersPeriod == 0u || header.integersPeriod > integersTable.size() ) {
+				failProgram("a wrong period of the table of integers");
+			}
+			for(unsigned char category : integersTable) {
+				if( category > header.categoriesCount ) {
+					failProgram("an unknown category in the table of integers");
+				}
+			}
+			integersPeriod = header.integersPeriod;
+		}
+		programBytes = program.first(layout.end);
+	}
+	
+	//------------- Evaluation
+	
+	bool PluralRules::matches(const Relation& relation, const PluralOperands& number) const {
+		using Operand = Relation::Operand;
+		std::uint64_t value = 0u;
+		//only `n` can have a fraction, its integer part is `i`
+		bool hasFraction = false;
+		switch( relation.operand ) {
+			case Operand::N: value = number.i; hasFraction = number.t != 0u; break;
+			case Operand::I: value = number.i; break;
+			case Operand::V: value = number.v; break;
+			case Operand::W: value = number.w; break;
+			case Operand::F: value = number.f; break;
+			case Operand::T: value = number.t; break;
+			case Operand::ZERO: break;
+		}
+		if( relation.modulus != 0u ) {
+			//32-bit division is a few times faster
+			if( (value | relation.modulus) <= 0xFFFF'FFFFu ) {
+				value = static_cast<std::uint32_t>(value) % static_cast<std::uint32_t>(relation.modulus);
+			} else {
+				value %= relation.modulus;
+			}
+		}
+		
+		bool found = false;
+		const Range* range = ranges.data() + relation.firstRange;
+		const Range* rangesEnd = range + relation.rangesCount;
+		if( hasFraction ) {
+			//a number with a fraction is never `in` a range of integers, but can be `within` it
+			for(; relation.within && range != rangesEnd; ++range) {
+				found |= (range->from <= value) & (value < range->to);
+			}
+		} else {
+			for(; range != rangesEnd; ++range) {
+				found |= (range->from <= value) & (value <= range->to);
+			}
+		}
+		return found != relation.negated;
+	}
+	
+	std::size_t PluralRules::evaluate(const PluralOperands& number) const {
+		std::uint32_t relation = 0u;
+		for(std::size_t category=0u; category<categoryEnds.size(); ++category) {
+			bool chainHolds = true;
+			bool anyChainHolds = false;
+			for(; relation<categoryEnds[category]; ++relation) {
+				//the rest of a failed `and` chain isn't checked
+				chainHolds = chainHolds && matches(relations[relation], number);
+				if( relations[relation].endsAndChain ) {
+					anyChainHolds |= chainHolds;
+					chainHolds = true;
+				}
+			}
+			if( anyChainHolds ) {
+				return category;
+			}
+		}
+		//other
+		return categories.size() - 1u;
+	}
+	
+	std::pair<std::uint64_t, std::uint64_t> PluralRules::integersTableShape() const {
+		using Operand = Relation::Operand;
+		//an integer's category depends only on `i`: ranges compared with `i` end below the `threshold`
+		// and categories of larger integers repeat with the `period`, the common multiple of moduli of `i`
+		std::uint64_t threshold = 0u;
+		std::uint64_t period = 1u;
+		for(auto& relation : relations) {
+			if( relation.operand != Operand::N && relation.operand != Operand::I ) {
+				continue;
+			}
+			if( relation.modulus != 0u ) {
+				period = std::lcm(period, relation.modulus);
+				if( period > MAX_INTEGERS_TABLE ) {
+					return {0u, 1u};
+				}
+				continue;
+			}
+			for(std::uint32_t range=relation.firstRange; range<relation.firstRange + relation.rangesCount; ++range) {
+				if( ranges[range].to >= MAX_INTEGERS_TABLE ) {
+					return {0u, 1u};
+				}
+				threshold = std::max(threshold, ranges[range].to + 1u);
+			}
+		}
+		
+		//the last period of the table starts at or above the threshold
+		const std::uint64_t size = ((threshold + period - 1u) / period + 1u) * period;
+		if( size > 2u * MAX_INTEGERS_TABLE ) {
+			return {0u, 1u};
+		}
+		return {size, period};
+	}
+	
+	std::size_t PluralRules::select(const PluralOperands& number) const {
+		if( number.v == 0u ) {
+			return select(number.i);
+		}
+		return evaluate(number);
+	}
+	
+	std::size_t PluralRules::select(std::uint64_t number) const {
+		if( integersTable.empty() ) {
+			PluralOperands operands;
+			operands.i = number;
+			return evaluate(operands);
+		}
+		if( number < integersTable.size() ) {
+			return integersTable[number];
+		}
+		return integersTable[integersTable.size() - integersPeriod + number % integersPeriod];
+	}
+	
+	//------------- Rules of languages
+	
+	/*
+	
+	=================== CLDR plural rules ===================
+	based on: https://unicode-org.github.io/cldr-staging/charts/latest/supplemental/language_plural_rules.html
+	
+	*/
+	
+	// cSpell: disable
+	namespace {
+		
+		struct LanguageRules {
+			std::string_view language;
+			const char* rules;
+		};
+		
+		constexpr const char* EAST_SLAVIC_RULES =
+			"one: v = 0 and i % 10 = 1 and i % 100 != 11;"
+			"few: v = 0 and i % 10 = 2..4 and i % 100 != 12..14;"
+			"many: v = 0 and i % 10 = 0 or v = 0 and i % 10 = 5..9 or v = 0 and i % 100 = 11..14";
+		constexpr const char* WEST_SLAVIC_RULES =
+			"one: i = 1 and v = 0; few: i = 2..4 and v = 0; many: v != 0";
+		constexpr const char* SOUTH_SLAVIC_RULES =
+			"one: v = 0 and i % 10 = 1 and i % 100 != 11 or f % 10 = 1 and f % 100 != 11;"
+			"few: v = 0 and i % 10 = 2..4 and i % 100 != 12..14 or f % 10 = 2..4 and f % 100 != 12..14";
+		constexpr const char* ONE_IF_INTEGER_1 = "one: i = 1 and v = 0";
+		constexpr const char* ONE_IF_1 = "one: n = 1";
+		constexpr const char* ONE_IF_0_OR_1 = "one: i = 0 or n = 1";
+		constexpr const char* ONLY_OTHER = "";
+		
+		///sorted by the language code
+		constexpr LanguageRules LANGUAGES_RULES[] = {
+			{"ar", "zero: n = 0; one: n = 1; two: n = 2; few: n % 100 = 3..10; many: n % 100 = 11..99"},
+			{"be",
+				"one: n % 10 = 1 and n % 100 != 11;"
+				"few: n % 10 = 2..4 and n % 100 != 12..14;"
+				"many: n % 10 = 0 or n % 10 = 5..9 or n % 100 = 11..14"},
+			{"bg", ONE_IF_1},
+			{"bn", ONE_IF_0_OR_1},
+			{"bs", SOUTH_SLAVIC_RULES},
+			{"ca", ONE_IF_INTEGER_1},
+			{"cs", WEST_SLAVIC_RULES},
+			{"cy", "zero: n = 0; one: n = 1; two: n = 2; few: n = 3; many: n = 6"},
+			{"da", "one: n = 1 or t != 0 and i = 0,1"},
+			{"de", ONE_IF_INTEGER_1},
+			{"el", ONE_IF_1},
+			{"en", ONE_IF_INTEGER_1},
+			{"es", ONE_IF_1},
+			{"et", ONE_IF_INTEGER_1},
+			{"fa", ONE_IF_0_OR_1},
+			{"fi", ONE_IF_INTEGER_1},
+			{"fr", "one: i = 0,1"},
+			{"ga", "one: n = 1; two: n = 2; few: n = 3..6; many: n = 7..10"},
+			{"gd", "one: n = 1,11; two: n = 2,12; few: n = 3..10,13..19"},
+			{"he", "one: i = 1 and v = 0; two: i = 2 and v = 0; many: v = 0 and n != 0..10 and n % 10 = 0"},
+			{"hi", ONE_IF_0_OR_1},
+			{"hr", SOUTH_SLAVIC_RULES},
+			{"hu", ONE_IF_1},
+			{"id", ONLY_OTHER},
+			{"is", "one: t = 0 and i % 10 = 1 and i % 100 != 11 or t != 0"},
+			{"it", ONE_IF_INTEGER_1},
+			{"ja", ONLY_OTHER},
+			{"ka", ONE_IF_1},
+			{"kk", ONE_IF_1},
+			{"ko", ONLY_OTHER},
+			{"lt", "one: n % 10 = 1 and n % 100 != 11..19; few: n % 10 = 2..9 and n % 100 != 11..19; many: f != 0"},
+			{"lv",
+				"zero: n % 10 = 0 or n % 100 = 11..19 or v = 2 and f % 100 = 11..19;"
+				"one: n % 10 = 1 and n % 100 != 11 or v = 2 and f % 10 = 1 and f % 100 != 11 or v != 2 and f % 10 = 1"},
+			{"mk", "one: v = 0 and i % 10 = 1 and i % 100 != 11 or f % 10 = 1 and f % 100 != 11"},
+			{"ms", ONLY_OTHER},
+			{"nb", ONE_IF_1},
+			{"nl", ONE_IF_INTEGER_1},
+			{"pl",
+				"one: i = 1 and v = 0;"
+				"few: v = 0 and i % 10 = 2..4 and i % 100 != 12..14;"
+				"many: v = 0 and i != 1 and i % 10 = 0..1 or v = 0 and i % 10 = 5..9 or v = 0 and i % 100 = 12..14"},
+			{"pt", "one: i = 0..1"},
+			{"ro", "one: i = 1 and v = 0; few: v != 0 or n = 0 or n % 100 = 2..19"},
+			{"ru", EAST_SLAVIC_RULES},
+			{"sk", WEST_SLAVIC_RULES},
+			{"sl", "one: v = 0 and i % 100 = 1; two: v = 0 and i % 100 = 2; few: v = 0 and i % 100 = 3..4 or v != 0"},
+			{"sq", ONE_IF_1},
+			{"sr", SOUTH_SLAVIC_RULES},
+			{"sv", ONE_IF_INTEGER_1},
+			{"th", ONLY_OTHER},
+			{"tr", ONE_IF_1},
+			{"uk", EAST_SLAVIC_RULES},
+			{"vi", ONLY_OTHER},
+			{"zh", ONLY_OTHER}
+		};
+	
+	};
+	// cSpell: enable
+	
+	const char* cldrPluralRules(std::string_view language) {
+		for(auto& entry : LANGUAGES_RULES) {
+			if( entry.language == language ) {
+				return entry.rules;
+			}
+		}
+		return nullptr;
+	}
+
+};
+
+//CUT-END
@@ -0,0 +1,136 @@
+#pragma once
+#ifndef MULAN_STRING_PLURAL_RULES
+#define MULAN_STRING_PLURAL_RULES
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// cSpell: words CLDR
+//CUT-START
+
+namespace mls::locale {
+	
+	/**
+	 * @brief Operands of a number used by CLDR plural rules
+	 * 
+	 * See https://unicode.org/reports/tr35/tr35-numbers.html#Operands
+	 */
+	struct PluralOperands {
+		///the integer digits of the absolute value
+		std::uint64_t i = 0u;
+		///count of visible fraction digits, with trailing zeros
+		std::uint32_t v = 0u;
+		///count of visible fraction digits, without trailing zeros
+		std::uint32_t w = 0u;
+		///visible fraction digits, with trailing zeros
+		std::uint64_t f = 0u;
+		///visible fraction digits, without trailing zeros
+		std::uint64_t t = 0u;
+	};
+	
+	PluralOperands pluralOperands(long integer);
+	///operands of a real number written with the given precision, `-1` is the shortest text which reads back the same
+	PluralOperands pluralOperands(double real, short precision = -1);
+	///operands of a number written in decimal, like `"1.50"`
+	PluralOperands pluralOperands(std::string_view decimal);
+	
+	/**
+	 * @brief CLDR plural rules compiled into a table of relations
+	 * 
+	 * Categories of integers are also kept in a table, so selecting them takes a lookup.
+	 * The rules are written like in CLDR: `"one: i = 1 and v = 0; few: v = 0 and i % 10 = 2..4"`.
+	 * Samples after `@` are ignored, `other` needs no condition and is always the last category.
+	 * The operands `e` and `c` (compact exponent) are always 0.
+	 * Invalid rules throw `InvalidPluralRules`.
+	 */
+	class PluralRules {
+		public:
+			///only the `other` category
+			PluralRules();
+			explicit PluralRules(std::string_view rules);
+			/**
+			 * @brief Rules compiled before, read in place from the output of `program()`
+			 * 
+			 * The program must be aligned to 8 bytes and made on a machine with the same byte order.
+			 * `owner` keeps the program's memory alive. A broken program throws `InvalidPluralRules`.
+			 */
+			PluralRules(std::span<const std::byte> program, std::shared_ptr<const void> owner);
+			
+			///names of categories, in the order of indexes returned by `select(...)`
+			const std::vector<const char*>& getCategories() const;
+			///the category of a non-negative integer
+			std::size_t select(std::uint64_t number) const;
+			std::size_t select(const PluralOperands& number) const;
+			///the compiled rules, which can be saved and read back by the constructor
+			std::span<const std::byte> program() const;
+		private:
+			///the start of a program, followed by its ranges, relations, ends and codes of categories and the table of integers
+			struct ProgramHeader {
+				///categories but `other`
+				std::uint32_t categoriesCount;
+				std::uint32_t relationsCount;
+				std::uint32_t rangesCount;
+				std::uint32_t integersTableSize;
+				std::uint64_t integersPeriod;
+			};
+			struct Relation {
+				enum class Operand : unsigned char {N, I, V, W, F, T, ZERO};
+				///`0` if there is no modulus
+				std::uint64_t modulus;
+				std::uint32_t firstRange;
+				std::uint32_t rangesCount;
+				Operand operand;
+				///`!=` or `not in`
+				bool negated;
+				///`within` also matches numbers with fractions between the ends of a range
+				bool within;
+				///the last relation of an `and` chain
+				bool endsAndChain;
+			};
+			struct Range {
+				std::uint64_t from;
+				std::uint64_t to;
+			};
+			
+			///keeps the program alive, shared by copies
+			std::shared_ptr<const void> storage;
+			std::span<const std::byte> programBytes;
+			std::vector<const char*> categories;
+			///the end of relations of each category but `other`
+			std::span<const std::uint32_t> categoryEnds;
+			std::span<const Relation> relations;
+			std::span<const Range> ranges;
+			///categories of integers, larger ones repeat the last `integersPeriod` entries; empty if too big
+			std::span<const unsigned char> integersTable;
+			std::uint64_t integersPeriod = 1u;
+			static constexpr std::uint64_t MAX_INTEGERS_TABLE = 2048u;
+			
+			bool matches(const Relation& relation, const PluralOperands& number) const;
+			///runs the relations, the slow way
+			std::size_t evaluate(const PluralOperands& number) const;
+			///lays out the program and fills its table of integers
+			void compile(
+				const std::vector<Range>& newRanges,
+				const std::vector<Relation>& newRelations,
+				const std::vector<std::uint32_t>& newCategoryEnds,
+				const std::vector<unsigned char>& categoryCodes
+			);
+			///points the spans into the program, checking it
+			void readProgram(std::span<const std::byte> program);
+			///the size of the table of integers and its period; a size of 0 if the table would be too big
+			std::pair<std::uint64_t, std::uint64_t> integersTableShape() const;
+	};
+	
+	///CLDR plural rules of a language given by its code, like `"pl"`; `nullptr` if unknown
+	const char* cldrPluralRules(std::string_view language);
+
+};
+
+//CUT-END
+
+#endif //!MULAN_STRING_PLURAL_RULES
@@ -4,360 +4,223 @@
  * 
  */
 
+#include <bit>
+#include <cstring>
+
 #include "preparser.h"
 #include "errors.h"
 
 //CUT-START
 
+#if !defined(MULANSTR_NO_SIMD) && (defined(__x86_64__) || defined(_M_X64))
+#	define MULANSTR_SIMD_X86
+#	include <immintrin.h>
+#	ifdef _MSC_VER
+#		include <intrin.h>
+#	endif
+#endif
+
 namespace mls::preparse {
 	
-	//------------ Configuration
-	
-	#ifdef MULANSTR_TAG_START
-	constexpr std::string_view TEMPLATE_START{MULANSTR_TAG_START};
-	#else
-	constexpr std::string_view TEMPLATE_START{"%{"};
-	#endif
-	
-	#ifdef MULANSTR_TAG_END
-	constexpr std::string_view TEMPLATE_END{MULANSTR_TAG_END};
-	#else
-	constexpr std::string_view TEMPLATE_END{"}%"};
-	#endif
-	
-	#ifdef MULANSTR_INNER_TAG_START
-	constexpr std::string_view INNER_TAG_START{MULANSTR_INNER_TAG_START};
-	#else
-	constexpr std::string_view INNER_TAG_START{"{"};
-	#endif
-	
-	#ifdef MULANSTR_INNER_TAG_END
-	constexpr std::string_view INNER_TAG_END{MULANSTR_INNER_TAG_END};
-	#else
-	constexpr std::string_view INNER_TAG_END{"}"};
-	#endif
-	
-	//-------------- Utility functions (ref)
-	
-	std::pair<std::string_view, std::string_view> 
-		breakInHalfOn( std::string_view source, std::string_view delimiter );
-	
-	bool contains( std::string_view container, std::string_view searched );
+	//-------------- Searching with vector instructions
+	// Blocks of text are compared with the first and the last character of the searched text at once, 
+	// only positions matching both are compared in full. Text without the first character is skipped 
+	// at the speed of reading memory.
 	
-	char *copyStringView( const std::string_view theView );
-	std::string copyStringViewAsString( const std::string_view theView );
-	
-	std::string_view trim(std::string_view theView);
-	
-	//-------------- The main function
-	
-	ParsedTemplateFunction* parse_template_contents(std::string_view content);
+	std::size_t findTextScalar(std::string_view source, std::string_view searched) {
+		return source.find(searched);
+	}
 	
-	std::pair<std::vector<char*>, std::vector<ParsedTemplateFunction*>>
-		preparse_template(std::string_view templateString) 
-	{
-		std::vector<char*> resultStrings;
-		std::vector<ParsedTemplateFunction*> resultFunctions;
-		
-		//check if we have got a template string
-		if( !contains(templateString, TEMPLATE_START) ) {
-			//not a template - just copy
-			resultStrings.push_back( copyStringView(templateString) );
-		} else {
-			//a rightful template
-			while( ! templateString.empty() ) {
-				auto[prefix, firstHalf] = breakInHalfOn(templateString, TEMPLATE_START);
-				resultStrings.push_back( copyStringView(prefix) );
-				
-				if( !contains(firstHalf, TEMPLATE_END) ) {//Wrong template
-					#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
-					//clean the result vars
-					for(char* el : resultStrings) {
-						delete[] el;
-					}
-					for(auto el : resultFunctions) {
-						delete el;
-					}
-					throw InvalidTemplateState{"No ending marker"};
-					#else
-					return {resultStrings, resultFunctions};
-					#endif
-				}
-				
-				auto[templateContent, suffix] = breakInHalfOn(firstHalf, TEMPLATE_END);
-				
-				try{
-					resultFunctions.push_back( parse_template_contents(templateContent) );
-				}
-				catch(InvalidTemplateState e) {
-					//clean the result vars
-					for(char* el : resultStrings) {
-						delete[] el;
-					}
-					for(auto el : resultFunctions) {
-						delete el;
-					}
-					throw e;
-				}
-				
-				if( contains(suffix, TEMPLATE_START) ) {//next template?
-					templateString = suffix;
-				} else {
-					//add the last string
-					resultStrings.push_back( copyStringView(suffix) );
-					templateString = std::string_view();
-				}
+	#ifdef MULANSTR_SIMD_X86
+	
+	///checks positions `offset + n` for every bit `n` set in the `mask`
+	inline std::size_t checkCandidates(
+		std::string_view source, 
+		std::string_view searched, 
+		std::size_t offset, 
+		std::uint32_t mask
+	) {
+		while( mask != 0u ) {
+			std::size_t pos = offset + static_cast<std::size_t>( std::countr_zero(mask) );
+			if( std::memcmp(source.data() + pos + 1, searched.data() + 1, searched.size() - 1u) == 0 ) {
+				return pos;
 			}
+			mask &= mask - 1u;
 		}
-		
-		return {resultStrings, resultFunctions};
+		return std::string_view::npos;
 	}
 	
-	constexpr std::string_view VAR_FN_DIVIDER{"!"};
-	constexpr std::string_view NO_VAR_FN{"+"};
-	constexpr char COMMENT_MARKER = '#';
-	
-	constexpr std::string_view FN_ARGS_DIV_ALL{"=: "};
-	constexpr char FN_ARGS_DIV_ONE = '=';
-	constexpr char FN_ARGS_DIV_TABLE = ':';
-	constexpr char FN_ARGS_DIV_HASH = ' ';
+	///the rest of the text, too short for a block
+	inline std::size_t findInTail(std::string_view source, std::string_view searched, std::size_t offset) {
+		auto found = source.substr(offset).find(searched);
+		return found == std::string_view::npos ? found : offset + found;
+	}
 	
-	ParsedTemplateFunction* parse_template_contents(std::string_view content) {
-		std::string varName{""};
-		bool hasFn = false;
-		//check for comments
-		if( content.starts_with(COMMENT_MARKER) && content.ends_with(COMMENT_MARKER) ) {
-			return nullptr; 
-		}
-		//extract var name
-		if( content.starts_with(NO_VAR_FN) ) {
-			//this is a no-var function
-			content.remove_prefix(NO_VAR_FN.size());
-			hasFn = true;
-		} else {
-			//look for name
-			if( contains(content, VAR_FN_DIVIDER) ) {
-				auto[varNameVS, theRest] = breakInHalfOn(content, VAR_FN_DIVIDER);
-				varName = copyStringViewAsString(varNameVS);
-				content = theRest;
-				hasFn = true;
-			} else {
-				//only var name
-				varName = copyStringViewAsString(content);
-			}
+	std::size_t findTextSSE2(std::string_view source, std::string_view searched) {
+		constexpr std::size_t BLOCK = 16u;
+		if( searched.empty() || source.size() < searched.size() + BLOCK ) {
+			return findTextScalar(source, searched);
 		}
-		//return the right function class
-		if( !hasFn ) {
-			VarOnlyFunction* result = new VarOnlyFunction();
-			result->varName = std::move(varName);
-			result->name[0] = result->name[1] = '\0';
-			
-			return result;
-		} else {
-			auto nameArgsDivider = content.find_first_of(FN_ARGS_DIV_ALL);
-			
-			if( nameArgsDivider == std::string_view::npos ) {
-				//no required element - error
-				#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
-				throw InvalidTemplateState("No function-parameters divider");
-				#else
-				return nullptr;
-				#endif
-			}
-			
-			if( nameArgsDivider != 1 && nameArgsDivider != 2 ) {
-				//wrong function name length
-				#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
-				throw InvalidTemplateState("Wrong function name length");
-				#else
-				return nullptr;
-				#endif
-			}
-			
-			ParsedTemplateFunction* result;
-			try{
-				switch( content[nameArgsDivider] ) {
-					case FN_ARGS_DIV_ONE:
-						result = new OneArgFunction(content.substr(nameArgsDivider+1));
-						break;
-					case FN_ARGS_DIV_TABLE:
-						result = new TableArgFunction(content.substr(nameArgsDivider+1));
-						break;
-					case FN_ARGS_DIV_HASH:
-						result = new HashArgFunction(content.substr(nameArgsDivider+1));
-						break;
-					default: //shouldn't reach
-						#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
-						throw InvalidTemplateState("Unknown function-parameters divider");
-						#else
-						return nullptr;
-						#endif
-				}
-			} catch(InvalidTemplateState e) {
-				#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
-				throw e;
-				#else
-				return nullptr;
-				#endif
+		const std::size_t lastOffset = searched.size() - 1u;
+		const __m128i first = _mm_set1_epi8(searched.front());
+		const __m128i last = _mm_set1_epi8(searched.back());
+		
+		std::size_t i = 0u;
+		for(; i + lastOffset + BLOCK <= source.size(); i += BLOCK) {
+			const __m128i blockFirst = _mm_loadu_si128( reinterpret_cast<const __m128i*>(source.data() + i) );
+			const __m128i blockLast = _mm_loadu_si128( reinterpret_cast<const __m128i*>(source.data() + i + lastOffset) );
+			const __m128i matches = _mm_and_si128( _mm_cmpeq_epi8(first, blockFirst), _mm_cmpeq_epi8(last, blockLast) );
+			auto found = checkCandidates(source, searched, i, static_cast<std::uint32_t>( _mm_movemask_epi8(matches) ));
+			if( found != std::string_view::npos ) {
+				return found;
 			}
-			result->varName = std::move(varName);
-			result->name[0] = content[0];
-			if( nameArgsDivider == 2 )
-				result->name[1] = content[1];
-			else
-				result->name[1] = '\0';
-			
-			return result;
 		}
+		return findInTail(source, searched, i);
 	}
 	
-	//-------------- Utility functions
-	
-	std::pair<std::string_view, std::string_view> 
-		breakInHalfOn( std::string_view source, std::string_view delimiter )
-	{
-		auto delimPos = source.find( delimiter );
-		if( delimPos != source.npos ) {
-			return {
-				source.substr(0, delimPos),
-				source.substr(delimPos + delimiter.size())
-			};
-		} else {
-			return {
-				source,
-				std::string_view()
-			};
-		}
-	}
-	
-	bool contains( std::string_view container, std::string_view searched )
-	{
-		auto pos = container.find( searched );
-		if( pos == container.npos )
-			return false;
-		else
-			return true;
-	}
+	#if defined(__GNUC__) || defined(__clang__)
+	#	define MULANSTR_TARGET_AVX2 __attribute__((target("avx2")))
+	#else
+	#	define MULANSTR_TARGET_AVX2
+	#endif
 	
-	char *copyStringView( const std::string_view theView )
-	{
-		char *result = new char[theView.size() + 1];
-		theView.copy( result, theView.size() );
-		result[theView.size()] = 0;
-		return result;
+	///bytes of a 32 bytes block which match the first and the last character of the searched text
+	MULANSTR_TARGET_AVX2
+	inline std::uint32_t matchesAVX2(const char* block, std::size_t lastOffset, __m256i first, __m256i last) {
+		const __m256i blockFirst = _mm256_loadu_si256( reinterpret_cast<const __m256i*>(block) );
+		const __m256i blockLast = _mm256_loadu_si256( reinterpret_cast<const __m256i*>(block + lastOffset) );
+		const __m256i matches = _mm256_and_si256( _mm256_cmpeq_epi8(first, blockFirst), _mm256_cmpeq_epi8(last, blockLast) );
+		return static_cast<std::uint32_t>( _mm256_movemask_epi8(matches) );
 	}
 	
-	std::string copyStringViewAsString( const std::string_view theView ) {
-		char* copy = copyStringView( theView );
-		std::string strCopy{copy};
-		delete[] copy;
-		return strCopy;
+	///whether any byte of a 128 bytes chunk, aligned to 32 bytes, is the first character of the searched text
+	MULANSTR_TARGET_AVX2
+	inline bool anyFirstAVX2(const char* chunk, __m256i first) {
+		const __m256i* blocks = reinterpret_cast<const __m256i*>(chunk);
+		const __m256i any = _mm256_or_si256(
+			_mm256_or_si256( 
+				_mm256_cmpeq_epi8(first, _mm256_load_si256(blocks)), 
+				_mm256_cmpeq_epi8(first, _mm256_load_si256(blocks + 1)) 
+			),
+			_mm256_or_si256( 
+				_mm256_cmpeq_epi8(first, _mm256_load_si256(blocks + 2)), 
+				_mm256_cmpeq_epi8(first, _mm256_load_si256(blocks + 3)) 
+			)
+		);
+		return !_mm256_testz_si256(any, any);
 	}
 	
-	std::string_view trim(std::string_view theView) {
-		auto pos = theView.find_first_not_of(" ");
-		if( pos != std::string_view::npos ) {
-			theView.remove_prefix(pos);
+	MULANSTR_TARGET_AVX2
+	std::size_t findTextAVX2(std::string_view source, std::string_view searched) {
+		constexpr std::size_t BLOCK = 32u;
+		constexpr std::size_t CHUNK = 4u * BLOCK;
+		if( searched.empty() || source.size() < searched.size() + CHUNK ) {
+			return findTextSSE2(source, searched);
+		}
+		const std::size_t lastOffset = searched.size() - 1u;
+		const __m256i first = _mm256_set1_epi8(searched.front());
+		const __m256i last = _mm256_set1_epi8(searched.back());
+		
+		//the text up to the first aligned chunk
+		std::size_t i = (BLOCK - reinterpret_cast<std::uintptr_t>(source.data()) % BLOCK) % BLOCK;
+		auto found = findTextSSE2(source.substr(0u, i + lastOffset), searched);
+		if( found != std::string_view::npos ) {
+			return found;
 		}
-		pos = theView.find_first_of(" ");
-		if( pos != std::string_view::npos ) {
-			theView.remove_suffix(theView.size() - pos);
+		for(; i + lastOffset + CHUNK <= source.size(); i += CHUNK) {
+			//text without the first character is skipped with one branch per chunk
+			if( !anyFirstAVX2(source.data() + i, first) ) {
+				continue;
+			}
+			for(std::size_t block = i; block < i + CHUNK; block += BLOCK) {
+				found = checkCandidates(source, searched, block, matchesAVX2(source.data() + block, lastOffset, first, last));
+				if( found != std::string_view::npos ) {
+					return found;
+				}
+			}
 		}
-		return theView;
+		return findInTail(source, searched, i);
 	}
 	
-	//-------------- class methods
-	
-	ParsedTemplateFunction::Type VarOnlyFunction::getType() const {
-		return ParsedTemplateFunction::Type::VAR_ONLY;
+	bool hasAVX2() {
+		#if defined(__GNUC__) || defined(__clang__)
+		//templates may be parsed by constructors of global objects, before the CPU info is ready
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2");
+		#elif defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 1);
+		bool savesYmmRegisters = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6u) == 6u;
+		__cpuidex(info, 7, 0);
+		return savesYmmRegisters && (info[1] & (1 << 5)) != 0;
+		#else
+		return false;
+		#endif
 	}
 	
-	ParsedTemplateFunction::Type OneArgFunction::getType() const {
-		return ParsedTemplateFunction::Type::ONE_ARG;
-	}
+	#endif //MULANSTR_SIMD_X86
 	
-	ParsedTemplateFunction::Type TableArgFunction::getType() const {
-		return ParsedTemplateFunction::Type::TABLE_ARG;
+	std::size_t find_text(std::string_view source, std::string_view searched) {
+		#ifdef MULANSTR_SIMD_X86
+		using FindFunction = std::size_t (*)(std::string_view, std::string_view);
+		static const FindFunction findBest = hasAVX2() ? findTextAVX2 : findTextSSE2;
+		return findBest(source, searched);
+		#else
+		return findTextScalar(source, searched);
+		#endif
 	}
 	
-	ParsedTemplateFunction::Type HashArgFunction::getType() const {
-		return ParsedTemplateFunction::Type::HASH_ARG;
-	}
+	//-------------- The main functions
 	
-	OneArgFunction::OneArgFunction(std::string_view templateContent) {
-		if( templateContent.empty() ) {
-			throw InvalidTemplateState("Empty argument");
-		}
-		argument = copyStringViewAsString(templateContent);
+	///copies the template string into `source` and returns a view of the copy
+	std::string_view copySource(std::unique_ptr<char[]> &source, std::string_view templateString) {
+		source.reset( new char[templateString.size() + 1] );
+		templateString.copy( source.get(), templateString.size() );
+		source[templateString.size()] = '\0';
+		return std::string_view{ source.get(), templateString.size() };
 	}
 	
-	TableArgFunction::TableArgFunction(std::string_view templateContent) {
-		if( templateContent.empty() ) {
-			throw InvalidTemplateState("Empty argument list");
-		}
+	PreparsedSyntax preparse_syntax(std::string_view templateString) 
+	{
+		PreparsedSyntax result;
+		//the only copy of the template string, everything else is a view into it
+		templateString = copySource(result.source, templateString);
 		
-		std::string_view::size_type pos{0};
-		while( pos != std::string_view::npos ) {
-			pos = templateContent.find(",");
-			if( pos != std::string_view::npos ) {
-				arguments.push_back(
-					copyStringViewAsString(
-						templateContent.substr(0, pos)
-					)
-				);
-				templateContent.remove_prefix(pos+1);
-			} else {
-				arguments.push_back(
-					copyStringViewAsString( templateContent )
+		const char* error = scan_template(templateString, 
+			[&result](std::string_view text) {
+				result.strings.push_back( text );
+			},
+			[&result](std::string_view templateContent) -> const char* {
+				TagSyntax tag;
+				auto firstArgument = result.arguments.size();
+				auto tagError = parse_tag(templateContent, tag, 
+					[&result](std::string_view key, std::string_view value) {
+						result.arguments.push_back( ArgumentSyntax{key, value} );
+					}
 				);
+				if( tagError != nullptr ) {
+					#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
+					return tagError;
+					#else
+					//an invalid tag is skipped like a comment
+					result.arguments.resize(firstArgument);
+					tag = TagSyntax{};
+					tag.isComment = true;
+					#endif
+				}
+				tag.firstArgument = static_cast<std::uint32_t>(firstArgument);
+				result.tags.push_back( tag );
+				return nullptr;
 			}
-		}
-	}
-	
-	HashArgFunction::HashArgFunction(std::string_view templateContent) {
-		if( templateContent.empty() ) {
-			throw InvalidTemplateState("Empty argument hash");
-		}
+		);
 		
-		std::string_view::size_type pos;
-		while( !templateContent.empty() ) {
-			pos = templateContent.find_first_not_of(" ");
-			if( pos == std::string_view::npos ) {//no more arguments
-				break;
-			} else {
-				templateContent.remove_prefix(pos-1);
-			}
-			
-			std::string argName{""};
-			pos = templateContent.find("=");
-			if( pos == std::string_view::npos ) {
-				//no required element
-				throw InvalidTemplateState("No required \"=\" sign");
-			}
-			argName = copyStringViewAsString(
-				trim( templateContent.substr(0, pos) )
-			);
-			templateContent.remove_prefix(pos);
-			
-			std::string argContent{""};
-			pos = templateContent.find(INNER_TAG_START);
-			if( pos == std::string_view::npos ) {
-				//no required element
-				throw InvalidTemplateState("No inner tag start");
-			}
-			templateContent.remove_prefix(pos + INNER_TAG_START.size());
-			pos = templateContent.find(INNER_TAG_END);
-			if( pos == std::string_view::npos ) {
-				//no required element
-				throw InvalidTemplateState("No inner tag end");
-			}
-			argContent = copyStringViewAsString(
-				templateContent.substr(0, pos)
-			);
-			templateContent.remove_prefix(pos + INNER_TAG_END.size());
-			
-			arguments.emplace(argName, argContent);
+		if( error != nullptr ) {//Wrong template
+			#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
+			throw InvalidTemplateState{error};
+			#endif
 		}
+		
+		return result;
 	}
 	
 };
@@ -2,66 +2,445 @@
 #ifndef MULAN_STRING_PREPARSER
 #define MULAN_STRING_PREPARSER
 
+#include <array>
+#include <cstdint>
+#include <span>
 #include <string_view>
 #include <string>
+#include <type_traits>
 #include <utility>
 #include <vector>
-#include <map>
+#include <memory>
 
 //CUT-START
 
 namespace mls::preparse {
 	
-	class ParsedTemplateFunction {
-		public:
-			char name[2];
-			std::string varName;
-			
-			enum class Type {
-				VAR_ONLY,
-				ONE_ARG,
-				TABLE_ARG,
-				HASH_ARG
+	//------------ Configuration
+	// The tag markers are used at compile time too, so they must be the same in every file
+	
+	#ifdef MULANSTR_TAG_START
+	constexpr std::string_view TEMPLATE_START{MULANSTR_TAG_START};
+	#else
+	constexpr std::string_view TEMPLATE_START{"%{"};
+	#endif
+	
+	#ifdef MULANSTR_TAG_END
+	constexpr std::string_view TEMPLATE_END{MULANSTR_TAG_END};
+	#else
+	constexpr std::string_view TEMPLATE_END{"}%"};
+	#endif
+	
+	#ifdef MULANSTR_INNER_TAG_START
+	constexpr std::string_view INNER_TAG_START{MULANSTR_INNER_TAG_START};
+	#else
+	constexpr std::string_view INNER_TAG_START{"{"};
+	#endif
+	
+	#ifdef MULANSTR_INNER_TAG_END
+	constexpr std::string_view INNER_TAG_END{MULANSTR_INNER_TAG_END};
+	#else
+	constexpr std::string_view INNER_TAG_END{"}"};
+	#endif
+	
+	constexpr std::string_view VAR_FN_DIVIDER{"!"};
+	constexpr std::string_view NO_VAR_FN{"+"};
+	constexpr char COMMENT_MARKER = '#';
+	
+	constexpr std::string_view FN_ARGS_DIV_ALL{"=: "};
+	constexpr char FN_ARGS_DIV_ONE = '=';
+	constexpr char FN_ARGS_DIV_TABLE = ':';
+	constexpr char FN_ARGS_DIV_HASH = ' ';
+	
+	///How the arguments of a tag's function are written
+	enum class TagType {
+		///`%{var}%`, no function
+		VAR_ONLY,
+		///`F=argument`
+		ONE_ARG,
+		///`F:a,b,c`
+		TABLE_ARG,
+		///`F a={A} b={B}`
+		HASH_ARG
+	};
+	
+	//-------------- The grammar
+	// It is shared by the run time parsers and the compile time parser of literals.
+	// Errors are returned as messages, `nullptr` means no error.
+	
+	// The searches below work on indexes while compiling, because some compilers can't compare pointers 
+	// into template arguments with `nullptr`, which the standard library's searches do.
+	
+	/**
+	 * @brief `source.find(searched)` using vector instructions of the CPU
+	 * 
+	 * The best of AVX2, SSE2 and plain code is picked at run time. 
+	 * Define `MULANSTR_NO_SIMD` to always use the plain code.
+	 */
+	std::size_t find_text(std::string_view source, std::string_view searched);
+	
+	///`source.find(searched)`
+	constexpr std::size_t findText(std::string_view source, std::string_view searched) {
+		if( !std::is_constant_evaluated() ) {
+			return find_text(source, searched);
+		}
+		if( searched.size() > source.size() ) {
+			return std::string_view::npos;
+		}
+		for(std::size_t i=0u; i + searched.size() <= source.size(); ++i) {
+			std::size_t j = 0u;
+			while( j < searched.size() && source[i+j] == searched[j] ) {
+				++j;
+			}
+			if( j == searched.size() ) {
+				return i;
+			}
+		}
+		return std::string_view::npos;
+	}
+	
+	///`source.find_first_of(chars)` or, if `isIn` is `false`, `source.find_first_not_of(chars)`
+	constexpr std::size_t findFirstOf(std::string_view source, std::string_view chars, bool isIn = true) {
+		if( !std::is_constant_evaluated() ) {
+			return isIn ? source.find_first_of(chars) : source.find_first_not_of(chars);
+		}
+		for(std::size_t i=0u; i<source.size(); ++i) {
+			bool found = false;
+			for(auto c : chars) {
+				found = found || source[i] == c;
+			}
+			if( found == isIn ) {
+				return i;
+			}
+		}
+		return std::string_view::npos;
+	}
+	
+	constexpr std::pair<std::string_view, std::string_view> 
+		breakInHalfOn( std::string_view source, std::string_view delimiter )
+	{
+		auto delimPos = findText( source, delimiter );
+		if( delimPos != source.npos ) {
+			return {
+				source.substr(0, delimPos),
+				source.substr(delimPos + delimiter.size())
 			};
-			virtual Type getType() const =0;
-			
-			virtual ~ParsedTemplateFunction() {};
+		} else {
+			return {
+				source,
+				std::string_view()
+			};
+		}
+	}
+	
+	constexpr bool contains( std::string_view container, std::string_view searched )
+	{
+		return findText( container, searched ) != container.npos;
+	}
+	
+	constexpr std::string_view trim(std::string_view theView) {
+		auto pos = findFirstOf(theView, " ", false);
+		if( pos != std::string_view::npos ) {
+			theView.remove_prefix(pos);
+		}
+		pos = findFirstOf(theView, " ");
+		if( pos != std::string_view::npos ) {
+			theView.remove_suffix(theView.size() - pos);
+		}
+		return theView;
+	}
+	
+	///One tag of a template. All strings are views into the template string
+	struct TagSyntax {
+		///comments have no function
+		bool isComment = false;
+		char name[2] = {'\0', '\0'};
+		TagType type = TagType::VAR_ONLY;
+		std::string_view varName{};
+		///the text after the function name and its divider
+		std::string_view argumentsText{};
+		///position of the tag's arguments in `TemplateSyntax::arguments`
+		std::uint32_t firstArgument = 0u;
+		std::uint32_t argumentsCount = 0u;
 	};
 	
-	class VarOnlyFunction : public ParsedTemplateFunction {
-		public:
-			virtual Type getType() const override;
+	///An argument of a tag; `key` is only set for a hash of arguments
+	struct ArgumentSyntax {
+		std::string_view key{};
+		std::string_view value{};
 	};
 	
-	class OneArgFunction : public ParsedTemplateFunction {
-		public:
-			virtual Type getType() const override;
-			
-			std::string argument;
-			
-			OneArgFunction(std::string_view templateContent);
+	///A parsed template, where `strings[i]` comes before `tags[i]`
+	struct TemplateSyntax {
+		std::span<const std::string_view> strings;
+		std::span<const TagSyntax> tags;
+		std::span<const ArgumentSyntax> arguments;
 	};
 	
-	class TableArgFunction : public ParsedTemplateFunction {
-		public:
-			virtual Type getType() const override;
+	///Calls `onArgument(value)` for every argument of a `a,b,c` list
+	template<typename ArgumentFn>
+	constexpr const char* for_each_table_argument(std::string_view templateContent, ArgumentFn onArgument) {
+		if( templateContent.empty() ) {
+			return "Empty argument list";
+		}
+		
+		std::string_view::size_type pos{0};
+		while( pos != std::string_view::npos ) {
+			pos = findText(templateContent, ",");
+			if( pos != std::string_view::npos ) {
+				onArgument( templateContent.substr(0, pos) );
+				templateContent.remove_prefix(pos+1);
+			} else {
+				onArgument( templateContent );
+			}
+		}
+		return nullptr;
+	}
+	
+	///Calls `onArgument(key, value)` for every argument of a `a={A} b={B}` hash
+	template<typename ArgumentFn>
+	constexpr const char* for_each_hash_argument(std::string_view templateContent, ArgumentFn onArgument) {
+		if( templateContent.empty() ) {
+			return "Empty argument hash";
+		}
+		
+		std::string_view::size_type pos;
+		while( !templateContent.empty() ) {
+			pos = findFirstOf(templateContent, " ", false);
+			if( pos == std::string_view::npos ) {//no more arguments
+				break;
+			} else {
+				templateContent.remove_prefix(pos);
+			}
 			
-			std::vector<std::string> arguments;
+			std::string_view argName{};
+			pos = findText(templateContent, "=");
+			if( pos == std::string_view::npos ) {
+				//no required element
+				return "No required \"=\" sign";
+			}
+			argName = trim( templateContent.substr(0, pos) );
+			templateContent.remove_prefix(pos);
 			
-			TableArgFunction(std::string_view templateContent);
-	};
+			std::string_view argContent{};
+			pos = findText(templateContent, INNER_TAG_START);
+			if( pos == std::string_view::npos ) {
+				//no required element
+				return "No inner tag start";
+			}
+			templateContent.remove_prefix(pos + INNER_TAG_START.size());
+			pos = findText(templateContent, INNER_TAG_END);
+			if( pos == std::string_view::npos ) {
+				//no required element
+				return "No inner tag end";
+			}
+			argContent = templateContent.substr(0, pos);
+			templateContent.remove_prefix(pos + INNER_TAG_END.size());
+			
+			onArgument(argName, argContent);
+		}
+		return nullptr;
+	}
 	
-	class HashArgFunction : public ParsedTemplateFunction {
-		public:
-			virtual Type getType() const override;
+	/**
+	 * @brief Parses the contents of a tag
+	 * 
+	 * Fills `tag` and calls `onArgument(key, value)` for every argument of its function
+	 */
+	template<typename ArgumentFn>
+	constexpr const char* parse_tag(std::string_view content, TagSyntax& tag, ArgumentFn onArgument) {
+		tag = TagSyntax{};
+		//check for comments
+		if( content.starts_with(COMMENT_MARKER) && content.ends_with(COMMENT_MARKER) ) {
+			tag.isComment = true;
+			return nullptr;
+		}
+		//extract var name
+		if( content.starts_with(NO_VAR_FN) ) {
+			//this is a no-var function
+			content.remove_prefix(NO_VAR_FN.size());
+		} else if( auto divider = findText(content, VAR_FN_DIVIDER); divider != std::string_view::npos ) {
+			tag.varName = content.substr(0, divider);
+			content.remove_prefix(divider + VAR_FN_DIVIDER.size());
+		} else {
+			//only var name
+			tag.varName = content;
+			return nullptr;
+		}
+		
+		auto nameArgsDivider = findFirstOf(content, FN_ARGS_DIV_ALL);
+		if( nameArgsDivider == std::string_view::npos ) {
+			return "No function-parameters divider";
+		}
+		if( nameArgsDivider != 1 && nameArgsDivider != 2 ) {
+			return "Wrong function name length";
+		}
+		tag.name[0] = content[0];
+		tag.name[1] = nameArgsDivider == 2 ? content[1] : '\0';
+		tag.argumentsText = content.substr(nameArgsDivider+1);
+		
+		auto countedArgument = [&tag, &onArgument](std::string_view key, std::string_view value) {
+			++tag.argumentsCount;
+			onArgument(key, value);
+		};
+		switch( content[nameArgsDivider] ) {
+			case FN_ARGS_DIV_ONE:
+				tag.type = TagType::ONE_ARG;
+				if( tag.argumentsText.empty() ) {
+					return "Empty argument";
+				}
+				countedArgument(std::string_view{}, tag.argumentsText);
+				return nullptr;
+			case FN_ARGS_DIV_TABLE:
+				tag.type = TagType::TABLE_ARG;
+				return for_each_table_argument(tag.argumentsText, [&countedArgument](std::string_view value) {
+					countedArgument(std::string_view{}, value);
+				});
+			case FN_ARGS_DIV_HASH:
+				tag.type = TagType::HASH_ARG;
+				return for_each_hash_argument(tag.argumentsText, countedArgument);
+			default: //shouldn't reach
+				return "Unknown function-parameters divider";
+		}
+	}
+	
+	/**
+	 * @brief Calls `onString(text)` for every text between tags and `onTag(content)` for every tag, which returns an error or `nullptr`
+	 * 
+	 * Every byte of the template string is searched only once.
+	 */
+	template<typename StringFn, typename TagFn>
+	constexpr const char* scan_template(std::string_view templateString, StringFn onString, TagFn onTag) {
+		auto tagStart = findText(templateString, TEMPLATE_START);
+		while( tagStart != std::string_view::npos ) {
+			onString( templateString.substr(0, tagStart) );
+			templateString.remove_prefix(tagStart + TEMPLATE_START.size());
 			
-			std::map<std::string, std::string> arguments;
+			auto tagEnd = findText(templateString, TEMPLATE_END);
+			if( tagEnd == std::string_view::npos ) {//Wrong template
+				return "No ending marker";
+			}
+			if( auto error = onTag(templateString.substr(0, tagEnd)) ) {
+				return error;
+			}
+			templateString.remove_prefix(tagEnd + TEMPLATE_END.size());
+			//next template?
+			tagStart = findText(templateString, TEMPLATE_START);
+		}
+		//the last string, or the only one if it isn't a template
+		onString( templateString );
+		return nullptr;
+	}
+	
+	/**
+	 * @brief Result of `preparse_syntax(...)`
+	 * 
+	 * The template string is copied once into `source` and all views of `view()` point into it.
+	 */
+	class PreparsedSyntax {
+		public:
+			std::unique_ptr<char[]> source;
+			std::vector<std::string_view> strings;
+			std::vector<TagSyntax> tags;
+			std::vector<ArgumentSyntax> arguments;
 			
-			HashArgFunction(std::string_view templateContent);
+			TemplateSyntax view() const {
+				return TemplateSyntax{strings, tags, arguments};
+			}
 	};
 	
-	std::pair<std::vector<char*>, std::vector<ParsedTemplateFunction*>>
-		preparse_template(std::string_view templateString);
+	///Parses a template string at run time into a flat syntax
+	PreparsedSyntax preparse_syntax(std::string_view templateString);
+	
+	//-------------- Literals parsed at compile time
+	
+	///A string literal which can be passed as a template argument
+	template<std::size_t N>
+	struct FixedString {
+		char data[N];
+		
+		consteval FixedString(const char (&text)[N]) {
+			for(std::size_t i=0u; i<N; ++i) {
+				data[i] = text[i];
+			}
+		}
+		
+		constexpr std::string_view view() const {
+			return std::string_view{data, N - 1u};
+		}
+	};
+	
+	///Lengths of the lists of `TemplateSyntax`, or the syntax error
+	struct SyntaxSize {
+		std::size_t strings = 0u;
+		std::size_t tags = 0u;
+		std::size_t arguments = 0u;
+		const char* error = nullptr;
+	};
+	
+	consteval SyntaxSize measure_syntax(std::string_view templateString) {
+		SyntaxSize size;
+		size.error = scan_template(templateString,
+			[&size](std::string_view) { ++size.strings; },
+			[&size](std::string_view content) -> const char* {
+				TagSyntax tag;
+				++size.tags;
+				return parse_tag(content, tag, [&size](std::string_view, std::string_view) { ++size.arguments; });
+			}
+		);
+		return size;
+	}
+	
+	///Syntax of a literal kept in arrays of exact sizes
+	template<std::size_t STRINGS, std::size_t TAGS, std::size_t ARGUMENTS>
+	struct StaticSyntax {
+		std::array<std::string_view, STRINGS> strings{};
+		std::array<TagSyntax, TAGS> tags{};
+		std::array<ArgumentSyntax, ARGUMENTS> arguments{};
+		
+		constexpr TemplateSyntax view() const {
+			return TemplateSyntax{strings, tags, arguments};
+		}
+	};
+	
+	///Parses a template string literal while compiling, so a malformed tag is a compile error
+	template<FixedString templateString>
+	consteval auto preparse_literal() {
+		constexpr SyntaxSize size = measure_syntax(templateString.view());
+		constexpr std::string_view error{size.error != nullptr ? size.error : ""};
+		static_assert( error != "No ending marker", "Template literal: no ending marker of a tag" );
+		static_assert( error != "No function-parameters divider", "Template literal: no function-parameters divider" );
+		static_assert( error != "Wrong function name length", "Template literal: wrong function name length" );
+		static_assert( error != "Empty argument", "Template literal: empty argument" );
+		static_assert( error != "Empty argument list", "Template literal: empty argument list" );
+		static_assert( error != "Empty argument hash", "Template literal: empty argument hash" );
+		static_assert( error != "No required \"=\" sign", "Template literal: no required \"=\" sign in a hash argument" );
+		static_assert( error != "No inner tag start", "Template literal: no inner tag start in a hash argument" );
+		static_assert( error != "No inner tag end", "Template literal: no inner tag end in a hash argument" );
+		static_assert( error.empty(), "Template literal: invalid syntax" );
+		
+		StaticSyntax<size.strings, size.tags, size.arguments> result;
+		if constexpr( !error.empty() ) {
+			return result;
+		}
+		std::size_t stringsCount = 0u, tagsCount = 0u, argumentsCount = 0u;
+		scan_template(templateString.view(),
+			[&](std::string_view text) { result.strings[stringsCount++] = text; },
+			[&](std::string_view content) -> const char* {
+				TagSyntax& tag = result.tags[tagsCount++];
+				auto error = parse_tag(content, tag, [&](std::string_view key, std::string_view value) {
+					result.arguments[argumentsCount++] = ArgumentSyntax{key, value};
+				});
+				tag.firstArgument = static_cast<std::uint32_t>(argumentsCount - tag.argumentsCount);
+				return error;
+			}
+		);
+		return result;
+	}
+	
+	///The syntax of a template string literal, see `mls::literal`
+	template<FixedString templateString>
+	inline constexpr auto literal_syntax = preparse_literal<templateString>();
 	
 };
 
@@ -4,8 +4,14 @@
  * 
  */
 
-#include <sstream>
+#include <algorithm>
 #include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <exception>
+#include <ostream>
+#include <thread>
 
 #include "template.h"
 
@@ -13,204 +19,185 @@
 
 namespace mls {
 	
-	//------------- Functions classes (ref)
+	//------------- Compiler helpers
 	
-	/**
-	 * @brief Just puts the variable content
-	 * 
-	 */
-	class VariablePutter : public TemplateFunction {
-		private:
-			const std::string variable;
-		public:
-			VariablePutter(std::string &&varName): variable{varName} {};
-			
-			virtual std::string produceString(std::map<std::string_view, variableValue> &variables) override;
-	};
+	///makes an instruction with no choices, no argument and no number format
+	Instruction makeInstruction(Instruction::Code code, std::string_view text) {
+		return Instruction{code, -1, 0u, 0u, VariableSlot::NONE, text, std::string_view{}, nullptr, Instruction::NO_INDEX};
+	}
 	
-	/**
-	 * @brief Outputs a result based on the gender of the variable
-	 * 
-	 * Template: `%{varname!G:output1,output2,...}%`
-	 * 	OR
-	 * Template: `%{varname!G gender1={output1} gender2={output2} ...}%`
-	 */
-	class GenderFunction : public TemplateFunction {
-		private:
-			const std::string variable;
-			std::map<std::string, std::string> outputTexts;
-		public:
-			GenderFunction(
-				std::string &&varName,
-				std::vector<std::string> &listOfOutputs,
-				const locale::Locale &locale
-			);
-			GenderFunction(
-				std::string &&varName,
-				std::map<std::string, std::string> &mapOfOutputs
-			);
-			
-			virtual std::string produceString(std::map<std::string_view, variableValue> &variables) override;
-	};
+	///the index of the key in the list, `Instruction::NO_INDEX` if it isn't there
+	std::uint32_t indexOf(std::span<const char* const> keys, std::string_view key) {
+		for(std::size_t i=0u; i<keys.size(); ++i) {
+			if( key == keys[i] ) {
+				return static_cast<std::uint32_t>(i);
+			}
+		}
+		return Instruction::NO_INDEX;
+	}
 	
 	/**
-	 * @brief Writes an output based on the `__CASE__` variable
+	 * @brief Adds outputs given as a table to the choices of an instruction
 	 * 
+	 * Outputs are matched with keys (plural forms, genders or cases of the locale) by their position
 	 */
-	class CaseWriterFunction : public TemplateFunction {
-		private:
-			std::map<std::string, std::string> outputTexts;
-		public:
-			CaseWriterFunction(
-				std::vector<std::string> &listOfOutputs,
-				const locale::Locale &locale
-			);
-			CaseWriterFunction(
-				std::map<std::string, std::string> &mapOfOutputs
-			);
-			
-			virtual std::string produceString(std::map<std::string_view, variableValue> &variables) override;
-	};
+	void addChoices(
+		Instruction &step,
+		std::vector<Choice> &choices,
+		std::span<const preparse::ArgumentSyntax> listOfOutputs,
+		std::span<const char* const> keys,
+		const char* wrongSizeError
+	) {
+		if( listOfOutputs.size() != keys.size() ) {
+			throw InvalidTemplateState(wrongSizeError);
+		}
+		
+		step.firstChoice = static_cast<std::uint32_t>(choices.size());
+		step.choicesCount = static_cast<std::uint32_t>(listOfOutputs.size());
+		for(std::size_t i=0u; i<listOfOutputs.size(); ++i) {
+			choices.push_back( Choice{keys[i], listOfOutputs[i].value} );
+		}
+	}
 	
-	/**
-	 * @brief Sets the `__CASE__` variable in the sub-template
-	 * 
-	 */
-	class CaseChooserFunction : public TemplateFunction {
-		private:
-			const std::string caseID;
-			const std::string variable;
-		public:
-			CaseChooserFunction(
-				std::string &&varName,
-				std::string &&case_id
-			);
-			
-		virtual std::string produceString(std::map<std::string_view, variableValue> &variables) override;
-	};
+	///returns `nullptr` if the hash of arguments has no such key
+	const preparse::ArgumentSyntax* findArgument(
+		std::span<const preparse::ArgumentSyntax> hashOfOptions, 
+		std::string_view key
+	) {
+		for(auto& option : hashOfOptions) {
+			if( option.key == key ) {
+				return &option;
+			}
+		}
+		return nullptr;
+	}
 	
 	/**
-	 * @brief Pluralizes a word based on a numeric value in the variable
+	 * @brief Adds outputs given as a hash to the choices of an instruction in the order of the keys
 	 * 
+	 * So a choice can be found by the key's index. A key missing in the hash gets a choice with an empty key, 
+	 * a key of the hash which isn't one of `keys` is an error.
 	 */
-	class PluralFunction : public TemplateFunction {
-		private:
-			const locale::Locale &theLocale;
-			const std::string variable;
-			std::map<std::string, std::string> outputTexts;
-		public:
-			PluralFunction(
-				std::string &&varName,
-				std::vector<std::string> listOfOutputs,
-				const locale::Locale &locale
-			);
-			PluralFunction(
-				std::string &&varName,
-				std::map<std::string, std::string> &mapOfOutputs,
-				const locale::Locale &locale
-			);
-			
-			virtual std::string produceString(std::map<std::string_view, variableValue> &variables) override;
-	};
+	void addIndexedChoices(
+		Instruction &step,
+		std::vector<Choice> &choices,
+		std::span<const preparse::ArgumentSyntax> hashOfOutputs,
+		std::span<const char* const> keys,
+		const char* unknownKeyError
+	) {
+		for(auto& output : hashOfOutputs) {
+			if( indexOf(keys, output.key) == Instruction::NO_INDEX ) {
+				throw InvalidTemplateState(unknownKeyError + std::string{output.key});
+			}
+		}
+		
+		step.firstChoice = static_cast<std::uint32_t>(choices.size());
+		step.choicesCount = static_cast<std::uint32_t>(keys.size());
+		for(const char* key : keys) {
+			if( auto output = findArgument(hashOfOutputs, key) ) {
+				choices.push_back( Choice{output->key, output->value} );
+			} else {
+				choices.push_back( Choice{std::string_view{}, std::string_view{}} );
+			}
+		}
+	}
 	
-	/**
-	 * @brief Formats an integer according to the locale's formater.
-	 * 
-	 */
-	class IntegerFormaterFunction : public TemplateFunction {
-		private:
-			const locale::NumberFormat &formater;
-			const std::string variable;
-		public:
-			IntegerFormaterFunction(
-				std::string &&varName,
-				std::string &formatName,
-				locale::Locale &theLocale
-			);
-			
-			virtual std::string produceString(std::map<std::string_view, variableValue> &variables) override;
-	};
+	bool isAllNumber(std::string_view str) {
+		//IMPORTANT: we don check for *negative* numbers
+		for(auto c : str) {
+			if( !std::isdigit(c) ) {
+				return false;
+			}
+		}
+		return true;
+	}
 	
-	/**
-	 * @brief Formats a real number according to the locale's formater.
-	 * 
-	 */
-	class RealFormaterFunction : public TemplateFunction {
-		private:
-			const std::string variable;
-			short precision;
-			locale::NumberFormat *formater;
-			
-			bool isAllNumber(std::string &str);
-		public:
-			RealFormaterFunction(
-				std::string &&varName,
-				std::vector<std::string> &listOfOptions,
-				locale::Locale &theLocale
-			);
-			RealFormaterFunction(
-				std::string &&varName,
-				std::map<std::string, std::string> &hashOfOptions,
-				locale::Locale &theLocale
-			);
-			
-			virtual std::string produceString(std::map<std::string_view, variableValue> &variables) override;
-	};
+	short readPrecision(std::string_view str) {
+		if( str.empty() || !isAllNumber(str) ) {
+			throw InvalidTemplateState("Invalid precision: " + std::string{str});
+		}
+		short result = -1;
+		auto[lastPtr, err] = std::from_chars(str.data(), str.data() + str.size(), result);
+		if( err != std::errc() ) {
+			throw InvalidTemplateState("Invalid precision: " + std::string{str});
+		}
+		return result;
+	}
 	
-	//------------- Template class
+	//------------- Compiled template class
 	
-	Template::Template():myLocale{nullptr}, genderID{""} {
-		//do nothing else
+	CompiledTemplate::CompiledTemplate(std::string_view templateString, locale::Locale& locale):
+		myLocale{&locale}, genderID{""} {
+		auto parsed = preparse::preparse_syntax(templateString);
+		//all texts of the program are views into the `source` buffer
+		source = std::move(parsed.source);
+		compile( parsed.view() );
+		resolveIndices();
 	}
 	
-	Template::Template(Template&& other):genderID{""} {
-		myLocale = other.myLocale;
-		other.myLocale = nullptr;
-		
-		for(char* aString : other.stringsList) {
-			stringsList.push_back(aString);
-		}
-		other.stringsList.clear();
-		
-		for(auto aFunction : other.functionsList) {
-			functionsList.push_back(aFunction);
+	CompiledTemplate::CompiledTemplate(const preparse::TemplateSyntax& syntax, locale::Locale& locale):
+		myLocale{&locale}, genderID{""} {
+		compile(syntax);
+		resolveIndices();
+	}
+	
+	CompiledTemplate::CompiledTemplate(
+		locale::Locale& locale, 
+		std::string_view gender, 
+		std::vector<Instruction> compiledProgram, 
+		std::vector<Choice> compiledChoices, 
+		std::vector<std::string_view> names
+	):
+		myLocale{&locale}, genderID{gender}, program{std::move(compiledProgram)}, 
+		choices{std::move(compiledChoices)}, variableNames{std::move(names)} {
+		resolveIndices();
+	}
+	
+	void CompiledTemplate::resolveIndices() {
+		genderIndex = indexOf(myLocale->getGendersList(), genderID);
+		for(Instruction &step : program) {
+			if( step.code == Instruction::Code::CASE_SELECT ) {
+				step.caseIndex = indexOf(myLocale->getCasesList(), step.argument);
+			}
 		}
-		other.functionsList.clear();
 	}
 	
-	Template::Template(const std::string templateString, locale::Locale& locale):
-		myLocale{&locale} {
+	void CompiledTemplate::compile(const preparse::TemplateSyntax& syntax) {
 		using namespace preparse;
-		using Type = ParsedTemplateFunction::Type;
-		auto[charList, fnList] = preparse_template(templateString);
+		using Type = TagType;
+		using Code = Instruction::Code;
 		
 		try{
-			for(char* aString : charList) {
-				stringsList.push_back(aString);
-			}
-			
-			for(auto& functionDesc : fnList) {
+			program.reserve( syntax.strings.size() + syntax.tags.size() );
+			for(std::size_t i=0u; i<syntax.strings.size(); ++i) {
+				if( !syntax.strings[i].empty() ) {
+					program.push_back( makeInstruction(Code::EMIT_LITERAL, syntax.strings[i]) );
+				}
+				if( i >= syntax.tags.size() ) {
+					continue;
+				}
+				
+				auto* functionDesc = &syntax.tags[i];
 				//test for comments
-				if( functionDesc == nullptr ) {
-					functionsList.push_back(nullptr);
+				if( functionDesc->isComment ) {
 					continue;
 				}
+				auto arguments = syntax.arguments.subspan(functionDesc->firstArgument, functionDesc->argumentsCount);
 				//select function
-				TemplateFunction* function = nullptr;
+				Instruction step = makeInstruction(Code::PUT_VAR, functionDesc->varName);
+				bool hasOutput = true;
 				switch( functionDesc->name[0] ) {
 					case '\0': //Variable put
-						if( functionDesc->getType() != Type::VAR_ONLY) {
+						if( functionDesc->type != Type::VAR_ONLY) {
 							throw InvalidTemplateState{"Wrong type of function"};
 						}
-						function = new VariablePutter(std::move(functionDesc->varName));
 						break;
 					case 'S': //Setter of...
+						hasOutput = false;
 						switch( functionDesc->name[1] ) {
 							case 'G': //gender
-								if( functionDesc->getType() == Type::ONE_ARG ) {
-									genderID = static_cast<OneArgFunction*>(
-										functionDesc
-									)->argument;
+								if( functionDesc->type == Type::ONE_ARG ) {
+									genderID = arguments[0].value;
 								} else {
 									throw InvalidTemplateState("Gender setter has invalid argument type");
 								}
@@ -223,16 +210,20 @@ namespace mls {
 						if( functionDesc->varName.empty() ) {
 							throw InvalidTemplateState("Variable name can't be empty");
 						}
-						if( functionDesc->getType() == Type::TABLE_ARG ) {
-							function = new GenderFunction(
-								std::move(functionDesc->varName),
-								static_cast<TableArgFunction*>(functionDesc)->arguments,
-								*myLocale
+						step.code = Code::GENDER_SELECT;
+						if( functionDesc->type == Type::TABLE_ARG ) {
+							addChoices(
+								step, choices,
+								arguments,
+								myLocale->getGendersList(),
+								"Invalid list of genders"
 							);
-						} else if( functionDesc->getType() == Type::HASH_ARG ) {
-							function = new GenderFunction(
-								std::move(functionDesc->varName),
-								static_cast<HashArgFunction*>(functionDesc)->arguments
+						} else if( functionDesc->type == Type::HASH_ARG ) {
+							addIndexedChoices(
+								step, choices,
+								arguments,
+								myLocale->getGendersList(),
+								"Unknown gender: "
 							);
 						} else {
 							throw InvalidTemplateState("Gender set called with wrong type of arguments");
@@ -240,24 +231,28 @@ namespace mls {
 						break;
 					case 'C': //case...
 						if( functionDesc->varName.empty() ) {// ...writer
-							if( functionDesc->getType() == Type::TABLE_ARG ) {
-								function = new CaseWriterFunction(
-									static_cast<TableArgFunction*>(functionDesc)->arguments,
-									*myLocale
+							step.code = Code::CASE_WRITE;
+							if( functionDesc->type == Type::TABLE_ARG ) {
+								addChoices(
+									step, choices,
+									arguments,
+									myLocale->getCasesList(),
+									"Invalid list of cases"
 								);
-							} else if( functionDesc->getType() == Type::HASH_ARG ) {
-								function = new CaseWriterFunction(
-									static_cast<HashArgFunction*>(functionDesc)->arguments
+							} else if( functionDesc->type == Type::HASH_ARG ) {
+								addIndexedChoices(
+									step, choices,
+									arguments,
+									myLocale->getCasesList(),
+									"Unknown case: "
 								);
 							} else {
 								throw InvalidTemplateState("Case writer called with wrong type of arguments");
 							}
 						} else {// ...chooser
-							if( functionDesc->getType() == Type::ONE_ARG ) {
-								function = new CaseChooserFunction(
-									std::move(functionDesc->varName),
-									std::move(static_cast<OneArgFunction*>(functionDesc)->argument)
-								);
+							step.code = Code::CASE_SELECT;
+							if( functionDesc->type == Type::ONE_ARG ) {
+								step.argument = arguments[0].value;
 							} else {
 								throw InvalidTemplateState("Case chooser called with wrong type of arguments");
 							}
@@ -268,17 +263,20 @@ namespace mls {
 							throw InvalidTemplateState("Variable name empty");
 						}
 						
-						if( functionDesc->getType() == Type::TABLE_ARG ) {
-							function = new PluralFunction(
-								std::move(functionDesc->varName),
-								static_cast<TableArgFunction*>(functionDesc)->arguments,
-								*myLocale
+						step.code = Code::PLURAL_SELECT;
+						if( functionDesc->type == Type::TABLE_ARG ) {
+							addChoices(
+								step, choices,
+								arguments,
+								myLocale->getPluralsList(),
+								"Wrong number of arguments"
 							);
-						} else if( functionDesc->getType() == Type::HASH_ARG ) {
-							function = new PluralFunction(
-								std::move(functionDesc->varName),
-								static_cast<HashArgFunction*>(functionDesc)->arguments,
-								*myLocale
+						} else if( functionDesc->type == Type::HASH_ARG ) {
+							addIndexedChoices(
+								step, choices,
+								arguments,
+								myLocale->getPluralsList(),
+								"Unknown plural form: "
 							);
 						} else {
 							throw InvalidTemplateState("Plural function called with invalid arguments type");
@@ -289,544 +287,1065 @@ namespace mls {
 							throw InvalidTemplateState("Variable name empty");
 						}
 						
-						if( functionDesc->getType() == Type::ONE_ARG ) {
-							function = new IntegerFormaterFunction(
-								std::move(functionDesc->varName),
-								static_cast<OneArgFunction*>(functionDesc)->argument,
-								*myLocale
+						step.code = Code::INT_FORMAT;
+						if( functionDesc->type == Type::ONE_ARG ) {
+							step.format = myLocale->getNumberFormat(
+								arguments[0].value
 							);
 						} else {
 							throw InvalidTemplateState("Integer function called with invalid arguments list");
 						}
+						
+						if( step.format == nullptr ) {
+							throw InvalidTemplateState("Unknown formater type");
+						}
 						break;
 					case 'R': //Real
 						if( functionDesc->varName.empty() ) {
 							throw InvalidTemplateState("Variable name empty");
 						}
 						
-						if( functionDesc->getType() == Type::TABLE_ARG ) {
-							function = new RealFormaterFunction(
-								std::move(functionDesc->varName),
-								static_cast<TableArgFunction*>(functionDesc)->arguments,
-								*myLocale
-							);
-						} else if( functionDesc->getType() == Type::HASH_ARG ) {
-							function = new RealFormaterFunction(
-								std::move(functionDesc->varName),
-								static_cast<HashArgFunction*>(functionDesc)->arguments,
-								*myLocale
-							);
+						step.code = Code::REAL_FORMAT;
+						if( functionDesc->type == Type::TABLE_ARG ) {
+							auto& listOfOptions = arguments;
+							if( listOfOptions.size() == 1u ) {
+								//only formater
+								step.format = myLocale->getNumberFormat(listOfOptions[0].value);
+							} else if( listOfOptions.size() == 2u ) {
+								//formater and precision
+								step.format = myLocale->getNumberFormat(listOfOptions[0].value);
+								step.precision = readPrecision(listOfOptions[1].value);
+							}
+						} else if( functionDesc->type == Type::HASH_ARG ) {
+							auto& hashOfOptions = arguments;
+							if( auto format = findArgument(hashOfOptions, "format") ) {
+								step.format = myLocale->getNumberFormat(format->value);
+							} else {
+								step.format = myLocale->getNumberFormat("general");
+							}
+							if( auto prec = findArgument(hashOfOptions, "prec") ) {
+								step.precision = readPrecision(prec->value);
+							}
 						} else {
 							throw InvalidTemplateState("Real function called with invalid arguments list");
 						}
+						
+						if( step.format == nullptr ) {
+							throw InvalidTemplateState("Unknown formater type");
+						}
 						break;
 					default:
 						throw InvalidTemplateState(std::string{"Unknown function: "} + functionDesc->name[0] + functionDesc->name[1]);
 				}
 				//-----
-				delete functionDesc;
-				functionDesc = nullptr;
-				functionsList.push_back(function);
+				if( hasOutput ) {
+					step.slot = addVariable(
+						step.code == Code::CASE_WRITE ? std::string_view{"__CASE__"} : step.text
+					);
+					program.push_back(step);
+				}
 			}
-		} catch(InvalidTemplateState e) {
+		} catch(const InvalidTemplateState& error) {
 			//clear all data
-			for(char* aString : stringsList) {
-				delete[] aString;
-			}
-			stringsList.clear();
-			for(auto functionDesc : fnList) {
-				delete functionDesc;
-			}
-			for(auto function : functionsList) {
-				delete function;
-			}
-			functionsList.clear();
+			program.clear();
+			choices.clear();
+			variableNames.clear();
+			compileError = error.what();
 			//return an error
 			#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
-			throw e;
+			throw;
 			#else
 			return;
 			#endif
 		}
 	}
 	
-	Template::~Template() {
-		for(char* aString : stringsList) {
-			delete[] aString;
-		}
-		for(auto function : functionsList) {
-			delete function;
+	CompiledTemplate::~CompiledTemplate() {}
+	
+	locale::Locale& CompiledTemplate::getLocale() const {
+		return *myLocale;
+	}
+	
+	std::string_view CompiledTemplate::getGender() const {
+		return genderID;
+	}
+	
+	std::uint32_t CompiledTemplate::getGenderIndex() const {
+		return genderIndex;
+	}
+	
+	std::string_view CompiledTemplate::getError() const {
+		return compileError;
+	}
+	
+	std::span<const Instruction> CompiledTemplate::getProgram() const {
+		return program;
+	}
+	
+	std::span<const Choice> CompiledTemplate::getChoices() const {
+		return choices;
+	}
+	
+	std::span<const std::string_view> CompiledTemplate::getVariableNames() const {
+		return variableNames;
+	}
+	
+	VariableSlot CompiledTemplate::slot(std::string_view varName) const {
+		for(std::size_t i=0u; i<variableNames.size(); ++i) {
+			if( variableNames[i] == varName ) {
+				return VariableSlot{ static_cast<std::uint32_t>(i) };
+			}
 		}
+		return VariableSlot{};
 	}
 	
-	Template& Template::apply(std::string_view varName, std::string_view rawString) {
-		if( myLocale == nullptr ) {
-			#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
-			throw InvalidTemplateState("Template not initialized");
-			#else
-			return *this;
-			#endif
+	std::size_t CompiledTemplate::slotsCount() const {
+		return variableNames.size();
+	}
+	
+	std::uint32_t CompiledTemplate::addVariable(std::string_view varName) {
+		auto found = slot(varName);
+		if( found.index != VariableSlot::NONE ) {
+			return found.index;
 		}
-		variables.insert_or_assign( varName, variableValue{rawString} );
-		return *this;
+		variableNames.push_back(varName);
+		return static_cast<std::uint32_t>(variableNames.size() - 1u);
 	}
 	
-	Template& Template::apply(std::string_view varName, long number) {
-		if( myLocale == nullptr ) {
-			#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
-			throw InvalidTemplateState("Template not initialized");
-			#else
-			return *this;
-			#endif
+	//------------- The interpreter
+	
+	/**
+	 * @brief Reports an invalid state found while rendering
+	 * 
+	 * Without `MULANSTR_THROW_ON_INVALID_TEMPLATE` the instruction just produces no output
+	 */
+	void renderingError(const std::string &message) {
+		#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
+		throw InvalidTemplateState(message);
+		#else
+		(void)message;
+		#endif
+	}
+	
+	///reads a number for integer functions, real numbers lose their fractional part
+	bool readInteger(const variableValue &content, long &number) {
+		if( auto integer = std::get_if<long>(&content) ) {
+			number = *integer;
+			return true;
 		}
-		variables.insert_or_assign( varName, variableValue{number} );
-		return *this;
+		if( auto real = std::get_if<double>(&content) ) {
+			//keep only the integer part
+			number = static_cast<long>(*real);
+			return true;
+		}
+		return false;
 	}
 	
-	Template& Template::applyReal(std::string_view varName, double number) {
-		if( myLocale == nullptr ) {
-			#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
-			throw InvalidTemplateState("Template not initialized");
-			#else
-			return *this;
-			#endif
+	///reads a number for real functions
+	bool readReal(const variableValue &content, double &number) {
+		if( auto real = std::get_if<double>(&content) ) {
+			number = *real;
+			return true;
 		}
-		variables.insert_or_assign( varName, variableValue{number} );
-		return *this;
+		if( auto integer = std::get_if<long>(&content) ) {
+			number = static_cast<double>(*integer);
+			return true;
+		}
+		return false;
 	}
 	
-	Template& Template::apply(std::string_view varName, Template& t) {
-		if( myLocale == nullptr ) {
-			#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
-			throw InvalidTemplateState("Template not initialized");
-			#else
-			return *this;
-			#endif
+	///the choice of the instruction at the index of a plural form, gender or case, `nullptr` if it has none
+	const Choice* indexedChoice(const Instruction &step, std::span<const Choice> choices, std::size_t index) {
+		if( index >= step.choicesCount || choices[step.firstChoice + index].key.empty() ) {
+			return nullptr;
 		}
-		variables.insert_or_assign( varName, variableValue{&t} );
-		return *this;
+		return &choices[step.firstChoice + index];
 	}
 	
-	std::string Template::get() {
-		if( myLocale == nullptr ) {
-			#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
-			throw InvalidTemplateState("Template not initialized");
-			#else
-			return "";
-			#endif
+	///most nested outputs remembered in one run, later ones are rendered every time
+	constexpr std::size_t MAX_NESTED_OUTPUTS = 8u;
+	
+	/**
+	 * @brief Outputs of nested templates rendered in one run, keyed by the template and the case
+	 * 
+	 * A nested template is rendered once and its output is repeated for every later tag using it.
+	 * `first` and `last` are positions whose meaning depends on the output type.
+	 */
+	class NestedOutputs {
+		public:
+			struct Entry {
+				const Template* nested;
+				std::string_view caseID;
+				std::size_t first;
+				std::size_t last;
+			};
+			
+			const Entry* find(const Template& nested, std::string_view caseID) const {
+				for(std::size_t i=0u; i<count; ++i) {
+					if( entries[i].nested == &nested && entries[i].caseID == caseID ) {
+						return &entries[i];
+					}
+				}
+				return nullptr;
+			}
+			void add(const Template& nested, std::string_view caseID, std::size_t first, std::size_t last) {
+				if( count < entries.size() ) {
+					entries[count++] = Entry{&nested, caseID, first, last};
+				}
+			}
+		private:
+			std::array<Entry, MAX_NESTED_OUTPUTS> entries;
+			std::size_t count = 0u;
+	};
+	
+	///The case asked by a `CASE_SELECT` instruction of the parent template, read by `CASE_WRITE`
+	struct CaseRequest {
+		///the name of the case, empty if none was asked
+		std::string_view name;
+		///the index of the case in the parent's locale
+		std::uint32_t index = Instruction::NO_INDEX;
+		const locale::Locale* parentLocale = nullptr;
+	};
+	
+	template<typename Output>
+	void runProgram(const CompiledTemplate& compiled, const TemplateArgs& args, Output& output, const CaseRequest& caseRequest);
+	
+	///renders a nested template with the parent's output, the nested template isn't changed
+	template<typename Output>
+	void renderNested(const Template& nested, const CaseRequest& caseRequest, Output& output) {
+		auto& nestedCompiled = nested.getCompiled();
+		if( nestedCompiled == nullptr ) {
+			renderingError("Template not initialized");
+			return;
 		}
-		std::ostringstream output;
-		std::size_t i=0u;
-		
-		for(i=0u; i<functionsList.size(); ++i) {
-			if( stringsList[i] != nullptr ) {
-				output << stringsList[i];
+		runProgram(*nestedCompiled, nested.getArgs(), output, caseRequest);
+	}
+	
+	///appends the output to a string
+	class StringOutput {
+		public:
+			explicit StringOutput(std::string& text): text{text} {}
+			
+			void put(std::string_view piece) {
+				text.append(piece);
+			}
+			void putLiteral(std::string_view piece) {
+				text.append(piece);
+			}
+			///number formats append straight to the output
+			std::string& formatBuffer() {
+				return text;
+			}
+			void putFormatted() {}
+			///nested templates append to the same string, where a repeated one is copied from
+			void putTemplate(const Template& nested, const CaseRequest& caseRequest) {
+				if( auto done = nestedOutputs.find(nested, caseRequest.name) ) {
+					const std::size_t length = done->last - done->first;
+					//no reallocation may happen between taking the pointer and appending
+					text.reserve(text.size() + length);
+					text.append(text.data() + done->first, length);
+					return;
+				}
+				const std::size_t first = text.size();
+				renderNested(nested, caseRequest, *this);
+				nestedOutputs.add(nested, caseRequest.name, first, text.size());
+			}
+		private:
+			std::string& text;
+			NestedOutputs nestedOutputs;
+	};
+	
+	///passes the output to a sink, numbers are formatted in a buffer reused for the whole run
+	class SinkOutput {
+		public:
+			explicit SinkOutput(RenderSink& sink): sink{sink} {}
+			
+			void put(std::string_view piece) {
+				sink.put(piece);
+				if( recording > 0u && !piece.empty() ) {
+					recorded.push_back( RecordedPiece{std::string_view{}, copies.size(), piece.size()} );
+					copies.append(piece);
+				}
+			}
+			void putLiteral(std::string_view piece) {
+				sink.putLiteral(piece);
+				if( recording > 0u && !piece.empty() ) {
+					recorded.push_back( RecordedPiece{piece, 0u, piece.size()} );
+				}
 			}
-			if( functionsList[i] != nullptr ) {
-				output << functionsList[i]->produceString(variables);
+			std::string& formatBuffer() {
+				buffer.clear();
+				return buffer;
 			}
+			void putFormatted() {
+				put(buffer);
+			}
+			///nested templates write to the same sink, their pieces are recorded to be put again
+			void putTemplate(const Template& nested, const CaseRequest& caseRequest) {
+				if( auto done = nestedOutputs.find(nested, caseRequest.name) ) {
+					for(std::size_t i=done->first; i<done->last; ++i) {
+						const RecordedPiece piece = recorded[i];
+						if( piece.literal.data() != nullptr ) {
+							sink.putLiteral(piece.literal);
+						} else {
+							sink.put( std::string_view{copies}.substr(piece.offset, piece.size) );
+						}
+						//a template nested deeper is put again as a part of its parent
+						if( recording > 0u ) {
+							recorded.push_back(piece);
+						}
+					}
+					return;
+				}
+				const std::size_t first = recorded.size();
+				++recording;
+				renderNested(nested, caseRequest, *this);
+				--recording;
+				nestedOutputs.add(nested, caseRequest.name, first, recorded.size());
+			}
+		private:
+			///a literal is referenced, other pieces are copied to `copies`
+			struct RecordedPiece {
+				std::string_view literal;
+				std::size_t offset;
+				std::size_t size;
+			};
+			
+			RenderSink& sink;
+			std::string buffer;
+			NestedOutputs nestedOutputs;
+			///the depth of nested templates being recorded
+			std::size_t recording = 0u;
+			std::vector<RecordedPiece> recorded;
+			std::string copies;
+	};
+	
+	///puts a variable content as is
+	template<typename Output>
+	void putVariable(const Instruction &step, const variableValue &content, Output &output) {
+		if( auto rawString = std::get_if<std::string_view>(&content) ) {
+			//raw strings are returned as is
+			output.put(*rawString);
+		} else if( auto subTemplate = std::get_if<Template*>(&content) ) {
+			output.putTemplate( **subTemplate, CaseRequest{} );
+		} else if( auto integer = std::get_if<long>(&content) ) {
+			//simple number formating
+			char buffer[24];
+			auto[lastPtr, err] = std::to_chars(&buffer[0], &buffer[sizeof(buffer)], *integer);
+			output.put( std::string_view(&buffer[0], static_cast<std::size_t>(lastPtr - &buffer[0])) );
+		} else if( auto real = std::get_if<double>(&content) ) {
+			//the same output as std::to_string(double)
+			char buffer[512];
+			int length = std::snprintf(&buffer[0], sizeof(buffer), "%f", *real);
+			if( length > 0 ) {
+				output.put( std::string_view(&buffer[0], static_cast<std::size_t>(length)) );
+			}
+		} else {
+			//other types of data are incompatible with this function
+			renderingError("Unsupported type of data for variable: " + std::string{step.text});
 		}
-		//the last string
-		if( stringsList[i] != nullptr ) {
-			output << stringsList[i];
+	}
+	
+	///count of digits of an integer
+	std::size_t countDigits(long number) {
+		unsigned long value = number < 0 ? 0ul - static_cast<unsigned long>(number) : static_cast<unsigned long>(number);
+		std::size_t digits = 1u;
+		while( value >= 10ul ) {
+			value /= 10ul;
+			++digits;
 		}
-		
-		//clear variables data
-		variables.clear();
-		
-		//return the result
-		return output.str();
+		return digits;
 	}
 	
-	std::string Template::getGender() {
-		return genderID;
+	///count of digits in the integer part of a real number
+	std::size_t countDigits(double number) {
+		//`double` can't have more than 309 digits
+		if( !(std::abs(number) < 1e18) ) return 309u;
+		return countDigits( static_cast<long>(number) );
 	}
 	
-	//------------- Methods for functions classes
+	///digits of the fractional part of a real number written with the given precision
+	constexpr std::size_t FRACTION_DIGITS_GUESS = 17u;
 	
-	std::string VariablePutter::produceString(std::map<std::string_view, variableValue> &variables) {
-		if( !variables.contains(variable) ) {
-			//error
-			#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
-			throw InvalidTemplateState("The variable doesn't exists: " + variable);
-			#else
-			return "";
-			#endif
-		}
+	std::size_t estimateSize(const CompiledTemplate& compiled, const TemplateArgs& args) {
+		using Code = Instruction::Code;
+		std::size_t result = 0u;
+		//variables can be read only from arguments made for this template
+		const bool hasArgs = args.getCompiled() == &compiled;
 		
-		auto content = variables.at(variable);
-		
-		if( std::holds_alternative<std::string_view>(content) ) {
-			//raw strings are returned as is
-			auto sv = std::get<std::string_view>(content);
-			char* sc = new char[sv.size()+1];
-			sv.copy(sc, sv.size());
-			sc[sv.size()] = '\0';
-			std::string result{sc};
-			delete[] sc;
+		for(const Instruction &step : compiled.program) {
+			if( step.code == Code::EMIT_LITERAL ) {
+				result += step.text.size();
+				continue;
+			}
+			if( step.code == Code::PLURAL_SELECT || step.code == Code::GENDER_SELECT || step.code == Code::CASE_WRITE ) {
+				std::size_t longest = 0u;
+				for(std::uint32_t i=step.firstChoice; i<step.firstChoice + step.choicesCount; ++i) {
+					longest = std::max(longest, compiled.choices[i].text.size());
+				}
+				result += longest;
+				continue;
+			}
 			
-			return result;
+			if( !hasArgs ) {
+				continue;
+			}
+			const variableValue *content = &args.get(step.slot);
+			if( auto rawString = std::get_if<std::string_view>(content) ) {
+				result += rawString->size();
+			} else if( auto subTemplate = std::get_if<Template*>(content) ) {
+				auto& subCompiled = (*subTemplate)->getCompiled();
+				if( subCompiled != nullptr ) {
+					result += estimateSize(*subCompiled, (*subTemplate)->getArgs());
+				}
+			} else if( auto integer = std::get_if<long>(content) ) {
+				if( step.code == Code::INT_FORMAT || step.code == Code::REAL_FORMAT ) {
+					result += step.format->maxLength( countDigits(*integer) );
+				} else {
+					result += 1u + countDigits(*integer);
+				}
+			} else if( auto real = std::get_if<double>(content) ) {
+				if( step.code == Code::INT_FORMAT ) {
+					result += step.format->maxLength( countDigits(*real) );
+				} else if( step.code == Code::REAL_FORMAT ) {
+					result += step.format->maxLength(
+						countDigits(*real),
+						step.precision >= 0 ? static_cast<std::size_t>(step.precision) : FRACTION_DIGITS_GUESS
+					);
+				} else {
+					//the "%f" format
+					result += 1u + countDigits(*real) + 7u;
+				}
+			}
 		}
 		
-		if( std::holds_alternative<Template*>(content) ) {
-			return std::get<Template*>(content)->get();
-		}
+		return result;
+	}
+	
+	std::string render(const CompiledTemplate& compiled, const TemplateArgs& args) {
+		std::string output;
+		render(compiled, args, output);
+		return output;
+	}
+	
+	///runs the program of the compiled template, see `StringOutput` and `SinkOutput`
+	template<typename Output>
+	void runProgram(const CompiledTemplate& compiled, const TemplateArgs& args, Output& output, const CaseRequest& caseRequest) {
+		using Code = Instruction::Code;
+		const variableValue *content = nullptr;
 		
-		//simple number formating
-		if( std::holds_alternative<long>(content) ) {
-			return std::to_string(
-				std::get<long>(content)
-			);
+		if( args.getCompiled() != &compiled && !compiled.getVariableNames().empty() ) {
+			renderingError("The arguments were made for another template");
+			return;
 		}
+		const auto choices = compiled.getChoices();
+		locale::Locale& myLocale = compiled.getLocale();
 		
-		if( std::holds_alternative<double>(content) ) {
-			return std::to_string(
-				std::get<double>(content)
-			);
+		for(const Instruction &step : compiled.getProgram()) {
+			//all instructions but these two work on a variable
+			if( step.code != Code::EMIT_LITERAL && step.code != Code::CASE_WRITE ) {
+				content = &args.get(step.slot);
+				if( std::holds_alternative<std::monostate>(*content) ) {
+					renderingError("The variable doesn't exists: " + std::string{step.text});
+					continue;
+				}
+			}
+			
+			switch( step.code ) {
+				case Code::EMIT_LITERAL:
+					output.putLiteral(step.text);
+					break;
+				case Code::PUT_VAR:
+					putVariable(step, *content, output);
+					break;
+				case Code::PLURAL_SELECT: {
+					//choices are in the order of the locale's plural forms
+					std::size_t form;
+					if( auto integer = std::get_if<long>(content) ) {
+						form = myLocale.getPluralIndex(*integer);
+					} else if( auto real = std::get_if<double>(content) ) {
+						//the fraction matters, "1.5" may have another form than "1"
+						form = myLocale.getPluralIndex( locale::pluralOperands(*real) );
+					} else {
+						renderingError("Invalid type of the variable: " + std::string{step.text});
+						break;
+					}
+					
+					const Choice* choice = indexedChoice(step, choices, form);
+					if( choice == nullptr ) {
+						const auto& forms = myLocale.getPluralsList();
+						renderingError("Unknown plural type: " + std::string{form < forms.size() ? forms[form] : "?"});
+					} else {
+						output.putLiteral(choice->text);
+					}
+					break;
+				}
+				case Code::GENDER_SELECT: {
+					auto subTemplate = std::get_if<Template*>(content);
+					if( subTemplate == nullptr ) {
+						//other types are incompatible with this function
+						renderingError("Unsupported type of the variable");
+						break;
+					}
+					auto& subCompiled = (*subTemplate)->getCompiled();
+					std::uint32_t gender = Instruction::NO_INDEX;
+					if( subCompiled != nullptr ) {
+						//the index of a template of another locale doesn't count here
+						gender = &subCompiled->getLocale() == &myLocale ? 
+							subCompiled->getGenderIndex() : indexOf(myLocale.getGendersList(), subCompiled->getGender());
+					}
+					auto choice = indexedChoice(step, choices, gender);
+					if( choice == nullptr ) {
+						renderingError("Unknown gender: " + std::string{subCompiled != nullptr ? subCompiled->getGender() : ""});
+					} else {
+						output.putLiteral(choice->text);
+					}
+					break;
+				}
+				case Code::CASE_WRITE: {
+					std::size_t caseIndex;
+					if( !caseRequest.name.empty() ) {
+						//the index counts only in the parent's locale
+						caseIndex = caseRequest.parentLocale == &myLocale && caseRequest.index != Instruction::NO_INDEX ? 
+							caseRequest.index : indexOf(myLocale.getCasesList(), caseRequest.name);
+					} else {
+						//without a parent the case may be given by the `__CASE__` variable
+						content = &args.get(step.slot);
+						if( std::holds_alternative<std::monostate>(*content) ) {
+							//not an error
+							break;
+						}
+						auto caseID = std::get_if<std::string_view>(content);
+						if( caseID == nullptr ) {
+							renderingError("Unsupported type of the __CASE__ variable");
+							break;
+						}
+						caseIndex = indexOf(myLocale.getCasesList(), *caseID);
+					}
+					auto choice = indexedChoice(step, choices, caseIndex);
+					if( choice == nullptr ) {
+						renderingError("Wrong case");
+					} else {
+						output.putLiteral(choice->text);
+					}
+					break;
+				}
+				case Code::CASE_SELECT: {
+					auto subTemplate = std::get_if<Template*>(content);
+					if( subTemplate == nullptr ) {
+						//other types of data are incompatible with this function
+						renderingError("Invalid type of variable: " + std::string{step.text});
+						break;
+					}
+					output.putTemplate( **subTemplate, CaseRequest{step.argument, step.caseIndex, &myLocale} );
+					break;
+				}
+				case Code::INT_FORMAT: {
+					long number;
+					if( !readInteger(*content, number) ) {
+						renderingError("The variable has improper content: " + std::string{step.text});
+						break;
+					}
+					step.format->formatInteger(number, output.formatBuffer());
+					output.putFormatted();
+					break;
+				}
+				case Code::REAL_FORMAT: {
+					double number;
+					if( !readReal(*content, number) ) {
+						renderingError("The variable has improper content: " + std::string{step.text});
+						break;
+					}
+					step.format->formatReal(number, output.formatBuffer(), step.precision);
+					output.putFormatted();
+					break;
+				}
+			}
 		}
-		
-		//other types of data are incompatible with this function
-		#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
-		throw InvalidTemplateState("Unsupported type of data for variable: " + variable);
-		#else
-		return "";
-		#endif
 	}
 	
-	GenderFunction::GenderFunction(
-		std::string &&varName,
-		std::vector<std::string> &listOfOutputs,
-		const locale::Locale &locale
-	):variable{varName} {
-		std::size_t i;
-		
-		if( listOfOutputs.size() != locale.getGendersList().size() ) {
-			throw InvalidTemplateState("Invalid list of genders");
+	///makes room for `needed` more bytes, growing the string geometrically when it must grow
+	void reserveMore(std::string& output, std::size_t needed) {
+		if( output.capacity() - output.size() < needed ) {
+			//`reserve` may allocate exactly the asked size, which would make every append copy the string
+			output.reserve( std::max(output.size() + needed, 2u * output.capacity()) );
 		}
-		
-		for(i=0u; i<listOfOutputs.size(); ++i) {
-			outputTexts.emplace(
-				locale.getGendersList()[i],
-				listOfOutputs[i]
-			);
+	}
+	
+	void render(const CompiledTemplate& compiled, const TemplateArgs& args, std::string& output) {
+		reserveMore( output, estimateSize(compiled, args) );
+		StringOutput stringOutput{output};
+		runProgram(compiled, args, stringOutput, CaseRequest{});
+	}
+	
+	void render(const CompiledTemplate& compiled, const TemplateArgs& args, RenderSink& sink) {
+		SinkOutput sinkOutput{sink};
+		runProgram(compiled, args, sinkOutput, CaseRequest{});
+	}
+	
+	//------------- Sinks
+	
+	void RenderSink::putLiteral(std::string_view text) {
+		put(text);
+	}
+	
+	OstreamSink::OstreamSink(std::ostream& stream): stream{stream} {}
+	
+	void OstreamSink::put(std::string_view text) {
+		stream.write(text.data(), static_cast<std::streamsize>(text.size()));
+	}
+	
+	FileSink::FileSink(std::FILE* file): file{file} {}
+	
+	void FileSink::put(std::string_view text) {
+		std::fwrite(text.data(), 1u, text.size(), file);
+	}
+	
+	void IovecSink::put(std::string_view text) {
+		if( text.empty() ) {
+			return;
+		}
+		//copies are appended one after another, so a copy following another one joins it
+		if( !pieces.empty() && pieces.back().data == nullptr ) {
+			pieces.back().size += text.size();
+		} else {
+			pieces.push_back( Piece{nullptr, copies.size(), text.size()} );
 		}
+		copies.append(text);
+		totalSize += text.size();
 	}
 	
-	GenderFunction::GenderFunction(
-		std::string &&varName,
-		std::map<std::string, std::string> &mapOfOutputs
-	):variable{varName} {
-		outputTexts = std::move(mapOfOutputs);
+	void IovecSink::putLiteral(std::string_view text) {
+		if( text.empty() ) {
+			return;
+		}
+		if( !pieces.empty() && pieces.back().data != nullptr && pieces.back().data + pieces.back().size == text.data() ) {
+			//the literal follows the previous one in memory
+			pieces.back().size += text.size();
+		} else {
+			pieces.push_back( Piece{text.data(), 0u, text.size()} );
+		}
+		totalSize += text.size();
 	}
 	
-	std::string GenderFunction::produceString(std::map<std::string_view, variableValue> &variables) {
-		if( !variables.contains(variable) ) {
-			//error
-			#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
-			throw InvalidTemplateState("The variable doesn't exists: " + variable);
-			#else
-			return "";
-			#endif
+	std::span<const IoSegment> IovecSink::segments() {
+		//copies may have moved since they were put, so their addresses are known only now
+		resolved.clear();
+		for(const Piece& piece : pieces) {
+			const char* start = piece.data != nullptr ? piece.data : copies.data() + piece.offset;
+			IoSegment segment;
+			segment.iov_base = const_cast<char*>(start);
+			segment.iov_len = piece.size;
+			resolved.push_back(segment);
 		}
-		
-		auto content = variables.at(variable);
-		
-		if( std::holds_alternative<Template*>(content) ) {
-			auto subTemplateGender = std::get<Template*>(content)->getGender();
-			
-			if( !outputTexts.contains(subTemplateGender) ) {
-				//error
-				#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
-				throw InvalidTemplateState("Unknown gender: " + subTemplateGender);
-				#else
-				return "";
-				#endif
-			}
-			
-			return outputTexts[subTemplateGender];
+		return resolved;
+	}
+	
+	std::size_t IovecSink::size() const {
+		return totalSize;
+	}
+	
+	void IovecSink::clear() {
+		pieces.clear();
+		copies.clear();
+		resolved.clear();
+		totalSize = 0u;
+	}
+	
+	//------------- Template arguments class
+	
+	TemplateArgs::TemplateArgs():compiled{nullptr} {}
+	
+	TemplateArgs::TemplateArgs(const CompiledTemplate& compiled):compiled{&compiled} {
+		if( compiled.slotsCount() > INLINE_SLOTS ) {
+			moreValues.resize( compiled.slotsCount() );
 		}
-		
-		//other types are incompatible with this function
-		#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
-		throw InvalidTemplateState("Unsupported type of the variable");
-		#else
-		return "";
-		#endif
 	}
 	
-	CaseWriterFunction::CaseWriterFunction(
-		std::vector<std::string> &listOfOutputs,
-		const locale::Locale &locale
-	) {
-		if( listOfOutputs.size() != locale.getCasesList().size() ) {
-			throw InvalidTemplateState("Invalid list of cases");
+	variableValue* TemplateArgs::values() {
+		return moreValues.empty() ? inlineValues.data() : moreValues.data();
+	}
+	
+	const variableValue* TemplateArgs::values() const {
+		return moreValues.empty() ? inlineValues.data() : moreValues.data();
+	}
+	
+	void TemplateArgs::set(VariableSlot slot, variableValue value) {
+		if( compiled == nullptr || slot.index >= compiled->slotsCount() ) {
+			//the template doesn't use the variable
+			return;
 		}
-		
-		for(std::size_t i=0u; i<listOfOutputs.size(); ++i) {
-			outputTexts.emplace(
-				locale.getCasesList()[i],
-				listOfOutputs[i]
-			);
+		values()[slot.index] = value;
+	}
+	
+	TemplateArgs& TemplateArgs::apply(std::string_view varName, std::string_view rawString) {
+		if( compiled != nullptr ) {
+			set( compiled->slot(varName), variableValue{rawString} );
 		}
+		return *this;
 	}
 	
-	CaseWriterFunction::CaseWriterFunction(
-		std::map<std::string, std::string> &mapOfOutputs
-	) {
-		outputTexts = std::move(mapOfOutputs);
+	TemplateArgs& TemplateArgs::apply(std::string_view varName, long number) {
+		if( compiled != nullptr ) {
+			set( compiled->slot(varName), variableValue{number} );
+		}
+		return *this;
 	}
 	
-	std::string CaseWriterFunction::produceString(std::map<std::string_view, variableValue> &variables) {
-		if( !variables.contains("__CASE__") ) {
-			//not an error
-			return "";
+	TemplateArgs& TemplateArgs::applyReal(std::string_view varName, double number) {
+		if( compiled != nullptr ) {
+			set( compiled->slot(varName), variableValue{number} );
 		}
-		
-		auto content = variables.at("__CASE__");
-		
-		if( std::holds_alternative<std::string_view>(content) ) {
-			auto sv = std::get<std::string_view>(content);
-			
-			for(auto&[key, value] : outputTexts) {
-				if( key == sv ) {
-					return value;
-				}
-			}
-			//other cases are errors
-			#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
-			throw InvalidTemplateState("Wrong case");
-			#else
-			return "";
-			#endif
+		return *this;
+	}
+	
+	TemplateArgs& TemplateArgs::apply(std::string_view varName, Template& t) {
+		if( compiled != nullptr ) {
+			set( compiled->slot(varName), variableValue{&t} );
 		}
-		//other types of data are errors
-		#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
-		throw InvalidTemplateState("Unsupported type of the __CASE__ variable");
-		#else
-		return "";
-		#endif
+		return *this;
 	}
 	
-	CaseChooserFunction::CaseChooserFunction(
-		std::string &&varName,
-		std::string &&case_id
-	):variable{varName}, caseID{case_id} { }
+	TemplateArgs& TemplateArgs::apply(VariableSlot slot, std::string_view rawString) {
+		set( slot, variableValue{rawString} );
+		return *this;
+	}
 	
-	std::string CaseChooserFunction::produceString(std::map<std::string_view, variableValue> &variables) {
-		if( !variables.contains(variable) ) {
-			//error
-			#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
-			throw InvalidTemplateState("The variable doesn't exists: " + variable);
-			#else
-			return "";
-			#endif
+	TemplateArgs& TemplateArgs::apply(VariableSlot slot, long number) {
+		set( slot, variableValue{number} );
+		return *this;
+	}
+	
+	TemplateArgs& TemplateArgs::applyReal(VariableSlot slot, double number) {
+		set( slot, variableValue{number} );
+		return *this;
+	}
+	
+	TemplateArgs& TemplateArgs::apply(VariableSlot slot, Template& t) {
+		set( slot, variableValue{&t} );
+		return *this;
+	}
+	
+	const variableValue* TemplateArgs::find(std::string_view varName) const {
+		if( compiled == nullptr ) {
+			return nullptr;
+		}
+		auto slot = compiled->slot(varName);
+		if( slot.index == VariableSlot::NONE ) {
+			return nullptr;
+		}
+		const variableValue& value = values()[slot.index];
+		if( std::holds_alternative<std::monostate>(value) ) {
+			return nullptr;
+		}
+		return &value;
+	}
+	
+	const variableValue& TemplateArgs::get(std::uint32_t slotIndex) const {
+		return values()[slotIndex];
+	}
+	
+	const CompiledTemplate* TemplateArgs::getCompiled() const {
+		return compiled;
+	}
+	
+	void TemplateArgs::clear() {
+		if( compiled == nullptr ) {
+			return;
+		}
+		auto count = compiled->slotsCount();
+		auto theValues = values();
+		for(std::size_t i=0u; i<count; ++i) {
+			theValues[i] = std::monostate{};
+		}
+	}
+	
+	//------------- Batches
+	
+	std::size_t BatchOutput::size() const {
+		return offsets.empty() ? 0u : offsets.size() - 1u;
+	}
+	
+	std::string_view BatchOutput::row(std::size_t index) const {
+		return std::string_view{text}.substr(offsets[index], offsets[index + 1u] - offsets[index]);
+	}
+	
+	///fewer rows than this aren't worth a thread
+	constexpr std::size_t MIN_BATCH_ROWS_PER_THREAD = 1024u;
+	
+	///renders rows `[first, last)` appending them to `text` and their ends to `ends`
+	void renderRows(
+		const CompiledTemplate& compiled, 
+		std::span<const BatchColumn> columns, 
+		std::span<const VariableSlot> slots, 
+		std::size_t first, 
+		std::size_t last, 
+		std::string& text, 
+		std::vector<std::size_t>& ends
+	) {
+		TemplateArgs args{compiled};
+		ends.reserve(ends.size() + (last - first));
+		for(std::size_t row=first; row<last; ++row) {
+			//every used slot gets a new value, so nothing has to be cleared
+			for(std::size_t column=0u; column<columns.size(); ++column) {
+				std::visit([&args, slot = slots[column], row](auto values) {
+					if constexpr( std::is_same_v<decltype(values), std::span<const double>> ) {
+						args.applyReal(slot, values[row]);
+					} else {
+						args.apply(slot, values[row]);
+					}
+				}, columns[column].values);
+			}
+			//the first row's size is the guess for all of them, later rows let the string grow by itself
+			if( row == first ) {
+				reserveMore( text, estimateSize(compiled, args) * (last - first) );
+			}
+			StringOutput rowOutput{text};
+			runProgram(compiled, args, rowOutput, CaseRequest{});
+			ends.push_back(text.size());
+		}
+	}
+	
+	void renderBatch(
+		const CompiledTemplate& compiled, 
+		std::span<const BatchColumn> columns, 
+		BatchOutput& output, 
+		BatchPolicy policy, 
+		unsigned maxThreads
+	) {
+		auto columnSize = [](const BatchColumn& column) {
+			return std::visit([](auto values) { return values.size(); }, column.values);
+		};
+		const std::size_t rows = columns.empty() ? 0u : columnSize(columns[0]);
+		std::vector<VariableSlot> slots;
+		slots.reserve(columns.size());
+		for(auto& column : columns) {
+			if( columnSize(column) != rows ) {
+				throw InvalidTemplateState("Columns of a batch have different sizes");
+			}
+			slots.push_back( compiled.slot(column.name) );
 		}
 		
-		auto content = variables.at(variable);
+		output.text.clear();
+		output.offsets.clear();
+		output.offsets.reserve(rows + 1u);
+		output.offsets.push_back(0u);
 		
-		if( std::holds_alternative<Template*>(content) ) {
-			return std::get<Template*>(content)->apply("__CASE__", caseID).get();
+		std::size_t threadsCount = 1u;
+		if( policy == BatchPolicy::PARALLEL ) {
+			if( maxThreads == 0u ) {
+				maxThreads = std::max(1u, std::thread::hardware_concurrency());
+			}
+			threadsCount = std::min<std::size_t>(maxThreads, rows / MIN_BATCH_ROWS_PER_THREAD);
+		}
+		if( threadsCount <= 1u ) {
+			renderRows(compiled, columns, slots, 0u, rows, output.text, output.offsets);
+			return;
 		}
 		
-		//other types of data are incompatible with this function
-		#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
-		throw InvalidTemplateState("Invalid type of variable: " + variable);
-		#else
-		return "";
-		#endif
-	}
-	
-	PluralFunction::PluralFunction(
-		std::string &&varName,
-		std::vector<std::string> listOfOutputs,
-		const locale::Locale &locale
-	):variable{varName}, theLocale{locale} {
-		if( listOfOutputs.size() != locale.getPluralsList().size() ) {
-			throw InvalidTemplateState("Wrong number of arguments");
+		//each thread renders its part of the rows into its own buffer, which are joined afterwards
+		struct Part {
+			std::string text;
+			std::vector<std::size_t> ends;
+			std::exception_ptr error;
+		};
+		std::vector<Part> parts(threadsCount);
+		auto renderPart = [&](std::size_t index) {
+			try {
+				renderRows(compiled, columns, slots, rows * index / threadsCount, rows * (index + 1u) / threadsCount, parts[index].text, parts[index].ends);
+			} catch(...) {
+				parts[index].error = std::current_exception();
+			}
+		};
+		std::vector<std::thread> threads;
+		threads.reserve(threadsCount - 1u);
+		for(std::size_t index=1u; index<threadsCount; ++index) {
+			threads.emplace_back(renderPart, index);
+		}
+		renderPart(0u);
+		for(auto& thread : threads) {
+			thread.join();
 		}
 		
-		for(std::size_t i=0u; i<listOfOutputs.size(); ++i) {
-			outputTexts.emplace(
-				locale.getPluralsList()[i],
-				listOfOutputs[i]
-			);
+		std::size_t textSize = 0u;
+		for(auto& part : parts) {
+			if( part.error ) {
+				std::rethrow_exception(part.error);
+			}
+			textSize += part.text.size();
+		}
+		output.text.reserve(textSize);
+		for(auto& part : parts) {
+			const std::size_t base = output.text.size();
+			output.text.append(part.text);
+			for(auto end : part.ends) {
+				output.offsets.push_back(base + end);
+			}
 		}
 	}
 	
-	PluralFunction::PluralFunction(
-		std::string &&varName,
-		std::map<std::string, std::string> &mapOfOutputs,
-		const locale::Locale &locale
-	):variable{varName}, theLocale{locale} {
-		outputTexts = std::move(mapOfOutputs);
+	//------------- Template class
+	
+	Template::Template():compiled{nullptr} {
+		//do nothing else
+	}
+	
+	Template::Template(Template&& other):
+		compiled{std::move(other.compiled)}, args{std::move(other.args)} {
+		other.compiled = nullptr;
+		other.args = TemplateArgs{};
 	}
 	
-	std::string PluralFunction::produceString(std::map<std::string_view, variableValue> &variables) {
-		if( !variables.contains(variable) ) {
-			//error
-			#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
-			throw InvalidTemplateState("The variable doesn't exists: " + variable);
-			#else
-			return "";
-			#endif
+	Template::Template(std::string_view templateString, locale::Locale& locale):
+		compiled{std::make_shared<const CompiledTemplate>(templateString, locale)}, args{*compiled} {}
+	
+	Template::Template(const preparse::TemplateSyntax& syntax, locale::Locale& locale):
+		compiled{std::make_shared<const CompiledTemplate>(syntax, locale)}, args{*compiled} {}
+	
+	Template::Template(std::shared_ptr<const CompiledTemplate> compiledTemplate):
+		compiled{std::move(compiledTemplate)} {
+		if( compiled != nullptr ) {
+			args = TemplateArgs{*compiled};
 		}
-		
-		long number;
-		auto content = variables.at(variable);
-		if( std::holds_alternative<long>(content) ) {
-			number = std::get<long>(content);
-		} else if( std::holds_alternative<double>(content) ) {
-			//keep only the integer part
-			number = static_cast<long>(std::get<double>(content));
-		} else {
-			//error
+	}
+	
+	Template::~Template() {}
+	
+	Template& Template::apply(std::string_view varName, std::string_view rawString) {
+		if( compiled == nullptr ) {
 			#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
-			throw InvalidTemplateState("Invalid type of the variable: " + variable);
+			throw InvalidTemplateState("Template not initialized");
 			#else
-			return "";
+			return *this;
 			#endif
 		}
-		
-		if( number < 0 ) number *= -1;
-		
-		std::string pluralID = theLocale.getPluralID(number);
-		if( ! outputTexts.contains(pluralID) ) {
+		args.apply(varName, rawString);
+		return *this;
+	}
+	
+	Template& Template::apply(std::string_view varName, long number) {
+		if( compiled == nullptr ) {
 			#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
-			throw InvalidTemplateState("Unknown plural type: " + pluralID);
+			throw InvalidTemplateState("Template not initialized");
 			#else
-			return "";
+			return *this;
 			#endif
-		} else {
-			return outputTexts[pluralID];
 		}
+		args.apply(varName, number);
+		return *this;
 	}
 	
-	IntegerFormaterFunction::IntegerFormaterFunction(
-		std::string &&varName,
-		std::string &formatName,
-		locale::Locale &theLocale
-	):variable{varName}, formater{*(theLocale.getNumberFormat(formatName))} {}
-	
-	std::string IntegerFormaterFunction::produceString(std::map<std::string_view, variableValue> &variables) {
-		if( !variables.contains(variable) ) {
-			//error
+	Template& Template::applyReal(std::string_view varName, double number) {
+		if( compiled == nullptr ) {
 			#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
-			throw InvalidTemplateState("The variable doesn't exists: " + variable);
+			throw InvalidTemplateState("Template not initialized");
 			#else
-			return "";
+			return *this;
 			#endif
 		}
-		
-		long number;
-		auto content = variables.at(variable);
-		
-		if( std::holds_alternative<long>(content) ) {
-			number = std::get<long>(content);
-		} else if( std::holds_alternative<double>(content) ) {
-			//keep only the integer part
-			number = static_cast<long>(std::get<double>(content));
-		} else {
+		args.applyReal(varName, number);
+		return *this;
+	}
+	
+	Template& Template::apply(std::string_view varName, Template& t) {
+		if( compiled == nullptr ) {
 			#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
-			throw InvalidTemplateState("The variable has improper content: " + variable);
+			throw InvalidTemplateState("Template not initialized");
 			#else
-			return "";
+			return *this;
 			#endif
 		}
-		
-		return formater.formatInteger(number);
+		args.apply(varName, t);
+		return *this;
 	}
 	
-	bool RealFormaterFunction::isAllNumber(std::string &str) {
-		//IMPORTANT: we don check for *negative* numbers
-		for(auto c : str) {
-			if( !std::isdigit(c) ) {
-				return false;
-			}
-		}
-		return true;
+	Template& Template::apply(VariableSlot slot, std::string_view rawString) {
+		args.apply(slot, rawString);
+		return *this;
 	}
 	
-	RealFormaterFunction::RealFormaterFunction(
-		std::string &&varName,
-		std::vector<std::string> &listOfOptions,
-		locale::Locale &theLocale
-	):variable{varName} {
-		formater = nullptr;
-		if( listOfOptions.size() == 1u ) {
-			//only formater
-			formater = theLocale.getNumberFormat(listOfOptions[0]);
-			precision = -1;
-		} else if( listOfOptions.size() == 2u ) {
-			//formater and precision
-			formater = theLocale.getNumberFormat(listOfOptions[0]);
-			if( ! isAllNumber(listOfOptions[1]) ) {
-				throw InvalidTemplateState("Invalid precision: " + listOfOptions[1]);
-			} else {
-				precision = static_cast<short>(std::stoi(listOfOptions[1]));
-			}
-		}
-		
-		if( formater == nullptr ) {
-			throw InvalidTemplateState("Unknow formater type");
+	Template& Template::apply(VariableSlot slot, long number) {
+		args.apply(slot, number);
+		return *this;
+	}
+	
+	Template& Template::applyReal(VariableSlot slot, double number) {
+		args.applyReal(slot, number);
+		return *this;
+	}
+	
+	Template& Template::apply(VariableSlot slot, Template& t) {
+		args.apply(slot, t);
+		return *this;
+	}
+	
+	VariableSlot Template::slot(std::string_view varName) const {
+		if( compiled == nullptr ) {
+			return VariableSlot{};
 		}
+		return compiled->slot(varName);
 	}
 	
-	RealFormaterFunction::RealFormaterFunction(
-		std::string &&varName,
-		std::map<std::string, std::string> &hashOfOptions,
-		locale::Locale &theLocale
-	):variable{varName} {
-		formater = nullptr;
-		if( hashOfOptions.contains("format") ) {
-			formater = theLocale.getNumberFormat(hashOfOptions["format"]);
-		} else {
-			formater = theLocale.getNumberFormat("general");
+	std::string Template::get() {
+		if( compiled == nullptr ) {
+			#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
+			throw InvalidTemplateState("Template not initialized");
+			#else
+			return "";
+			#endif
 		}
+		std::string result = render(*compiled, args);
 		
-		precision = -1;
-		if( hashOfOptions.contains("prec") ) {
-			if( isAllNumber(hashOfOptions["prec"]) ) {
-				precision = static_cast<short>(
-					std::stoi(hashOfOptions["prec"])
-				);
-			} else {
-				throw InvalidTemplateState("Invalid number for precision: " + hashOfOptions["prec"]);
-			}
-		}
+		//clear variables data
+		args.clear();
 		
-		if( formater == nullptr ) {
-			throw InvalidTemplateState("Unknown formater type");
-		}
+		//return the result
+		return result;
 	}
 	
-	std::string RealFormaterFunction::produceString(std::map<std::string_view, variableValue> &variables) {
-		if( !variables.contains(variable) ) {
-			//error
+	void Template::get(std::string& output) {
+		if( compiled == nullptr ) {
 			#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
-			throw InvalidTemplateState("The variable doesn't exists: " + variable);
+			throw InvalidTemplateState("Template not initialized");
 			#else
-			return "";
+			return;
 			#endif
 		}
+		render(*compiled, args, output);
 		
-		double number;
-		auto content = variables.at(variable);
-		
-		if( std::holds_alternative<double>(content) ) {
-			number = std::get<double>(content);
-		} else if( std::holds_alternative<long>(content) ) {
-			//keep only the integer part
-			number = static_cast<double>(std::get<long>(content));
-		} else {
+		//clear variables data
+		args.clear();
+	}
+	
+	void Template::get(RenderSink& sink) {
+		if( compiled == nullptr ) {
 			#ifdef MULANSTR_THROW_ON_INVALID_TEMPLATE
-			throw InvalidTemplateState("The variable has improper content: " + variable);
+			throw InvalidTemplateState("Template not initialized");
 			#else
-			return "";
+			return;
 			#endif
 		}
+		render(*compiled, args, sink);
 		
-		return formater->formatReal(number, precision);
+		//clear variables data
+		args.clear();
+	}
+	
+	std::string Template::getGender() {
+		if( compiled == nullptr ) {
+			return "";
+		}
+		return std::string{ compiled->getGender() };
+	}
+	
+	const std::shared_ptr<const CompiledTemplate>& Template::getCompiled() const {
+		return compiled;
+	}
+	
+	const TemplateArgs& Template::getArgs() const {
+		return args;
 	}
+
 };
 
 //CUT-END
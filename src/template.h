@@ -2,11 +2,17 @@
 #ifndef MULAN_STRING_TEMPLATE
 #define MULAN_STRING_TEMPLATE
 
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <iosfwd>
 #include <utility>
 #include <string_view>
 #include <string>
 #include <vector>
 #include <map>
+#include <memory>
+#include <span>
 #include <variant>
 
 #include "mls_locale.h"
@@ -14,16 +20,337 @@
 #include "errors.h"
 //CUT-START
 
+#if !defined(_WIN32)
+#	include <sys/uio.h>
+#endif
+
 namespace mls {
 	
 	class Template;
-	typedef std::variant<std::string_view, long, double, Template*> variableValue;
+	class CompiledTemplate;
+	///`std::monostate` marks a variable which wasn't set
+	typedef std::variant<std::monostate, std::string_view, long, double, Template*> variableValue;
+	
+	///Handle of a template's variable, see `CompiledTemplate::slot(...)`
+	struct VariableSlot {
+		///value of `index` for variables the template doesn't use
+		static constexpr std::uint32_t NONE = UINT32_MAX;
+		
+		std::uint32_t index = NONE;
+	};
+	
+	/**
+	 * @brief Values of variables used in one run of a compiled template
+	 * 
+	 * Values are kept in an array indexed by the template's variable slots.
+	 * Variables the template doesn't use are ignored.
+	 */
+	class TemplateArgs {
+		public:
+			///number of variables kept without allocating memory
+			static constexpr std::size_t INLINE_SLOTS = 8u;
+			
+			///arguments for no template, all variables are ignored
+			TemplateArgs();
+			///arguments for the compiled template, which must live longer than them
+			explicit TemplateArgs(const CompiledTemplate& compiled);
+			
+			//apply function group
+			
+			///set a raw string for a variable
+			TemplateArgs& apply(std::string_view varName, std::string_view rawString);
+			///set an integer number for a variable
+			TemplateArgs& apply(std::string_view varName, long number);
+			///set a real number for a variable
+			TemplateArgs& applyReal(std::string_view varName, double number);
+			///set another template for a variable
+			TemplateArgs& apply(std::string_view varName, Template& t);
+			
+			///set a raw string for a variable slot
+			TemplateArgs& apply(VariableSlot slot, std::string_view rawString);
+			///set an integer number for a variable slot
+			TemplateArgs& apply(VariableSlot slot, long number);
+			///set a real number for a variable slot
+			TemplateArgs& applyReal(VariableSlot slot, double number);
+			///set another template for a variable slot
+			TemplateArgs& apply(VariableSlot slot, Template& t);
+			
+			//end apply
+			
+			///returns `nullptr` if the variable wasn't set
+			const variableValue* find(std::string_view varName) const;
+			///the value in a slot, `std::monostate` if it wasn't set
+			const variableValue& get(std::uint32_t slotIndex) const;
+			///the compiled template these arguments are for
+			const CompiledTemplate* getCompiled() const;
+			///forget all variables
+			void clear();
+		private:
+			const CompiledTemplate *compiled;
+			std::array<variableValue, INLINE_SLOTS> inlineValues;
+			///used instead of `inlineValues` by templates with many variables
+			std::vector<variableValue> moreValues;
+			
+			void set(VariableSlot slot, variableValue value);
+			variableValue* values();
+			const variableValue* values() const;
+	};//!class TemplateArgs
 	
-	///interface for template functions
-	class TemplateFunction {
+	/**
+	 * @brief One step of a compiled template
+	 * 
+	 * A template is compiled into a flat list of instructions which `render(...)` runs one by one
+	 */
+	struct Instruction {
+		///value of indices which point to nothing
+		static constexpr std::uint32_t NO_INDEX = UINT32_MAX;
+		
+		enum class Code : unsigned char {
+			///puts the `text`
+			EMIT_LITERAL,
+			///puts the content of the variable
+			PUT_VAR,
+			///puts a choice selected by the plural form of the number in the variable
+			PLURAL_SELECT,
+			///puts a choice selected by the gender of the template in the variable, choices are in the order of the locale's genders
+			GENDER_SELECT,
+			///puts a choice selected by the case asked by the parent template or, without one, by the `__CASE__` variable; 
+			///choices are in the order of the locale's cases
+			CASE_WRITE,
+			///puts the template in the variable in the case given by the `argument`
+			CASE_SELECT,
+			///puts the number in the variable formatted as an integer
+			INT_FORMAT,
+			///puts the number in the variable formatted as a real number
+			REAL_FORMAT
+		};
+		
+		Code code;
+		///precision of a real number, `-1` if not given
+		short precision;
+		///the first entry in the choices table
+		std::uint32_t firstChoice;
+		///the number of entries in the choices table
+		std::uint32_t choicesCount;
+		///the variable slot
+		std::uint32_t slot;
+		///the literal text for `EMIT_LITERAL`, otherwise the variable name
+		std::string_view text;
+		///the case for `CASE_SELECT`
+		std::string_view argument;
+		///the number format for `INT_FORMAT` and `REAL_FORMAT`
+		const locale::NumberFormat *format;
+		///the index of the `argument` in the locale's cases for `CASE_SELECT`, `NO_INDEX` if there is no such case
+		std::uint32_t caseIndex = NO_INDEX;
+	};
+	
+	///An output text together with the plural form, gender or case selecting it
+	struct Choice {
+		std::string_view key;
+		std::string_view text;
+	};
+	
+	/**
+	 * @brief Template string parsed and bound to a locale
+	 * 
+	 * It is never changed after construction, so one object can be shared between many `Template`s 
+	 * and rendered by many threads at once.
+	 */
+	class CompiledTemplate {
 		public:
-			virtual std::string produceString(std::map<std::string_view, variableValue> &variables) = 0;
-	};//!class TemplateFunction
+			///no copy ctor
+			CompiledTemplate(const CompiledTemplate& other) = delete;
+			///parses the template string
+			CompiledTemplate(std::string_view templateString, locale::Locale& locale);
+			///uses a parsed template, like `mls::literal<"...">`, whose texts must live longer than this object
+			CompiledTemplate(const preparse::TemplateSyntax& syntax, locale::Locale& locale);
+			/**
+			 * @brief Uses an already compiled program, like one read from a template catalog
+			 * 
+			 * Nothing is checked but the indices of the gender and cases, which are found again. 
+			 * All texts must live longer than this object.
+			 */
+			CompiledTemplate(
+				locale::Locale& locale, 
+				std::string_view gender, 
+				std::vector<Instruction> compiledProgram, 
+				std::vector<Choice> compiledChoices, 
+				std::vector<std::string_view> names
+			);
+			~CompiledTemplate();
+			
+			locale::Locale& getLocale() const;
+			std::string_view getGender() const;
+			///the index of the gender in the locale's genders, `Instruction::NO_INDEX` if it isn't there
+			std::uint32_t getGenderIndex() const;
+			///why the template couldn't be compiled, empty if it could; an invalid template has no program
+			std::string_view getError() const;
+			
+			///the instructions run by `render(...)`
+			std::span<const Instruction> getProgram() const;
+			///the choices of all instructions
+			std::span<const Choice> getChoices() const;
+			///names of the variables, indexed by slots
+			std::span<const std::string_view> getVariableNames() const;
+			
+			///the slot of a variable, `VariableSlot::NONE` if the template doesn't use it
+			VariableSlot slot(std::string_view varName) const;
+			///number of variables used by the template
+			std::size_t slotsCount() const;
+			
+			friend std::size_t estimateSize(const CompiledTemplate& compiled, const TemplateArgs& args);
+		private:
+			locale::Locale *myLocale;
+			///copy of the template string which owns all texts of the template
+			std::unique_ptr<char[]> source;
+			std::string_view genderID;
+			std::uint32_t genderIndex = Instruction::NO_INDEX;
+			std::vector<Instruction> program;
+			std::vector<Choice> choices;
+			///names of the variables, indexed by slots
+			std::vector<std::string_view> variableNames;
+			///the error of `compile(...)`, kept when it doesn't throw
+			std::string compileError;
+			
+			std::uint32_t addVariable(std::string_view varName);
+			void compile(const preparse::TemplateSyntax& syntax);
+			///finds the indices of the gender and the cases of `CASE_SELECT` in the locale
+			void resolveIndices();
+	};//!class CompiledTemplate
+	
+	/**
+	 * @brief A template string literal checked and parsed while compiling
+	 * 
+	 * `mls::Template{mls::literal<"%{n!I=grouped}% files">, locale}` needs no parsing at run time, 
+	 * and a malformed tag in the literal is a compile error.
+	 */
+	template<preparse::FixedString templateString>
+	inline constexpr preparse::TemplateSyntax literal = preparse::literal_syntax<templateString>.view();
+	
+	///runs the compiled template with the given variables and produces a result string
+	std::string render(const CompiledTemplate& compiled, const TemplateArgs& args);
+	///runs the compiled template with the given variables and appends the result to `output`
+	void render(const CompiledTemplate& compiled, const TemplateArgs& args, std::string& output);
+	/**
+	 * @brief Receives the output of a template piece by piece, as it is produced
+	 * 
+	 * Literals are texts of the compiled template, which live as long as it does. 
+	 * Other pieces, like variables and formatted numbers, may be gone after the call.
+	 */
+	class RenderSink {
+		public:
+			virtual ~RenderSink() = default;
+			///a piece of output valid only during the call
+			virtual void put(std::string_view text) = 0;
+			///a text of the compiled template, which lives as long as the template
+			virtual void putLiteral(std::string_view text);
+	};
+	
+	///Writes the output to a stream, errors are left in the stream's state
+	class OstreamSink : public RenderSink {
+		public:
+			explicit OstreamSink(std::ostream& stream);
+			void put(std::string_view text) override;
+		private:
+			std::ostream& stream;
+	};
+	
+	///Writes the output to a C file, errors are left for `std::ferror(...)`
+	class FileSink : public RenderSink {
+		public:
+			explicit FileSink(std::FILE* file);
+			void put(std::string_view text) override;
+		private:
+			std::FILE* file;
+	};
+	
+	#if defined(_WIN32)
+	///A buffer of output, laid out like the POSIX `iovec`
+	struct IoSegment {
+		void* iov_base;
+		std::size_t iov_len;
+	};
+	#else
+	///A buffer of output for `writev(...)`
+	using IoSegment = ::iovec;
+	#endif
+	
+	/**
+	 * @brief Collects the output as a list of buffers, which can be written with one `writev(...)` call
+	 * 
+	 * Literals are referenced in place and only the other pieces are copied, 
+	 * so the compiled templates must outlive the segments.
+	 */
+	class IovecSink : public RenderSink {
+		public:
+			void put(std::string_view text) override;
+			void putLiteral(std::string_view text) override;
+			
+			///the output, valid until the sink is changed; `writev(...)` takes at most `IOV_MAX` segments at once
+			std::span<const IoSegment> segments();
+			///length of the whole output
+			std::size_t size() const;
+			///forgets the output, but keeps the memory for the next one
+			void clear();
+		private:
+			///a literal has its `data`, a copied piece starts at `offset` of `copies`
+			struct Piece {
+				const char* data;
+				std::size_t offset;
+				std::size_t size;
+			};
+			std::vector<Piece> pieces;
+			std::string copies;
+			std::vector<IoSegment> resolved;
+			std::size_t totalSize = 0u;
+	};
+	
+	///runs the compiled template with the given variables and passes the output to `sink`
+	void render(const CompiledTemplate& compiled, const TemplateArgs& args, RenderSink& sink);
+	/**
+	 * @brief Estimates the size of the template's output
+	 * 
+	 * The estimate is exact for texts and integers. For real numbers it is a guess that fits common values.
+	 */
+	std::size_t estimateSize(const CompiledTemplate& compiled, const TemplateArgs& args);
+	
+	///Values of one variable for every row of a batch, see `renderBatch(...)`
+	struct BatchColumn {
+		std::string_view name;
+		std::variant<std::span<const std::string_view>, std::span<const long>, std::span<const double>> values;
+	};
+	
+	///Rows rendered by `renderBatch(...)`, all in one buffer
+	struct BatchOutput {
+		std::string text;
+		///row `i` is the part of `text` between `offsets[i]` and `offsets[i + 1]`
+		std::vector<std::size_t> offsets;
+		
+		std::size_t size() const;
+		std::string_view row(std::size_t index) const;
+	};
+	
+	///How `renderBatch(...)` runs
+	enum class BatchPolicy {
+		SEQUENTIAL,
+		///splits the rows between threads, when there are enough of them
+		PARALLEL
+	};
+	
+	/**
+	 * @brief Renders the compiled template once for every row of the columns
+	 * 
+	 * All columns must have the same number of rows, columns of variables the template doesn't use are ignored. 
+	 * The rows replace the contents of `output`, whose memory is reused. `maxThreads` limits the threads 
+	 * of `BatchPolicy::PARALLEL`, `0` allows one for each hardware thread.
+	 */
+	void renderBatch(
+		const CompiledTemplate& compiled, 
+		std::span<const BatchColumn> columns, 
+		BatchOutput& output, 
+		BatchPolicy policy = BatchPolicy::SEQUENTIAL, 
+		unsigned maxThreads = 0u
+	);
 	
 	///Template class used to make string out of a template string and a locale
 	class Template {
@@ -35,7 +362,11 @@ namespace mls {
 			///move ctor
 			Template(Template&& other);
 			///standard ctor
-			Template(const std::string templateString, locale::Locale& locale);
+			Template(std::string_view templateString, locale::Locale& locale);
+			///ctor using a parsed template, like `mls::literal<"...">`
+			Template(const preparse::TemplateSyntax& syntax, locale::Locale& locale);
+			///ctor using an already compiled template
+			Template(std::shared_ptr<const CompiledTemplate> compiledTemplate);
 			~Template();
 			
 			//apply function group
@@ -49,21 +380,39 @@ namespace mls {
 			///set another template for a variable
 			Template& apply(std::string_view varName, Template& t);
 			
+			///set a raw string for a variable slot
+			Template& apply(VariableSlot slot, std::string_view rawString);
+			///set an integer number for a variable slot
+			Template& apply(VariableSlot slot, long number);
+			///set a real number for a variable slot
+			Template& applyReal(VariableSlot slot, double number);
+			///set another template for a variable slot
+			Template& apply(VariableSlot slot, Template& t);
+			
 			//end apply
 			
+			///the slot of a variable, which sets it faster than its name
+			VariableSlot slot(std::string_view varName) const;
+			
 			///runs the template and produces a result string
 			std::string get();
+			///runs the template and appends the result to `output`, so one buffer can be reused for many runs
+			void get(std::string& output);
+			///runs the template and passes the result to `sink` piece by piece
+			void get(RenderSink& sink);
 			
 			std::string getGender();
-		private:
-			locale::Locale *myLocale;
-			std::string genderID;
-			std::vector<char*> stringsList;
-			std::map<std::string_view, variableValue> variables;
-			std::vector<TemplateFunction*> functionsList;
 			
-	};//!class Template
+			///the compiled template which may be shared with other `Template` objects
+			const std::shared_ptr<const CompiledTemplate>& getCompiled() const;
+			///variables applied so far
+			const TemplateArgs& getArgs() const;
+		private:
+			std::shared_ptr<const CompiledTemplate> compiled;
+			TemplateArgs args;
 	
+	};//!class Template
+
 };
 
 //CUT-END
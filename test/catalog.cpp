@@ -0,0 +1,343 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE catalog_module
+#include <boost/test/unit_test.hpp>
+
+#include <catalog.h>
+#include <errors.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+// cSpell:disable
+
+namespace {
+	
+	std::filesystem::path testFolder() {
+		return std::filesystem::temp_directory_path() / "mls_test_catalogs";
+	}
+	
+	void putWord(std::string& out, std::uint32_t value, bool bigEndian) {
+		for(int i=0; i<4; ++i) {
+			int shift = bigEndian ? 24 - 8 * i : 8 * i;
+			out += static_cast<char>((value >> shift) & 0xffu);
+		}
+	}
+	
+	std::uint32_t hashpjw(const std::string& key) {
+		std::uint32_t hash = 0u;
+		for(unsigned char c : key) {
+			hash = (hash << 4) + c;
+			std::uint32_t high = hash & 0xf0000000u;
+			if( high != 0u ) {
+				hash ^= high >> 24;
+				hash ^= high;
+			}
+		}
+		return hash;
+	}
+	
+	///the .mo layout written by `msgfmt`, keys with NULs are plural messages
+	std::string moFile(const std::map<std::string, std::string>& messages, std::uint32_t hashSize, bool bigEndian = false) {
+		const std::uint32_t count = static_cast<std::uint32_t>(messages.size());
+		const std::uint32_t originals = 28u;
+		const std::uint32_t translations = originals + count * 8u;
+		const std::uint32_t hashOffset = translations + count * 8u;
+		std::uint32_t stringsOffset = hashOffset + hashSize * 4u;
+		
+		std::vector<std::uint32_t> hashTable(hashSize, 0u);
+		std::string tables, strings;
+		std::string translated;
+		std::uint32_t index = 0u;
+		for(auto& [key, translation] : messages) {
+			putWord(tables, static_cast<std::uint32_t>(key.size()), bigEndian);
+			putWord(tables, stringsOffset + static_cast<std::uint32_t>(strings.size()), bigEndian);
+			strings += key;
+			strings += '\0';
+			
+			if( hashSize != 0u ) {
+				std::uint32_t hash = hashpjw(key.substr(0u, key.find('\0')));
+				std::uint32_t slot = hash % hashSize;
+				std::uint32_t step = 1u + hash % (hashSize - 2u);
+				while( hashTable[slot] != 0u ) {
+					slot = slot >= hashSize - step ? slot - (hashSize - step) : slot + step;
+				}
+				hashTable[slot] = ++index;
+			}
+		}
+		for(auto& [key, translation] : messages) {
+			putWord(translated, static_cast<std::uint32_t>(translation.size()), bigEndian);
+			putWord(translated, stringsOffset + static_cast<std::uint32_t>(strings.size()), bigEndian);
+			strings += translation;
+			strings += '\0';
+		}
+		
+		std::string result;
+		putWord(result, 0x950412deu, bigEndian);
+		putWord(result, 0u, bigEndian);
+		putWord(result, count, bigEndian);
+		putWord(result, originals, bigEndian);
+		putWord(result, translations, bigEndian);
+		putWord(result, hashSize, bigEndian);
+		putWord(result, hashOffset, bigEndian);
+		result += tables + translated;
+		for(auto entry : hashTable) {
+			putWord(result, entry, bigEndian);
+		}
+		return result + strings;
+	}
+	
+	const std::map<std::string, std::string> POLISH{
+		{"", "Content-Type: text/plain; charset=UTF-8\n"},
+		{"To translate", "Do przetłumaczenia"},
+		{"%{num}% file%{num!P:,s}%", "%{num}% plik%{num!P:,i,ów}%"},
+		{std::string{"menu\x04Open"}, "Otwórz"},
+		{std::string{"One file\0%{n}% files", 21}, std::string{"Jeden plik\0%{n}% pliki", 22}}
+	};
+	
+	std::string writeCatalog(const std::string& name, const std::string& contents) {
+		std::filesystem::create_directories(testFolder());
+		auto path = (testFolder() / name).string();
+		std::ofstream file{path, std::ios::binary};
+		file << contents;
+		return path;
+	}
+
+};
+
+BOOST_AUTO_TEST_CASE( testHashedLookup ) {
+	auto& polish = mls::locale::getLocale("pl_PL");
+	mls::backend::Catalog catalog{writeCatalog("hashed.mo", moFile(POLISH, 7u)), polish};
+	
+	BOOST_TEST_REQUIRE( catalog.size() == POLISH.size() );
+	BOOST_TEST_REQUIRE( catalog.find("To translate").value() == "Do przetłumaczenia" );
+	BOOST_TEST_REQUIRE( !catalog.find("Not translated").has_value() );
+	BOOST_TEST_REQUIRE( catalog.find("menu", "Open").value() == "Otwórz" );
+	BOOST_TEST_REQUIRE( !catalog.find("Open").has_value() );
+	//the first form of a plural message
+	BOOST_TEST_REQUIRE( catalog.find("One file").value() == "Jeden plik" );
+	
+	BOOST_TEST_REQUIRE( catalog.translate("%{num}% file%{num!P:,s}%").apply("num", 5).get() == "5 plików" );
+	BOOST_TEST_REQUIRE( catalog.translate("Not %{x}%").apply("x", "here").get() == "Not here" );
+	BOOST_TEST_REQUIRE( catalog.translate("Not here", mls::literal<"Not here">).get() == "Not here" );
+}
+
+BOOST_AUTO_TEST_CASE( testSortedLookupAndByteOrder ) {
+	auto& polish = mls::locale::getLocale("pl_PL");
+	for(bool bigEndian : {false, true}) {
+		mls::backend::Catalog catalog{writeCatalog("sorted.mo", moFile(POLISH, 0u, bigEndian)), polish};
+		for(auto& [key, translation] : POLISH) {
+			auto msgid = key.substr(0u, key.find('\0'));
+			BOOST_TEST_REQUIRE( catalog.find(msgid).value() == translation.substr(0u, translation.find('\0')) );
+		}
+		BOOST_TEST_REQUIRE( !catalog.find("Zzz").has_value() );
+		BOOST_TEST_REQUIRE( !catalog.find("A").has_value() );
+	}
+}
+
+BOOST_AUTO_TEST_CASE( testInvalidCatalogs ) {
+	auto& polish = mls::locale::getLocale("pl_PL");
+	BOOST_CHECK_THROW( (mls::backend::Catalog{(testFolder() / "missing.mo").string(), polish}), mls::InvalidCatalog );
+	
+	const std::string good = moFile(POLISH, 7u);
+	std::string broken = good;
+	broken[0] = 'X';
+	BOOST_CHECK_THROW( (mls::backend::Catalog{writeCatalog("broken.mo", broken), polish}), mls::InvalidCatalog );
+	
+	//the last string loses its NUL
+	BOOST_CHECK_THROW( (mls::backend::Catalog{writeCatalog("broken.mo", good.substr(0u, good.size() - 1u)), polish}), mls::InvalidCatalog );
+	
+	//a hash table entry past the messages
+	broken = good;
+	broken[28u + 2u * 8u * POLISH.size()] = 100;
+	BOOST_CHECK_THROW( (mls::backend::Catalog{writeCatalog("broken.mo", broken), polish}), mls::InvalidCatalog );
+}
+
+BOOST_AUTO_TEST_CASE( testCatalogSet ) {
+	auto& polish = mls::locale::getLocale("pl_PL");
+	auto& english = mls::locale::getLocale("en_US");
+	std::filesystem::create_directories(testFolder() / "pl" / "LC_MESSAGES");
+	std::filesystem::create_directories(testFolder() / "en_US" / "LC_MESSAGES");
+	writeCatalog("pl/LC_MESSAGES/app.mo", moFile(POLISH, 7u));
+	writeCatalog("en_US/LC_MESSAGES/app.mo", moFile({{"To translate", "Translated"}}, 3u));
+	
+	mls::backend::CatalogSet catalogs{testFolder().string()};
+	//`pl_PL` falls back to `pl`
+	catalogs.add("app", polish);
+	catalogs.add("app", english);
+	BOOST_CHECK_THROW( catalogs.add("other", polish), mls::InvalidCatalog );
+	BOOST_TEST_REQUIRE( catalogs.find("other", polish) == nullptr );
+	
+	//threads translate into different locales at once
+	std::string results[2];
+	std::thread threads[2] = {
+		std::thread{[&]() {
+			for(int i=0; i<1000; ++i) {
+				results[0] = catalogs.translate("app", polish, "To translate").get();
+			}
+		}},
+		std::thread{[&]() {
+			for(int i=0; i<1000; ++i) {
+				results[1] = catalogs.translate("app", english, "To translate").get();
+			}
+		}}
+	};
+	for(auto& thread : threads) {
+		thread.join();
+	}
+	BOOST_TEST_REQUIRE( results[0] == "Do przetłumaczenia" );
+	BOOST_TEST_REQUIRE( results[1] == "Translated" );
+	BOOST_TEST_REQUIRE( catalogs.translate("other", english, "To translate").get() == "To translate" );
+}
+
+BOOST_AUTO_TEST_CASE( testTemplateCatalog ) {
+	auto& polish = mls::locale::getLocale("pl_PL");
+	const std::vector<std::pair<std::string, std::string>> messages{
+		{"To translate", "Do przetłumaczenia"},
+		{"%{num}% file%{num!P:,s}%", "%{num}% plik%{num!P:,i,ów}%"},
+		{"%{num}% files", "%{num!I=grouped}% plik%{num!P one={} few={i} other={ów}}%"},
+		{"%{x}%", "%{x!R:grouped,2}%"},
+		{"wife", "%{+SG=f}%żona"},
+		{"good %{person}%", "dobr%{person!G:y,a,e}% %{person}%"},
+		{"home", "dom%{+C:,u,owi,,em,u,ie}%"},
+		{"Enter the %{obj}%", "Wejście do %{obj!C=gen}%"},
+		{std::string{"menu\x04Open"}, "Otwórz"},
+		{"To translate", "Repeated"}
+	};
+	std::filesystem::create_directories(testFolder());
+	auto path = (testFolder() / "templates.mlsc").string();
+	mls::backend::writeTemplateCatalog(path, polish, messages);
+	
+	mls::backend::TemplateCatalog catalog{path};
+	BOOST_TEST_REQUIRE( catalog.size() == messages.size() - 1u );
+	BOOST_TEST_REQUIRE( &catalog.getLocale() == &polish );
+	BOOST_TEST_REQUIRE( catalog.find("Not translated") == nullptr );
+	BOOST_TEST_REQUIRE( catalog.find("Open") == nullptr );
+	BOOST_TEST_REQUIRE( catalog.find("menu", "Open") != nullptr );
+	//the template is made once
+	BOOST_TEST_REQUIRE( catalog.find("home").get() == catalog.find("home").get() );
+	BOOST_TEST_REQUIRE( catalog.translate("Not translated").getCompiled() == catalog.translate("Not translated").getCompiled() );
+	
+	BOOST_TEST_REQUIRE( catalog.translate("To translate").get() == "Do przetłumaczenia" );
+	BOOST_TEST_REQUIRE( catalog.translate("%{num}% file%{num!P:,s}%").apply("num", 5).get() == "5 plików" );
+	BOOST_TEST_REQUIRE( catalog.translate("%{num}% files").apply("num", 12345).get() == "12 345 plików" );
+	BOOST_TEST_REQUIRE( catalog.translate("%{num}% files").apply("num", 3).get() == "3 pliki" );
+	//the same output as the template parsed at run time
+	mls::Template parsed{"%{x!R:grouped,2}%", polish};
+	BOOST_TEST_REQUIRE( catalog.translate("%{x}%").applyReal("x", 1234.567).get() == parsed.applyReal("x", 1234.567).get() );
+	
+	auto wife = catalog.translate("wife");
+	BOOST_TEST_REQUIRE( wife.getGender() == "f" );
+	BOOST_TEST_REQUIRE( catalog.translate("good %{person}%").apply("person", wife).get() == "dobra żona" );
+	auto home = catalog.translate("home");
+	BOOST_TEST_REQUIRE( catalog.translate("Enter the %{obj}%").apply("obj", home).get() == "Wejście do domu" );
+	BOOST_TEST_REQUIRE( catalog.translate(std::string_view{"Not here"}, mls::literal<"Not here">).get() == "Not here" );
+	
+	//the catalog's state outlives it in its templates
+	std::shared_ptr<const mls::CompiledTemplate> kept;
+	{
+		mls::backend::TemplateCatalog another{path};
+		kept = another.find("To translate");
+	}
+	BOOST_TEST_REQUIRE( mls::Template{kept}.get() == "Do przetłumaczenia" );
+}
+
+BOOST_AUTO_TEST_CASE( testInvalidTemplateCatalogs ) {
+	auto& polish = mls::locale::getLocale("pl_PL");
+	auto path = (testFolder() / "templates.mlsc").string();
+	mls::backend::writeTemplateCatalog(path, polish, {{"%{n}% files", "%{n!I=grouped}% plików"}});
+	std::string good;
+	{
+		std::ifstream file{path, std::ios::binary};
+		good.assign(std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{});
+	}
+	
+	std::string broken = good;
+	broken[0] = 'X';
+	BOOST_CHECK_THROW( mls::backend::TemplateCatalog{writeCatalog("broken.mlsc", broken)}, mls::InvalidCatalog );
+	BOOST_CHECK_THROW( mls::backend::TemplateCatalog{writeCatalog("broken.mlsc", good.substr(0u, good.size() - 1u))}, mls::InvalidCatalog );
+	//a number format the locale doesn't have
+	auto format = good.rfind("grouped");
+	broken = good;
+	broken[format] = 'X';
+	BOOST_CHECK_THROW( mls::backend::TemplateCatalog{writeCatalog("broken.mlsc", broken)}, mls::InvalidCatalog );
+	//other plural forms
+	broken = good;
+	broken[12] = 7;
+	BOOST_CHECK_THROW( mls::backend::TemplateCatalog{writeCatalog("broken.mlsc", broken)}, mls::InvalidCatalog );
+	
+	//invalid translations are never written, the error names the message id
+	auto invalidPath = (testFolder() / "invalid.mlsc").string();
+	BOOST_CHECK_THROW( mls::backend::writeTemplateCatalog(invalidPath, polish, {{"%{n}% files", "%{n!X=a}% plików"}}), mls::InvalidCatalog );
+	BOOST_CHECK_THROW( mls::backend::writeTemplateCatalog(invalidPath, polish, {{"%{n}% files", "%{n!P=}% plików"}}), mls::InvalidCatalog );
+	BOOST_CHECK_THROW( mls::backend::writeTemplateCatalog(invalidPath, polish, {{"%{n}% files", "%{n plików"}}), mls::InvalidCatalog );
+	try {
+		mls::backend::writeTemplateCatalog(invalidPath, polish, {{"%{n}% files", "%{n!G mascline={y}}%"}});
+		BOOST_ERROR( "An invalid translation was written" );
+	} catch(const mls::InvalidCatalog& error) {
+		BOOST_TEST_REQUIRE( std::string_view{error.what()}.find("%{n}% files") != std::string_view::npos );
+	}
+}
+
+BOOST_AUTO_TEST_CASE( testCatalogSetPrefersTemplates ) {
+	auto& polish = mls::locale::getLocale("pl_PL");
+	std::filesystem::create_directories(testFolder() / "pl" / "LC_MESSAGES");
+	writeCatalog("pl/LC_MESSAGES/compiled.mo", moFile(POLISH, 7u));
+	mls::backend::writeTemplateCatalog((testFolder() / "pl" / "LC_MESSAGES" / "compiled.mlsc").string(), polish, {{"To translate", "Skompilowane"}});
+	
+	mls::backend::CatalogSet catalogs{testFolder().string()};
+	catalogs.add("compiled", polish);
+	BOOST_TEST_REQUIRE( catalogs.find("compiled", polish) == nullptr );
+	BOOST_TEST_REQUIRE( catalogs.findCompiled("compiled", polish) != nullptr );
+	BOOST_TEST_REQUIRE( catalogs.translate("compiled", polish, "To translate").get() == "Skompilowane" );
+}
+
+BOOST_AUTO_TEST_CASE( testTranslationContext ) {
+	auto& polish = mls::locale::getLocale("pl_PL");
+	auto& english = mls::locale::getLocale("en_US");
+	std::filesystem::create_directories(testFolder() / "pl" / "LC_MESSAGES");
+	std::filesystem::create_directories(testFolder() / "en_US" / "LC_MESSAGES");
+	writeCatalog("pl/LC_MESSAGES/app.mo", moFile(POLISH, 7u));
+	writeCatalog("en_US/LC_MESSAGES/app.mo", moFile({{"To translate", "Translated"}}, 3u));
+	mls::backend::CatalogSet catalogs{testFolder().string()};
+	catalogs.add("app", polish);
+	catalogs.add("app", english);
+	
+	const mls::TranslationContext polishContext{polish, catalogs, "app"};
+	const mls::TranslationContext englishContext{english, catalogs, "app"};
+	BOOST_TEST_REQUIRE( mls::translate(polishContext, "To translate").get() == "Do przetłumaczenia" );
+	BOOST_TEST_REQUIRE( mls::translate(englishContext, "app", "To translate").get() == "Translated" );
+	BOOST_TEST_REQUIRE( mls::translate<"%{num}% file%{num!P:,s}%">(polishContext).apply("num", 2).get() == "2 pliki" );
+	BOOST_TEST_REQUIRE( mls::translate<"Not translated">(englishContext).get() == "Not translated" );
+	//a translation is parsed once, later calls share its template
+	BOOST_TEST_REQUIRE( mls::translate(polishContext, "To translate").getCompiled() == mls::translate(polishContext, "To translate").getCompiled() );
+	//so is a message id without a translation or without a catalog
+	BOOST_TEST_REQUIRE( mls::translate(polishContext, "Not translated").getCompiled() == mls::translate(polishContext, "Not translated").getCompiled() );
+	BOOST_TEST_REQUIRE( mls::translate(polishContext, "other", "No catalog").getCompiled() == mls::translate(polishContext, "other", "No catalog").getCompiled() );
+	BOOST_TEST_REQUIRE( mls::translate(polishContext, "other", "No catalog").getCompiled() != mls::translate(englishContext, "other", "No catalog").getCompiled() );
+	
+	BOOST_TEST_REQUIRE( mls::currentTranslationContext() == nullptr );
+	{
+		mls::TranslationContextGuard outer{polishContext};
+		BOOST_TEST_REQUIRE( mls::currentTranslationContext() == &polishContext );
+		{
+			mls::TranslationContextGuard inner{englishContext};
+			BOOST_TEST_REQUIRE( mls::currentTranslationContext() == &englishContext );
+		}
+		BOOST_TEST_REQUIRE( mls::currentTranslationContext() == &polishContext );
+		
+		//other threads have their own contexts
+		const mls::TranslationContext* seen = &polishContext;
+		std::thread{[&seen]() {
+			seen = mls::currentTranslationContext();
+		}}.join();
+		BOOST_TEST_REQUIRE( seen == nullptr );
+	}
+	BOOST_TEST_REQUIRE( mls::currentTranslationContext() == nullptr );
+}
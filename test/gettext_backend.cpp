@@ -4,6 +4,8 @@
 
 #include <gettext_backend.h>
 #include <template.h>
+
+#include <filesystem>
 // cSpell:disable
 
 BOOST_AUTO_TEST_CASE( testTranslation ) {
@@ -14,3 +16,51 @@ BOOST_AUTO_TEST_CASE( testTranslation ) {
 	
 	BOOST_TEST_REQUIRE( translated == "Do przetłumaczenia" );
 }
+
+BOOST_AUTO_TEST_CASE( testTranslationCache ) {
+	mls::backend::init("gettext_test", "pl_PL.UTF-8", LOCALES_DIR); 
+	
+	auto first = _("To translate").get();
+	auto second = _("To translate").get();
+	auto stats = mls::backend::getCacheStats();
+	
+	BOOST_TEST_REQUIRE( first == "Do przetłumaczenia" );
+	BOOST_TEST_REQUIRE( second == "Do przetłumaczenia" );
+	BOOST_TEST_REQUIRE( stats.misses == 1u );
+	BOOST_TEST_REQUIRE( stats.hits == 1u );
+	BOOST_TEST_REQUIRE( stats.size == 1u );
+	
+	mls::backend::setCacheCapacity(0u);
+	stats = mls::backend::getCacheStats();
+	BOOST_TEST_REQUIRE( stats.size == 0u );
+	BOOST_TEST_REQUIRE( stats.evictions == 1u );
+	
+	mls::backend::setCacheCapacity(512u);
+}
+
+BOOST_AUTO_TEST_CASE( testInstalledContext ) {
+	auto folder = std::filesystem::temp_directory_path() / "mls_test_context";
+	std::filesystem::create_directories(folder / "en_GB" / "LC_MESSAGES");
+	auto& british = mls::locale::getLocale("en_GB");
+	mls::backend::writeTemplateCatalog( (folder / "en_GB" / "LC_MESSAGES" / "gettext_test.mlsc").string(), british, {{"To translate", "Translated"}} );
+	mls::backend::CatalogSet catalogs{folder.string()};
+	catalogs.add("gettext_test", british);
+	mls::TranslationContext context{british, catalogs, "gettext_test"};
+	
+	{
+		mls::TranslationContextGuard guard{context};
+		BOOST_TEST_REQUIRE( _("To translate").get() == "Translated" );
+		BOOST_TEST_REQUIRE( _c("gettext_test", "To translate").get() == "Translated" );
+		BOOST_TEST_REQUIRE( &_("Not translated").getCompiled()->getLocale() == &british );
+	}
+	BOOST_TEST_REQUIRE( mls::currentTranslationContext() == nullptr );
+}
+
+BOOST_AUTO_TEST_CASE( testNullCatalog ) {
+	mls::backend::init("gettext_test", "pl_PL.UTF-8", LOCALES_DIR); 
+	
+	//a null catalog means the current text domain, like in `dgettext(...)`
+	auto translated = mls::translate(static_cast<const char*>(nullptr), "To translate").get();
+	
+	BOOST_TEST_REQUIRE( translated == "Do przetłumaczenia" );
+}
@@ -0,0 +1,131 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE locale_data_module
+#include <boost/test/unit_test.hpp>
+
+#include <locale_data.h>
+#include <errors.h>
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+namespace {
+	
+	std::string dataPath(const char* name) {
+		return (std::filesystem::temp_directory_path() / name).string();
+	}
+	
+	std::string readFile(const std::string& path) {
+		std::ifstream file{path, std::ios::binary};
+		return std::string{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+	}
+	
+	void writeFile(const std::string& path, const std::string& contents) {
+		std::ofstream file{path, std::ios::binary};
+		file << contents;
+	}
+	
+	///a locale unknown to the library
+	// cSpell: disable
+	mls::locale::Locale czech{
+		"cs_CZ", mls::locale::cldrPluralRules("cs"), {"nom","gen","dat","acc","voc","loc","ins"}, {"m","f","n"}, {
+			{"general", {" ", ",", {}}},
+			{"grouped", {" ", ",", {3}}}
+		}
+	};
+	// cSpell: enable
+	
+	///writes `czech` with its alias once
+	const std::string& czechData() {
+		static const std::string path = [](){
+			std::string result = dataPath("mls_test_cs.mlsl");
+			mls::locale::writeLocaleData(result, {&czech}, {{"cs-CZ", "cs_CZ"}});
+			return result;
+		}();
+		return path;
+	}
+
+};
+
+BOOST_AUTO_TEST_CASE( testWriteAndLoad ) {
+	BOOST_TEST_REQUIRE( mls::locale::findLocale("cs_CZ") == nullptr );
+	BOOST_TEST_REQUIRE( mls::locale::loadLocaleData(czechData()) == 1u );
+	
+	auto* loaded = mls::locale::findLocale("cs-CZ");
+	BOOST_TEST_REQUIRE( loaded != nullptr );
+	BOOST_TEST_REQUIRE( loaded->getName() == "cs_CZ" );
+	BOOST_TEST_REQUIRE( loaded->getCasesList().size() == 7u );
+	BOOST_TEST_REQUIRE( std::string{loaded->getCasesList()[6]} == "ins" );
+	BOOST_TEST_REQUIRE( std::string{loaded->getGendersList()[1]} == "f" );
+	
+	BOOST_TEST_REQUIRE( loaded->getPluralsList().size() == 4u );
+	BOOST_TEST_REQUIRE( loaded->getPluralID(3) == "few" );
+	BOOST_TEST_REQUIRE( loaded->getPluralIndex(mls::locale::pluralOperands(0.5)) == 2u );
+	
+	auto* grouped = loaded->getNumberFormat("grouped");
+	BOOST_TEST_REQUIRE( grouped != nullptr );
+	BOOST_TEST_REQUIRE( grouped->formatReal(1234.5) == "1 234,5" );
+	
+	//the built-in locales are still there
+	BOOST_TEST_REQUIRE( mls::locale::getLocale("pl-PL").getName() == "pl_PL" );
+}
+
+BOOST_AUTO_TEST_CASE( testLoadedLocalesHideBuiltIn ) {
+	std::string path = dataPath("mls_test_en.mlsl");
+	mls::locale::Locale british{
+		"en_GB", mls::locale::cldrPluralRules("en"), {}, {}, {
+			{"general", {" ", ".", {}}}
+		}
+	};
+	mls::locale::writeLocaleData(path, {&british}, {});
+	BOOST_TEST_REQUIRE( mls::locale::loadLocaleData(path) == 1u );
+	
+	auto& loaded = mls::locale::getLocale("en_GB");
+	BOOST_TEST_REQUIRE( loaded.getNumberFormat("general")->formatInteger(1000) == "1000" );
+	BOOST_TEST_REQUIRE( loaded.getNumberFormat("grouped") == nullptr );
+	//aliases of the built-in locale name the loaded one
+	BOOST_TEST_REQUIRE( &mls::locale::getLocale("en-GB") == &loaded );
+}
+
+BOOST_AUTO_TEST_CASE( testInvalidFiles ) {
+	BOOST_CHECK_THROW( mls::locale::loadLocaleData(dataPath("mls_test_missing.mlsl")), mls::InvalidLocaleData );
+	
+	const std::string good = readFile(czechData());
+	std::string path = dataPath("mls_test_broken.mlsl");
+	
+	writeFile(path, good.substr(0, good.size() - 1u));
+	BOOST_CHECK_THROW( mls::locale::loadLocaleData(path), mls::InvalidLocaleData );
+	
+	std::string broken = good;
+	broken[0] = 'X';
+	writeFile(path, broken);
+	BOOST_CHECK_THROW( mls::locale::loadLocaleData(path), mls::InvalidLocaleData );
+	
+	//the version
+	broken = good;
+	broken[4] = static_cast<char>(mls::locale::LOCALE_DATA_VERSION + 1u);
+	writeFile(path, broken);
+	BOOST_CHECK_THROW( mls::locale::loadLocaleData(path), mls::InvalidLocaleData );
+	
+	//the byte order mark
+	broken = good;
+	std::swap(broken[6], broken[7]);
+	writeFile(path, broken);
+	BOOST_CHECK_THROW( mls::locale::loadLocaleData(path), mls::InvalidLocaleData );
+	
+	//the strings pool
+	broken = good;
+	broken.back() = 'x';
+	writeFile(path, broken);
+	BOOST_CHECK_THROW( mls::locale::loadLocaleData(path), mls::InvalidLocaleData );
+	
+	//nothing was added
+	BOOST_TEST_REQUIRE( mls::locale::loadedLocales.size() == 2u );
+}
+
+BOOST_AUTO_TEST_CASE( testOnlyRulesAreWritten ) {
+	mls::locale::Locale legacy{"xx_XX", {"one", "other"}, mls::locale::PluralRule1, {}, {}, {}};
+	BOOST_CHECK_THROW( mls::locale::writeLocaleData(dataPath("mls_test_legacy.mlsl"), {&legacy}, {}), mls::InvalidLocaleData );
+	BOOST_CHECK_THROW( mls::locale::writeLocaleData(dataPath("mls_test_legacy.mlsl"), {&czech}, {{"xx", "xx_XX"}}), mls::InvalidLocaleData );
+}
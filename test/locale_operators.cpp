@@ -3,6 +3,7 @@
 #include <boost/test/unit_test.hpp>
 
 #include <mls_locale.h>
+#include <limits>
 
 BOOST_AUTO_TEST_CASE( testGeneralNumberFormatWithInteger ) {
 	auto& enLocale = mls::locale::getLocale("en_US");
@@ -101,3 +102,137 @@ BOOST_AUTO_TEST_CASE( testGroupedNumberFormatWithReal ) {
 	result = enLocale.getNumberFormat(nf_name)->formatReal(-100.2, 1);
 	BOOST_TEST_REQUIRE( result == "-100.2" );
 }
+
+BOOST_AUTO_TEST_CASE( testMultiGroupNumberFormat ) {
+	mls::locale::NumberFormat indian{",", ".", {3,2}};
+	
+	BOOST_TEST_REQUIRE( indian.formatInteger(1'234'567) == "12,34,567" );
+	BOOST_TEST_REQUIRE( indian.formatInteger(-123'456'789) == "-12,34,56,789" );
+	BOOST_TEST_REQUIRE( indian.formatInteger(12'345) == "12,345" );
+	BOOST_TEST_REQUIRE( indian.formatInteger(999) == "999" );
+	
+	//a group of 0 ends grouping
+	mls::locale::NumberFormat thousandsOnly{" ", ",", {3,0}};
+	BOOST_TEST_REQUIRE( thousandsOnly.formatInteger(1'234'567) == "1234 567" );
+}
+
+BOOST_AUTO_TEST_CASE( testIntegerFormatLimitsAndAppending ) {
+	auto& enLocale = mls::locale::getLocale("en_US");
+	auto* grouped = enLocale.getNumberFormat("grouped");
+	
+	BOOST_TEST_REQUIRE( grouped->formatInteger(0) == "0" );
+	//its magnitude doesn't fit in a `long`
+	auto* general = enLocale.getNumberFormat("general");
+	BOOST_TEST_REQUIRE( general->formatInteger(std::numeric_limits<long>::min()) == std::to_string(std::numeric_limits<long>::min()) );
+	
+	std::string output{"Total: "};
+	grouped->formatInteger(-1'234'567, output);
+	BOOST_TEST_REQUIRE( output == "Total: -1,234,567" );
+}
+
+BOOST_AUTO_TEST_CASE( testRealFormatOverFullRange ) {
+	auto& enLocale = mls::locale::getLocale("en_US");
+	auto* general = enLocale.getNumberFormat("general");
+	auto* grouped = enLocale.getNumberFormat("grouped");
+	
+	//shortest text which reads back the same
+	BOOST_TEST_REQUIRE( general->formatReal(100.2) == "100.2" );
+	BOOST_TEST_REQUIRE( general->formatReal(0.1 + 0.2) == "0.30000000000000004" );
+	BOOST_TEST_REQUIRE( general->formatReal(-0.5) == "-0.5" );
+	BOOST_TEST_REQUIRE( general->formatReal(-0.0) == "0" );
+	//above the range of `long`
+	BOOST_TEST_REQUIRE( grouped->formatReal(1e20) == "100,000,000,000,000,000,000" );
+	BOOST_TEST_REQUIRE( general->formatReal(-1.5e19) == "-15000000000000000000" );
+	
+	//fixed precision rounds and carries into the integer part
+	BOOST_TEST_REQUIRE( grouped->formatReal(999.996, 2) == "1,000" );
+	BOOST_TEST_REQUIRE( general->formatReal(2.75, 0) == "3" );
+	BOOST_TEST_REQUIRE( general->formatReal(-0.004, 2) == "0" );
+	BOOST_TEST_REQUIRE( general->formatReal(-0.25, 3) == "-0.25" );
+	
+	auto& plLocale = mls::locale::getLocale("pl_PL");
+	std::string output{"= "};
+	plLocale.getNumberFormat("grouped")->formatReal(-1234567.126, output, 2);
+	BOOST_TEST_REQUIRE( output == "= -1 234 567,13" );
+}
+
+BOOST_AUTO_TEST_CASE( testPluralIndexes ) {
+	auto& plLocale = mls::locale::getLocale("pl_PL");
+	auto forms = plLocale.getPluralsList();
+	
+	BOOST_TEST_REQUIRE( std::string{forms[plLocale.getPluralIndex(1)]} == "one" );
+	BOOST_TEST_REQUIRE( std::string{forms[plLocale.getPluralIndex(3)]} == "few" );
+	BOOST_TEST_REQUIRE( std::string{forms[plLocale.getPluralIndex(13)]} == "other" );
+	BOOST_TEST_REQUIRE( std::string{forms[plLocale.getPluralIndex(22)]} == "few" );
+	BOOST_TEST_REQUIRE( std::string{forms[plLocale.getPluralIndex(-1024)]} == "few" );
+	BOOST_TEST_REQUIRE( std::string{forms[plLocale.getPluralIndex(112)]} == "other" );
+	BOOST_TEST_REQUIRE( plLocale.getPluralID(std::numeric_limits<long>::min()) == "other" );
+	
+	//every rule gives an index of the locale's plural forms
+	for(auto& definition : mls::locale::builtInLocales()) {
+		auto& locale = mls::locale::getLocale(definition.name);
+		for(long n=0; n<2000; ++n) {
+			BOOST_TEST_REQUIRE( locale.getPluralIndex(n) < locale.getPluralsList().size() );
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE( testLocaleRegistry ) {
+	auto* polish = mls::locale::findLocale("pl_PL");
+	BOOST_TEST_REQUIRE( polish != nullptr );
+	BOOST_TEST_REQUIRE( polish->getName() == "pl_PL" );
+	BOOST_TEST_REQUIRE( mls::locale::findLocale("pl-PL") == polish );
+	BOOST_TEST_REQUIRE( mls::locale::findLocale("Polish_Poland") == polish );
+	BOOST_TEST_REQUIRE( mls::locale::findLocale("English_United Kingdom")->getName() == "en_GB" );
+	
+	BOOST_TEST_REQUIRE( mls::locale::findLocale("xx_XX") == nullptr );
+	BOOST_TEST_REQUIRE( mls::locale::findLocale("") == nullptr );
+	BOOST_TEST_REQUIRE( mls::locale::getLocale("xx_XX").getName() == "en_US" );
+	
+	//an alias added later is found too
+	mls::locale::localeAliases.push_back( {"polski", "pl_PL"} );
+	mls::locale::registerLocales();
+	BOOST_TEST_REQUIRE( mls::locale::findLocale("polski") == polish );
+	mls::locale::localeAliases.pop_back();
+	mls::locale::registerLocales();
+	BOOST_TEST_REQUIRE( mls::locale::findLocale("polski") == nullptr );
+}
+
+BOOST_AUTO_TEST_CASE( testNumberFormatIDs ) {
+	auto grouped = mls::locale::findNumberFormatID("grouped");
+	BOOST_TEST_REQUIRE( grouped != mls::locale::NO_NUMBER_FORMAT );
+	BOOST_TEST_REQUIRE( mls::locale::findNumberFormatID("unknown") == mls::locale::NO_NUMBER_FORMAT );
+	
+	auto& enLocale = mls::locale::getLocale("en_US");
+	BOOST_TEST_REQUIRE( enLocale.getNumberFormat(grouped) == enLocale.getNumberFormat("grouped") );
+	BOOST_TEST_REQUIRE( enLocale.getNumberFormat(grouped)->formatInteger(1000) == "1,000" );
+	BOOST_TEST_REQUIRE( enLocale.getNumberFormat(mls::locale::NO_NUMBER_FORMAT) == nullptr );
+	BOOST_TEST_REQUIRE( enLocale.getNumberFormat("unknown") == nullptr );
+	
+	//a format added by a locale gets the next ID, other locales don't have it
+	mls::locale::Locale custom{"xx_XX", "", {}, {}, {{"compact", {"", ".", {}}}}};
+	auto compact = mls::locale::findNumberFormatID("compact");
+	BOOST_TEST_REQUIRE( compact != mls::locale::NO_NUMBER_FORMAT );
+	BOOST_TEST_REQUIRE( mls::locale::numberFormatName(compact) == "compact" );
+	BOOST_TEST_REQUIRE( custom.getNumberFormat(compact) == custom.getNumberFormat("compact") );
+	BOOST_TEST_REQUIRE( custom.getNumberFormat(compact) != nullptr );
+	BOOST_TEST_REQUIRE( enLocale.getNumberFormat(compact) == nullptr );
+}
+
+BOOST_AUTO_TEST_CASE( testBuiltInLocales ) {
+	//formats can be made while compiling, a longer schema keeps its first sizes
+	constexpr mls::locale::NumberFormat indian{",", ".", {3, 2}};
+	BOOST_TEST_REQUIRE( indian.formatInteger(12'345'678) == "1,23,45,678" );
+	constexpr mls::locale::NumberFormat longSchema{",", ".", {1, 1, 1, 1, 1, 1, 1, 1, 1, 1}};
+	BOOST_TEST_REQUIRE( longSchema.getGroupingSchema().size() == mls::locale::NumberFormat::MAX_GROUPS );
+	
+	for(auto& definition : mls::locale::builtInLocales()) {
+		auto* locale = mls::locale::findLocale(definition.name);
+		BOOST_TEST_REQUIRE( locale != nullptr );
+		BOOST_TEST_REQUIRE( locale->getCasesList().size() == definition.cases.size() );
+		BOOST_TEST_REQUIRE( locale->getNumberFormats().size() == definition.numberFormats.size() );
+		for(auto alias : definition.aliases) {
+			BOOST_TEST_REQUIRE( mls::locale::findLocale(alias) == locale );
+		}
+	}
+}
@@ -0,0 +1,158 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE plural_rules_module
+#include <boost/test/unit_test.hpp>
+
+#include <plural_rules.h>
+#include <errors.h>
+
+#include <string>
+
+// cSpell: words CLDR
+namespace {
+	
+	///the name of the category of a number written in decimal
+	std::string categoryOf(const mls::locale::PluralRules& rules, std::string_view number) {
+		return rules.getCategories()[ rules.select(mls::locale::pluralOperands(number)) ];
+	}
+
+};
+
+BOOST_AUTO_TEST_CASE( testOperands ) {
+	auto operands = mls::locale::pluralOperands("-1.50");
+	BOOST_TEST_REQUIRE( operands.i == 1u );
+	BOOST_TEST_REQUIRE( operands.v == 2u );
+	BOOST_TEST_REQUIRE( operands.w == 1u );
+	BOOST_TEST_REQUIRE( operands.f == 50u );
+	BOOST_TEST_REQUIRE( operands.t == 5u );
+	
+	operands = mls::locale::pluralOperands(1.5, 2);
+	BOOST_TEST_REQUIRE( operands.f == 50u );
+	BOOST_TEST_REQUIRE( operands.t == 5u );
+	
+	operands = mls::locale::pluralOperands(1.0);
+	BOOST_TEST_REQUIRE( operands.i == 1u );
+	BOOST_TEST_REQUIRE( operands.v == 0u );
+	
+	//huge numbers keep their last digits
+	operands = mls::locale::pluralOperands("123456789012345678901");
+	BOOST_TEST_REQUIRE( operands.i % 1000u == 901u );
+	BOOST_TEST_REQUIRE( operands.i != 1u );
+}
+
+BOOST_AUTO_TEST_CASE( testEnglishRules ) {
+	mls::locale::PluralRules rules{mls::locale::cldrPluralRules("en")};
+	
+	BOOST_TEST_REQUIRE( rules.getCategories().size() == 2u );
+	BOOST_TEST_REQUIRE( categoryOf(rules, "1") == "one" );
+	BOOST_TEST_REQUIRE( categoryOf(rules, "1.0") == "other" );
+	BOOST_TEST_REQUIRE( categoryOf(rules, "0") == "other" );
+	BOOST_TEST_REQUIRE( categoryOf(rules, "21") == "other" );
+}
+
+BOOST_AUTO_TEST_CASE( testSlavicRules ) {
+	// cSpell: disable
+	mls::locale::PluralRules polish{mls::locale::cldrPluralRules("pl")};
+	BOOST_TEST_REQUIRE( categoryOf(polish, "1") == "one" );
+	BOOST_TEST_REQUIRE( categoryOf(polish, "22") == "few" );
+	BOOST_TEST_REQUIRE( categoryOf(polish, "12") == "many" );
+	BOOST_TEST_REQUIRE( categoryOf(polish, "5") == "many" );
+	BOOST_TEST_REQUIRE( categoryOf(polish, "1.5") == "other" );
+	
+	mls::locale::PluralRules russian{mls::locale::cldrPluralRules("ru")};
+	BOOST_TEST_REQUIRE( categoryOf(russian, "21") == "one" );
+	BOOST_TEST_REQUIRE( categoryOf(russian, "11") == "many" );
+	BOOST_TEST_REQUIRE( categoryOf(russian, "104") == "few" );
+	BOOST_TEST_REQUIRE( categoryOf(russian, "2.5") == "other" );
+	//past the table of integers
+	BOOST_TEST_REQUIRE( categoryOf(russian, "1000021") == "one" );
+	BOOST_TEST_REQUIRE( categoryOf(russian, "1000011") == "many" );
+	BOOST_TEST_REQUIRE( categoryOf(russian, "123456789012345678903") == "few" );
+	
+	mls::locale::PluralRules czech{mls::locale::cldrPluralRules("cs")};
+	BOOST_TEST_REQUIRE( categoryOf(czech, "3") == "few" );
+	BOOST_TEST_REQUIRE( categoryOf(czech, "0.5") == "many" );
+	
+	mls::locale::PluralRules croatian{mls::locale::cldrPluralRules("hr")};
+	BOOST_TEST_REQUIRE( categoryOf(croatian, "0.1") == "one" );
+	BOOST_TEST_REQUIRE( categoryOf(croatian, "0.2") == "few" );
+	BOOST_TEST_REQUIRE( categoryOf(croatian, "0.5") == "other" );
+	// cSpell: enable
+}
+
+BOOST_AUTO_TEST_CASE( testOtherRules ) {
+	mls::locale::PluralRules arabic{mls::locale::cldrPluralRules("ar")};
+	BOOST_TEST_REQUIRE( arabic.getCategories().size() == 6u );
+	BOOST_TEST_REQUIRE( categoryOf(arabic, "0") == "zero" );
+	BOOST_TEST_REQUIRE( categoryOf(arabic, "2") == "two" );
+	BOOST_TEST_REQUIRE( categoryOf(arabic, "103") == "few" );
+	BOOST_TEST_REQUIRE( categoryOf(arabic, "111") == "many" );
+	BOOST_TEST_REQUIRE( categoryOf(arabic, "100") == "other" );
+	BOOST_TEST_REQUIRE( categoryOf(arabic, "3.5") == "other" );
+	BOOST_TEST_REQUIRE( categoryOf(arabic, "1000103") == "few" );
+	BOOST_TEST_REQUIRE( categoryOf(arabic, "1000002") == "other" );
+	
+	mls::locale::PluralRules latvian{mls::locale::cldrPluralRules("lv")};
+	BOOST_TEST_REQUIRE( categoryOf(latvian, "10") == "zero" );
+	BOOST_TEST_REQUIRE( categoryOf(latvian, "21") == "one" );
+	BOOST_TEST_REQUIRE( categoryOf(latvian, "0.1") == "one" );
+	BOOST_TEST_REQUIRE( categoryOf(latvian, "2") == "other" );
+	
+	mls::locale::PluralRules french{mls::locale::cldrPluralRules("fr")};
+	BOOST_TEST_REQUIRE( categoryOf(french, "1.5") == "one" );
+	BOOST_TEST_REQUIRE( categoryOf(french, "2") == "other" );
+	
+	mls::locale::PluralRules japanese{mls::locale::cldrPluralRules("ja")};
+	BOOST_TEST_REQUIRE( japanese.getCategories().size() == 1u );
+	BOOST_TEST_REQUIRE( japanese.select(1u) == 0u );
+	
+	BOOST_TEST_REQUIRE( mls::locale::cldrPluralRules("xx") == nullptr );
+}
+
+BOOST_AUTO_TEST_CASE( testRuleSyntax ) {
+	//the long forms of relations, `within` and samples
+	mls::locale::PluralRules rules{
+		"one: n is 1 @integer 1; "
+		"two: n mod 10 is not 0 and n within 2..3, 5 @decimal 2.5; "
+		"few: n not in 6..7 and n in 4..9 or n = 100; "
+		"other: @integer 0, 10~20"
+	};
+	BOOST_TEST_REQUIRE( categoryOf(rules, "1") == "one" );
+	BOOST_TEST_REQUIRE( categoryOf(rules, "2.5") == "two" );
+	BOOST_TEST_REQUIRE( categoryOf(rules, "5") == "two" );
+	BOOST_TEST_REQUIRE( categoryOf(rules, "4") == "few" );
+	BOOST_TEST_REQUIRE( categoryOf(rules, "100") == "few" );
+	BOOST_TEST_REQUIRE( categoryOf(rules, "6") == "other" );
+	BOOST_TEST_REQUIRE( categoryOf(rules, "4.5") == "other" );
+	
+	//the compact exponent is always 0
+	mls::locale::PluralRules compact{"many: e = 0 and i % 1000000 = 0 and i != 0 and v = 0 or e != 0..5"};
+	BOOST_TEST_REQUIRE( categoryOf(compact, "2000000") == "many" );
+	BOOST_TEST_REQUIRE( categoryOf(compact, "2000001") == "other" );
+	BOOST_TEST_REQUIRE( compact.select(std::uint64_t{3'000'000}) == 0u );
+}
+
+BOOST_AUTO_TEST_CASE( testInvalidRules ) {
+	BOOST_CHECK_THROW( mls::locale::PluralRules{"one i = 1"}, mls::InvalidPluralRules );
+	BOOST_CHECK_THROW( mls::locale::PluralRules{"single: i = 1"}, mls::InvalidPluralRules );
+	BOOST_CHECK_THROW( mls::locale::PluralRules{"one: i = 1; one: i = 2"}, mls::InvalidPluralRules );
+	BOOST_CHECK_THROW( mls::locale::PluralRules{"one: x = 1"}, mls::InvalidPluralRules );
+	BOOST_CHECK_THROW( mls::locale::PluralRules{"one: i == 1"}, mls::InvalidPluralRules );
+	BOOST_CHECK_THROW( mls::locale::PluralRules{"one: i % 0 = 1"}, mls::InvalidPluralRules );
+	BOOST_CHECK_THROW( mls::locale::PluralRules{"one: i = 5..2"}, mls::InvalidPluralRules );
+	BOOST_CHECK_THROW( mls::locale::PluralRules{"one: i = 1 and"}, mls::InvalidPluralRules );
+	BOOST_CHECK_THROW( mls::locale::PluralRules{"one: "}, mls::InvalidPluralRules );
+	BOOST_CHECK_THROW( mls::locale::PluralRules{"other: n = 1"}, mls::InvalidPluralRules );
+}
+
+BOOST_AUTO_TEST_CASE( testAllLanguagesRulesAreValid ) {
+	const char* languages[] = {
+		"ar", "be", "bg", "bn", "bs", "ca", "cs", "cy", "da", "de", "el", "en", "es", "et", "fa", "fi", "fr",
+		"ga", "gd", "he", "hi", "hr", "hu", "id", "is", "it", "ja", "ka", "kk", "ko", "lt", "lv", "mk", "ms",
+		"nb", "nl", "pl", "pt", "ro", "ru", "sk", "sl", "sq", "sr", "sv", "th", "tr", "uk", "vi", "zh"
+	};
+	for(const char* language : languages) {
+		const char* text = mls::locale::cldrPluralRules(language);
+		BOOST_TEST_REQUIRE( text != nullptr );
+		BOOST_CHECK_NO_THROW( mls::locale::PluralRules{text} );
+	}
+}
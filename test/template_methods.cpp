@@ -4,6 +4,14 @@
 
 #include <template.h>
 
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+#include <thread>
+#if !defined(_WIN32)
+#	include <unistd.h>
+#endif
+
 BOOST_AUTO_TEST_CASE( testNoVarNoFuncTemplate ) {
 	auto& enLocale = mls::locale::getLocale("en_US");
 	mls::Template theTemplate{"simple", enLocale};
@@ -82,6 +90,34 @@ BOOST_AUTO_TEST_CASE( testCaseFunction ) {
 	// cSpell: enable
 }
 
+BOOST_AUTO_TEST_CASE( testIndexedGenderAndCaseOutputs ) {
+	auto& plLocale = mls::locale::getLocale("pl_PL");
+	auto& enLocale = mls::locale::getLocale("en_US");
+	// cSpell: disable
+	mls::Template fTmpl{"%{+SG=f}%żona", plLocale};
+	mls::Template homeT{"dom%{+C gen={u} ins={em} nom={}}%", plLocale};
+	BOOST_TEST_REQUIRE( fTmpl.getCompiled()->getGenderIndex() == 1u );
+	BOOST_TEST_REQUIRE( homeT.getCompiled()->getGenderIndex() == mls::Instruction::NO_INDEX );
+	
+	//hash outputs are matched with the locale's genders and cases, whatever their order
+	mls::Template hashTmpl{"dobr%{person!G f={a} m={y}}% %{person}%", plLocale};
+	BOOST_TEST_REQUIRE( hashTmpl.apply("person", fTmpl).get() == "dobra żona" );
+	//a key which isn't a gender of the locale makes the template invalid
+	mls::Template typoTmpl{"dobr%{person!G f={a} mascline={y}}%", plLocale};
+	BOOST_TEST_REQUIRE( typoTmpl.getCompiled()->getProgram().empty() );
+	
+	mls::Template genCase{"Wejście do %{obj!C=gen}%", plLocale};
+	BOOST_TEST_REQUIRE( genCase.apply("obj", homeT).get() == "Wejście do domu" );
+	mls::Template datCase{"Daję %{obj!C=dat}%", plLocale};
+	//no output for a case missing in the hash
+	BOOST_TEST_REQUIRE( datCase.apply("obj", homeT).get() == "Daję dom" );
+	
+	//a template of another locale gets the case by its name
+	mls::Template enCase{"Inside the %{obj!C=ins}%", enLocale};
+	BOOST_TEST_REQUIRE( enCase.apply("obj", homeT).get() == "Inside the domem" );
+	// cSpell: enable
+}
+
 // cSpell: words pluralizer
 BOOST_AUTO_TEST_CASE( testPluralizerNormalNumbers ) {
 	auto& enLocale = mls::locale::getLocale("en_US");
@@ -119,6 +155,30 @@ BOOST_AUTO_TEST_CASE( testPluralizerRealNumbers ) {
 	BOOST_TEST_REQUIRE( manyFiles == "files" );
 }
 
+BOOST_AUTO_TEST_CASE( testPluralizerHashOutputs ) {
+	auto& plLocale = mls::locale::getLocale("pl_PL");
+	
+	// cSpell: disable
+	//keys in any order
+	mls::Template nFiles{"plik%{num!P other={ów} one={} few={i}}%", plLocale};
+	
+	BOOST_TEST_REQUIRE( nFiles.apply("num", 1).get() == "plik" );
+	BOOST_TEST_REQUIRE( nFiles.apply("num", 22).get() == "pliki" );
+	BOOST_TEST_REQUIRE( nFiles.apply("num", 12).get() == "plików" );
+	// cSpell: enable
+}
+
+BOOST_AUTO_TEST_CASE( testPluralizerAppliedReals ) {
+	auto& enLocale = mls::locale::getLocale("en_US");
+	
+	mls::Template nFiles{"file%{num!P:,s}%", enLocale};
+	
+	//numbers with visible fractions are plural in English
+	BOOST_TEST_REQUIRE( nFiles.applyReal("num", 1.0).get() == "file" );
+	BOOST_TEST_REQUIRE( nFiles.applyReal("num", 1.2).get() == "files" );
+	BOOST_TEST_REQUIRE( nFiles.applyReal("num", -1.0).get() == "file" );
+}
+
 BOOST_AUTO_TEST_CASE( testIntegerFormaterInTemplates ) {
 	auto& enLocale = mls::locale::getLocale("en_US");
 	
@@ -164,3 +224,274 @@ BOOST_AUTO_TEST_CASE( testRealFormaterInTemplatesLongVersion ) {
 	
 	BOOST_TEST_REQUIRE( numStr2 == "1000.123 1000.123 1,000.123" );
 }
+
+BOOST_AUTO_TEST_CASE( testSharedCompiledTemplate ) {
+	auto& enLocale = mls::locale::getLocale("en_US");
+	
+	auto compiled = std::make_shared<const mls::CompiledTemplate>("%{num}% file%{num!P:,s}%", enLocale);
+	
+	mls::TemplateArgs oneArgs{*compiled}, manyArgs{*compiled};
+	oneArgs.apply("num", 1);
+	manyArgs.apply("num", 7);
+	
+	BOOST_TEST_REQUIRE( mls::render(*compiled, oneArgs) == "1 file" );
+	BOOST_TEST_REQUIRE( mls::render(*compiled, manyArgs) == "7 files" );
+	//rendering doesn't consume the arguments
+	BOOST_TEST_REQUIRE( mls::render(*compiled, oneArgs) == "1 file" );
+	
+	mls::Template first{compiled};
+	mls::Template second{compiled};
+	std::string firstResult = first.apply("num", 2).get();
+	std::string secondResult = second.apply("num", 1).get();
+	
+	BOOST_TEST_REQUIRE( firstResult == "2 files" );
+	BOOST_TEST_REQUIRE( secondResult == "1 file" );
+	BOOST_TEST_REQUIRE( first.getCompiled() == second.getCompiled() );
+}
+
+BOOST_AUTO_TEST_CASE( testGetAppendsToBuffer ) {
+	auto& enLocale = mls::locale::getLocale("en_US");
+	
+	mls::Template nFiles{"%{num!I=grouped}% file%{num!P:,s}%", enLocale};
+	std::string buffer{"> "};
+	
+	nFiles.apply("num", 1).get(buffer);
+	BOOST_TEST_REQUIRE( buffer == "> 1 file" );
+	
+	nFiles.apply("num", 12'345).get(buffer);
+	BOOST_TEST_REQUIRE( buffer == "> 1 file12,345 files" );
+	
+	//the estimate is big enough for texts and integers
+	mls::TemplateArgs args{*nFiles.getCompiled()};
+	args.apply("num", 12'345);
+	std::size_t estimate = mls::estimateSize(*nFiles.getCompiled(), args);
+	BOOST_TEST_REQUIRE( estimate >= std::string{"12,345 files"}.size() );
+	
+	//appending many times to one buffer grows it geometrically
+	std::string many;
+	std::size_t reallocations = 0u;
+	for(int i=0; i<1000; ++i) {
+		const std::size_t capacity = many.capacity();
+		nFiles.apply("num", i).get(many);
+		reallocations += many.capacity() != capacity ? 1u : 0u;
+	}
+	BOOST_TEST_REQUIRE( reallocations < 32u );
+}
+
+BOOST_AUTO_TEST_CASE( testRenderSinks ) {
+	auto& enLocale = mls::locale::getLocale("en_US");
+	mls::Template noun{"folder", enLocale};
+	mls::Template message{"Hello %{name}%! %{num!I=grouped}% file%{num!P:,s}% in %{dir}%.", enLocale};
+	const std::string expected = "Hello World! 12,345 files in folder.";
+	
+	std::ostringstream stream;
+	mls::OstreamSink streamSink{stream};
+	message.apply("name", "World").apply("num", 12'345).apply("dir", noun).get(streamSink);
+	BOOST_TEST_REQUIRE( stream.str() == expected );
+	
+	std::FILE* file = std::tmpfile();
+	BOOST_TEST_REQUIRE( file != nullptr );
+	mls::FileSink fileSink{file};
+	message.apply("name", "World").apply("num", 12'345).apply("dir", noun).get(fileSink);
+	std::rewind(file);
+	char buffer[64] = {};
+	BOOST_TEST_REQUIRE( std::fread(buffer, 1u, sizeof(buffer), file) == expected.size() );
+	BOOST_TEST_REQUIRE( std::string{buffer} == expected );
+	std::fclose(file);
+	
+	mls::IovecSink segmentsSink;
+	message.apply("name", "World").apply("num", 12'345).apply("dir", noun).get(segmentsSink);
+	BOOST_TEST_REQUIRE( segmentsSink.size() == expected.size() );
+	auto segments = segmentsSink.segments();
+	std::string joined;
+	for(auto& segment : segments) {
+		joined.append(static_cast<const char*>(segment.iov_base), segment.iov_len);
+	}
+	BOOST_TEST_REQUIRE( joined == expected );
+	//literals are referenced in place
+	BOOST_TEST_REQUIRE( segments[0].iov_base == message.getCompiled()->getProgram()[0].text.data() );
+	
+	#if !defined(_WIN32)
+	int pipeEnds[2];
+	BOOST_TEST_REQUIRE( pipe(pipeEnds) == 0 );
+	BOOST_TEST_REQUIRE( writev(pipeEnds[1], segments.data(), static_cast<int>(segments.size())) == static_cast<ssize_t>(expected.size()) );
+	BOOST_TEST_REQUIRE( read(pipeEnds[0], buffer, sizeof(buffer)) == static_cast<ssize_t>(expected.size()) );
+	BOOST_TEST_REQUIRE( std::string(buffer, expected.size()) == expected );
+	close(pipeEnds[0]);
+	close(pipeEnds[1]);
+	#endif
+	
+	segmentsSink.clear();
+	BOOST_TEST_REQUIRE( segmentsSink.size() == 0u );
+	BOOST_TEST_REQUIRE( segmentsSink.segments().empty() );
+}
+
+BOOST_AUTO_TEST_CASE( testNestedTemplatesShareOutput ) {
+	auto& plLocale = mls::locale::getLocale("pl_PL");
+	mls::Template noun{"sąsiad%{+C:,a,owi,a,em,zie,zie}%", plLocale};
+	mls::Template person{"%{who!C=ins}% z sąsiedniej wioski", plLocale};
+	mls::Template message{"Rozmawiałem z %{person}%.", plLocale};
+	
+	std::string buffer{"> "};
+	message.apply("person", person.apply("who", noun)).get(buffer);
+	BOOST_TEST_REQUIRE( buffer == "> Rozmawiałem z sąsiadem z sąsiedniej wioski." );
+	
+	//texts of nested templates reach the sink in place, without a string of the nested output
+	mls::IovecSink sink;
+	message.apply("person", person.apply("who", noun)).get(sink);
+	auto segments = sink.segments();
+	auto nounText = noun.getCompiled()->getProgram()[0].text;
+	BOOST_TEST_REQUIRE( std::any_of(segments.begin(), segments.end(), [&](const mls::IoSegment& segment) {
+		return segment.iov_base == nounText.data();
+	}) );
+	std::string joined;
+	for(auto& segment : segments) {
+		joined.append(static_cast<const char*>(segment.iov_base), segment.iov_len);
+	}
+	BOOST_TEST_REQUIRE( joined == "Rozmawiałem z sąsiadem z sąsiedniej wioski." );
+}
+
+BOOST_AUTO_TEST_CASE( testRepeatedNestedTemplates ) {
+	auto& plLocale = mls::locale::getLocale("pl_PL");
+	mls::Template noun{"sąsiad%{+C:,a,owi,a,em,zie,zie}%", plLocale};
+	mls::Template person{"%{who!C=ins}% z sąsiedniej wioski", plLocale};
+	mls::Template people{"Rozmawiałem z %{first}%, %{second}% i %{third}%.", plLocale};
+	const std::string expected = "Rozmawiałem z sąsiadem z sąsiedniej wioski, sąsiadem z sąsiedniej wioski i sąsiadem z sąsiedniej wioski.";
+	
+	//the nested template is rendered once and its output is repeated
+	person.apply("who", noun);
+	BOOST_TEST_REQUIRE( people.apply("first", person).apply("second", person).apply("third", person).get() == expected );
+	
+	person.apply("who", noun);
+	mls::IovecSink sink;
+	people.apply("first", person).apply("second", person).apply("third", person).get(sink);
+	std::string joined;
+	for(auto& segment : sink.segments()) {
+		joined.append(static_cast<const char*>(segment.iov_base), segment.iov_len);
+	}
+	BOOST_TEST_REQUIRE( joined == expected );
+	
+	//other cases of the same template are rendered on their own
+	mls::Template wife{"%{+SG=f}%żon%{+C:a,y,ie,ę,ą,ie,o}%", plLocale};
+	mls::Template sentence{"dobr%{p!G:y,a,e}% %{p!C=nom}%, widzę %{p!C=acc}% z %{p!C=ins}%", plLocale};
+	BOOST_TEST_REQUIRE( sentence.apply("p", wife).get() == "dobra żona, widzę żonę z żoną" );
+}
+
+BOOST_AUTO_TEST_CASE( testNestedTemplatesStayUnchanged ) {
+	auto& plLocale = mls::locale::getLocale("pl_PL");
+	// cSpell: disable
+	mls::Template home{"dom%{+C:,u,owi,,em,u,ie}%", plLocale};
+	mls::Template owner{"%{who}% z %{what!C=gen}%", plLocale};
+	owner.apply("who", "Jan").apply("what", home);
+	
+	mls::Template message{"Widzę %{p}% i %{obj!C=acc}%", plLocale};
+	BOOST_TEST_REQUIRE( message.apply("p", owner).apply("obj", home).get() == "Widzę Jan z domu i dom" );
+	//variables of nested templates are kept, as they aren't run on their own
+	BOOST_TEST_REQUIRE( (owner.getArgs().get( owner.slot("who").index ) == mls::variableValue{std::string_view{"Jan"}}) );
+	BOOST_TEST_REQUIRE( message.apply("p", owner).apply("obj", home).get() == "Widzę Jan z domu i dom" );
+	
+	//so templates sharing a nested one can be rendered by many threads
+	auto renderInCase = [&home](const char* templateString, std::string expected, bool& ok) {
+		auto& locale = mls::locale::getLocale("pl_PL");
+		mls::Template sentence{templateString, locale};
+		for(int i=0; i<2000; ++i) {
+			ok = ok && sentence.apply("obj", home).get() == expected;
+		}
+	};
+	bool genOk = true, insOk = true;
+	std::thread genThread{renderInCase, "do %{obj!C=gen}%", "do domu", std::ref(genOk)};
+	renderInCase("z %{obj!C=ins}%", "z domem", insOk);
+	genThread.join();
+	BOOST_TEST_REQUIRE( genOk );
+	BOOST_TEST_REQUIRE( insOk );
+	// cSpell: enable
+}
+
+BOOST_AUTO_TEST_CASE( testVariableSlots ) {
+	auto& enLocale = mls::locale::getLocale("en_US");
+	
+	mls::Template nFiles{"%{num}% file%{num!P:,s}% in %{dir}%", enLocale};
+	auto numSlot = nFiles.slot("num");
+	auto dirSlot = nFiles.slot("dir");
+	auto noSlot = nFiles.slot("unknown");
+	
+	BOOST_TEST_REQUIRE( numSlot.index == 0u );
+	BOOST_TEST_REQUIRE( dirSlot.index == 1u );
+	BOOST_TEST_REQUIRE( noSlot.index == mls::VariableSlot::NONE );
+	
+	std::string result = nFiles.apply(numSlot, 3).apply(dirSlot, "/tmp").apply(noSlot, 1).get();
+	BOOST_TEST_REQUIRE( result == "3 files in /tmp" );
+	
+	//names and slots can be mixed
+	result = nFiles.apply("num", 1).apply(dirSlot, "/home").get();
+	BOOST_TEST_REQUIRE( result == "1 file in /home" );
+}
+
+BOOST_AUTO_TEST_CASE( testManyVariables ) {
+	auto& enLocale = mls::locale::getLocale("en_US");
+	
+	mls::Template manyVars{"%{a}%%{b}%%{c}%%{d}%%{e}%%{f}%%{g}%%{h}%%{i}%%{j}%", enLocale};
+	const char* names[] = {"a","b","c","d","e","f","g","h","i","j"};
+	for(long i=0; i<10; ++i) {
+		manyVars.apply(names[i], i);
+	}
+	
+	BOOST_TEST_REQUIRE( manyVars.get() == "0123456789" );
+}
+
+BOOST_AUTO_TEST_CASE( testLiteralTemplate ) {
+	auto& enLocale = mls::locale::getLocale("en_US");
+	
+	mls::Template nFiles{mls::literal<"%{num!I=grouped}% file%{num!P:,s}%">, enLocale};
+	mls::Template parsedAtRunTime{"%{num!I=grouped}% file%{num!P:,s}%", enLocale};
+	
+	BOOST_TEST_REQUIRE( nFiles.apply("num", 12'345).get() == "12,345 files" );
+	BOOST_TEST_REQUIRE( nFiles.apply("num", 1).get() == parsedAtRunTime.apply("num", 1).get() );
+}
+
+BOOST_AUTO_TEST_CASE( testRenderBatch ) {
+	auto& enLocale = mls::locale::getLocale("en_US");
+	mls::CompiledTemplate compiled{"%{n}% file%{n!P:,s}% in %{dir}% (%{size!R:grouped,1}% kB)", enLocale};
+	
+	std::vector<long> numbers;
+	std::vector<std::string_view> dirs;
+	std::vector<double> sizes;
+	std::vector<long> unused;
+	for(long row=0; row<5000; ++row) {
+		numbers.push_back(row % 3);
+		dirs.push_back(row % 2 == 0 ? "/tmp" : "/home");
+		sizes.push_back(1000.0 + static_cast<double>(row));
+		unused.push_back(row);
+	}
+	const mls::BatchColumn columns[] = {
+		{"n", numbers},
+		{"dir", dirs},
+		{"size", sizes},
+		{"unused", unused}
+	};
+	
+	mls::BatchOutput output;
+	mls::renderBatch(compiled, columns, output);
+	BOOST_TEST_REQUIRE( output.size() == 5000u );
+	BOOST_TEST_REQUIRE( output.row(0) == "0 files in /tmp (1,000 kB)" );
+	BOOST_TEST_REQUIRE( output.row(1) == "1 file in /home (1,001 kB)" );
+	BOOST_TEST_REQUIRE( output.offsets.back() == output.text.size() );
+	
+	//the same rows, whatever the number of threads
+	mls::BatchOutput parallel;
+	mls::renderBatch(compiled, columns, parallel, mls::BatchPolicy::PARALLEL, 4u);
+	BOOST_TEST_REQUIRE( parallel.text == output.text );
+	BOOST_TEST_REQUIRE( parallel.offsets == output.offsets );
+	
+	//the output is replaced
+	mls::renderBatch(compiled, std::span<const mls::BatchColumn>{columns}.first(3u), output);
+	BOOST_TEST_REQUIRE( output.size() == 5000u );
+	
+	const mls::BatchColumn uneven[] = {
+		{"n", numbers},
+		{"dir", std::span<const std::string_view>{dirs}.first(10u)}
+	};
+	BOOST_CHECK_THROW( mls::renderBatch(compiled, uneven, output), mls::InvalidTemplateState );
+	mls::renderBatch(compiled, {}, output);
+	BOOST_TEST_REQUIRE( output.size() == 0u );
+}
@@ -4,375 +4,259 @@
 
 #include <preparser.h>
 
-template<typename T>
-void clearVector(const std::vector<T> &theVector) {
-	for(auto elem : theVector) {
-		delete elem;
-	}
+using mls::preparse::TagType;
+
+///the arguments of the tag as `key` and `value` pairs
+std::vector<mls::preparse::ArgumentSyntax> tagArguments(const mls::preparse::PreparsedSyntax& parsed, const mls::preparse::TagSyntax& tag) {
+	return {parsed.arguments.begin() + tag.firstArgument, parsed.arguments.begin() + tag.firstArgument + tag.argumentsCount};
 }
 
 BOOST_AUTO_TEST_CASE( testNonTemplate ) {
 	std::string nonTemplate{"NonTemplate"};
 	
-	auto[charList, fnList] = mls::preparse::preparse_template(nonTemplate);
+	auto parsed = mls::preparse::preparse_syntax(nonTemplate);
 	
-	if( charList.size() == 1 && fnList.size() == 0 ) {
-		std::string compStr{charList[0]};
-		clearVector(charList);
-		
-		BOOST_TEST_REQUIRE( nonTemplate == compStr );
-	} else {
-		clearVector(charList);
-		clearVector(fnList);
-		BOOST_ERROR( "Wrong size" );
-	}
+	BOOST_TEST_REQUIRE( parsed.strings.size() == 1u );
+	BOOST_TEST_REQUIRE( parsed.tags.size() == 0u );
+	BOOST_TEST_REQUIRE( parsed.strings[0] == nonTemplate );
 }
 
 BOOST_AUTO_TEST_CASE( testComments ) {
 	std::string commentTemplate{"ab%{#comment#}%cd"};
 	
-	auto[charList, fnList] = mls::preparse::preparse_template(commentTemplate);
-	if( charList.size() == 2 && fnList.size() == 1 ) {
-		std::string prefix{charList[0]};
-		std::string suffix{charList[1]};
-		clearVector(charList);
-		
-		if( fnList[0] != nullptr ) {
-			delete fnList[0];
-			BOOST_ERROR( "A function returned when expected a null pointer" );
-		}
-		BOOST_TEST_REQUIRE( prefix == "ab" );
-		BOOST_TEST_REQUIRE( suffix == "cd" );
-	} else {
-		clearVector(charList);
-		clearVector(fnList);
-		BOOST_ERROR( "Wrong size" );
-	}
+	auto parsed = mls::preparse::preparse_syntax(commentTemplate);
+	
+	BOOST_TEST_REQUIRE( parsed.strings.size() == 2u );
+	BOOST_TEST_REQUIRE( parsed.tags.size() == 1u );
+	BOOST_TEST_REQUIRE( parsed.tags[0].isComment );
+	BOOST_TEST_REQUIRE( parsed.strings[0] == "ab" );
+	BOOST_TEST_REQUIRE( parsed.strings[1] == "cd" );
 }
 
 BOOST_AUTO_TEST_CASE( testVarOnly ) {
 	std::string_view varTemplate{"a%{var}%b"};
 	
-	auto[charList, fnList] = mls::preparse::preparse_template(varTemplate);
+	auto parsed = mls::preparse::preparse_syntax(varTemplate);
 	
-	if( charList.size() == 2 && fnList.size() == 1) {
-		std::string prefix{charList[0]};
-		std::string suffix{charList[1]};
-		clearVector(charList);
-		
-		auto fn = fnList[0];
-		if( fn == nullptr ) {
-			BOOST_ERROR( "Null pointer where expected a parsed function" );
-		} else {
-			auto varName = fn->varName;
-			delete fn;
-			
-			BOOST_TEST_REQUIRE( varName == "var" );
-			BOOST_TEST_REQUIRE( prefix == "a" );
-			BOOST_TEST_REQUIRE( suffix == "b" );
-		}
-	} else {
-		clearVector(charList);
-		clearVector(fnList);
-		BOOST_ERROR( "Wrong size" );
-	}
+	BOOST_TEST_REQUIRE( parsed.strings.size() == 2u );
+	BOOST_TEST_REQUIRE( parsed.tags.size() == 1u );
+	auto& tag = parsed.tags[0];
+	BOOST_TEST_REQUIRE( !tag.isComment );
+	BOOST_TEST_REQUIRE( (tag.type == TagType::VAR_ONLY) );
+	BOOST_TEST_REQUIRE( tag.varName == "var" );
+	BOOST_TEST_REQUIRE( parsed.strings[0] == "a" );
+	BOOST_TEST_REQUIRE( parsed.strings[1] == "b" );
 }
 
 BOOST_AUTO_TEST_CASE( testNoVarFunctionOneArg ) {
 	std::string_view testTemplate{"a%{+F=b}%c"};
 	
-	auto[charList, fnList] = mls::preparse::preparse_template(testTemplate);
+	auto parsed = mls::preparse::preparse_syntax(testTemplate);
 	
-	if( charList.size() == 2 && fnList.size() == 1) {
-		std::string prefix{charList[0]};
-		std::string suffix{charList[1]};
-		clearVector(charList);
-		
-		auto fn = fnList[0];
-		if( fn == nullptr ) {
-			BOOST_ERROR( "Null pointer where expected a parsed function" );
-		} else {
-			auto varName = fn->varName;
-			char fnName1 = fn->name[0];
-			char fnName2 = fn->name[1];
-			auto type = fn->getType();
-			std::string arg{""};
-			if(type == mls::preparse::ParsedTemplateFunction::Type::ONE_ARG) {
-				arg = static_cast<mls::preparse::OneArgFunction*>(fn)->argument;
-			}
-			delete fn;
-			
-			BOOST_TEST_REQUIRE( varName == "" );
-			BOOST_TEST_REQUIRE( fnName1 == 'F' );
-			BOOST_TEST_REQUIRE( fnName2 == '\0' );
-			BOOST_TEST_REQUIRE( (type == mls::preparse::ParsedTemplateFunction::Type::ONE_ARG) );
-			BOOST_TEST_REQUIRE( arg == "b" );
-			BOOST_TEST_REQUIRE( prefix == "a" );
-			BOOST_TEST_REQUIRE( suffix == "c" );
-		}
-	} else {
-		clearVector(charList);
-		clearVector(fnList);
-		BOOST_ERROR( "Wrong size" );
-	}
+	BOOST_TEST_REQUIRE( parsed.strings.size() == 2u );
+	BOOST_TEST_REQUIRE( parsed.tags.size() == 1u );
+	auto& tag = parsed.tags[0];
+	auto args = tagArguments(parsed, tag);
+	BOOST_TEST_REQUIRE( tag.varName == "" );
+	BOOST_TEST_REQUIRE( tag.name[0] == 'F' );
+	BOOST_TEST_REQUIRE( tag.name[1] == '\0' );
+	BOOST_TEST_REQUIRE( (tag.type == TagType::ONE_ARG) );
+	BOOST_TEST_REQUIRE( args.size() == 1u );
+	BOOST_TEST_REQUIRE( args[0].value == "b" );
+	BOOST_TEST_REQUIRE( parsed.strings[0] == "a" );
+	BOOST_TEST_REQUIRE( parsed.strings[1] == "c" );
 }
 
 BOOST_AUTO_TEST_CASE( testWithVarFunctionOneArg ) {
 	std::string_view testTemplate{"a%{var!F=b}%c"};
 	
-	auto[charList, fnList] = mls::preparse::preparse_template(testTemplate);
+	auto parsed = mls::preparse::preparse_syntax(testTemplate);
 	
-	if( charList.size() == 2 && fnList.size() == 1) {
-		std::string prefix{charList[0]};
-		std::string suffix{charList[1]};
-		clearVector(charList);
-		
-		auto fn = fnList[0];
-		if( fn == nullptr ) {
-			BOOST_ERROR( "Null pointer where expected a parsed function" );
-		} else {
-			auto varName = fn->varName;
-			char fnName1 = fn->name[0];
-			char fnName2 = fn->name[1];
-			auto type = fn->getType();
-			std::string arg{""};
-			if(type == mls::preparse::ParsedTemplateFunction::Type::ONE_ARG) {
-				arg = static_cast<mls::preparse::OneArgFunction*>(fn)->argument;
-			}
-			delete fn;
-			
-			BOOST_TEST_REQUIRE( varName == "var" );
-			BOOST_TEST_REQUIRE( fnName1 == 'F' );
-			BOOST_TEST_REQUIRE( fnName2 == '\0' );
-			BOOST_TEST_REQUIRE( (type == mls::preparse::ParsedTemplateFunction::Type::ONE_ARG) );
-			BOOST_TEST_REQUIRE( arg == "b" );
-			BOOST_TEST_REQUIRE( prefix == "a" );
-			BOOST_TEST_REQUIRE( suffix == "c" );
-		}
-	} else {
-		clearVector(charList);
-		clearVector(fnList);
-		BOOST_ERROR( "Wrong size" );
-	}
+	BOOST_TEST_REQUIRE( parsed.strings.size() == 2u );
+	BOOST_TEST_REQUIRE( parsed.tags.size() == 1u );
+	auto& tag = parsed.tags[0];
+	auto args = tagArguments(parsed, tag);
+	BOOST_TEST_REQUIRE( tag.varName == "var" );
+	BOOST_TEST_REQUIRE( tag.name[0] == 'F' );
+	BOOST_TEST_REQUIRE( tag.name[1] == '\0' );
+	BOOST_TEST_REQUIRE( (tag.type == TagType::ONE_ARG) );
+	BOOST_TEST_REQUIRE( args.size() == 1u );
+	BOOST_TEST_REQUIRE( args[0].value == "b" );
+	BOOST_TEST_REQUIRE( parsed.strings[0] == "a" );
+	BOOST_TEST_REQUIRE( parsed.strings[1] == "c" );
 }
 
 BOOST_AUTO_TEST_CASE( testNoVarFunctionOneArgWrongFormat ) {
 	std::string_view testTemplate{"a%{+F=}%c"};
 	
-	auto[charList, fnList] = mls::preparse::preparse_template(testTemplate);
+	auto parsed = mls::preparse::preparse_syntax(testTemplate);
 	
-	if( charList.size() == 2 && fnList.size() == 1) {
-		clearVector(charList);
-		
-		auto fn = fnList[0];
-		if( fn != nullptr ) {
-			delete fn;
-			BOOST_ERROR( "Function returned on wrong template" );
-		}
-	} else {
-		clearVector(charList);
-		clearVector(fnList);
-	}
+	//an invalid tag is skipped like a comment
+	BOOST_TEST_REQUIRE( parsed.strings.size() == 2u );
+	BOOST_TEST_REQUIRE( parsed.tags.size() == 1u );
+	BOOST_TEST_REQUIRE( parsed.tags[0].isComment );
+	BOOST_TEST_REQUIRE( parsed.arguments.empty() );
 }
 
 BOOST_AUTO_TEST_CASE( testNoVarFunctionTableArg ) {
 	std::string_view testTemplate{"a%{+F:b,c}%d"};
 	
-	auto[charList, fnList] = mls::preparse::preparse_template(testTemplate);
+	auto parsed = mls::preparse::preparse_syntax(testTemplate);
 	
-	if( charList.size() == 2 && fnList.size() == 1) {
-		std::string prefix{charList[0]};
-		std::string suffix{charList[1]};
-		clearVector(charList);
-		
-		auto fn = fnList[0];
-		if( fn == nullptr ) {
-			BOOST_ERROR( "Null pointer where expected a parsed function" );
-		} else {
-			auto varName = fn->varName;
-			char fnName1 = fn->name[0];
-			char fnName2 = fn->name[1];
-			auto type = fn->getType();
-			std::vector<std::string> args;
-			if(type == mls::preparse::ParsedTemplateFunction::Type::TABLE_ARG) {
-				args = static_cast<mls::preparse::TableArgFunction*>(fn)->arguments;
-			}
-			delete fn;
-			
-			BOOST_TEST_REQUIRE( varName == "" );
-			BOOST_TEST_REQUIRE( fnName1 == 'F' );
-			BOOST_TEST_REQUIRE( fnName2 == '\0' );
-			BOOST_TEST_REQUIRE( (type == mls::preparse::ParsedTemplateFunction::Type::TABLE_ARG) );
-			BOOST_TEST_REQUIRE( args.size() == 2 );
-			BOOST_TEST_REQUIRE( args[0] == "b" );
-			BOOST_TEST_REQUIRE( args[1] == "c" );
-			BOOST_TEST_REQUIRE( prefix == "a" );
-			BOOST_TEST_REQUIRE( suffix == "d" );
-		}
-	} else {
-		clearVector(charList);
-		clearVector(fnList);
-		BOOST_ERROR( "Wrong size" );
-	}
+	BOOST_TEST_REQUIRE( parsed.strings.size() == 2u );
+	BOOST_TEST_REQUIRE( parsed.tags.size() == 1u );
+	auto& tag = parsed.tags[0];
+	auto args = tagArguments(parsed, tag);
+	BOOST_TEST_REQUIRE( tag.varName == "" );
+	BOOST_TEST_REQUIRE( tag.name[0] == 'F' );
+	BOOST_TEST_REQUIRE( tag.name[1] == '\0' );
+	BOOST_TEST_REQUIRE( (tag.type == TagType::TABLE_ARG) );
+	BOOST_TEST_REQUIRE( args.size() == 2u );
+	BOOST_TEST_REQUIRE( args[0].value == "b" );
+	BOOST_TEST_REQUIRE( args[1].value == "c" );
+	BOOST_TEST_REQUIRE( parsed.strings[0] == "a" );
+	BOOST_TEST_REQUIRE( parsed.strings[1] == "d" );
 }
 
 BOOST_AUTO_TEST_CASE( testWithVarFunctionTableArg ) {
 	std::string_view testTemplate{"a%{var!F:b,c}%d"};
 	
-	auto[charList, fnList] = mls::preparse::preparse_template(testTemplate);
+	auto parsed = mls::preparse::preparse_syntax(testTemplate);
 	
-	if( charList.size() == 2 && fnList.size() == 1) {
-		std::string prefix{charList[0]};
-		std::string suffix{charList[1]};
-		clearVector(charList);
-		
-		auto fn = fnList[0];
-		if( fn == nullptr ) {
-			BOOST_ERROR( "Null pointer where expected a parsed function" );
-		} else {
-			auto varName = fn->varName;
-			char fnName1 = fn->name[0];
-			char fnName2 = fn->name[1];
-			auto type = fn->getType();
-			std::vector<std::string> args;
-			if(type == mls::preparse::ParsedTemplateFunction::Type::TABLE_ARG) {
-				args = static_cast<mls::preparse::TableArgFunction*>(fn)->arguments;
-			}
-			delete fn;
-			
-			BOOST_TEST_REQUIRE( varName == "var" );
-			BOOST_TEST_REQUIRE( fnName1 == 'F' );
-			BOOST_TEST_REQUIRE( fnName2 == '\0' );
-			BOOST_TEST_REQUIRE( (type == mls::preparse::ParsedTemplateFunction::Type::TABLE_ARG) );
-			BOOST_TEST_REQUIRE( args.size() == 2 );
-			BOOST_TEST_REQUIRE( args[0] == "b" );
-			BOOST_TEST_REQUIRE( args[1] == "c" );
-			BOOST_TEST_REQUIRE( prefix == "a" );
-			BOOST_TEST_REQUIRE( suffix == "d" );
-		}
-	} else {
-		clearVector(charList);
-		clearVector(fnList);
-		BOOST_ERROR( "Wrong size" );
-	}
+	BOOST_TEST_REQUIRE( parsed.strings.size() == 2u );
+	BOOST_TEST_REQUIRE( parsed.tags.size() == 1u );
+	auto& tag = parsed.tags[0];
+	auto args = tagArguments(parsed, tag);
+	BOOST_TEST_REQUIRE( tag.varName == "var" );
+	BOOST_TEST_REQUIRE( tag.name[0] == 'F' );
+	BOOST_TEST_REQUIRE( tag.name[1] == '\0' );
+	BOOST_TEST_REQUIRE( (tag.type == TagType::TABLE_ARG) );
+	BOOST_TEST_REQUIRE( args.size() == 2u );
+	BOOST_TEST_REQUIRE( args[0].value == "b" );
+	BOOST_TEST_REQUIRE( args[1].value == "c" );
+	BOOST_TEST_REQUIRE( parsed.strings[0] == "a" );
+	BOOST_TEST_REQUIRE( parsed.strings[1] == "d" );
 }
 
 BOOST_AUTO_TEST_CASE( testNoVarFunctionTableArgWrongFormat ) {
 	std::string_view testTemplate{"a%{+F:}%c"};
 	
-	auto[charList, fnList] = mls::preparse::preparse_template(testTemplate);
+	auto parsed = mls::preparse::preparse_syntax(testTemplate);
 	
-	if( charList.size() == 2 && fnList.size() == 1) {
-		clearVector(charList);
-		
-		auto fn = fnList[0];
-		if( fn != nullptr ) {
-			delete fn;
-			BOOST_ERROR( "Function returned on wrong template" );
-		}
-	} else {
-		clearVector(charList);
-		clearVector(fnList);
-	}
+	BOOST_TEST_REQUIRE( parsed.strings.size() == 2u );
+	BOOST_TEST_REQUIRE( parsed.tags.size() == 1u );
+	BOOST_TEST_REQUIRE( parsed.tags[0].isComment );
+	BOOST_TEST_REQUIRE( parsed.arguments.empty() );
 }
 
 BOOST_AUTO_TEST_CASE( testNoVarFunctionHashArg ) {
 	std::string_view testTemplate{"a%{+F b={B} c={C}}%d"};
 	
-	auto[charList, fnList] = mls::preparse::preparse_template(testTemplate);
+	auto parsed = mls::preparse::preparse_syntax(testTemplate);
 	
-	if( charList.size() == 2 && fnList.size() == 1) {
-		std::string prefix{charList[0]};
-		std::string suffix{charList[1]};
-		clearVector(charList);
-		
-		auto fn = fnList[0];
-		if( fn == nullptr ) {
-			BOOST_ERROR( "Null pointer where expected a parsed function" );
-		} else {
-			auto varName = fn->varName;
-			char fnName1 = fn->name[0];
-			char fnName2 = fn->name[1];
-			auto type = fn->getType();
-			std::map<std::string, std::string> args;
-			if(type == mls::preparse::ParsedTemplateFunction::Type::HASH_ARG) {
-				args = static_cast<mls::preparse::HashArgFunction*>(fn)->arguments;
-			}
-			delete fn;
-			
-			BOOST_TEST_REQUIRE( varName == "" );
-			BOOST_TEST_REQUIRE( fnName1 == 'F' );
-			BOOST_TEST_REQUIRE( fnName2 == '\0' );
-			BOOST_TEST_REQUIRE( (type == mls::preparse::ParsedTemplateFunction::Type::HASH_ARG) );
-			BOOST_TEST_REQUIRE( args.size() == 2 );
-			BOOST_TEST_REQUIRE( args["b"] == "B" );
-			BOOST_TEST_REQUIRE( args["c"] == "C" );
-			BOOST_TEST_REQUIRE( prefix == "a" );
-			BOOST_TEST_REQUIRE( suffix == "d" );
-		}
-	} else {
-		clearVector(charList);
-		clearVector(fnList);
-		BOOST_ERROR( "Wrong size" );
-	}
+	BOOST_TEST_REQUIRE( parsed.strings.size() == 2u );
+	BOOST_TEST_REQUIRE( parsed.tags.size() == 1u );
+	auto& tag = parsed.tags[0];
+	auto args = tagArguments(parsed, tag);
+	BOOST_TEST_REQUIRE( tag.varName == "" );
+	BOOST_TEST_REQUIRE( tag.name[0] == 'F' );
+	BOOST_TEST_REQUIRE( tag.name[1] == '\0' );
+	BOOST_TEST_REQUIRE( (tag.type == TagType::HASH_ARG) );
+	BOOST_TEST_REQUIRE( args.size() == 2u );
+	BOOST_TEST_REQUIRE( args[0].key == "b" );
+	BOOST_TEST_REQUIRE( args[0].value == "B" );
+	BOOST_TEST_REQUIRE( args[1].key == "c" );
+	BOOST_TEST_REQUIRE( args[1].value == "C" );
+	BOOST_TEST_REQUIRE( parsed.strings[0] == "a" );
+	BOOST_TEST_REQUIRE( parsed.strings[1] == "d" );
 }
 
 BOOST_AUTO_TEST_CASE( testWithVarFunctionHashArg ) {
 	std::string_view testTemplate{"a%{var!F b={B} c={C}}%d"};
 	
-	auto[charList, fnList] = mls::preparse::preparse_template(testTemplate);
+	auto parsed = mls::preparse::preparse_syntax(testTemplate);
 	
-	if( charList.size() == 2 && fnList.size() == 1) {
-		std::string prefix{charList[0]};
-		std::string suffix{charList[1]};
-		clearVector(charList);
-		
-		auto fn = fnList[0];
-		if( fn == nullptr ) {
-			BOOST_ERROR( "Null pointer where expected a parsed function" );
-		} else {
-			auto varName = fn->varName;
-			char fnName1 = fn->name[0];
-			char fnName2 = fn->name[1];
-			auto type = fn->getType();
-			std::map<std::string, std::string> args;
-			if(type == mls::preparse::ParsedTemplateFunction::Type::HASH_ARG) {
-				args = static_cast<mls::preparse::HashArgFunction*>(fn)->arguments;
-			}
-			delete fn;
-			
-			BOOST_TEST_REQUIRE( varName == "var" );
-			BOOST_TEST_REQUIRE( fnName1 == 'F' );
-			BOOST_TEST_REQUIRE( fnName2 == '\0' );
-			BOOST_TEST_REQUIRE( (type == mls::preparse::ParsedTemplateFunction::Type::HASH_ARG) );
-			BOOST_TEST_REQUIRE( args.size() == 2 );
-			BOOST_TEST_REQUIRE( args["b"] == "B" );
-			BOOST_TEST_REQUIRE( args["c"] == "C" );
-			BOOST_TEST_REQUIRE( prefix == "a" );
-			BOOST_TEST_REQUIRE( suffix == "d" );
-		}
-	} else {
-		clearVector(charList);
-		clearVector(fnList);
-		BOOST_ERROR( "Wrong size" );
-	}
+	BOOST_TEST_REQUIRE( parsed.strings.size() == 2u );
+	BOOST_TEST_REQUIRE( parsed.tags.size() == 1u );
+	auto& tag = parsed.tags[0];
+	auto args = tagArguments(parsed, tag);
+	BOOST_TEST_REQUIRE( tag.varName == "var" );
+	BOOST_TEST_REQUIRE( tag.name[0] == 'F' );
+	BOOST_TEST_REQUIRE( tag.name[1] == '\0' );
+	BOOST_TEST_REQUIRE( (tag.type == TagType::HASH_ARG) );
+	BOOST_TEST_REQUIRE( args.size() == 2u );
+	BOOST_TEST_REQUIRE( args[0].key == "b" );
+	BOOST_TEST_REQUIRE( args[0].value == "B" );
+	BOOST_TEST_REQUIRE( args[1].key == "c" );
+	BOOST_TEST_REQUIRE( args[1].value == "C" );
+	BOOST_TEST_REQUIRE( parsed.strings[0] == "a" );
+	BOOST_TEST_REQUIRE( parsed.strings[1] == "d" );
 }
 
 BOOST_AUTO_TEST_CASE( testNoVarFunctionHashArgWrongFormat ) {
 	std::string_view testTemplate{"a%{+F }%c"};
 	
-	auto[charList, fnList] = mls::preparse::preparse_template(testTemplate);
+	auto parsed = mls::preparse::preparse_syntax(testTemplate);
 	
-	if( charList.size() == 2 && fnList.size() == 1) {
-		clearVector(charList);
-		
-		auto fn = fnList[0];
-		if( fn != nullptr ) {
-			delete fn;
-			BOOST_ERROR( "Function returned on wrong template" );
+	BOOST_TEST_REQUIRE( parsed.strings.size() == 2u );
+	BOOST_TEST_REQUIRE( parsed.tags.size() == 1u );
+	BOOST_TEST_REQUIRE( parsed.tags[0].isComment );
+	BOOST_TEST_REQUIRE( parsed.arguments.empty() );
+}
+
+BOOST_AUTO_TEST_CASE( testLiteralParsedAtCompileTime ) {
+	using namespace mls::preparse;
+	constexpr auto& syntax = literal_syntax<"%{n!I=general}% file%{n!P a={} b={s}}%%{#note#}%">;
+	static_assert( syntax.strings.size() == 4u );
+	static_assert( syntax.tags.size() == 3u );
+	static_assert( syntax.arguments.size() == 3u );
+	static_assert( syntax.tags[0].name[0] == 'I' && syntax.tags[0].varName == "n" );
+	static_assert( syntax.tags[1].type == TagType::HASH_ARG );
+	static_assert( syntax.tags[2].isComment );
+	
+	//the same grammar runs at run time
+	auto parsed = preparse_syntax("%{n!I=general}% file%{n!P a={} b={s}}%%{#note#}%");
+	BOOST_TEST_REQUIRE( parsed.strings.size() == syntax.strings.size() );
+	for(std::size_t i=0u; i<parsed.strings.size(); ++i) {
+		BOOST_TEST_REQUIRE( parsed.strings[i] == syntax.strings[i] );
+	}
+	BOOST_TEST_REQUIRE( parsed.arguments.size() == syntax.arguments.size() );
+	for(std::size_t i=0u; i<parsed.arguments.size(); ++i) {
+		BOOST_TEST_REQUIRE( parsed.arguments[i].key == syntax.arguments[i].key );
+		BOOST_TEST_REQUIRE( parsed.arguments[i].value == syntax.arguments[i].value );
+	}
+}
+
+BOOST_AUTO_TEST_CASE( testFindTextMatchesStringView ) {
+	//tag markers of any length, as set by `MULANSTR_TAG_START` and `MULANSTR_TAG_END`
+	const std::string_view markers[] = {"%{", "}%", "[[", "<<<", "|", "{{{{{"};
+	for(auto marker : markers) {
+		for(std::size_t length : {0u, 1u, 15u, 16u, 17u, 31u, 32u, 33u, 47u, 64u, 100u, 257u, 600u}) {
+			std::string text(length, 'a');
+			//the marker not found, partial markers, and the marker at every position
+			BOOST_TEST_REQUIRE( mls::preparse::find_text(text, marker) == std::string_view{text}.find(marker) );
+			if( length > 0u ) {
+				text[length / 2] = marker.front();
+				text.back() = marker.back();
+				BOOST_TEST_REQUIRE( mls::preparse::find_text(text, marker) == std::string_view{text}.find(marker) );
+			}
+			for(std::size_t pos=0u; pos + marker.size() <= length; ++pos) {
+				std::string withMarker(length, 'a');
+				withMarker.replace(pos, marker.size(), marker);
+				BOOST_TEST_REQUIRE( mls::preparse::find_text(withMarker, marker) == pos );
+			}
 		}
-	} else {
-		clearVector(charList);
-		clearVector(fnList);
 	}
+	BOOST_TEST_REQUIRE( mls::preparse::find_text("abc", "") == 0u );
+}
+
+BOOST_AUTO_TEST_CASE( testLongTemplate ) {
+	std::string paragraph(1000, 'x');
+	auto parsed = mls::preparse::preparse_syntax(paragraph + "%{a}%" + paragraph + "%{b}%" + paragraph);
+	
+	BOOST_TEST_REQUIRE( parsed.strings.size() == 3u );
+	BOOST_TEST_REQUIRE( parsed.tags.size() == 2u );
+	BOOST_TEST_REQUIRE( parsed.strings[1] == paragraph );
+	BOOST_TEST_REQUIRE( parsed.tags[0].varName == "a" );
+	BOOST_TEST_REQUIRE( parsed.tags[1].varName == "b" );
 }
@@ -0,0 +1,213 @@
+/**
+ * @file catalogc.cpp
+ * @brief Compiles translations of `.po` or `.mo` files into template catalogs read by `mls::backend::TemplateCatalog`
+ *
+ * Usage: `mls-catalogc -l <locale> [-d <locale data file>...] -o <output file> <.po or .mo file>`.
+ * Every translation is checked as a template of the locale, so a broken one stops the build with its message id.
+ */
+
+#include <catalog.h>
+#include <locale_data.h>
+#include <errors.h>
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+	
+	typedef std::vector<std::pair<std::string, std::string>> Messages;
+	
+	[[noreturn]] void fail(const std::string& path, int lineNo, const std::string& message) {
+		throw mls::InvalidCatalog(path + ":" + std::to_string(lineNo) + ": " + message);
+	}
+	
+	///reads a quoted string of a .po file with its escape sequences
+	std::string readQuoted(std::string_view text, const std::string& path, int lineNo) {
+		auto start = text.find('"');
+		auto end = text.rfind('"');
+		if( start == std::string_view::npos || end == start ) {
+			fail(path, lineNo, "no quoted string");
+		}
+		std::string result;
+		for(auto i=start + 1u; i<end; ++i) {
+			if( text[i] != '\\' || i + 1u == end ) {
+				result += text[i];
+				continue;
+			}
+			switch( text[++i] ) {
+				case 'n': result += '\n'; break;
+				case 't': result += '\t'; break;
+				case 'r': result += '\r'; break;
+				case 'a': result += '\a'; break;
+				case 'b': result += '\b'; break;
+				case 'f': result += '\f'; break;
+				case 'v': result += '\v'; break;
+				default: result += text[i];
+			}
+		}
+		return result;
+	}
+	
+	/**
+	 * @brief Reads translated messages of a .po file
+	 * 
+	 * Like `msgfmt`, it leaves out fuzzy and untranslated messages. A plural message gives its first form.
+	 */
+	Messages readPoFile(const std::string& path) {
+		std::ifstream file{path};
+		if( !file ) {
+			throw mls::InvalidCatalog("Can't read \"" + path + "\"");
+		}
+		Messages result;
+		std::string context, msgid, msgstr;
+		bool hasContext = false, fuzzy = false, fuzzyNext = false;
+		bool entryStarted = false, hasTranslation = false;
+		//the text continued by following quoted lines
+		std::string* field = nullptr;
+		
+		auto finish = [&]() {
+			if( !msgid.empty() && !msgstr.empty() && !fuzzy ) {
+				result.emplace_back( hasContext ? context + '\x04' + msgid : msgid, msgstr );
+			}
+			context.clear();
+			msgid.clear();
+			msgstr.clear();
+			hasContext = false;
+			entryStarted = false;
+			hasTranslation = false;
+			field = nullptr;
+		};
+		
+		std::string line;
+		for(int lineNo = 1; std::getline(file, line); ++lineNo) {
+			std::string_view text{line};
+			while( !text.empty() && (text.back() == '\r' || text.back() == ' ') ) {
+				text.remove_suffix(1u);
+			}
+			if( text.empty() ) {
+				continue;
+			}
+			if( text.starts_with("#,") ) {
+				fuzzyNext = fuzzyNext || text.find("fuzzy") != std::string_view::npos;
+				continue;
+			}
+			if( text.starts_with('#') ) {
+				continue;
+			}
+			if( text.starts_with('"') ) {
+				if( field == nullptr ) {
+					fail(path, lineNo, "a string out of any field");
+				}
+				*field += readQuoted(text, path, lineNo);
+				continue;
+			}
+			
+			if( text.starts_with("msgctxt ") || text.starts_with("msgid ") ) {
+				if( hasTranslation ) {
+					finish();
+				}
+				//flags are written before the message they belong to
+				if( !entryStarted ) {
+					entryStarted = true;
+					fuzzy = fuzzyNext;
+					fuzzyNext = false;
+				}
+			}
+			if( text.starts_with("msgctxt ") ) {
+				hasContext = true;
+				field = &context;
+			} else if( text.starts_with("msgid_plural ") ) {
+				//the id of a plural message is its singular form
+				field = nullptr;
+				continue;
+			} else if( text.starts_with("msgid ") ) {
+				field = &msgid;
+			} else if( text.starts_with("msgstr ") || text.starts_with("msgstr[0] ") ) {
+				hasTranslation = true;
+				field = &msgstr;
+			} else if( text.starts_with("msgstr[") ) {
+				//other plural forms aren't used, templates choose forms themselves
+				hasTranslation = true;
+				field = nullptr;
+				continue;
+			} else {
+				fail(path, lineNo, "unknown keyword");
+			}
+			*field = readQuoted(text, path, lineNo);
+		}
+		finish();
+		return result;
+	}
+	
+	///reads translated messages of a .mo file, without its header entry
+	Messages readMoFile(const std::string& path, mls::locale::Locale& locale) {
+		mls::backend::Catalog catalog{path, locale};
+		Messages result;
+		for(std::size_t index=0u; index<catalog.size(); ++index) {
+			if( !catalog.original(index).empty() ) {
+				result.emplace_back( std::string{catalog.original(index)}, std::string{catalog.translation(index)} );
+			}
+		}
+		return result;
+	}
+	
+	///prints every translation which isn't a valid template, returns `false` if there was one
+	bool checkTranslations(const std::string& path, const Messages& messages, mls::locale::Locale& locale) {
+		bool allValid = true;
+		for(auto& [key, translation] : messages) {
+			try {
+				mls::CompiledTemplate compiled{translation, locale};
+			} catch(const mls::InvalidTemplateState& error) {
+				std::fprintf(stderr, "%s: msgid \"%s\": %s\n", path.c_str(), key.c_str(), error.what());
+				allValid = false;
+			}
+		}
+		return allValid;
+	}
+
+};
+
+int main(int argc, char** argv) {
+	std::string output, input, localeName;
+	std::vector<std::string> localeData;
+	for(int i=1; i<argc; ++i) {
+		std::string option{argv[i]};
+		if( option == "-o" && i + 1 < argc ) {
+			output = argv[++i];
+		} else if( option == "-l" && i + 1 < argc ) {
+			localeName = argv[++i];
+		} else if( option == "-d" && i + 1 < argc ) {
+			localeData.push_back(argv[++i]);
+		} else {
+			input = option;
+		}
+	}
+	if( output.empty() || input.empty() || localeName.empty() ) {
+		std::fprintf(stderr, "Usage: %s -l <locale> [-d <locale data file>...] -o <output file> <.po or .mo file>\n", argv[0]);
+		return 1;
+	}
+	
+	try {
+		for(auto& path : localeData) {
+			mls::locale::loadLocaleData(path);
+		}
+		auto* locale = mls::locale::findLocale(localeName);
+		if( locale == nullptr ) {
+			std::fprintf(stderr, "Unknown locale \"%s\"\n", localeName.c_str());
+			return 1;
+		}
+		
+		Messages messages = input.ends_with(".mo") ? readMoFile(input, *locale) : readPoFile(input);
+		if( !checkTranslations(input, messages, *locale) ) {
+			return 1;
+		}
+		mls::backend::writeTemplateCatalog(output, *locale, messages);
+	} catch(const std::exception& error) {
+		std::fprintf(stderr, "%s\n", error.what());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,195 @@
+/**
+ * @file localegen.cpp
+ * @brief Writes binary locale data files read by `mls::locale::loadLocaleData(...)`
+ *
+ * Usage: `mls-localegen [--builtin] -o <output file> [<locales file>...]`.
+ * `--builtin` also writes the locales built into the library, see `locales.txt` for the format of locales files.
+ */
+
+#include <locale_data.h>
+#include <errors.h>
+
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+	
+	///a locale being read, its strings live in `Generator::texts`
+	struct LocaleDescription {
+		std::string_view name;
+		std::string pluralRules;
+		std::vector<const char*> cases;
+		std::vector<const char*> genders;
+		std::vector<mls::locale::NamedNumberFormat> formats;
+	};
+	
+	class Generator {
+			///texts pointed to by locales, which never move
+			std::deque<std::string> texts;
+			std::deque<mls::locale::Locale> locales;
+			std::vector<mls::locale::LocaleAlias> aliases;
+			
+			const char* keep(std::string text) {
+				return texts.emplace_back(std::move(text)).c_str();
+			}
+			
+			[[noreturn]] static void fail(const std::string& path, int lineNo, const std::string& message) {
+				throw mls::InvalidLocaleData(path + ":" + std::to_string(lineNo) + ": " + message);
+			}
+			
+			///reads a word, or a text in quotes
+			static bool readToken(std::istringstream& line, std::string& token) {
+				line >> std::ws;
+				if( line.peek() != '"' ) {
+					return static_cast<bool>(line >> token);
+				}
+				line.get();
+				return static_cast<bool>(std::getline(line, token, '"'));
+			}
+			
+			void addLocale(std::optional<LocaleDescription>& description, const std::string& path) {
+				if( !description.has_value() ) {
+					return;
+				}
+				try {
+					locales.emplace_back(
+						description->name,
+						mls::locale::PluralRules(description->pluralRules),
+						std::move(description->cases),
+						std::move(description->genders),
+						std::move(description->formats)
+					);
+				} catch(const mls::InvalidPluralRules& error) {
+					throw mls::InvalidLocaleData(path + ": " + error.what());
+				}
+				description.reset();
+			}
+		public:
+			void addBuiltIn() {
+				for(auto& definition : mls::locale::builtInLocales()) {
+					locales.emplace_back(definition);
+					for(auto alias : definition.aliases) {
+						aliases.push_back( mls::locale::LocaleAlias{alias, definition.name} );
+					}
+				}
+			}
+			
+			void readFile(const std::string& path) {
+				std::ifstream file{path};
+				if( !file ) {
+					throw mls::InvalidLocaleData("Can't read \"" + path + "\"");
+				}
+				std::optional<LocaleDescription> description;
+				std::string text;
+				for(int lineNo = 1; std::getline(file, text); ++lineNo) {
+					std::istringstream line{text};
+					std::string keyword;
+					if( !(line >> keyword) || keyword.starts_with('#') ) {
+						continue;
+					}
+					if( keyword == "locale" ) {
+						addLocale(description, path);
+						std::string name;
+						if( !(line >> name) ) {
+							fail(path, lineNo, "no name of the locale");
+						}
+						description.emplace();
+						description->name = keep(name);
+						continue;
+					}
+					if( !description.has_value() ) {
+						fail(path, lineNo, "\"" + keyword + "\" before the first locale");
+					}
+					
+					std::string word;
+					if( keyword == "alias" ) {
+						while( line >> word ) {
+							aliases.push_back( mls::locale::LocaleAlias{keep(word), description->name} );
+						}
+					} else if( keyword == "plurals" ) {
+						std::getline(line >> std::ws, description->pluralRules);
+						if( description->pluralRules.starts_with("cldr ") ) {
+							const char* rules = mls::locale::cldrPluralRules(description->pluralRules.substr(5));
+							if( rules == nullptr ) {
+								fail(path, lineNo, "no CLDR plural rules of \"" + description->pluralRules.substr(5) + "\"");
+							}
+							description->pluralRules = rules;
+						}
+					} else if( keyword == "cases" ) {
+						while( line >> word ) {
+							description->cases.push_back( keep(word) );
+						}
+					} else if( keyword == "genders" ) {
+						while( line >> word ) {
+							description->genders.push_back( keep(word) );
+						}
+					} else if( keyword == "format" ) {
+						std::string name, groupChar, fractionChar;
+						if( !(line >> name) || !readToken(line, groupChar) || !readToken(line, fractionChar) ) {
+							fail(path, lineNo, "a format needs a name, a grouping character and a fraction separator");
+						}
+						std::vector<unsigned char> schema;
+						for(unsigned size; line >> size; ) {
+							schema.push_back( static_cast<unsigned char>(size) );
+						}
+						description->formats.push_back( mls::locale::NamedNumberFormat{
+							keep(name),
+							mls::locale::NumberFormat{keep(groupChar), keep(fractionChar), schema}
+						} );
+					} else {
+						fail(path, lineNo, "unknown setting \"" + keyword + "\"");
+					}
+				}
+				addLocale(description, path);
+			}
+			
+			void write(const std::string& path) const {
+				std::vector<const mls::locale::Locale*> written;
+				for(auto& locale : locales) {
+					written.push_back(&locale);
+				}
+				mls::locale::writeLocaleData(path, written, aliases);
+			}
+	};
+
+};
+
+int main(int argc, char** argv) {
+	Generator generator;
+	std::string output;
+	std::vector<std::string> inputs;
+	bool builtIn = false;
+	for(int i=1; i<argc; ++i) {
+		std::string option{argv[i]};
+		if( option == "--builtin" ) {
+			builtIn = true;
+		} else if( option == "-o" && i + 1 < argc ) {
+			output = argv[++i];
+		} else {
+			inputs.push_back(option);
+		}
+	}
+	if( output.empty() ) {
+		std::fprintf(stderr, "Usage: %s [--builtin] -o <output file> [<locales file>...]\n", argv[0]);
+		return 1;
+	}
+	
+	try {
+		if( builtIn ) {
+			generator.addBuiltIn();
+		}
+		for(auto& input : inputs) {
+			generator.readFile(input);
+		}
+		generator.write(output);
+	} catch(const std::exception& error) {
+		std::fprintf(stderr, "%s\n", error.what());
+		return 1;
+	}
+	return 0;
+}